@@ -69,12 +69,15 @@ void Application::Initialize() {
     auto codec = board.GetAudioCodec();
     audio_service_.Initialize(codec);
     audio_service_.Start();
+    audio_sender_.OnSent([this]() { wake_word_latency_.OnUplinkAudio(); });
+    audio_sender_.Start();
 
     AudioServiceCallbacks callbacks;
     callbacks.on_send_queue_available = [this]() {
-        xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
+        audio_sender_.Notify();
     };
     callbacks.on_wake_word_detected = [this](const std::string& wake_word) {
+        wake_word_latency_.OnDetected();
         xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
     };
     callbacks.on_vad_change = [this](bool speaking) {
@@ -170,7 +173,7 @@ void Application::Run() {
     vTaskPrioritySet(nullptr, 10);
 
     const EventBits_t ALL_EVENTS =
-        MAIN_EVENT_SCHEDULE | MAIN_EVENT_SEND_AUDIO | MAIN_EVENT_WAKE_WORD_DETECTED |
+        MAIN_EVENT_SCHEDULE | MAIN_EVENT_WAKE_WORD_DETECTED |
         MAIN_EVENT_VAD_CHANGE | MAIN_EVENT_CLOCK_TICK | MAIN_EVENT_ERROR |
         MAIN_EVENT_NETWORK_CONNECTED | MAIN_EVENT_NETWORK_DISCONNECTED | MAIN_EVENT_TOGGLE_CHAT |
         MAIN_EVENT_START_LISTENING | MAIN_EVENT_STOP_LISTENING | MAIN_EVENT_ACTIVATION_DONE |
@@ -223,20 +226,6 @@ void Application::Run() {
             HandleStopListeningEvent();
         }
 
-        if (bits & MAIN_EVENT_SEND_AUDIO) {
-            while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-                if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
-                    // Drop the remaining packets. Leaving them in the queue would
-                    // stall the Opus codec task (it waits for queue space), which in
-                    // turn deadlocks the whole audio input pipeline, as no new
-                    // MAIN_EVENT_SEND_AUDIO event would ever be triggered again.
-                    while (audio_service_.PopPacketFromSendQueue())
-                        ;
-                    break;
-                }
-            }
-        }
-
         if (bits & MAIN_EVENT_WAKE_WORD_DETECTED) {
             HandleWakeWordDetectedEvent();
         }
@@ -261,10 +250,15 @@ void Application::Run() {
             clock_ticks_++;
             auto display = Board::GetInstance().GetDisplay();
             display->UpdateStatusBar();
+#if CONFIG_AUDIO_CHANNEL_PRECONNECT
+            UpdateWarmAudioChannel();
+#endif
 
             // Print debug info every 10 seconds
             if (clock_ticks_ % 10 == 0) {
                 SystemInfo::PrintHeapStats();
+                audio_service_.PrintDebugStatistics();
+                audio_sender_.PrintStatistics();
                 // SystemInfo::PrintTaskList();
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
             }
@@ -305,6 +299,7 @@ void Application::HandleNetworkDisconnectedEvent() {
     if (state == kDeviceStateConnecting || state == kDeviceStateListening ||
         state == kDeviceStateSpeaking) {
         ESP_LOGI(TAG, "Closing audio channel due to network disconnection");
+        WaitForPreconnect();
         protocol_->CloseAudioChannel();
     }
 
@@ -334,6 +329,9 @@ void Application::HandleActivationDoneEvent() {
     Schedule([this]() {
         // Play the success sound to indicate the device is ready
         audio_service_.PlaySound(Lang::Sounds::OGG_SUCCESS);
+        // Have the opus decode task decode the prompts played on every wake up or error ahead of time
+        audio_service_.PreloadSound(Lang::Sounds::OGG_POPUP);
+        audio_service_.PreloadSound(Lang::Sounds::OGG_EXCLAMATION);
     });
 }
 
@@ -499,6 +497,8 @@ void Application::InitializeProtocol() {
 
     display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
 
+    // The sender must let go of a previous protocol before it is replaced
+    audio_sender_.SetProtocol(nullptr);
     if (ota_->HasMqttConfig()) {
         protocol_ = std::make_unique<MqttProtocol>();
     } else if (ota_->HasWebsocketConfig()) {
@@ -511,18 +511,33 @@ void Application::InitializeProtocol() {
     protocol_->OnConnected([this]() { DismissAlert(); });
 
     protocol_->OnNetworkError([this](const std::string& message) {
+        if (preconnecting_) {
+            // Not worth an alert, the channel is opened again when a conversation starts
+            ESP_LOGW(TAG, "Pre-connect failed: %s", message.c_str());
+            return;
+        }
         last_error_message_ = message;
         xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
     });
 
+    protocol_->SetAudioPacketAllocator([this]() {
+        return audio_service_.AcquirePacket();
+    });
+    protocol_->SetAudioPacketRecycler([this](std::unique_ptr<AudioStreamPacket> packet) {
+        audio_service_.RecyclePacket(std::move(packet));
+    });
     protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
         if (GetDeviceState() == kDeviceStateSpeaking) {
+            wake_word_latency_.OnDownlinkAudio();
             audio_service_.PushPacketToDecodeQueue(std::move(packet));
+        } else {
+            audio_service_.RecyclePacket(std::move(packet));
         }
     });
 
     protocol_->OnAudioChannelOpened([this, codec, &board]() {
         board.SetPowerSaveLevel(PowerSaveLevel::PERFORMANCE);
+        audio_service_.ResetUplinkRate(protocol_->max_uplink_frame_duration());
         if (protocol_->server_sample_rate() != codec->output_sample_rate()) {
             ESP_LOGW(TAG,
                      "Server sample rate %d does not match device output sample rate %d, "
@@ -540,14 +555,18 @@ void Application::InitializeProtocol() {
         });
     });
 
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (!cJSON_IsString(type)) {
+    protocol_->OnIncomingJson([this, display](const JsonMessage& json) {
+        const std::string& type = json.type();
+        if (type.empty()) {
             ESP_LOGW(TAG, "Incoming JSON message has no type");
             return;
         }
-        if (strcmp(type->valuestring, "tts") == 0) {
+        auto root = json.root();
+        if (root == nullptr) {
+            ESP_LOGW(TAG, "Invalid JSON message of type %s", type.c_str());
+            return;
+        }
+        if (type == "tts") {
             auto state = cJSON_GetObjectItem(root, "state");
             if (!cJSON_IsString(state)) {
                 return;
@@ -558,7 +577,7 @@ void Application::InitializeProtocol() {
                     SetDeviceState(kDeviceStateSpeaking);
                 });
             } else if (strcmp(state->valuestring, "stop") == 0) {
-                Schedule([this]() {
+                Schedule([this, display]() {
                     if (GetDeviceState() == kDeviceStateSpeaking) {
                         if (listening_mode_ == kListeningModeManualStop) {
                             SetDeviceState(kDeviceStateIdle);
@@ -566,13 +585,14 @@ void Application::InitializeProtocol() {
                             SetDeviceState(kDeviceStateListening);
                         }
                     }
+                    display->PersistTextGlyphs();
                 });
             } else if (strcmp(state->valuestring, "sentence_start") == 0) {
                 auto text = cJSON_GetObjectItem(root, "text");
                 if (cJSON_IsString(text)) {
                     std::vector<TextGlyph> glyphs;
                     uint8_t bpp = 0;
-                    if (!TextGlyphPayload::Parse(root, glyphs, bpp)) {
+                    if (!TextGlyphPayload::Parse(json.Member("glyph_push"), glyphs, bpp)) {
                         glyphs.clear();
                     }
                     ESP_LOGI(TAG, "<< %s", text->valuestring);
@@ -583,12 +603,12 @@ void Application::InitializeProtocol() {
                     });
                 }
             }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
+        } else if (type == "stt") {
             auto text = cJSON_GetObjectItem(root, "text");
             if (cJSON_IsString(text)) {
                 std::vector<TextGlyph> glyphs;
                 uint8_t bpp = 0;
-                if (!TextGlyphPayload::Parse(root, glyphs, bpp)) {
+                if (!TextGlyphPayload::Parse(json.Member("glyph_push"), glyphs, bpp)) {
                     glyphs.clear();
                 }
                 ESP_LOGI(TAG, ">> %s", text->valuestring);
@@ -598,19 +618,19 @@ void Application::InitializeProtocol() {
                     display->SetChatMessage("user", message.c_str());
                 });
             }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
+        } else if (type == "llm") {
             auto emotion = cJSON_GetObjectItem(root, "emotion");
             if (cJSON_IsString(emotion)) {
                 Schedule([display, emotion_str = std::string(emotion->valuestring)]() {
                     display->SetEmotion(emotion_str.c_str());
                 });
             }
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
+        } else if (type == "mcp") {
             auto payload = cJSON_GetObjectItem(root, "payload");
             if (cJSON_IsObject(payload)) {
                 McpServer::GetInstance().ParseMessage(payload);
             }
-        } else if (strcmp(type->valuestring, "system") == 0) {
+        } else if (type == "system") {
             auto command = cJSON_GetObjectItem(root, "command");
             if (cJSON_IsString(command)) {
                 ESP_LOGI(TAG, "System command: %s", command->valuestring);
@@ -621,7 +641,7 @@ void Application::InitializeProtocol() {
                     ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
                 }
             }
-        } else if (strcmp(type->valuestring, "alert") == 0) {
+        } else if (type == "alert") {
             auto status = cJSON_GetObjectItem(root, "status");
             auto message = cJSON_GetObjectItem(root, "message");
             auto emotion = cJSON_GetObjectItem(root, "emotion");
@@ -632,7 +652,7 @@ void Application::InitializeProtocol() {
                 ESP_LOGW(TAG, "Alert command requires status, message and emotion");
             }
 #if CONFIG_RECEIVE_CUSTOM_MESSAGE
-        } else if (strcmp(type->valuestring, "custom") == 0) {
+        } else if (type == "custom") {
             auto payload = cJSON_GetObjectItem(root, "payload");
             ESP_LOGI(TAG, "Received custom message: %s", cJSON_PrintUnformatted(root));
             if (cJSON_IsObject(payload)) {
@@ -645,11 +665,12 @@ void Application::InitializeProtocol() {
             }
 #endif
         } else {
-            ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
+            ESP_LOGW(TAG, "Unknown message type: %s", type.c_str());
         }
     });
 
     protocol_->Start();
+    audio_sender_.SetProtocol(protocol_.get());
 }
 
 void Application::ShowActivationCode(const std::string& code, const std::string& message) {
@@ -726,7 +747,7 @@ void Application::HandleToggleChatEvent() {
 
     if (state == kDeviceStateIdle) {
         ListeningMode mode = GetDefaultListeningMode();
-        if (!protocol_->IsAudioChannelOpened()) {
+        if (preconnecting_ || !protocol_->IsAudioChannelOpened()) {
             SetDeviceState(kDeviceStateConnecting);
             // Schedule to let the state change be processed first (UI update)
             Schedule([this, mode]() { ContinueOpenAudioChannel(mode); });
@@ -750,6 +771,7 @@ void Application::ContinueOpenAudioChannel(ListeningMode mode) {
     auto& board = Board::GetInstance();
     board.SetPowerSaveLevel(PowerSaveLevel::PERFORMANCE);
 
+    WaitForPreconnect();
     if (!protocol_->IsAudioChannelOpened()) {
         if (!protocol_->OpenAudioChannel()) {
             // Return to idle so the device is not stuck in the connecting
@@ -780,7 +802,7 @@ void Application::HandleStartListeningEvent() {
     }
 
     if (state == kDeviceStateIdle) {
-        if (!protocol_->IsAudioChannelOpened()) {
+        if (preconnecting_ || !protocol_->IsAudioChannelOpened()) {
             SetDeviceState(kDeviceStateConnecting);
             // Schedule to let the state change be processed first (UI update)
             Schedule([this]() { ContinueOpenAudioChannel(kListeningModeManualStop); });
@@ -819,21 +841,26 @@ void Application::HandleWakeWordDetectedEvent() {
 
     if (state == kDeviceStateIdle) {
         BeginWakeWordInvoke(wake_word);
-    } else if (state == kDeviceStateSpeaking || state == kDeviceStateListening) {
+        return;
+    }
+    // Only invocations from idle are measured
+    wake_word_latency_.Cancel();
+    if (state == kDeviceStateSpeaking || state == kDeviceStateListening) {
         AbortSpeaking(kAbortReasonWakeWordDetected);
         // Clear send queue to avoid sending residues to server
-        while (audio_service_.PopPacketFromSendQueue())
-            ;
+        while (auto packet = audio_service_.PopPacketFromSendQueue()) {
+            audio_service_.RecyclePacket(std::move(packet));
+        }
 
+        audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
         if (state == kDeviceStateListening) {
             protocol_->SendStartListening(GetDefaultListeningMode());
             audio_service_.ResetDecoder();
-            audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
             // Re-enable wake word detection as it was stopped by the detection itself
             audio_service_.EnableWakeWordDetection(true);
         } else {
-            // Play popup sound and start listening again
-            play_popup_on_listening_ = true;
+            // Start listening again
+            restart_listening_audio_ = true;
             SetListeningMode(GetDefaultListeningMode());
         }
     } else if (state == kDeviceStateActivating) {
@@ -845,6 +872,9 @@ void Application::HandleWakeWordDetectedEvent() {
 void Application::BeginWakeWordInvoke(const std::string& wake_word) {
     // Must run in the main task with the device in idle state
     audio_service_.EncodeWakeWord();
+    // A channel still being pre-connected counts as cold
+    bool opened = !preconnecting_ && protocol_->IsAudioChannelOpened();
+    wake_word_latency_.Start(opened);
 
     // Always pass through the connecting state, even if the audio channel is
     // already opened. ContinueWakeWordInvoke() rejects any other state, so
@@ -856,7 +886,7 @@ void Application::BeginWakeWordInvoke(const std::string& wake_word) {
         return;
     }
 
-    if (!protocol_->IsAudioChannelOpened()) {
+    if (!opened) {
         // Schedule to let the state change be processed first (UI update),
         // then continue with OpenAudioChannel which may block for ~1 second
         Schedule([this, wake_word]() { ContinueWakeWordInvoke(wake_word); });
@@ -876,6 +906,7 @@ void Application::ContinueWakeWordInvoke(const std::string& wake_word) {
     auto& board = Board::GetInstance();
     board.SetPowerSaveLevel(PowerSaveLevel::PERFORMANCE);
 
+    WaitForPreconnect();
     if (!protocol_->IsAudioChannelOpened()) {
         if (!protocol_->OpenAudioChannel()) {
             // Return to idle so the device is not stuck in the connecting
@@ -890,15 +921,18 @@ void Application::ContinueWakeWordInvoke(const std::string& wake_word) {
 #if CONFIG_SEND_WAKE_WORD_DATA
     // Encode and send the wake word data to the server
     while (auto packet = audio_service_.PopWakeWordPacket()) {
-        protocol_->SendAudio(std::move(packet));
+        if (protocol_->SendAudio(*packet)) {
+            wake_word_latency_.OnUplinkAudio();
+        }
+        audio_service_.RecyclePacket(std::move(packet));
     }
     // Set the chat state to wake word detected
     protocol_->SendWakeWordDetected(wake_word);
     SetListeningMode(GetDefaultListeningMode());
 #else
-    // Set flag to play popup sound after state changes to listening
-    // (PlaySound here would be cleared by ResetDecoder in EnableVoiceProcessing)
-    play_popup_on_listening_ = true;
+    // Sound effects are not flushed by ResetDecoder in EnableVoiceProcessing
+    audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
+    restart_listening_audio_ = true;
     SetListeningMode(GetDefaultListeningMode());
 #endif
 }
@@ -923,6 +957,15 @@ void Application::HandleStateChangedEvent() {
             display->SetEmotion("neutral");  // Then set emotion (wechat mode checks child count)
             audio_service_.EnableVoiceProcessing(false);
             audio_service_.EnableWakeWordDetection(true);
+            wake_word_latency_.Cancel();
+#if CONFIG_AUDIO_CHANNEL_PRECONNECT
+            if (in_conversation_) {
+                // Keep the channel warm for a follow-up wake word, reopened if the server closed it
+                in_conversation_ = false;
+                warm_channel_ticks_ = CONFIG_AUDIO_CHANNEL_WARM_SECONDS;
+                warm_channel_reopened_ = false;
+            }
+#endif
             break;
         case kDeviceStateConnecting:
             display->SetStatus(Lang::Strings::CONNECTING);
@@ -932,9 +975,10 @@ void Application::HandleStateChangedEvent() {
         case kDeviceStateListening:
             display->SetStatus(Lang::Strings::LISTENING);
             display->SetEmotion("neutral");
+            in_conversation_ = true;
 
             // Make sure the audio processor is running
-            if (play_popup_on_listening_ || !audio_service_.IsAudioProcessorRunning()) {
+            if (restart_listening_audio_ || !audio_service_.IsAudioProcessorRunning()) {
                 // For auto mode, wait for the playback queue to drain before enabling
                 // voice processing. This prevents audio truncation when STOP arrives
                 // late due to network jitter. Instead of blocking the main loop here,
@@ -950,6 +994,7 @@ void Application::HandleStateChangedEvent() {
             break;
         case kDeviceStateSpeaking:
             display->SetStatus(Lang::Strings::SPEAKING);
+            in_conversation_ = true;
 
             if (listening_mode_ != kListeningModeRealtime) {
                 audio_service_.EnableVoiceProcessing(false);
@@ -979,13 +1024,9 @@ void Application::StartListeningAudio() {
     protocol_->SendStartListening(listening_mode_);
     audio_service_.EnableVoiceProcessing(true);
 
-    ConfigureWakeWordForListening();
+    restart_listening_audio_ = false;
 
-    // Play popup sound after ResetDecoder (in EnableVoiceProcessing) has been called
-    if (play_popup_on_listening_) {
-        play_popup_on_listening_ = false;
-        audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
-    }
+    ConfigureWakeWordForListening();
 }
 
 void Application::ConfigureWakeWordForListening() {
@@ -1026,9 +1067,11 @@ ListeningMode Application::GetDefaultListeningMode() const {
 void Application::Reboot() {
     ESP_LOGI(TAG, "Rebooting...");
     // Disconnect the audio channel
+    WaitForPreconnect();
     if (protocol_ && protocol_->IsAudioChannelOpened()) {
         protocol_->CloseAudioChannel();
     }
+    audio_sender_.SetProtocol(nullptr);
     protocol_.reset();
     audio_service_.Stop();
 
@@ -1044,6 +1087,7 @@ bool Application::UpgradeFirmware(const std::string& url, const std::string& ver
     std::string version_info = version.empty() ? "(Manual upgrade)" : version;
 
     // Close audio channel if it's open
+    WaitForPreconnect();
     if (protocol_ && protocol_->IsAudioChannelOpened()) {
         ESP_LOGI(TAG, "Closing audio channel before firmware upgrade");
         protocol_->CloseAudioChannel();
@@ -1117,12 +1161,73 @@ void Application::WakeWordInvoke(const std::string& wake_word) {
     }
 }
 
+void Application::PreconnectAudioChannel() {
+#if CONFIG_AUDIO_CHANNEL_PRECONNECT
+    Schedule([this]() {
+        if (!protocol_ || GetDeviceState() != kDeviceStateIdle) {
+            return;
+        }
+        warm_channel_ticks_ = CONFIG_AUDIO_CHANNEL_WARM_SECONDS;
+        warm_channel_reopened_ = true;
+        if (!preconnecting_ && !protocol_->IsAudioChannelOpened()) {
+            StartPreconnect();
+        }
+    });
+#endif
+}
+
+void Application::StartPreconnect() {
+    // Runs in the main task. The channel is opened in its own task so the main loop,
+    // wake word and buttons stay responsive during the connect and the hello round trip.
+    ESP_LOGI(TAG, "Pre-connecting the audio channel");
+    preconnecting_ = true;
+    BaseType_t created = xTaskCreate(
+        [](void* arg) {
+            Application* app = static_cast<Application*>(arg);
+            app->protocol_->OpenAudioChannel();
+            app->preconnecting_ = false;
+            vTaskDelete(NULL);
+        },
+        "preconnect", 4096 * 2, this, 2, nullptr);
+    if (created != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create the pre-connect task");
+        preconnecting_ = false;
+    }
+}
+
+void Application::WaitForPreconnect() {
+    // The main task must not touch protocol_ while a pre-connect task is opening the channel
+    while (preconnecting_) {
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+}
+
+void Application::UpdateWarmAudioChannel() {
+    // Runs every second in the main loop
+    if (!protocol_ || GetDeviceState() != kDeviceStateIdle || warm_channel_ticks_ <= 0 || preconnecting_) {
+        return;
+    }
+    if (--warm_channel_ticks_ == 0) {
+        if (protocol_->IsAudioChannelOpened()) {
+            ESP_LOGI(TAG, "Closing the idle audio channel");
+            protocol_->CloseAudioChannel();
+        }
+        return;
+    }
+    // Reopen a channel the server closed, once per window so a server that drops
+    // idle channels is not reconnected to in a loop
+    if (!warm_channel_reopened_ && !protocol_->IsAudioChannelOpened()) {
+        warm_channel_reopened_ = true;
+        StartPreconnect();
+    }
+}
+
 bool Application::CanEnterSleepMode() {
     if (GetDeviceState() != kDeviceStateIdle) {
         return false;
     }
 
-    if (protocol_ && protocol_->IsAudioChannelOpened()) {
+    if (preconnecting_ || (protocol_ && protocol_->IsAudioChannelOpened())) {
         return false;
     }
 
@@ -1141,6 +1246,7 @@ void Application::RegisterMcpBroadcastCallback(std::function<void(const std::str
 void Application::SendMcpMessage(const std::string& payload) {
     // Always schedule to run in main task for thread safety
     Schedule([this, payload]() {
+        WaitForPreconnect();
         if (protocol_) {
             protocol_->SendMcpMessage(payload);
         }
@@ -1171,6 +1277,7 @@ void Application::SetAecMode(AecMode mode) {
         }
 
         // If the AEC mode is changed, close the audio channel
+        WaitForPreconnect();
         if (protocol_ && protocol_->IsAudioChannelOpened()) {
             protocol_->CloseAudioChannel();
         }
@@ -1182,10 +1289,12 @@ void Application::PlaySound(const std::string_view& sound) { audio_service_.Play
 void Application::ResetProtocol() {
     Schedule([this]() {
         // Close audio channel if opened
+        WaitForPreconnect();
         if (protocol_ && protocol_->IsAudioChannelOpened()) {
             protocol_->CloseAudioChannel();
         }
         // Reset protocol
+        audio_sender_.SetProtocol(nullptr);
         protocol_.reset();
     });
 }
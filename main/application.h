@@ -6,6 +6,7 @@
 #include <freertos/task.h>
 #include <esp_timer.h>
 
+#include <atomic>
 #include <string>
 #include <mutex>
 #include <deque>
@@ -15,12 +16,13 @@
 #include "protocol.h"
 #include "ota.h"
 #include "audio_service.h"
+#include "audio_sender.h"
 #include "device_state.h"
 #include "device_state_machine.h"
+#include "wake_word_latency.h"
 
 // Main event bits
 #define MAIN_EVENT_SCHEDULE             (1 << 0)
-#define MAIN_EVENT_SEND_AUDIO           (1 << 1)
 #define MAIN_EVENT_WAKE_WORD_DETECTED   (1 << 2)
 #define MAIN_EVENT_VAD_CHANGE           (1 << 3)
 #define MAIN_EVENT_ERROR                (1 << 4)
@@ -107,6 +109,13 @@ public:
 
     void Reboot();
     void WakeWordInvoke(const std::string& wake_word);
+
+    /**
+     * Hint that a conversation is likely to start soon (thread-safe)
+     * With CONFIG_AUDIO_CHANNEL_PRECONNECT, opens the audio channel in idle off the main task
+     * and keeps it open for CONFIG_AUDIO_CHANNEL_WARM_SECONDS. Does nothing otherwise.
+     */
+    void PreconnectAudioChannel();
     bool UpgradeFirmware(const std::string& url, const std::string& version = "");
     bool CanEnterSleepMode();
     void SendMcpMessage(const std::string& payload);
@@ -137,6 +146,7 @@ private:
     AecMode aec_mode_ = kAecOff;
     std::string last_error_message_;
     AudioService audio_service_;
+    AudioSender audio_sender_{audio_service_};
     std::unique_ptr<Ota> ota_;
 
     std::function<void(const std::string&)> mcp_broadcast_callback_;
@@ -144,10 +154,15 @@ private:
     bool has_server_time_ = false;
     bool aborted_ = false;
     bool assets_version_checked_ = false;
-    bool play_popup_on_listening_ = false;  // Flag to play popup sound after state changes to listening
+    bool restart_listening_audio_ = false;  // Restart listening audio when the state changes to listening
     bool pending_listening_start_ = false;  // Waiting for playback to drain before starting listening (auto mode)
     int clock_ticks_ = 0;
+    int warm_channel_ticks_ = 0;            // Seconds left of the warm window in idle
+    bool warm_channel_reopened_ = false;    // The warm window already reopened a closed channel
+    bool in_conversation_ = false;          // Entering idle ends a conversation and starts a warm window
+    std::atomic<bool> preconnecting_ = false;  // A pre-connect task owns protocol_ until it clears this
     TaskHandle_t activation_task_handle_ = nullptr;
+    WakeWordLatency wake_word_latency_;
 
 
     // Event handlers
@@ -164,6 +179,9 @@ private:
     void ContinueWakeWordInvoke(const std::string& wake_word);
     void StartListeningAudio();
     void ConfigureWakeWordForListening();
+    void UpdateWarmAudioChannel();
+    void StartPreconnect();
+    void WaitForPreconnect();
 
     // Activation task (runs in background)
     void ActivationTask();
@@ -1,10 +1,14 @@
 #include "assets.h"
+#include "assets_checksum.h"
+#include "download_resume.h"
+#include "partition_writer.h"
 #include "application.h"
 #include "board.h"
 #include "display.h"
 #include "emote_display.h"
 #include "expression_emote.h"
 #include "lvgl_theme.h"
+#include "settings.h"
 #if HAVE_LVGL
 #include <spi_flash_mmap.h>
 #include "display/lcd_display.h"
@@ -17,10 +21,13 @@
 #include <cbin_font.h>
 #include <noto_font_bundle.h>
 
+#include <cstdio>
 #include <cstring>
 
 #define TAG "Assets"
 #define PARTITION_LABEL "assets"
+// Settings key of the last assets header whose payload checksum was verified
+#define VERIFIED_KEY "verified"
 
 struct mmap_assets_table {
     char asset_name[32];   /*!< Name of the asset */
@@ -63,6 +70,9 @@ bool Assets::InitializePartition() {
 
 void Assets::UnApplyPartition() {
     UseBuiltInTextFontCapability();
+    if (on_unmap_partition_) {
+        on_unmap_partition_();
+    }
     if (strategy_) {
         strategy_->UnApplyPartition(this);
     }
@@ -84,6 +94,10 @@ bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
     return strategy_ ? strategy_->GetAssetData(this, name, ptr, size) : false;
 }
 
+bool Assets::GetSpareRegion(size_t size, size_t& offset, const char*& mapped) {
+    return strategy_ ? strategy_->GetSpareRegion(this, size, offset, mapped) : false;
+}
+
 bool Assets::LoadSrmodelsFromIndex(Assets* assets, cJSON* root) {
     void* ptr = nullptr;
     size_t size = 0;
@@ -135,14 +149,6 @@ bool Assets::LoadSrmodelsFromIndex(Assets* assets, cJSON* root) {
 }
 
 #if HAVE_LVGL
-uint32_t Assets::LvglStrategy::CalculateChecksum(const char* data, uint32_t length) {
-    uint32_t checksum = 0;
-    for (uint32_t i = 0; i < length; i++) {
-        checksum += data[i];
-    }
-    return checksum & 0xFFFF;
-}
-
 bool Assets::LvglStrategy::InitializePartition(Assets* assets) {
     assets->partition_valid_ = false;
     assets_.clear();
@@ -181,18 +187,43 @@ bool Assets::LvglStrategy::InitializePartition(Assets* assets) {
         return false;
     }
 
-    auto start_time = esp_timer_get_time();
-    uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
-    auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
-
-    if (calculated_checksum != stored_chksum) {
-        ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)",
-                 calculated_checksum, stored_chksum);
+    if (stored_files > stored_len / sizeof(mmap_assets_table)) {
+        ESP_LOGD(TAG, "The stored_files (%lu) do not fit in stored_len (0x%lx)", stored_files,
+                 stored_len);
         return false;
     }
 
+    // Download() erases the header first and writes it last, so the same header and asset table
+    // on the same partition mean the payload verified at an earlier boot is unchanged
+    uint32_t table_checksum =
+        AssetsChecksum(mmap_root_ + 12, stored_files * sizeof(mmap_assets_table));
+    char record[64];
+    snprintf(record, sizeof(record), "%lx:%lx:%lx:%lx:%lx", stored_files, stored_chksum, stored_len,
+             assets->partition_->size, table_checksum);
+    Settings settings("assets", true);
+    if (settings.GetString(VERIFIED_KEY) == record) {
+        ESP_LOGI(TAG, "The checksum was verified before, skipping the full scan");
+    } else {
+        auto start_time = esp_timer_get_time();
+        uint32_t calculated_checksum = AssetsChecksum(mmap_root_ + 12, stored_len);
+        auto end_time = esp_timer_get_time();
+        // The rate shows the speed-up of the word-wide sum over memory-mapped flash on the device
+        int elapsed_us = int(end_time - start_time);
+        ESP_LOGI(TAG, "The checksum calculation time is %d ms for %lu bytes, %d KB/s", elapsed_us / 1000,
+                 stored_len, elapsed_us > 0 ? int((uint64_t)stored_len * 1000000 / 1024 / elapsed_us) : 0);
+
+        if (calculated_checksum != stored_chksum) {
+            ESP_LOGE(TAG,
+                     "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)",
+                     calculated_checksum, stored_chksum);
+            settings.EraseKey(VERIFIED_KEY);
+            return false;
+        }
+        settings.SetString(VERIFIED_KEY, record);
+    }
+
     checksum_valid_ = true;
+    data_end_ = 12 + stored_len;
 
     for (uint32_t i = 0; i < stored_files; i++) {
         auto item = (const mmap_assets_table*)(mmap_root_ + 12 + i * sizeof(mmap_assets_table));
@@ -211,6 +242,7 @@ void Assets::LvglStrategy::UnApplyPartition(Assets* assets) {
         mmap_root_ = nullptr;
     }
     checksum_valid_ = false;
+    data_end_ = 0;
     assets_.clear();
     (void)assets;  // Unused parameter
 }
@@ -233,6 +265,21 @@ bool Assets::LvglStrategy::GetAssetData(Assets* assets, const std::string& name,
     return true;
 }
 
+bool Assets::LvglStrategy::GetSpareRegion(Assets* assets, size_t size, size_t& offset,
+                                          const char*& mapped) {
+    if (!checksum_valid_ || mmap_root_ == nullptr || size > assets->partition_->size) {
+        return false;
+    }
+    const size_t sector_size = esp_partition_get_main_flash_sector_size();
+    offset = (assets->partition_->size - size) / sector_size * sector_size;
+    // A newer, larger assets image would overwrite the region, so users must validate what they read
+    if (offset < data_end_) {
+        return false;
+    }
+    mapped = mmap_root_ + offset;
+    return true;
+}
+
 bool Assets::LvglStrategy::Apply(Assets* assets, bool refresh_display_theme) {
     void* ptr = nullptr;
     size_t size = 0;
@@ -489,54 +536,81 @@ bool Assets::Download(std::string url,
                       std::function<void(int progress, size_t speed)> progress_callback) {
     ESP_LOGI(TAG, "Downloading new version of assets from %s", url.c_str());
 
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
+    constexpr size_t HEADER_SIZE = 12;
 
-    if (!http->Open("GET", url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
-    }
+    const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get assets, status code: %d", http->GetStatusCode());
-        return false;
+    // An interrupted download continues where its last checkpoint in flash is
+    DownloadResume resume("assets", SECTOR_SIZE, HEADER_SIZE);
+    if (resume.offset() > 0) {
+        resume.Verify([this](size_t offset, void* data, size_t size) {
+            return esp_partition_read(partition_, offset, data, size) == ESP_OK;
+        });
     }
 
-    size_t content_length = http->GetBodyLength();
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(0);
 
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
+    size_t start = 0;
+    if (!resume.Open(*http, url, start)) {
+        ESP_LOGE(TAG, "Failed to get assets");
         return false;
     }
 
+    size_t content_length = resume.content_length();
+
     if (content_length > partition_->size) {
         ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", content_length,
                  partition_->size);
         return false;
     }
 
-    constexpr size_t HEADER_SIZE = 12;
-
     if (content_length < HEADER_SIZE) {
         ESP_LOGE(TAG, "Content length (%u) is smaller than header size (%u)", content_length,
                  HEADER_SIZE);
         return false;
     }
 
-    const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
-    using BufferPtr = std::unique_ptr<char, decltype(&heap_caps_free)>;
-
-    BufferPtr buffer(static_cast<char*>(heap_caps_malloc(SECTOR_SIZE, MALLOC_CAP_INTERNAL)),
-                     &heap_caps_free);
-
-    if (!buffer) {
-        ESP_LOGE(TAG, "Failed to allocate buffer");
-        return false;
+    // HTTP reads go straight into sector buffers, a writer task erases ahead and programs them.
+    // The header is held back and written last.
+    PartitionWriter::Target target;
+    target.size = partition_->size;
+    target.sector_size = SECTOR_SIZE;
+    target.erase = [this](size_t offset, size_t size) {
+        esp_err_t err = esp_partition_erase_range(partition_, offset, size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase assets partition at offset %u: %s", (unsigned int)offset,
+                     esp_err_to_name(err));
+        }
+        return err == ESP_OK;
+    };
+    target.write = [this](size_t offset, const void* data, size_t size) {
+        esp_err_t err = esp_partition_write(partition_, offset, data, size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", (unsigned int)offset,
+                     esp_err_to_name(err));
+        }
+        return err == ESP_OK;
+    };
+    PartitionWriter writer(target, content_length, HEADER_SIZE);
+    if (start > 0) {
+        writer.Resume(start, resume.head());
     }
+    writer.OnWritten([&resume](const char* data, size_t size) { resume.Update(data, size); });
 
     // Unapply the partition
     UnApplyPartition();
 
+    // The new payload gets a full checksum scan when the partition is initialized again
+    {
+        Settings settings("assets", true);
+        settings.EraseKey(VERIFIED_KEY);
+    }
+
+    if (!writer.Start()) {
+        return false;
+    }
+
     size_t sectors_to_erase = (content_length + SECTOR_SIZE - 1) / SECTOR_SIZE;
     size_t total_erase_size = sectors_to_erase * SECTOR_SIZE;
     ESP_LOGI(TAG,
@@ -544,125 +618,44 @@ bool Assets::Download(std::string url,
              "sectors to erase: %u, total erase size: %u",
              SECTOR_SIZE, content_length, sectors_to_erase, total_erase_size);
 
-    size_t total_written = 0;
-    size_t recent_written = 0;
-    size_t current_sector = 0;
-
-    int64_t last_calc_time = esp_timer_get_time();
-
-    uint8_t header_buf[HEADER_SIZE];
-    size_t header_collected = 0;
-    bool success = false;
-    while (true) {
-        int ret = http->Read(buffer.get(), SECTOR_SIZE);
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            break;
-        }
-
-        if (ret == 0) {
-            // End of data
-            success = true;
-            break;
-        }
-
-        size_t buf_pos = 0;
-
-        // Collect header
-        if (header_collected < HEADER_SIZE) {
-            size_t need = HEADER_SIZE - header_collected;
-            size_t take = std::min(static_cast<size_t>(ret), need);
-            memcpy(header_buf + header_collected, buffer.get(), take);
-            header_collected += take;
-            buf_pos += take;
-        }
-
-        // Write payload
-        if ((size_t)ret > buf_pos) {
-            size_t write_len = (size_t)ret - buf_pos;
-            size_t write_end_offset = HEADER_SIZE + total_written + write_len;
-            size_t needed_sectors = (write_end_offset + SECTOR_SIZE - 1) / SECTOR_SIZE;
-            // Erase sectors
-            bool erase_failed = false;
-            while (current_sector < needed_sectors) {
-                size_t sector_start = current_sector * SECTOR_SIZE;
-                size_t sector_end = sector_start + SECTOR_SIZE;
-                if (sector_end > partition_->size) {
-                    ESP_LOGE(TAG, "Sector end (%u) exceeds partition size (%lu)", sector_end,
-                             partition_->size);
-                    erase_failed = true;
-                    break;
-                }
-                ESP_LOGD(TAG, "Erasing sector %u (offset: %u, size: %u)", current_sector,
-                         sector_start, SECTOR_SIZE);
-                esp_err_t err = esp_partition_erase_range(partition_, sector_start, SECTOR_SIZE);
-                if (err != ESP_OK) {
-                    ESP_LOGE(TAG, "Failed to erase sector %u at offset %u: %s", current_sector,
-                             sector_start, esp_err_to_name(err));
-                    erase_failed = true;
-                    break;
-                }
-                current_sector++;
-            }
-
-            if (erase_failed) {
-                break;
-            }
-
-            esp_err_t err = esp_partition_write(partition_, HEADER_SIZE + total_written,
-                                                buffer.get() + buf_pos, write_len);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s",
-                         (unsigned int)(HEADER_SIZE + total_written), esp_err_to_name(err));
-                break;
-            }
-
-            total_written += write_len;
-            recent_written += write_len;
-        }
-
-        // Calculate progress
-        if (esp_timer_get_time() - last_calc_time >= 1000000 ||
-            (header_collected + total_written) == content_length) {
-            size_t progress = (header_collected + total_written) * 100 / content_length;
-            size_t speed = recent_written;
+    // HTTP reads go straight into the writer's sector buffers
+    DownloadResume::Sink sink;
+    sink.acquire = [&writer](size_t& space) { return writer.Acquire(space); };
+    sink.commit = [&writer](size_t size) {
+        writer.Commit(size);
+        return true;
+    };
+    bool success = resume.Receive(http, [network]() { return network->CreateHttp(0); }, url, start, sink,
+        [&](size_t received, size_t recent) {
+            size_t progress = received * 100 / content_length;
             ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Sectors erased: %u", progress,
-                     (unsigned int)(header_collected + total_written), (unsigned int)content_length,
-                     (unsigned int)speed, (unsigned int)current_sector);
-
+                     (unsigned int)received, (unsigned int)content_length, (unsigned int)recent,
+                     (unsigned int)writer.sectors_erased());
             if (progress_callback) {
-                progress_callback(progress, speed);
+                progress_callback(progress, recent);
             }
-            last_calc_time = esp_timer_get_time();
-            recent_written = 0;
-        }
-    }
+        });
 
-    // Check if the downloaded size matches the expected size
-    if (success && (header_collected + total_written != content_length)) {
-        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)",
-                 (unsigned int)(header_collected + total_written), (unsigned int)content_length);
-        success = false;
-    }
+    // Program what is still buffered and wait for the writer
+    success = writer.Finish() && success;
 
     // Write header
-    if (success) {
-        esp_err_t err = esp_partition_write(partition_, 0, header_buf, HEADER_SIZE);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write assets header to partition: %s", esp_err_to_name(err));
-            success = false;
-        }
+    if (success && !writer.WriteHead()) {
+        ESP_LOGE(TAG, "Failed to write assets header to partition");
+        success = false;
     }
 
     if (!success) {
+        // The resume record keeps the last checkpoint for the next attempt
         ESP_LOGE(TAG, "Assets download failed");
         return false;
     }
+    resume.Clear();
 
     ESP_LOGI(TAG,
              "Header written, assets download completed, total written: %u bytes, total sectors "
              "erased: %u",
-             (unsigned int)(header_collected + total_written), (unsigned int)current_sector);
+             (unsigned int)writer.received(), (unsigned int)writer.sectors_erased());
 
     // Re-initialize the assets partition
     if (!InitializePartition()) {
@@ -40,8 +40,14 @@ public:
                   std::function<void(int progress, size_t speed)> progress_callback);
     bool Apply(bool refresh_display_theme = true);
     bool GetAssetData(const std::string& name, void*& ptr, size_t& size);
+    // size bytes at the end of the partition that the assets do not use, for data kept across
+    // reboots (e.g. the glyph store). Written with esp_partition_write and read through mapped.
+    bool GetSpareRegion(size_t size, size_t& offset, const char*& mapped);
+    // Runs before the partition is unmapped, while pointers into it are still valid
+    void OnUnmapPartition(std::function<void()> callback) { on_unmap_partition_ = callback; }
 
     inline bool partition_valid() const { return partition_valid_; }
+    inline const esp_partition_t* partition() const { return partition_; }
     inline std::string default_assets_url() const { return default_assets_url_; }
     inline TextFontCapability text_font_capability() const { return text_font_capability_; }
 
@@ -65,6 +71,9 @@ private:
         virtual void UnApplyPartition(Assets* assets) = 0;
         virtual bool GetAssetData(Assets* assets, const std::string& name, void*& ptr,
                                   size_t& size) = 0;
+        virtual bool GetSpareRegion(Assets* assets, size_t size, size_t& offset, const char*& mapped) {
+            return false;
+        }
     };
 
     class LvglStrategy : public AssetStrategy {
@@ -74,12 +83,13 @@ private:
         void UnApplyPartition(Assets* assets) override;
         bool GetAssetData(Assets* assets, const std::string& name, void*& ptr,
                           size_t& size) override;
+        bool GetSpareRegion(Assets* assets, size_t size, size_t& offset, const char*& mapped) override;
 
     private:
-        static uint32_t CalculateChecksum(const char* data, uint32_t length);
         std::map<std::string, Asset> assets_;
         esp_partition_mmap_handle_t mmap_handle_ = 0;
         const char* mmap_root_ = nullptr;
+        size_t data_end_ = 0;
         bool checksum_valid_ = false;
     };
 
@@ -101,6 +111,7 @@ protected:
     std::string default_assets_url_;
     TextFontCapability text_font_capability_;
     srmodel_list_t* models_list_ = nullptr;
+    std::function<void()> on_unmap_partition_;
 };
 
 #endif
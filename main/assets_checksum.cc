@@ -0,0 +1,59 @@
+#include "assets_checksum.h"
+
+#include <climits>
+
+namespace {
+
+// The byte loop sums `char`: bytes from 0x80 add 256 less when it is signed
+constexpr bool kSignedChar = CHAR_MIN < 0;
+
+// 128 words add at most 128 * 2 * 255 to a 16-bit lane, which still fits
+constexpr size_t kWordsPerBlock = 128;
+
+uint32_t SumBytes(const char* data, size_t length) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < length; i++) {
+        sum += data[i];
+    }
+    return sum;
+}
+
+uint32_t SumWords(const uint32_t* words, size_t count) {
+    uint32_t lanes = 0;
+    uint32_t high_lanes = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t word = words[i];
+        lanes += (word & 0x00FF00FF) + ((word >> 8) & 0x00FF00FF);
+        if (kSignedChar) {
+            high_lanes += (word >> 7) & 0x01010101;
+        }
+    }
+    uint32_t sum = (lanes & 0xFFFF) + (lanes >> 16);
+    if (kSignedChar) {
+        high_lanes = (high_lanes & 0x00FF00FF) + ((high_lanes >> 8) & 0x00FF00FF);
+        sum -= ((high_lanes & 0xFFFF) + (high_lanes >> 16)) * 256;
+    }
+    return sum;
+}
+
+} // namespace
+
+uint32_t AssetsChecksum(const char* data, size_t length) {
+    // Leading bytes up to a word boundary, the mapped payload starts aligned anyway
+    size_t head = (4 - (reinterpret_cast<uintptr_t>(data) & 3)) & 3;
+    if (head > length) {
+        head = length;
+    }
+    uint32_t sum = SumBytes(data, head);
+    data += head;
+    length -= head;
+
+    auto words = reinterpret_cast<const uint32_t*>(data);
+    size_t word_count = length / 4;
+    for (size_t i = 0; i < word_count; i += kWordsPerBlock) {
+        size_t count = word_count - i < kWordsPerBlock ? word_count - i : kWordsPerBlock;
+        sum += SumWords(words + i, count);
+    }
+    sum += SumBytes(data + word_count * 4, length % 4);
+    return sum & 0xFFFF;
+}
@@ -0,0 +1,16 @@
+#ifndef ASSETS_CHECKSUM_H
+#define ASSETS_CHECKSUM_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Checksum of the assets partition payload: the sum of its bytes as `char`, truncated
+ * to 16 bits, as stored in the partition header.
+ *
+ * The sum is taken a 32-bit word at a time with the bytes added in 16-bit lanes, which
+ * gives the same value as the byte loop whether `char` is signed or unsigned.
+ */
+uint32_t AssetsChecksum(const char* data, size_t length);
+
+#endif // ASSETS_CHECKSUM_H
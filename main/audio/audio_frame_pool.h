@@ -0,0 +1,99 @@
+#ifndef AUDIO_FRAME_POOL_H
+#define AUDIO_FRAME_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct AudioFramePoolStats {
+    size_t capacity = 0;
+    size_t free = 0;
+    size_t high_water = 0;      // Most frames ever taken out of the pool at once
+    uint32_t misses = 0;        // Acquire() calls that had to fall back to the heap
+};
+
+/*
+ * Fixed-capacity free list of preallocated audio frames.
+ *
+ * Frames are handed out as plain std::unique_ptr so they can travel through the
+ * existing queues unchanged, and are given back with Release() by whoever
+ * consumes them last. A recycled frame keeps the capacity of its buffers, so
+ * once the pool is warm the streaming path does not touch the heap.
+ *
+ * When the pool runs dry, Acquire() allocates a fresh frame and counts a miss.
+ * Release() also accepts frames that were not created by the pool and frees
+ * whatever does not fit back into it.
+ */
+template <typename T>
+class AudioFramePool {
+public:
+    using Prepare = std::function<void(T&)>;
+
+    void Initialize(size_t capacity, Prepare prepare = nullptr) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        prepare_ = std::move(prepare);
+        capacity_ = capacity;
+        high_water_ = 0;
+        misses_ = 0;
+        free_.clear();
+        free_.reserve(capacity);
+        for (size_t i = 0; i < capacity; ++i) {
+            free_.push_back(Create());
+        }
+    }
+
+    std::unique_ptr<T> Acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) {
+            ++misses_;
+            high_water_ = std::max(high_water_, capacity_);
+            return Create();
+        }
+        auto frame = std::move(free_.back());
+        free_.pop_back();
+        high_water_ = std::max(high_water_, capacity_ - free_.size());
+        return frame;
+    }
+
+    void Release(std::unique_ptr<T> frame) {
+        if (!frame) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.size() < capacity_) {
+            free_.push_back(std::move(frame));
+        }
+    }
+
+    AudioFramePoolStats stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        AudioFramePoolStats stats;
+        stats.capacity = capacity_;
+        stats.free = free_.size();
+        stats.high_water = high_water_;
+        stats.misses = misses_;
+        return stats;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<T>> free_;
+    Prepare prepare_;
+    size_t capacity_ = 0;
+    size_t high_water_ = 0;
+    uint32_t misses_ = 0;
+
+    std::unique_ptr<T> Create() {
+        auto frame = std::make_unique<T>();
+        if (prepare_) {
+            prepare_(*frame);
+        }
+        return frame;
+    }
+};
+
+#endif // AUDIO_FRAME_POOL_H
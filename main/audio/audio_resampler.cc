@@ -0,0 +1,181 @@
+#include "audio_resampler.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define TAG "AudioResampler"
+
+AudioResampler::~AudioResampler() {
+    Close();
+}
+
+bool AudioResampler::Open(int src_rate, int dest_rate, int channels) {
+    Close();
+    if (src_rate <= 0 || dest_rate <= 0 || channels <= 0) {
+        return false;
+    }
+    src_rate_ = src_rate;
+    dest_rate_ = dest_rate;
+    channels_ = channels;
+
+    if (dest_rate > src_rate && dest_rate % src_rate == 0 && dest_rate / src_rate <= kMaxIntegerRatio) {
+        up_ = dest_rate / src_rate;
+        down_ = 1;
+        DesignFilter(up_);
+        history_frames_ = kTapsPerPhase - 1;
+    } else if (src_rate > dest_rate && src_rate % dest_rate == 0 && src_rate / dest_rate <= kMaxIntegerRatio) {
+        up_ = 1;
+        down_ = src_rate / dest_rate;
+        DesignFilter(down_);
+        history_frames_ = coefficients_.size() - 1;
+    } else {
+        esp_ae_rate_cvt_cfg_t cfg = {
+            .src_rate = (uint32_t)src_rate,
+            .dest_rate = (uint32_t)dest_rate,
+            .channel = (uint8_t)channels,
+            .bits_per_sample = ESP_AUDIO_BIT16,
+            .complexity = 2,
+            .perf_type = ESP_AE_RATE_CVT_PERF_TYPE_SPEED,
+        };
+        auto ret = esp_ae_rate_cvt_open(&cfg, &converter_);
+        if (converter_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to create resampler %d -> %d, error code: %d", src_rate, dest_rate, ret);
+            return false;
+        }
+        ESP_LOGI(TAG, "Resampling %d -> %d Hz", src_rate, dest_rate);
+        return true;
+    }
+
+    Reset();
+    ESP_LOGI(TAG, "Resampling %d -> %d Hz with a %u tap polyphase filter", src_rate, dest_rate,
+        (unsigned)coefficients_.size());
+    return true;
+}
+
+void AudioResampler::Close() {
+    if (converter_ != nullptr) {
+        esp_ae_rate_cvt_close(converter_);
+        converter_ = nullptr;
+    }
+    up_ = 0;
+    down_ = 0;
+    coefficients_.clear();
+    history_.clear();
+    history_frames_ = 0;
+}
+
+void AudioResampler::Reset() {
+    if (converter_ != nullptr) {
+        esp_ae_rate_cvt_reset(converter_);
+        return;
+    }
+    down_phase_ = 0;
+    history_.assign(history_frames_ * channels_, 0);
+}
+
+size_t AudioResampler::MaxOutputFrames(size_t frames) const {
+    if (up_ > 0) {
+        return frames * up_ / down_ + 1;
+    }
+    if (converter_ == nullptr) {
+        return 0;
+    }
+    uint32_t max_frames = 0;
+    esp_ae_rate_cvt_get_max_out_sample_num(converter_, frames, &max_frames);
+    return max_frames;
+}
+
+size_t AudioResampler::Process(const int16_t* src, size_t frames, int16_t* dest) {
+    if (converter_ != nullptr) {
+        uint32_t output_frames = MaxOutputFrames(frames);
+        esp_ae_rate_cvt_process(converter_, (esp_ae_sample_t)src, frames, (esp_ae_sample_t)dest, &output_frames);
+        return output_frames;
+    }
+    if (up_ == 0) {
+        return 0;
+    }
+
+    // Append the new input behind the history, so every tap reads one contiguous buffer
+    history_.resize((history_frames_ + frames) * channels_);
+    memcpy(history_.data() + history_frames_ * channels_, src, frames * channels_ * sizeof(int16_t));
+    size_t output_frames = down_ == 1 ? Upsample(frames, dest) : Downsample(frames, dest);
+    memmove(history_.data(), history_.data() + frames * channels_, history_frames_ * channels_ * sizeof(int16_t));
+    history_.resize(history_frames_ * channels_);
+    return output_frames;
+}
+
+void AudioResampler::DesignFilter(int ratio) {
+    // Blackman-windowed sinc, cut off at 90% of the Nyquist frequency of the lower rate
+    constexpr double kCutoff = 0.9;
+    const int taps = kTapsPerPhase * ratio;
+    const double center = (taps - 1) / 2.0;
+    std::vector<double> h(taps);
+    double sum = 0;
+    for (int i = 0; i < taps; ++i) {
+        double x = (i - center) * kCutoff / ratio;
+        double sinc = x == 0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+        double window = 0.42 - 0.5 * std::cos(2 * M_PI * (i + 0.5) / taps) + 0.08 * std::cos(4 * M_PI * (i + 0.5) / taps);
+        h[i] = sinc * window;
+        sum += h[i];
+    }
+
+    // Unity gain: each upsampling phase and the whole downsampling filter sum to one
+    const double gain = (up_ > 1 ? ratio : 1) / sum;
+    coefficients_.resize(taps);
+    for (int i = 0; i < taps; ++i) {
+        int index = i;
+        if (up_ > 1) {
+            // Phase p uses taps p, p + ratio, p + 2 * ratio, ... stored next to each other
+            index = (i % ratio) * kTapsPerPhase + i / ratio;
+        }
+        coefficients_[index] = (int16_t)std::lround(h[i] * gain * (1 << 14));
+    }
+}
+
+static inline int16_t RoundQ14(int32_t acc) {
+    return (int16_t)std::min<int32_t>(std::max<int32_t>((acc + (1 << 13)) >> 14, -32768), 32767);
+}
+
+size_t AudioResampler::Upsample(size_t frames, int16_t* dest) {
+    const int channels = channels_;
+    for (size_t n = 0; n < frames; ++n) {
+        // Newest input frame first, the taps walk back through the history
+        const int16_t* x = history_.data() + (history_frames_ + n) * channels;
+        for (int p = 0; p < up_; ++p) {
+            const int16_t* h = coefficients_.data() + p * kTapsPerPhase;
+            for (int c = 0; c < channels; ++c) {
+                int32_t acc = 0;
+                for (int k = 0; k < kTapsPerPhase; ++k) {
+                    acc += h[k] * x[c - k * channels];
+                }
+                *dest++ = RoundQ14(acc);
+            }
+        }
+    }
+    return frames * up_;
+}
+
+size_t AudioResampler::Downsample(size_t frames, int16_t* dest) {
+    const int channels = channels_;
+    const int taps = coefficients_.size();
+    size_t output_frames = 0;
+    for (size_t n = 0; n < frames; ++n) {
+        if (down_phase_ > 0) {
+            down_phase_--;
+            continue;
+        }
+        down_phase_ = down_ - 1;
+        const int16_t* x = history_.data() + (history_frames_ + n) * channels;
+        for (int c = 0; c < channels; ++c) {
+            int32_t acc = 0;
+            for (int j = 0; j < taps; ++j) {
+                acc += coefficients_[j] * x[c - j * channels];
+            }
+            *dest++ = RoundQ14(acc);
+        }
+        output_frames++;
+    }
+    return output_frames;
+}
@@ -0,0 +1,59 @@
+#ifndef AUDIO_RESAMPLER_H
+#define AUDIO_RESAMPLER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "esp_ae_rate_cvt.h"
+#include "esp_audio_types.h"
+
+/*
+ * Sample rate converter for interleaved 16-bit PCM that writes into caller buffers.
+ *
+ * Integer ratios up to kMaxIntegerRatio (16 <-> 48 kHz, 24 <-> 48 kHz, 16 <-> 32 kHz)
+ * use a polyphase FIR with Q14 coefficients: upsampling computes only the phase
+ * each output sample needs, downsampling only the kept samples. Other ratios
+ * fall back to esp_ae_rate_cvt. Filter state carries across calls, so a stream
+ * is converted without seams; Reset() drops it between streams.
+ */
+class AudioResampler {
+public:
+    AudioResampler() = default;
+    ~AudioResampler();
+    AudioResampler(const AudioResampler&) = delete;
+    AudioResampler& operator=(const AudioResampler&) = delete;
+
+    bool Open(int src_rate, int dest_rate, int channels);
+    void Close();
+    bool IsOpen() const { return up_ > 0 || converter_ != nullptr; }
+    bool IsFastPath() const { return up_ > 0; }
+
+    // Upper bound of the frames Process() writes for `frames` input frames
+    size_t MaxOutputFrames(size_t frames) const;
+    // Returns the number of frames written to dest, which holds MaxOutputFrames(frames)
+    size_t Process(const int16_t* src, size_t frames, int16_t* dest);
+    void Reset();
+
+private:
+    static constexpr int kMaxIntegerRatio = 6;
+    // Filter taps per output sample; the prototype filter has kTapsPerPhase * ratio taps
+    static constexpr int kTapsPerPhase = 16;
+
+    int src_rate_ = 0;
+    int dest_rate_ = 0;
+    int channels_ = 1;
+    int up_ = 0;        // Integer ratio of the fast path, 0 when esp_ae_rate_cvt is used
+    int down_ = 0;
+    int down_phase_ = 0;    // Input frames left to skip before the next kept frame
+    std::vector<int16_t> coefficients_;     // Grouped by phase when upsampling
+    std::vector<int16_t> history_;          // Previous input followed by the new input, interleaved
+    size_t history_frames_ = 0;             // Frames of previous input kept in history_
+    esp_ae_rate_cvt_handle_t converter_ = nullptr;
+
+    void DesignFilter(int ratio);
+    size_t Upsample(size_t frames, int16_t* dest);
+    size_t Downsample(size_t frames, int16_t* dest);
+};
+
+#endif // AUDIO_RESAMPLER_H
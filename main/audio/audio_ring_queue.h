@@ -0,0 +1,97 @@
+#ifndef AUDIO_RING_QUEUE_H
+#define AUDIO_RING_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+ * Bounded lock-free ring of std::unique_ptr<T> with a single producer.
+ *
+ * Only one task may push at a time (queues with several producers serialize
+ * them with their own producer-side mutex). Removal claims the head slot with
+ * a compare-and-swap, so the consumer, a task clearing the queue and the
+ * producer dropping its oldest element never hand out the same element twice.
+ * Every reader loads the slot before claiming it, so a slot reused by the
+ * producer right after a claim is never read twice either.
+ *
+ * Neither side blocks; callers wake each other with task notifications.
+ */
+template <typename T>
+class AudioRingQueue {
+public:
+    explicit AudioRingQueue(size_t capacity)
+        : capacity_(capacity), slots_(new std::atomic<T*>[capacity]) {
+        for (size_t i = 0; i < capacity_; ++i) {
+            slots_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~AudioRingQueue() {
+        while (Pop()) {
+        }
+    }
+
+    AudioRingQueue(const AudioRingQueue&) = delete;
+    AudioRingQueue& operator=(const AudioRingQueue&) = delete;
+
+    // Producer only. Leaves item untouched and returns false when the ring is full.
+    bool Push(std::unique_ptr<T>& item) {
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - head_.load(std::memory_order_acquire) >= capacity_) {
+            return false;
+        }
+        slots_[tail % capacity_].store(item.release(), std::memory_order_relaxed);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer only. Never fails: when the ring is full, the oldest element is
+    // removed and returned to the caller.
+    std::unique_ptr<T> PushDropOldest(std::unique_ptr<T> item) {
+        std::unique_ptr<T> dropped;
+        uint32_t tail = tail_.load(std::memory_order_relaxed);
+        uint32_t head = head_.load(std::memory_order_acquire);
+        while (tail - head >= capacity_) {
+            T* oldest = slots_[head % capacity_].load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, head + 1,
+                    std::memory_order_acq_rel, std::memory_order_acquire)) {
+                dropped.reset(oldest);
+                break;
+            }
+        }
+        slots_[tail % capacity_].store(item.release(), std::memory_order_relaxed);
+        tail_.store(tail + 1, std::memory_order_release);
+        return dropped;
+    }
+
+    // Any task. Returns nullptr when the ring is empty.
+    std::unique_ptr<T> Pop() {
+        uint32_t head = head_.load(std::memory_order_acquire);
+        while (head != tail_.load(std::memory_order_acquire)) {
+            T* item = slots_[head % capacity_].load(std::memory_order_relaxed);
+            if (head_.compare_exchange_weak(head, head + 1,
+                    std::memory_order_acq_rel, std::memory_order_acquire)) {
+                return std::unique_ptr<T>(item);
+            }
+        }
+        return nullptr;
+    }
+
+    size_t Size() const {
+        uint32_t head = head_.load(std::memory_order_acquire);
+        return tail_.load(std::memory_order_acquire) - head;
+    }
+
+    bool Empty() const { return Size() == 0; }
+    size_t capacity() const { return capacity_; }
+
+private:
+    const size_t capacity_;
+    std::unique_ptr<std::atomic<T*>[]> slots_;
+    std::atomic<uint32_t> head_{0};
+    std::atomic<uint32_t> tail_{0};
+};
+
+#endif // AUDIO_RING_QUEUE_H
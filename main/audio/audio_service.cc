@@ -1,26 +1,8 @@
 #include "audio_service.h"
+#include "pcm_kernels.h"
 #include <esp_log.h>
 #include <cstring>
-
-#define RATE_CVT_CFG(_src_rate, _dest_rate, _channel)        \
-    (esp_ae_rate_cvt_cfg_t)                                  \
-    {                                                        \
-        .src_rate        = (uint32_t)(_src_rate),            \
-        .dest_rate       = (uint32_t)(_dest_rate),           \
-        .channel         = (uint8_t)(_channel),              \
-        .bits_per_sample = ESP_AUDIO_BIT16,                  \
-        .complexity      = 2,                                \
-        .perf_type       = ESP_AE_RATE_CVT_PERF_TYPE_SPEED,  \
-    }
-
-#define OPUS_DEC_CFG(_sample_rate, _frame_duration_ms)                                                    \
-    (esp_opus_dec_cfg_t)                                                                                  \
-    {                                                                                                     \
-        .sample_rate    = (uint32_t)(_sample_rate),                                                       \
-        .channel        = ESP_AUDIO_MONO,                                                                 \
-        .frame_duration = (esp_opus_dec_frame_duration_t)AS_OPUS_GET_FRAME_DRU_ENUM(_frame_duration_ms),  \
-        .self_delimited = false,                                                                          \
-    }
+#include <algorithm>
 
 #if CONFIG_IDF_TARGET_ESP32S3 || CONFIG_IDF_TARGET_ESP32P4 || CONFIG_IDF_TARGET_ESP32S31
 #include "engines/afe_audio_engine.h"
@@ -41,32 +23,18 @@ AudioService::~AudioService() {
     if (opus_encoder_ != nullptr) {
         esp_opus_enc_close(opus_encoder_);
     }
-    if (opus_decoder_ != nullptr) {
-        esp_opus_dec_close(opus_decoder_);
-    }
-    if (input_resampler_ != nullptr) {
-        esp_ae_rate_cvt_close(input_resampler_);
-    }
-    if (output_resampler_ != nullptr) {
-        esp_ae_rate_cvt_close(output_resampler_);
-    }
 }
 
 void AudioService::Initialize(AudioCodec* codec) {
     codec_ = codec;
     codec_->Start();
 
-    esp_opus_dec_cfg_t opus_dec_cfg = OPUS_DEC_CFG(codec->output_sample_rate(), OPUS_FRAME_DURATION_MS);
-    auto ret = esp_opus_dec_open(&opus_dec_cfg, sizeof(esp_opus_dec_cfg_t), &opus_decoder_);
-    if (opus_decoder_ == nullptr) {
-        ESP_LOGE(TAG, "Failed to create audio decoder, error code: %d", ret);
-    } else {
-        decoder_sample_rate_ = codec->output_sample_rate();
-        decoder_duration_ms_ = OPUS_FRAME_DURATION_MS;
-        decoder_frame_size_ = decoder_sample_rate_ / 1000 * OPUS_FRAME_DURATION_MS;
-    }
+    decoders_.Initialize(codec->output_sample_rate());
+    sound_effects_.Initialize(codec->output_sample_rate());
+    sound_effect_frame_.resize(codec->output_sample_rate() / 1000 * SOUND_EFFECT_PERIOD_MS);
+    decoders_.Get(codec->output_sample_rate(), OPUS_FRAME_DURATION_MS);
     esp_opus_enc_config_t opus_enc_cfg = AS_OPUS_ENC_CONFIG();
-    ret = esp_opus_enc_open(&opus_enc_cfg, sizeof(esp_opus_enc_config_t), &opus_encoder_);
+    auto ret = esp_opus_enc_open(&opus_enc_cfg, sizeof(esp_opus_enc_config_t), &opus_encoder_);
     if (opus_encoder_ == nullptr) {
         ESP_LOGE(TAG, "Failed to create audio encoder, error code: %d", ret);
     } else {
@@ -76,12 +44,23 @@ void AudioService::Initialize(AudioCodec* codec) {
         encoder_frame_size_ = encoder_frame_size_ / sizeof(int16_t);
     }
 
+    /* Preallocate the frames that circulate between the audio tasks */
+    const size_t encode_samples = encoder_sample_rate_ / 1000 * OPUS_FRAME_DURATION_MS;
+    encode_task_pool_.Initialize(ENCODE_TASK_POOL_SIZE, [encode_samples](AudioTask& task) {
+        task.pcm.reserve(encode_samples);
+    });
+    const size_t playback_samples = codec->output_sample_rate() / 1000 * OPUS_FRAME_DURATION_MS;
+    playback_task_pool_.Initialize(PLAYBACK_TASK_POOL_SIZE, [playback_samples](AudioTask& task) {
+        task.pcm.reserve(playback_samples);
+    });
+    // Packet payloads are variable-sized, they grow to their working size on first use
+    packet_pool_.Initialize(PACKET_POOL_SIZE);
+    encode_buffer_.resize(encoder_outbuf_size_);
+    decode_buffer_.reserve(codec->output_sample_rate() / 1000 * OPUS_FRAME_DURATION_MS);
+
     if (codec->input_sample_rate() != 16000) {
-        esp_ae_rate_cvt_cfg_t input_resampler_cfg = RATE_CVT_CFG(
-            codec->input_sample_rate(), ESP_AUDIO_SAMPLE_RATE_16K, codec->input_channels());
-        auto resampler_ret = esp_ae_rate_cvt_open(&input_resampler_cfg, &input_resampler_);
-        if (input_resampler_ == nullptr) {
-            ESP_LOGE(TAG, "Failed to create input resampler, error code: %d", resampler_ret);
+        if (!input_resampler_.Open(codec->input_sample_rate(), 16000, codec->input_channels())) {
+            ESP_LOGE(TAG, "Failed to create input resampler");
         }
     }
 
@@ -90,8 +69,8 @@ void AudioService::Initialize(AudioCodec* codec) {
 #else
     audio_engine_ = std::make_unique<LiteAudioEngine>();
 #endif
-    audio_engine_->OnOutput([this](std::vector<int16_t>&& data) {
-        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, std::move(data));
+    audio_engine_->OnOutput([this](const std::vector<int16_t>& data) {
+        PushTaskToEncodeQueue(kAudioTaskTypeEncodeToSendQueue, data);
     });
     audio_engine_->OnVadStateChange([this](bool speaking) {
         voice_detected_ = speaking;
@@ -138,6 +117,7 @@ void AudioService::Start() {
     xTaskCreate([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioOutputTask();
+        audio_service->audio_output_task_handle_ = nullptr;
         vTaskDelete(NULL);
     }, "audio_output", 2048 * 2, this, 4, &audio_output_task_handle_);
 #else
@@ -152,16 +132,37 @@ void AudioService::Start() {
     xTaskCreate([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->AudioOutputTask();
+        audio_service->audio_output_task_handle_ = nullptr;
         vTaskDelete(NULL);
     }, "audio_output", 2048, this, 4, &audio_output_task_handle_);
 #endif
 
+#if CONFIG_USE_SPLIT_OPUS_CODEC_TASKS
+    /* Start the opus encoder and decoder tasks on different cores */
+    xTaskCreatePinnedToCore([](void* arg) {
+        AudioService* audio_service = (AudioService*)arg;
+        audio_service->OpusEncodeTask();
+        audio_service->opus_encode_task_handle_ = nullptr;
+        vTaskDelete(NULL);
+    }, "opus_encode", 2048 * 12, this, 2, &opus_encode_task_handle_, CONFIG_OPUS_ENCODE_TASK_CORE);
+
+    xTaskCreatePinnedToCore([](void* arg) {
+        AudioService* audio_service = (AudioService*)arg;
+        audio_service->OpusDecodeTask();
+        audio_service->opus_decode_task_handle_ = nullptr;
+        vTaskDelete(NULL);
+    }, "opus_decode", 2048 * 8, this, 2, &opus_decode_task_handle_, CONFIG_OPUS_DECODE_TASK_CORE);
+#else
     /* Start the opus codec task */
     xTaskCreate([](void* arg) {
         AudioService* audio_service = (AudioService*)arg;
         audio_service->OpusCodecTask();
+        audio_service->opus_encode_task_handle_ = nullptr;
+        audio_service->opus_decode_task_handle_ = nullptr;
         vTaskDelete(NULL);
-    }, "opus_codec", 2048 * 12, this, 2, &opus_codec_task_handle_);
+    }, "opus_codec", 2048 * 12, this, 2, &opus_encode_task_handle_);
+    opus_decode_task_handle_ = opus_encode_task_handle_;
+#endif
 }
 
 void AudioService::Stop() {
@@ -169,22 +170,17 @@ void AudioService::Stop() {
     service_stopped_.store(true);
     xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
         AS_EVENT_WAKE_WORD_RUNNING |
-        AS_EVENT_AUDIO_PROCESSOR_RUNNING);
-
-    bool notify_drained = false;
-    {
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        ++playback_generation_;
-        audio_encode_queue_.clear();
-        audio_decode_queue_.clear();
-        audio_playback_queue_.clear();
-        audio_testing_queue_.clear();
-        notify_drained = MarkPlaybackDrainedLocked();
-        audio_queue_cv_.notify_all();
-    }
-    if (notify_drained && callbacks_.on_playback_drained) {
-        callbacks_.on_playback_drained();
-    }
+        AS_EVENT_AUDIO_PROCESSOR_RUNNING |
+        AS_EVENT_DECODE_QUEUE_AVAILABLE);
+
+    ++playback_generation_;
+    DrainTasks(encode_task_pool_, audio_encode_queue_);
+    int drained = DrainPackets(audio_decode_queue_) + DrainTasks(playback_task_pool_, audio_playback_queue_);
+    DrainPackets(audio_testing_queue_);
+    NotifyTask(opus_encode_task_handle_);
+    NotifyTask(opus_decode_task_handle_);
+    NotifyTask(audio_output_task_handle_);
+    FinishPlaybackWork(drained);
 }
 
 bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples) {
@@ -199,17 +195,14 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
         if (!codec_->InputData(data)) {
             return false;
         }
-        if (input_resampler_ != nullptr) {
+        if (input_resampler_.IsOpen()) {
             std::lock_guard<std::mutex> lock(input_resampler_mutex_);
-            uint32_t in_sample_num = data.size() / codec_->input_channels();
-            uint32_t output_samples = 0;
-            esp_ae_rate_cvt_get_max_out_sample_num(input_resampler_, in_sample_num, &output_samples);
-            auto resampled = std::vector<int16_t>(output_samples * codec_->input_channels());
-            uint32_t actual_output = output_samples;
-            esp_ae_rate_cvt_process(input_resampler_, (esp_ae_sample_t)data.data(), in_sample_num,
-                                   (esp_ae_sample_t)resampled.data(), &actual_output);
-            resampled.resize(actual_output * codec_->input_channels());
-            data = std::move(resampled);
+            size_t in_frames = data.size() / codec_->input_channels();
+            input_resample_buffer_.resize(input_resampler_.MaxOutputFrames(in_frames) * codec_->input_channels());
+            size_t out_frames = input_resampler_.Process(data.data(), in_frames, input_resample_buffer_.data());
+            input_resample_buffer_.resize(out_frames * codec_->input_channels());
+            // Swap instead of copying, both buffers keep their capacity for the next read
+            data.swap(input_resample_buffer_);
         }
     } else {
         data.resize(samples * codec_->input_channels());
@@ -236,6 +229,8 @@ bool AudioService::ReadAudioData(std::vector<int16_t>& data, int sample_rate, in
 void AudioService::AudioInputTask() {
     constexpr EventBits_t kAudioInputActiveBits = AS_EVENT_AUDIO_TESTING_RUNNING |
         AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING;
+    // Reused for every read, so the input path does not allocate per frame
+    std::vector<int16_t> data;
 
     while (true) {
         EventBits_t bits = xEventGroupWaitBits(event_group_, kAudioInputActiveBits |
@@ -273,23 +268,20 @@ void AudioService::AudioInputTask() {
 
         /* Used for audio testing in NetworkConfiguring mode by clicking the BOOT button */
         if (bits & AS_EVENT_AUDIO_TESTING_RUNNING) {
-            if (audio_testing_queue_.size() >= AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS) {
+            if (audio_testing_queue_.Size() >= AUDIO_TESTING_MAX_PACKETS) {
                 ESP_LOGW(TAG, "Audio testing queue is full, stopping audio testing");
                 EnableAudioTesting(false);
                 continue;
             }
-            std::vector<int16_t> data;
             int samples = OPUS_FRAME_DURATION_MS * 16000 / 1000;
             if (ReadAudioData(data, 16000, samples)) {
-                // If input channels is 2, we need to fetch the left channel data
+                // If input channels is 2, we need to fetch the left channel data (in place)
                 if (codec_->input_channels() == 2) {
-                    auto mono_data = std::vector<int16_t>(data.size() / 2);
-                    for (size_t i = 0, j = 0; i < mono_data.size(); ++i, j += 2) {
-                        mono_data[i] = data[j];
-                    }
-                    data = std::move(mono_data);
+                    const size_t mono_samples = data.size() / 2;
+                    pcm::ExtractChannel(data.data(), data.data(), mono_samples, 2, 0);
+                    data.resize(mono_samples);
                 }
-                PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, std::move(data));
+                PushTaskToEncodeQueue(kAudioTaskTypeEncodeToTestingQueue, data);
                 continue;
             }
         }
@@ -297,9 +289,8 @@ void AudioService::AudioInputTask() {
         /* Feed the selected audio engine */
         if (bits & (AS_EVENT_WAKE_WORD_RUNNING | AS_EVENT_AUDIO_PROCESSOR_RUNNING)) {
             int samples = 160; // 10ms
-            std::vector<int16_t> data;
             if (ReadAudioData(data, 16000, samples)) {
-                audio_engine_->Feed(std::move(data));
+                audio_engine_->Feed(data);
                 continue;
             }
         }
@@ -312,239 +303,317 @@ void AudioService::AudioInputTask() {
 }
 
 void AudioService::AudioOutputTask() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() {
-            return !audio_playback_queue_.empty() || service_stopped_.load();
-        });
-        if (service_stopped_.load()) {
-            break;
+    while (!service_stopped_.load()) {
+        auto task = audio_playback_queue_.Pop();
+        if (!task) {
+            if (sound_effects_.IsPlaying()) {
+                /* Nothing from the server, play the sound effects on their own */
+                std::fill(sound_effect_frame_.begin(), sound_effect_frame_.end(), 0);
+                sound_effects_.Mix(sound_effect_frame_.data(), sound_effect_frame_.size());
+                OutputPlaybackData(sound_effect_frame_);
+                continue;
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
         }
+        /* A playback slot is free again, let the decoder take the next packet */
+        NotifyTask(opus_decode_task_handle_);
 
-        auto task = std::move(audio_playback_queue_.front());
-        audio_playback_queue_.pop_front();
-        output_in_flight_ = true;
-        audio_queue_cv_.notify_all();
-        lock.unlock();
+        /* Frames decoded before the last ResetDecoder() are discarded */
+        if (task->generation == playback_generation_.load()) {
+            sound_effects_.Mix(task->pcm.data(), task->pcm.size());
+            OutputPlaybackData(task->pcm);
+            debug_statistics_.playback_count++;
 
-        if (!codec_->output_enabled()) {
-            esp_timer_stop(audio_power_timer_);
-            esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
-            codec_->EnableOutput(true);
+#if CONFIG_USE_SERVER_AEC
+            /* Record the timestamp for server AEC */
+            if (task->timestamp > 0) {
+                std::lock_guard<std::mutex> lock(timestamp_mutex_);
+                timestamp_queue_.push_back(task->timestamp);
+            }
+#endif
         }
+        playback_task_pool_.Release(std::move(task));
+        FinishPlaybackWork();
+    }
 
-        codec_->OutputData(task->pcm);
+    ESP_LOGW(TAG, "Audio output task stopped");
+}
 
-        /* Update the last output time */
-        last_output_time_ = std::chrono::steady_clock::now();
-        debug_statistics_.playback_count++;
+void AudioService::OutputPlaybackData(std::vector<int16_t>& pcm) {
+    if (!codec_->output_enabled()) {
+        esp_timer_stop(audio_power_timer_);
+        esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
+        codec_->EnableOutput(true);
+    }
 
-        bool notify_drained = false;
-        lock.lock();
-#if CONFIG_USE_SERVER_AEC
-        /* Record the timestamp for server AEC */
-        if (task->timestamp > 0) {
-            timestamp_queue_.push_back(task->timestamp);
-        }
-#endif
-        output_in_flight_ = false;
-        notify_drained = MarkPlaybackDrainedLocked();
-        audio_queue_cv_.notify_all();
-        lock.unlock();
+    codec_->OutputData(pcm);
 
-        if (notify_drained && callbacks_.on_playback_drained) {
-            callbacks_.on_playback_drained();
+    /* Update the last output time */
+    last_output_time_ = std::chrono::steady_clock::now();
+}
+
+void AudioService::OpusCodecTask() {
+    while (!service_stopped_.load()) {
+        bool busy = sound_effects_.DecodeNext();
+        busy = DecodeNextPacket() || busy;
+        busy = EncodeNextTask() || busy;
+        if (!busy) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         }
     }
 
-    ESP_LOGW(TAG, "Audio output task stopped");
+    ESP_LOGW(TAG, "Opus codec task stopped");
 }
 
-void AudioService::OpusCodecTask() {
-    while (true) {
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-        audio_queue_cv_.wait(lock, [this]() {
-            return service_stopped_.load() ||
-                !audio_encode_queue_.empty() ||
-                (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
-        });
-        if (service_stopped_.load()) {
-            break;
+void AudioService::OpusEncodeTask() {
+    while (!service_stopped_.load()) {
+        if (!EncodeNextTask()) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         }
+    }
 
-        /* Decode the audio from decode queue */
-        if (!audio_decode_queue_.empty() && audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
-            auto packet = std::move(audio_decode_queue_.front());
-            audio_decode_queue_.pop_front();
-            decode_in_flight_ = true;
-            const uint32_t generation = playback_generation_;
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto task = std::make_unique<AudioTask>();
-            task->type = kAudioTaskTypeDecodeToPlaybackQueue;
-            task->timestamp = packet->timestamp;
-
-            SetDecodeSampleRate(packet->sample_rate, packet->frame_duration);
-            bool decoded = false;
-            if (opus_decoder_ != nullptr) {
-                task->pcm.resize(decoder_frame_size_);
-                esp_audio_dec_in_raw_t raw = {
-                    .buffer = (uint8_t *)(packet->payload.data()),
-                    .len = (uint32_t)(packet->payload.size()),
-                    .consumed = 0,
-                    .frame_recover = ESP_AUDIO_DEC_RECOVERY_NONE,
-                };
-                esp_audio_dec_out_frame_t out_frame = {
-                    .buffer = (uint8_t *)(task->pcm.data()),
-                    .len = (uint32_t)(task->pcm.size() * sizeof(int16_t)),
-                    .decoded_size = 0,
-                };
-                esp_audio_dec_info_t dec_info = {};
-                std::unique_lock<std::mutex> decoder_lock(decoder_mutex_);
-                auto ret = esp_opus_dec_decode(opus_decoder_, &raw, &out_frame, &dec_info);
-                decoder_lock.unlock();
-                if (ret == ESP_AUDIO_ERR_OK) {
-                    task->pcm.resize(out_frame.decoded_size / sizeof(int16_t));
-                    if (decoder_sample_rate_ != codec_->output_sample_rate() && output_resampler_ != nullptr) {
-                        uint32_t target_size = 0;
-                        esp_ae_rate_cvt_get_max_out_sample_num(output_resampler_, task->pcm.size(), &target_size);
-                        std::vector<int16_t> resampled(target_size);
-                        uint32_t actual_output = target_size;
-                        esp_ae_rate_cvt_process(output_resampler_, (esp_ae_sample_t)task->pcm.data(), task->pcm.size(),
-                                                (esp_ae_sample_t)resampled.data(), &actual_output);
-                        resampled.resize(actual_output);
-                        task->pcm = std::move(resampled);
-                    }
-                    decoded = true;
-                } else {
-                    ESP_LOGE(TAG, "Failed to decode audio after resize, error code: %d", ret);
-                }
-            } else {
-                ESP_LOGE(TAG, "Audio decoder is not configured");
-            }
+    ESP_LOGW(TAG, "Opus encode task stopped");
+}
 
-            lock.lock();
-            if (decoded && generation == playback_generation_ && !service_stopped_.load()) {
-                audio_playback_queue_.push_back(std::move(task));
-            }
-            decode_in_flight_ = false;
-            debug_statistics_.decode_count++;
-            const bool notify_drained = MarkPlaybackDrainedLocked();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-            if (notify_drained && callbacks_.on_playback_drained) {
-                callbacks_.on_playback_drained();
-            }
-            lock.lock();
-        }
-        /* Encode the audio to send queue */
-        if (!audio_encode_queue_.empty()) {
-            auto task = std::move(audio_encode_queue_.front());
-            audio_encode_queue_.pop_front();
-            audio_queue_cv_.notify_all();
-            lock.unlock();
-
-            auto packet = std::make_unique<AudioStreamPacket>();
-            packet->frame_duration = OPUS_FRAME_DURATION_MS;
-            packet->sample_rate = 16000;
-            packet->timestamp = task->timestamp;
-
-            if (opus_encoder_ != nullptr && task->pcm.size() == encoder_frame_size_) {
-                std::vector<uint8_t> buf(encoder_outbuf_size_);
-                esp_audio_enc_in_frame_t in = {
-                    .buffer = (uint8_t *)(task->pcm.data()),
-                    .len = (uint32_t)(encoder_frame_size_ * sizeof(int16_t)),
-                };
-                esp_audio_enc_out_frame_t out = {
-                    .buffer = buf.data(),
-                    .len = (uint32_t)encoder_outbuf_size_,
-                    .encoded_bytes = 0,
-                };
-                auto ret = esp_opus_enc_process(opus_encoder_, &in, &out);
-                if (ret == ESP_AUDIO_ERR_OK) {
-                    packet->payload.assign(buf.data(), buf.data() + out.encoded_bytes);
-
-                    if (task->type == kAudioTaskTypeEncodeToSendQueue) {
-                        {
-                            std::lock_guard<std::mutex> lock2(audio_queue_mutex_);
-                            /* Never let a full send queue stall encoding: stale realtime
-                             * audio is useless to the server, so drop the oldest packet. */
-                            if (audio_send_queue_.size() >= MAX_SEND_PACKETS_IN_QUEUE) {
-                                audio_send_queue_.pop_front();
-                            }
-                            audio_send_queue_.push_back(std::move(packet));
-                        }
-                        if (callbacks_.on_send_queue_available) {
-                            callbacks_.on_send_queue_available();
-                        }
-                    } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
-                        std::lock_guard<std::mutex> lock2(audio_queue_mutex_);
-                        audio_testing_queue_.push_back(std::move(packet));
-                    }
-                    debug_statistics_.encode_count++;
-                } else {
-                    ESP_LOGE(TAG, "Failed to encode audio, error code: %d", ret);
-                }
-            } else {
-                ESP_LOGE(TAG, "Failed to encode audio: encoder not configured or invalid frame size (got %u, expected %u)",
-                         task->pcm.size(), encoder_frame_size_);
-            }
-            lock.lock();
+void AudioService::OpusDecodeTask() {
+    while (!service_stopped_.load()) {
+        bool busy = sound_effects_.DecodeNext();
+        if (!DecodeNextPacket() && !busy) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
         }
     }
 
-    ESP_LOGW(TAG, "Opus codec task stopped");
+    ESP_LOGW(TAG, "Opus decode task stopped");
 }
 
-void AudioService::SetDecodeSampleRate(int sample_rate, int frame_duration) {
-    if (decoder_sample_rate_ == sample_rate && decoder_duration_ms_ == frame_duration) {
-        return;
+bool AudioService::DecodeNextPacket() {
+    if (audio_playback_queue_.Size() >= MAX_PLAYBACK_TASKS_IN_QUEUE) {
+        return false;
+    }
+    // Read before the pop, so a packet popped before a reset cannot pass as one after it
+    const uint32_t generation = playback_generation_.load();
+    auto packet = audio_decode_queue_.Pop();
+    if (!packet) {
+        return false;
     }
+    /* Wake up producers waiting for space in the decode queue */
+    xEventGroupSetBits(event_group_, AS_EVENT_DECODE_QUEUE_AVAILABLE);
+
+    auto task = playback_task_pool_.Acquire();
+    task->type = kAudioTaskTypeDecodeToPlaybackQueue;
+    task->timestamp = packet->timestamp;
+    task->generation = generation;
+
+    bool decoded = false;
     std::unique_lock<std::mutex> decoder_lock(decoder_mutex_);
-    if (opus_decoder_ != nullptr) {
-        esp_opus_dec_close(opus_decoder_);
-        opus_decoder_ = nullptr;
+    auto decoder = decoders_.Get(packet->sample_rate, packet->frame_duration);
+    if (decoder != nullptr) {
+        // Decode straight into the playback frame unless it still has to be resampled
+        const bool resample = decoder->resampler.IsOpen();
+        auto& pcm = resample ? decode_buffer_ : task->pcm;
+        pcm.resize(decoder->frame_size);
+        // A lost frame is rebuilt from the FEC data of the next packet, or concealed without it
+        esp_audio_dec_recovery_t recovery = ESP_AUDIO_DEC_RECOVERY_NONE;
+        if (packet->lost) {
+            recovery = packet->payload.empty() ? ESP_AUDIO_DEC_RECOVERY_PLC : ESP_AUDIO_DEC_RECOVERY_FEC;
+        }
+        esp_audio_dec_in_raw_t raw = {
+            .buffer = packet->payload.empty() ? nullptr : (uint8_t *)(packet->payload.data()),
+            .len = (uint32_t)(packet->payload.size()),
+            .consumed = 0,
+            .frame_recover = recovery,
+        };
+        esp_audio_dec_out_frame_t out_frame = {
+            .buffer = (uint8_t *)(pcm.data()),
+            .len = (uint32_t)(pcm.size() * sizeof(int16_t)),
+            .decoded_size = 0,
+        };
+        esp_audio_dec_info_t dec_info = {};
+        int64_t start_time = esp_timer_get_time();
+        auto ret = esp_opus_dec_decode(decoder->handle, &raw, &out_frame, &dec_info);
+        if (ret == ESP_AUDIO_ERR_OK) {
+            pcm.resize(out_frame.decoded_size / sizeof(int16_t));
+            if (resample) {
+                // Into the pooled playback frame, which keeps its capacity between packets
+                task->pcm.resize(decoder->resampler.MaxOutputFrames(pcm.size()));
+                task->pcm.resize(decoder->resampler.Process(pcm.data(), pcm.size(), task->pcm.data()));
+            }
+            decoded = true;
+            uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start_time);
+            decode_time_total_us_ += elapsed;
+            debug_statistics_.decode_time_max_us = std::max(debug_statistics_.decode_time_max_us, elapsed);
+        } else {
+            ESP_LOGE(TAG, "Failed to decode audio after resize, error code: %d", ret);
+        }
+    } else {
+        ESP_LOGE(TAG, "Audio decoder is not configured");
     }
     decoder_lock.unlock();
-    esp_opus_dec_cfg_t opus_dec_cfg = OPUS_DEC_CFG(sample_rate, frame_duration);
-    auto ret = esp_opus_dec_open(&opus_dec_cfg, sizeof(esp_opus_dec_cfg_t), &opus_decoder_);
-    if (opus_decoder_ == nullptr) {
-        ESP_LOGE(TAG, "Failed to create audio decoder, error code: %d", ret);
-        return;
+
+    packet_pool_.Release(std::move(packet));
+    debug_statistics_.decode_count++;
+
+    if (decoded && generation == playback_generation_.load() && !service_stopped_.load() &&
+        audio_playback_queue_.Push(task)) {
+        NotifyTask(audio_output_task_handle_);
+    } else {
+        playback_task_pool_.Release(std::move(task));
+        FinishPlaybackWork();
+    }
+    return true;
+}
+
+bool AudioService::EncodeNextTask() {
+    auto task = audio_encode_queue_.Pop();
+    if (!task) {
+        return false;
     }
-    decoder_sample_rate_ = sample_rate;
-    decoder_duration_ms_ = frame_duration;
-    decoder_frame_size_ = decoder_sample_rate_ / 1000 * frame_duration;
+#if CONFIG_USE_ADAPTIVE_OPUS_BITRATE
+    UpdateUplinkRate();
+#endif
 
-    auto codec = Board::GetInstance().GetAudioCodec();
-    if (decoder_sample_rate_ != codec->output_sample_rate()) {
-        ESP_LOGI(TAG, "Resampling audio from %d to %d", decoder_sample_rate_, codec->output_sample_rate());
-        if (output_resampler_ != nullptr) {
-            esp_ae_rate_cvt_close(output_resampler_);
-            output_resampler_ = nullptr;
+    const std::vector<int16_t>* pcm = &task->pcm;
+    uint32_t timestamp = task->timestamp;
+    if (encoder_duration_ms_ != OPUS_FRAME_DURATION_MS) {
+        // Longer uplink frames are built from several input frames
+        if (encode_accumulator_.empty()) {
+            encode_accumulator_timestamp_ = task->timestamp;
+        }
+        encode_accumulator_.insert(encode_accumulator_.end(), task->pcm.begin(), task->pcm.end());
+        if ((int)encode_accumulator_.size() < encoder_frame_size_) {
+            encode_task_pool_.Release(std::move(task));
+            return true;
+        }
+        pcm = &encode_accumulator_;
+        timestamp = encode_accumulator_timestamp_;
+    }
+
+    auto packet = AcquirePacket();
+    packet->frame_duration = encoder_duration_ms_;
+    packet->sample_rate = 16000;
+    packet->timestamp = timestamp;
+
+    if (opus_encoder_ != nullptr && pcm->size() == encoder_frame_size_) {
+        esp_audio_enc_in_frame_t in = {
+            .buffer = (uint8_t *)(pcm->data()),
+            .len = (uint32_t)(encoder_frame_size_ * sizeof(int16_t)),
+        };
+        esp_audio_enc_out_frame_t out = {
+            .buffer = encode_buffer_.data(),
+            .len = (uint32_t)encoder_outbuf_size_,
+            .encoded_bytes = 0,
+        };
+        int64_t start_time = esp_timer_get_time();
+        auto ret = esp_opus_enc_process(opus_encoder_, &in, &out);
+        if (ret == ESP_AUDIO_ERR_OK) {
+            uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start_time);
+            encode_time_total_us_ += elapsed;
+            debug_statistics_.encode_time_max_us = std::max(debug_statistics_.encode_time_max_us, elapsed);
+
+            packet->payload.assign(encode_buffer_.data(), encode_buffer_.data() + out.encoded_bytes);
+
+            if (task->type == kAudioTaskTypeEncodeToSendQueue) {
+                /* Never let a full send queue stall encoding: stale realtime
+                 * audio is useless to the server, so drop the oldest packet. */
+                auto dropped = audio_send_queue_.PushDropOldest(std::move(packet));
+                if (dropped) {
+                    send_drop_count_++;
+                    packet_pool_.Release(std::move(dropped));
+                }
+                if (callbacks_.on_send_queue_available) {
+                    callbacks_.on_send_queue_available();
+                }
+            } else if (task->type == kAudioTaskTypeEncodeToTestingQueue) {
+                // On success the queue takes the packet, otherwise it is released below
+                audio_testing_queue_.Push(packet);
+            }
+            debug_statistics_.encode_count++;
+        } else {
+            ESP_LOGE(TAG, "Failed to encode audio, error code: %d", ret);
         }
-        esp_ae_rate_cvt_cfg_t output_resampler_cfg = RATE_CVT_CFG(
-            decoder_sample_rate_, codec->output_sample_rate(), ESP_AUDIO_MONO);
-        auto resampler_ret = esp_ae_rate_cvt_open(&output_resampler_cfg, &output_resampler_);
-        if (output_resampler_ == nullptr) {
-            ESP_LOGE(TAG, "Failed to create output resampler, error code: %d", resampler_ret);
+    } else {
+        ESP_LOGE(TAG, "Failed to encode audio: encoder not configured or invalid frame size (got %u, expected %u)",
+                 pcm->size(), encoder_frame_size_);
+    }
+    encode_accumulator_.clear();
+    // Both are no-ops when the frame was handed over to a queue
+    packet_pool_.Release(std::move(packet));
+    encode_task_pool_.Release(std::move(task));
+    return true;
+}
+
+void AudioService::UpdateUplinkRate() {
+    bool changed = false;
+    int max_frame_duration = uplink_rate_reset_.exchange(-1);
+    if (max_frame_duration >= 0) {
+        rate_controller_.Reset(OPUS_FRAME_DURATION_MS, max_frame_duration);
+        changed = true;
+    }
+    /* Send-side drops and failed sends since the previous frame. Encode queue drops
+     * mean the encoder itself fell behind, which a lower bitrate with FEC would not help. */
+    uint32_t events = send_drop_count_.load() + send_failure_count_.load();
+    changed = rate_controller_.Update(audio_send_queue_.Size(), events - rate_pressure_events_) || changed;
+    rate_pressure_events_ = events;
+    if (changed || encoder_settings_pending_) {
+        // Retried on the next frame if the encoder could not be reopened
+        encoder_settings_pending_ = !ApplyEncoderSettings(rate_controller_.settings());
+    }
+}
+
+bool AudioService::ApplyEncoderSettings(const OpusRateSettings& settings) {
+    if (opus_encoder_ != nullptr && settings.fec == encoder_fec_ &&
+        settings.frame_duration_ms == encoder_duration_ms_) {
+        if (settings.bitrate == encoder_bitrate_) {
+            return true;
         }
+        if (esp_opus_enc_set_bitrate(opus_encoder_, settings.bitrate) == ESP_AUDIO_ERR_OK) {
+            encoder_bitrate_ = settings.bitrate;
+            return true;
+        }
+    }
+
+    /* FEC and frame duration can only be changed by reopening the encoder.
+     * The current one keeps encoding until the new one is open. */
+    esp_opus_enc_config_t opus_enc_cfg = AS_OPUS_ENC_CONFIG();
+    opus_enc_cfg.bitrate = settings.bitrate;
+    opus_enc_cfg.enable_fec = settings.fec;
+    opus_enc_cfg.frame_duration = (esp_opus_enc_frame_duration_t)AS_OPUS_GET_FRAME_DRU_ENUM(settings.frame_duration_ms);
+    void* encoder = nullptr;
+    auto ret = esp_opus_enc_open(&opus_enc_cfg, sizeof(esp_opus_enc_config_t), &encoder);
+    if (encoder == nullptr) {
+        ESP_LOGE(TAG, "Failed to reopen audio encoder, error code: %d", ret);
+        return false;
+    }
+    if (opus_encoder_ != nullptr) {
+        esp_opus_enc_close(opus_encoder_);
+    }
+    opus_encoder_ = encoder;
+    esp_opus_enc_get_frame_size(opus_encoder_, &encoder_frame_size_, &encoder_outbuf_size_);
+    encoder_frame_size_ = encoder_frame_size_ / sizeof(int16_t);
+    encoder_duration_ms_ = settings.frame_duration_ms;
+    encoder_bitrate_ = settings.bitrate;
+    encoder_fec_ = settings.fec;
+    encode_buffer_.resize(encoder_outbuf_size_);
+    if ((int)encode_accumulator_.size() >= encoder_frame_size_) {
+        encode_accumulator_.clear();
     }
+    return true;
 }
 
-void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm) {
-    auto task = std::make_unique<AudioTask>();
+void AudioService::PushTaskToEncodeQueue(AudioTaskType type, const std::vector<int16_t>& pcm) {
+    if (service_stopped_.load()) {
+        return;
+    }
+    auto task = encode_task_pool_.Acquire();
     task->type = type;
-    task->pcm = std::move(pcm);
+    task->timestamp = 0;
+    task->pcm.assign(pcm.begin(), pcm.end());
 
-    uint32_t dropped_total = 0;
-    {
-        /* Push the task to the encode queue */
-        std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-
-        /* If the task is to send queue, we need to set the timestamp */
-        if (type == kAudioTaskTypeEncodeToSendQueue && !timestamp_queue_.empty()) {
+    /* If the task is to send queue, we need to set the timestamp */
+    if (type == kAudioTaskTypeEncodeToSendQueue) {
+        std::lock_guard<std::mutex> lock(timestamp_mutex_);
+        if (!timestamp_queue_.empty()) {
             if (timestamp_queue_.size() <= MAX_TIMESTAMPS_IN_QUEUE) {
                 task->timestamp = timestamp_queue_.front();
             } else {
@@ -552,21 +621,24 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
             }
             timestamp_queue_.pop_front();
         }
+    }
 
+    uint32_t dropped_total = 0;
+    {
         /* Microphone audio is realtime, so drop the oldest frame instead of blocking.
          * Blocking here would stall the audio engine task (AFE fetch) and deadlock the
          * whole input pipeline when the send queue stops being drained (e.g. network
          * congestion or a failed UDP send). */
-        if (audio_encode_queue_.size() >= MAX_ENCODE_TASKS_IN_QUEUE) {
-            audio_encode_queue_.pop_front();
+        std::lock_guard<std::mutex> lock(encode_push_mutex_);
+        auto dropped = audio_encode_queue_.PushDropOldest(std::move(task));
+        if (dropped) {
             dropped_total = ++debug_statistics_.encode_drop_count;
+            encode_task_pool_.Release(std::move(dropped));
         }
-        audio_encode_queue_.push_back(std::move(task));
-        audio_queue_cv_.notify_all();
     }
+    NotifyTask(opus_encode_task_handle_);
 
-    /* Log outside the lock (UART writes are slow and would starve the codec task),
-     * at most once per second. */
+    /* Log at most once per second (UART writes are slow) */
     if (dropped_total > 0) {
         int64_t now = esp_timer_get_time();
         if (now - last_encode_drop_log_time_ >= 1000000) {
@@ -578,37 +650,59 @@ void AudioService::PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t
 }
 
 bool AudioService::PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait) {
-    std::unique_lock<std::mutex> lock(audio_queue_mutex_);
-    if (audio_decode_queue_.size() >= MAX_DECODE_PACKETS_IN_QUEUE) {
-        if (wait) {
-            audio_queue_cv_.wait(lock, [this]() {
-                return service_stopped_.load() ||
-                    audio_decode_queue_.size() < MAX_DECODE_PACKETS_IN_QUEUE;
-            });
-        } else {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(decode_push_mutex_);
+            if (service_stopped_.load()) {
+                packet_pool_.Release(std::move(packet));
+                return false;
+            }
+            if (audio_decode_queue_.Size() < MAX_DECODE_PACKETS_IN_QUEUE) {
+                /* Count the packet before the codec task can see it, so the playback
+                 * never looks drained while the packet is on its way */
+                playback_pending_.fetch_add(1);
+                audio_decode_queue_.Push(packet);
+                break;
+            }
+        }
+        if (!wait) {
+            packet_pool_.Release(std::move(packet));
             return false;
         }
+        /* Clear the bit before checking again, so a slot freed in between still wakes us up */
+        xEventGroupClearBits(event_group_, AS_EVENT_DECODE_QUEUE_AVAILABLE);
+        if (audio_decode_queue_.Size() >= MAX_DECODE_PACKETS_IN_QUEUE && !service_stopped_.load()) {
+            xEventGroupWaitBits(event_group_, AS_EVENT_DECODE_QUEUE_AVAILABLE, pdFALSE, pdFALSE, portMAX_DELAY);
+        }
     }
-    if (service_stopped_.load()) {
-        return false;
-    }
-    playback_drained_notified_ = false;
-    audio_decode_queue_.push_back(std::move(packet));
-    audio_queue_cv_.notify_all();
+    NotifyTask(opus_decode_task_handle_);
     return true;
 }
 
 std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    if (audio_send_queue_.empty()) {
-        return nullptr;
-    }
-    auto packet = std::move(audio_send_queue_.front());
-    audio_send_queue_.pop_front();
-    audio_queue_cv_.notify_all();
+    return audio_send_queue_.Pop();
+}
+
+std::unique_ptr<AudioStreamPacket> AudioService::AcquirePacket() {
+    auto packet = packet_pool_.Acquire();
+    packet->timestamp = 0;
+    packet->lost = false;
     return packet;
 }
 
+void AudioService::RecyclePacket(std::unique_ptr<AudioStreamPacket> packet) {
+    packet_pool_.Release(std::move(packet));
+}
+
+void AudioService::ReportSendFailure(size_t dropped_packets) {
+    send_failure_count_++;
+    send_drop_count_ += dropped_packets;
+}
+
+void AudioService::ResetUplinkRate(int max_frame_duration_ms) {
+    uplink_rate_reset_.store(std::max(max_frame_duration_ms, 0));
+}
+
 void AudioService::EncodeWakeWord() {
     if (audio_engine_) {
         audio_engine_->EncodeWakeWordData();
@@ -621,11 +715,14 @@ const std::string& AudioService::GetLastWakeWord() const {
 }
 
 std::unique_ptr<AudioStreamPacket> AudioService::PopWakeWordPacket() {
-    auto packet = std::make_unique<AudioStreamPacket>();
-    if (audio_engine_ && audio_engine_->GetWakeWordOpus(packet->payload)) {
-        return packet;
+    if (!audio_engine_ || !audio_engine_->GetWakeWordOpus(wake_word_opus_)) {
+        return nullptr;
     }
-    return nullptr;
+    auto packet = AcquirePacket();
+    packet->sample_rate = 16000;
+    packet->frame_duration = OPUS_FRAME_DURATION_MS;
+    packet->payload.assign(wake_word_opus_.begin(), wake_word_opus_.end());
+    return packet;
 }
 
 void AudioService::EnableWakeWordDetection(bool enable) {
@@ -637,9 +734,7 @@ void AudioService::EnableWakeWordDetection(bool enable) {
         }
         {
             std::lock_guard<std::mutex> lock(input_resampler_mutex_);
-            if (input_resampler_ != nullptr) {
-                esp_ae_rate_cvt_reset(input_resampler_);
-            }
+            input_resampler_.Reset();
         }
         audio_engine_->EnableWakeWordDetection(true);
         xEventGroupSetBits(event_group_, AS_EVENT_WAKE_WORD_RUNNING);
@@ -662,9 +757,7 @@ void AudioService::EnableVoiceProcessing(bool enable) {
         audio_input_need_warmup_ = true;
         {
             std::lock_guard<std::mutex> lock(input_resampler_mutex_);
-            if (input_resampler_ != nullptr) {
-                esp_ae_rate_cvt_reset(input_resampler_);
-            }
+            input_resampler_.Reset();
         }
         audio_engine_->EnableVoiceProcessing(true);
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
@@ -682,13 +775,21 @@ void AudioService::EnableAudioTesting(bool enable) {
         xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
     } else {
         xEventGroupClearBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING);
-        /* Copy audio_testing_queue_ to audio_decode_queue_ */
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        audio_decode_queue_ = std::move(audio_testing_queue_);
-        if (!audio_decode_queue_.empty()) {
-            playback_drained_notified_ = false;
+        /* Move audio_testing_queue_ to audio_decode_queue_, it is large enough for a whole recording */
+        int drained = 0;
+        {
+            std::lock_guard<std::mutex> lock(decode_push_mutex_);
+            drained = DrainPackets(audio_decode_queue_);
+            while (auto packet = audio_testing_queue_.Pop()) {
+                playback_pending_.fetch_add(1);
+                if (!audio_decode_queue_.Push(packet)) {
+                    playback_pending_.fetch_sub(1);
+                    packet_pool_.Release(std::move(packet));
+                }
+            }
         }
-        audio_queue_cv_.notify_all();
+        NotifyTask(opus_decode_task_handle_);
+        FinishPlaybackWork(drained);
     }
 }
 
@@ -708,6 +809,17 @@ void AudioService::SetCallbacks(AudioServiceCallbacks& callbacks) {
 }
 
 void AudioService::PlaySound(const std::string_view& ogg) {
+    /* Mixed into the output by AudioOutputTask, independent of the decode queue. A clip
+     * that follows one still streaming through the decode queue streams after it. */
+    if (!(sound_streaming_ && !IsPlaybackIdle()) && sound_effects_.Play(ogg)) {
+        sound_streaming_ = false;
+        // A clip that is not cached yet is decoded by the opus decode task
+        NotifyTask(opus_decode_task_handle_);
+        NotifyTask(audio_output_task_handle_);
+        return;
+    }
+    sound_streaming_ = true;
+
     if (!codec_->output_enabled()) {
         esp_timer_stop(audio_power_timer_);
         esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
@@ -719,60 +831,75 @@ void AudioService::PlaySound(const std::string_view& ogg) {
 
     auto demuxer = std::make_unique<OggDemuxer>();
     demuxer->OnDemuxerFinished([this](const uint8_t* data, int sample_rate, size_t size){
-        auto packet = std::make_unique<AudioStreamPacket>();
+        auto packet = AcquirePacket();
         packet->sample_rate = sample_rate;
         packet->frame_duration = 60;
-        packet->payload.resize(size);
-        std::memcpy(packet->payload.data(), data, size);
+        packet->timestamp = 0;
+        packet->payload.assign(data, data + size);
         PushPacketToDecodeQueue(std::move(packet), true);
     });
     demuxer->Reset();
     demuxer->Process(buf, size);
 }
 
+void AudioService::PreloadSound(const std::string_view& ogg) {
+    sound_effects_.Preload(ogg);
+    NotifyTask(opus_decode_task_handle_);
+}
+
 bool AudioService::IsIdle() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return audio_encode_queue_.empty() && IsPlaybackDrainedLocked() && audio_testing_queue_.empty();
+    return audio_encode_queue_.Empty() && playback_pending_.load() == 0 && audio_testing_queue_.Empty() &&
+        !sound_effects_.IsPlaying();
 }
 
 bool AudioService::IsPlaybackIdle() {
-    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-    return IsPlaybackDrainedLocked();
+    return playback_pending_.load() == 0;
 }
 
 void AudioService::ResetDecoder() {
-    bool notify_drained = false;
+    ++playback_generation_;
     {
-        std::lock_guard<std::mutex> lock(audio_queue_mutex_);
-        ++playback_generation_;
-        std::unique_lock<std::mutex> decoder_lock(decoder_mutex_);
-        if (opus_decoder_ != nullptr) {
-            esp_opus_dec_reset(opus_decoder_);
-        }
-        decoder_lock.unlock();
+        std::lock_guard<std::mutex> decoder_lock(decoder_mutex_);
+        decoders_.Reset();
+    }
+    {
+        std::lock_guard<std::mutex> lock(timestamp_mutex_);
         timestamp_queue_.clear();
-        audio_decode_queue_.clear();
-        audio_playback_queue_.clear();
-        audio_testing_queue_.clear();
-        notify_drained = MarkPlaybackDrainedLocked();
-        audio_queue_cv_.notify_all();
     }
-    if (notify_drained && callbacks_.on_playback_drained) {
-        callbacks_.on_playback_drained();
+    int drained = DrainPackets(audio_decode_queue_) + DrainTasks(playback_task_pool_, audio_playback_queue_);
+    DrainPackets(audio_testing_queue_);
+    xEventGroupSetBits(event_group_, AS_EVENT_DECODE_QUEUE_AVAILABLE);
+    FinishPlaybackWork(drained);
+}
+
+int AudioService::DrainPackets(AudioRingQueue<AudioStreamPacket>& queue) {
+    int count = 0;
+    while (auto packet = queue.Pop()) {
+        packet_pool_.Release(std::move(packet));
+        ++count;
     }
+    return count;
 }
 
-bool AudioService::IsPlaybackDrainedLocked() const {
-    return audio_decode_queue_.empty() && audio_playback_queue_.empty() &&
-        !decode_in_flight_ && !output_in_flight_;
+int AudioService::DrainTasks(AudioFramePool<AudioTask>& pool, AudioRingQueue<AudioTask>& queue) {
+    int count = 0;
+    while (auto task = queue.Pop()) {
+        pool.Release(std::move(task));
+        ++count;
+    }
+    return count;
 }
 
-bool AudioService::MarkPlaybackDrainedLocked() {
-    if (!IsPlaybackDrainedLocked() || playback_drained_notified_) {
-        return false;
+void AudioService::FinishPlaybackWork(int count) {
+    if (count > 0 && playback_pending_.fetch_sub(count) == count && callbacks_.on_playback_drained) {
+        callbacks_.on_playback_drained();
+    }
+}
+
+void AudioService::NotifyTask(TaskHandle_t task) {
+    if (task != nullptr) {
+        xTaskNotifyGive(task);
     }
-    playback_drained_notified_ = true;
-    return true;
 }
 
 void AudioService::CheckAndUpdateAudioPowerState() {
@@ -803,6 +930,51 @@ void AudioService::SetModelsList(srmodel_list_t* models_list) {
     models_list_ = models_list;
 }
 
+DebugStatistics AudioService::GetDebugStatistics() const {
+    DebugStatistics statistics = debug_statistics_;
+    statistics.encode_task_pool = encode_task_pool_.stats();
+    statistics.playback_task_pool = playback_task_pool_.stats();
+    statistics.packet_pool = packet_pool_.stats();
+    statistics.send_drop_count = send_drop_count_.load();
+    statistics.send_failure_count = send_failure_count_.load();
+    statistics.uplink_bitrate = encoder_bitrate_;
+    statistics.uplink_fec = encoder_fec_;
+    statistics.uplink_frame_duration_ms = encoder_duration_ms_;
+    if (statistics.encode_count > 0) {
+        statistics.encode_time_avg_us = encode_time_total_us_ / statistics.encode_count;
+    }
+    if (statistics.decode_count > 0) {
+        statistics.decode_time_avg_us = decode_time_total_us_ / statistics.decode_count;
+    }
+    return statistics;
+}
+
+void AudioService::PrintDebugStatistics() const {
+    auto statistics = GetDebugStatistics();
+    ESP_LOGI(TAG, "input: %lu, encode: %lu (dropped %lu), decode: %lu, playback: %lu",
+        (unsigned long)statistics.input_count, (unsigned long)statistics.encode_count,
+        (unsigned long)statistics.encode_drop_count, (unsigned long)statistics.decode_count,
+        (unsigned long)statistics.playback_count);
+    ESP_LOGI(TAG, "encode time: avg %lu us, max %lu us; decode time: avg %lu us, max %lu us",
+        (unsigned long)statistics.encode_time_avg_us, (unsigned long)statistics.encode_time_max_us,
+        (unsigned long)statistics.decode_time_avg_us, (unsigned long)statistics.decode_time_max_us);
+    ESP_LOGI(TAG, "uplink: bitrate %d, fec %d, frame %d ms, send dropped %lu, send failed %lu",
+        statistics.uplink_bitrate, statistics.uplink_fec, statistics.uplink_frame_duration_ms,
+        (unsigned long)statistics.send_drop_count, (unsigned long)statistics.send_failure_count);
+    auto print_pool = [](const char* name, const AudioFramePoolStats& pool) {
+        ESP_LOGI(TAG, "%s pool: %u/%u free, high water %u, misses %lu", name,
+            (unsigned)pool.free, (unsigned)pool.capacity, (unsigned)pool.high_water,
+            (unsigned long)pool.misses);
+    };
+    print_pool("encode", statistics.encode_task_pool);
+    print_pool("playback", statistics.playback_task_pool);
+    print_pool("packet", statistics.packet_pool);
+    auto sounds = sound_effects_.GetCacheStats();
+    ESP_LOGI(TAG, "sound cache: %lu hits, %lu misses, %lu evictions, %u clips, %u KB",
+        (unsigned long)sounds.hits, (unsigned long)sounds.misses, (unsigned long)sounds.evictions,
+        (unsigned)sounds.entries, (unsigned)(sounds.bytes / 1024));
+}
+
 bool AudioService::IsAfeWakeWord() {
     return audio_engine_initialized_ && audio_engine_->IsAfeWakeWord();
 }
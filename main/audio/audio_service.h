@@ -4,7 +4,6 @@
 #include <memory>
 #include <atomic>
 #include <deque>
-#include <condition_variable>
 #include <chrono>
 #include <mutex>
 
@@ -22,18 +21,31 @@
 #include "audio_codec.h"
 #include "audio_debugger.h"
 #include "audio_engine.h"
+#include "audio_frame_pool.h"
+#include "audio_resampler.h"
+#include "audio_ring_queue.h"
+#include "opus_decoder_cache.h"
+#include "opus_rate_controller.h"
+#include "sound_effect_mixer.h"
 #include "protocol.h"
 #include "ogg_demuxer.h"
 
 /*
  * There are two types of audio data flow:
- * 1. (MIC) -> [Audio Engine] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> (Server)
+ * 1. (MIC) -> [Audio Engine] -> {Encode Queue} -> [Opus Encoder] -> {Send Queue} -> [AudioSender] -> (Server)
  * 2. (Server) -> {Decode Queue} -> [Opus Decoder] -> {Playback Queue} -> (Speaker)
  *
  * We use dedicated tasks for input, output, and Opus encoding/decoding.
+ * With CONFIG_USE_SPLIT_OPUS_CODEC_TASKS, encoding and decoding run in two tasks pinned to different cores.
  * 
  * Decode Queue and Send Queue are the main queues, because Opus packets are quite smaller than PCM packets.
  * 
+ * PCM frames and Opus packets are recycled through fixed-size pools, so steady-state streaming
+ * does not allocate from the heap.
+ *
+ * Every queue is a lock-free ring with one producer. Tasks wake each other with task notifications,
+ * so a push only wakes the task that consumes from that queue.
+ *
  */
 
 #define OPUS_FRAME_DURATION_MS 60
@@ -42,7 +54,14 @@
 #define MAX_DECODE_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define MAX_SEND_PACKETS_IN_QUEUE (2400 / OPUS_FRAME_DURATION_MS)
 #define AUDIO_TESTING_MAX_DURATION_MS 10000
+#define AUDIO_TESTING_MAX_PACKETS (AUDIO_TESTING_MAX_DURATION_MS / OPUS_FRAME_DURATION_MS)
 #define MAX_TIMESTAMPS_IN_QUEUE 3
+#define SOUND_EFFECT_PERIOD_MS 20
+
+/* One extra frame is held by the producer and one by the consumer of each PCM queue */
+#define ENCODE_TASK_POOL_SIZE (MAX_ENCODE_TASKS_IN_QUEUE + 2)
+#define PLAYBACK_TASK_POOL_SIZE (MAX_PLAYBACK_TASKS_IN_QUEUE + 2)
+#define PACKET_POOL_SIZE (MAX_SEND_PACKETS_IN_QUEUE + MAX_DECODE_PACKETS_IN_QUEUE + 4)
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
@@ -51,6 +70,7 @@
 #define AS_EVENT_WAKE_WORD_RUNNING          (1 << 1)
 #define AS_EVENT_AUDIO_PROCESSOR_RUNNING    (1 << 2)
 #define AS_EVENT_AUDIO_INPUT_STOP_REQUEST   (1 << 4)
+#define AS_EVENT_DECODE_QUEUE_AVAILABLE     (1 << 5)
 
 #define AS_OPUS_GET_FRAME_DRU_ENUM(duration_ms)                   \
     ((duration_ms) == 5 ? ESP_OPUS_ENC_FRAME_DURATION_5_MS :      \
@@ -95,6 +115,7 @@ struct AudioTask {
     AudioTaskType type;
     std::vector<int16_t> pcm;
     uint32_t timestamp = 0;
+    uint32_t generation = 0;    // Playback generation the frame was decoded for
 };
 
 struct DebugStatistics {
@@ -103,6 +124,20 @@ struct DebugStatistics {
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
     uint32_t encode_drop_count = 0;
+    uint32_t send_drop_count = 0;       // Packets dropped from a full send queue or after a failed send
+    uint32_t send_failure_count = 0;
+    // Current uplink encoder settings (see OpusRateController)
+    int uplink_bitrate = ESP_OPUS_BITRATE_AUTO;
+    bool uplink_fec = false;
+    int uplink_frame_duration_ms = OPUS_FRAME_DURATION_MS;
+    // Time spent in the Opus encoder / decoder (and output resampler) per frame
+    uint32_t encode_time_avg_us = 0;
+    uint32_t encode_time_max_us = 0;
+    uint32_t decode_time_avg_us = 0;
+    uint32_t decode_time_max_us = 0;
+    AudioFramePoolStats encode_task_pool;
+    AudioFramePoolStats playback_task_pool;
+    AudioFramePoolStats packet_pool;
 };
 
 class AudioService {
@@ -132,10 +167,19 @@ public:
 
     bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet, bool wait = false);
     std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+    // Packets from AcquirePacket() are recycled by the audio service once consumed, or with RecyclePacket()
+    std::unique_ptr<AudioStreamPacket> AcquirePacket();
+    void RecyclePacket(std::unique_ptr<AudioStreamPacket> packet);
+    void ReportSendFailure(size_t dropped_packets);
+    void ResetUplinkRate(int max_frame_duration_ms);
     void PlaySound(const std::string_view& sound);
+    // Has the opus decode task put a sound into the sound effect cache, so its first PlaySound() starts at once
+    void PreloadSound(const std::string_view& sound);
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void SetModelsList(srmodel_list_t* models_list);
+    DebugStatistics GetDebugStatistics() const;
+    void PrintDebugStatistics() const;
 
 private:
     AudioCodec* codec_ = nullptr;
@@ -143,22 +187,46 @@ private:
     std::unique_ptr<AudioEngine> audio_engine_;
     std::unique_ptr<AudioDebugger> audio_debugger_;
     void* opus_encoder_ = nullptr;
-    void* opus_decoder_ = nullptr;
+    // Guards decoders_, also against ResetDecoder() from other tasks
     std::mutex decoder_mutex_;
+    OpusDecoderCache decoders_;
+    SoundEffectMixer sound_effects_;
+    // Output period when only sound effects play, short so server audio is not held up
+    std::vector<int16_t> sound_effect_frame_;
+    // The last sound was too large for the mixer and went through the decode queue
+    std::atomic<bool> sound_streaming_{false};
     std::mutex input_resampler_mutex_;
-    esp_ae_rate_cvt_handle_t input_resampler_ = nullptr;
-    esp_ae_rate_cvt_handle_t output_resampler_ = nullptr;
+    AudioResampler input_resampler_;
     
     // Encoder/Decoder state
     int encoder_sample_rate_ = 16000;
     int encoder_duration_ms_ = OPUS_FRAME_DURATION_MS;
     int encoder_frame_size_ = 0;
     int encoder_outbuf_size_ = 0;
-    int decoder_sample_rate_ = 0;
-    int decoder_duration_ms_ = OPUS_FRAME_DURATION_MS;
-    int decoder_frame_size_ = 0;
+    int encoder_bitrate_ = ESP_OPUS_BITRATE_AUTO;
+    bool encoder_fec_ = false;
     DebugStatistics debug_statistics_;
+    AudioFramePool<AudioTask> encode_task_pool_;
+    AudioFramePool<AudioTask> playback_task_pool_;
+    AudioFramePool<AudioStreamPacket> packet_pool_;
+    // Scratch buffers reused across frames, each owned by a single task
+    std::vector<int16_t> input_resample_buffer_;
+    std::vector<int16_t> decode_buffer_;
+    std::vector<uint8_t> encode_buffer_;
+    std::vector<uint8_t> wake_word_opus_;
+    // Input frames collected for an uplink frame longer than OPUS_FRAME_DURATION_MS
+    std::vector<int16_t> encode_accumulator_;
+    uint32_t encode_accumulator_timestamp_ = 0;
+    OpusRateController rate_controller_;
+    // Max uplink frame duration passed to ResetUplinkRate(), picked up by the encoder task; -1 when none
+    std::atomic<int> uplink_rate_reset_{-1};
+    std::atomic<uint32_t> send_drop_count_{0};
+    std::atomic<uint32_t> send_failure_count_{0};
+    uint32_t rate_pressure_events_ = 0;
+    bool encoder_settings_pending_ = false;
     int64_t last_encode_drop_log_time_ = 0;
+    uint64_t encode_time_total_us_ = 0;
+    uint64_t decode_time_total_us_ = 0;
     srmodel_list_t* models_list_ = nullptr;
 
     EventGroupHandle_t event_group_;
@@ -166,19 +234,24 @@ private:
     // Audio encode / decode
     TaskHandle_t audio_input_task_handle_ = nullptr;
     TaskHandle_t audio_output_task_handle_ = nullptr;
-    TaskHandle_t opus_codec_task_handle_ = nullptr;
-    std::mutex audio_queue_mutex_;
-    std::condition_variable audio_queue_cv_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_decode_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_send_queue_;
-    std::deque<std::unique_ptr<AudioStreamPacket>> audio_testing_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_encode_queue_;
-    std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
-    bool decode_in_flight_ = false;
-    bool output_in_flight_ = false;
-    bool playback_drained_notified_ = true;
-    uint32_t playback_generation_ = 0;
+    // Both handles refer to the same task unless the encoder and decoder are split
+    TaskHandle_t opus_encode_task_handle_ = nullptr;
+    TaskHandle_t opus_decode_task_handle_ = nullptr;
+    // The decode queue can also hold a whole audio test recording (see EnableAudioTesting)
+    AudioRingQueue<AudioStreamPacket> audio_decode_queue_{AUDIO_TESTING_MAX_PACKETS + MAX_ENCODE_TASKS_IN_QUEUE};
+    AudioRingQueue<AudioStreamPacket> audio_send_queue_{MAX_SEND_PACKETS_IN_QUEUE};
+    AudioRingQueue<AudioStreamPacket> audio_testing_queue_{AUDIO_TESTING_MAX_PACKETS + MAX_ENCODE_TASKS_IN_QUEUE};
+    AudioRingQueue<AudioTask> audio_encode_queue_{MAX_ENCODE_TASKS_IN_QUEUE};
+    AudioRingQueue<AudioTask> audio_playback_queue_{MAX_PLAYBACK_TASKS_IN_QUEUE};
+    // Serialize the producers of the queues that are fed from more than one task
+    std::mutex encode_push_mutex_;
+    std::mutex decode_push_mutex_;
+    // Packets queued for decoding plus the frames decoded from them that have not been played yet.
+    // Whoever brings it down to zero reports the playback as drained.
+    std::atomic<int> playback_pending_{0};
+    std::atomic<uint32_t> playback_generation_{0};
     // For server AEC
+    std::mutex timestamp_mutex_;
     std::deque<uint32_t> timestamp_queue_;
 
     bool audio_engine_initialized_ = false;
@@ -198,12 +271,20 @@ private:
     void AudioInputTask();
     void AudioOutputTask();
     void OpusCodecTask();
-    void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t>&& pcm);
+    void OpusEncodeTask();
+    void OpusDecodeTask();
+    bool DecodeNextPacket();
+    bool EncodeNextTask();
+    void UpdateUplinkRate();
+    bool ApplyEncoderSettings(const OpusRateSettings& settings);
+    void PushTaskToEncodeQueue(AudioTaskType type, const std::vector<int16_t>& pcm);
+    int DrainPackets(AudioRingQueue<AudioStreamPacket>& queue);
+    int DrainTasks(AudioFramePool<AudioTask>& pool, AudioRingQueue<AudioTask>& queue);
+    void FinishPlaybackWork(int count = 1);
+    void OutputPlaybackData(std::vector<int16_t>& pcm);
+    void NotifyTask(TaskHandle_t task);
     bool InitializeAudioEngine();
-    void SetDecodeSampleRate(int sample_rate, int frame_duration);
     void CheckAndUpdateAudioPowerState();
-    bool IsPlaybackDrainedLocked() const;
-    bool MarkPlaybackDrainedLocked();
 };
 
 #endif
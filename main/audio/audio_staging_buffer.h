@@ -0,0 +1,97 @@
+#ifndef AUDIO_STAGING_BUFFER_H
+#define AUDIO_STAGING_BUFFER_H
+
+#include "pcm_kernels.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/*
+ * Fixed-capacity staging buffer for PCM that is produced in one block size and
+ * consumed in another, e.g. 10 ms microphone reads fed to the AFE in chunks of
+ * get_feed_chunksize, or AFE results cut into encoder frames.
+ *
+ * Consumed samples only advance a read offset. The unread tail, always shorter
+ * than one chunk, is moved to the front when an append would not fit, so every
+ * chunk stays contiguous without erasing from the front of a vector on every
+ * read. Not thread safe, callers keep their own locking.
+ */
+class AudioStagingBuffer {
+public:
+    // Room for the largest chunk consumed plus the largest block appended at once
+    void Reserve(size_t capacity) {
+        if (buffer_.size() < capacity) {
+            Compact();
+            buffer_.resize(capacity);
+        }
+    }
+
+    void Clear() {
+        read_ = 0;
+        write_ = 0;
+    }
+
+    size_t Size() const { return write_ - read_; }
+
+    void Append(const int16_t* data, size_t samples) {
+        int16_t* dest = Prepare(samples);
+        std::memcpy(dest, data, samples * sizeof(int16_t));
+        write_ += samples;
+    }
+
+    // Keeps every stride-th sample, starting with the first (channel 0 of interleaved input)
+    void AppendStrided(const int16_t* data, size_t samples, size_t stride) {
+        if (stride <= 1) {
+            Append(data, samples);
+            return;
+        }
+        const size_t count = (samples + stride - 1) / stride;
+        int16_t* dest = Prepare(count);
+        const size_t frames = samples / stride;
+        pcm::ExtractChannel(data, dest, frames, stride, 0);
+        if (count > frames) {
+            // A partial last frame still gives its first sample
+            dest[frames] = data[frames * stride];
+        }
+        write_ += count;
+    }
+
+    // Oldest unread sample, valid for Size() samples until the next append
+    const int16_t* Data() const { return buffer_.data() + read_; }
+
+    void Consume(size_t samples) {
+        read_ += samples;
+        if (read_ >= write_) {
+            Clear();
+        }
+    }
+
+private:
+    std::vector<int16_t> buffer_;
+    size_t read_ = 0;
+    size_t write_ = 0;
+
+    int16_t* Prepare(size_t samples) {
+        if (write_ + samples > buffer_.size()) {
+            Compact();
+            if (write_ + samples > buffer_.size()) {
+                // Only when a caller appends more than it reserved for
+                buffer_.resize(write_ + samples);
+            }
+        }
+        return buffer_.data() + write_;
+    }
+
+    void Compact() {
+        if (read_ == 0) {
+            return;
+        }
+        std::memmove(buffer_.data(), buffer_.data() + read_, Size() * sizeof(int16_t));
+        write_ -= read_;
+        read_ = 0;
+    }
+};
+
+#endif // AUDIO_STAGING_BUFFER_H
@@ -215,14 +215,17 @@ int Es8389AudioCodec::Write(const int16_t* data, int samples) {
         if (output_channels_ > 1) {
             // xiaozhi 全链路产出单声道 PCM；双声道输出时复制到 L/R 两路，
             // 否则样本数不匹配会导致 I2S 欠载/杂音。
-            std::vector<int16_t> stereo(static_cast<size_t>(samples) * output_channels_);
+            const size_t output_samples = static_cast<size_t>(samples) * output_channels_;
+            if (output_buffer_.size() < output_samples) {
+                output_buffer_.resize(output_samples);
+            }
             for (int i = 0; i < samples; ++i) {
                 for (int c = 0; c < output_channels_; ++c) {
-                    stereo[static_cast<size_t>(i) * output_channels_ + c] = data[i];
+                    output_buffer_[static_cast<size_t>(i) * output_channels_ + c] = data[i];
                 }
             }
             ESP_ERROR_CHECK_WITHOUT_ABORT(esp_codec_dev_write(
-                output_dev_, stereo.data(), stereo.size() * sizeof(int16_t)));
+                output_dev_, output_buffer_.data(), output_samples * sizeof(int16_t)));
         } else {
             ESP_ERROR_CHECK_WITHOUT_ABORT(esp_codec_dev_write(output_dev_, (void*)data, samples * sizeof(int16_t)));
         }
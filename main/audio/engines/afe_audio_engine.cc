@@ -54,7 +54,7 @@ bool AfeAudioEngine::Initialize(AudioCodec* codec, int frame_duration_ms, srmode
 
     codec_ = codec;
     frame_samples_ = frame_duration_ms * 16000 / 1000;
-    output_buffer_.reserve(frame_samples_);
+    output_frame_.reserve(frame_samples_);
 
     if (models_list == nullptr) {
         models_ = esp_srmodel_init("model");
@@ -100,7 +100,11 @@ bool AfeAudioEngine::Initialize(AudioCodec* codec, int frame_duration_ms, srmode
                 wake_words_.push_back(word);
             }
         }
-#if CONFIG_SEND_WAKE_WORD_DATA
+#if CONFIG_SEND_WAKE_WORD_DATA_PREENCODED
+        if (!wake_word_opus_cache_.Initialize(2000)) {
+            ESP_LOGW(TAG, "Wake-word audio upload disabled: encoder task allocation failed");
+        }
+#elif CONFIG_SEND_WAKE_WORD_DATA
         if (!wake_word_audio_cache_.Initialize(16000 * 2)) {
             ESP_LOGW(TAG, "Wake-word audio upload disabled: PSRAM cache allocation failed");
         }
@@ -191,7 +195,7 @@ bool AfeAudioEngine::Initialize(AudioCodec* codec, int frame_duration_ms, srmode
     return true;
 }
 
-void AfeAudioEngine::Feed(std::vector<int16_t>&& data) {
+void AfeAudioEngine::Feed(const std::vector<int16_t>& data) {
     EventBits_t bits = xEventGroupGetBits(event_group_);
     if ((bits & kVoiceProcessingEnabled) && !kUseAfeForVoiceProcessing) {
         OutputRawAudio(data);
@@ -204,11 +208,12 @@ void AfeAudioEngine::Feed(std::vector<int16_t>&& data) {
     if ((xEventGroupGetBits(event_group_) & kAfeActive) == 0) {
         return;
     }
-    input_buffer_.insert(input_buffer_.end(), data.begin(), data.end());
     size_t chunk_size = afe_iface_->get_feed_chunksize(afe_data_) * codec_->input_channels();
-    while (input_buffer_.size() >= chunk_size) {
-        afe_iface_->feed(afe_data_, input_buffer_.data());
-        input_buffer_.erase(input_buffer_.begin(), input_buffer_.begin() + chunk_size);
+    input_buffer_.Reserve(chunk_size + data.size());
+    input_buffer_.Append(data.data(), data.size());
+    while (input_buffer_.Size() >= chunk_size) {
+        afe_iface_->feed(afe_data_, input_buffer_.Data());
+        input_buffer_.Consume(chunk_size);
     }
 }
 
@@ -271,7 +276,7 @@ void AfeAudioEngine::OnWakeWordDetected(std::function<void(const std::string& wa
     wake_word_detected_callback_ = std::move(callback);
 }
 
-void AfeAudioEngine::OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) {
+void AfeAudioEngine::OnOutput(std::function<void(const std::vector<int16_t>& data)> callback) {
     output_callback_ = std::move(callback);
 }
 
@@ -290,7 +295,7 @@ void AfeAudioEngine::UpdateActiveState() {
         xEventGroupClearBits(event_group_, kAfeActive);
         control_generation_.fetch_add(1);
         std::lock_guard<std::mutex> lock(input_buffer_mutex_);
-        input_buffer_.clear();
+        input_buffer_.Clear();
         if (afe_data_ != nullptr) {
             // Don't call reset_buffer() here: this runs in the main task while
             // ProcessingTask may be inside fetch_with_delay() on the same AFE
@@ -341,7 +346,7 @@ void AfeAudioEngine::ApplyPendingReset() {
     // Discard audio recorded before (re)activation. Holding input_buffer_mutex_
     // serializes the reset against Feed(); fetch/reset both run in this task.
     std::lock_guard<std::mutex> lock(input_buffer_mutex_);
-    input_buffer_.clear();
+    input_buffer_.Clear();
     afe_iface_->reset_buffer(afe_data_);
 }
 
@@ -390,7 +395,9 @@ void AfeAudioEngine::HandleWakeWordResult(const afe_fetch_result_t* result) {
         return;
     }
 
-#if CONFIG_SEND_WAKE_WORD_DATA
+#if CONFIG_SEND_WAKE_WORD_DATA_PREENCODED
+    wake_word_opus_cache_.Store(result->data, result->data_size / sizeof(int16_t));
+#elif CONFIG_SEND_WAKE_WORD_DATA
     wake_word_audio_cache_.Store(result->data, result->data_size / sizeof(int16_t));
 #endif
     if (result->wakeup_state != WAKENET_DETECTED) {
@@ -415,7 +422,7 @@ void AfeAudioEngine::HandleWakeWordResult(const afe_fetch_result_t* result) {
 
 void AfeAudioEngine::HandleVoiceResult(const afe_fetch_result_t* result) {
     if (output_reset_pending_.exchange(false)) {
-        output_buffer_.clear();
+        output_buffer_.Clear();
     }
     if (vad_state_change_callback_) {
         if (result->vad_state == VAD_SPEECH && !is_speaking_) {
@@ -431,18 +438,9 @@ void AfeAudioEngine::HandleVoiceResult(const afe_fetch_result_t* result) {
     }
 
     size_t samples = result->data_size / sizeof(int16_t);
-    output_buffer_.insert(output_buffer_.end(), result->data, result->data + samples);
-    while (output_buffer_.size() >= static_cast<size_t>(frame_samples_)) {
-        if (output_buffer_.size() == static_cast<size_t>(frame_samples_)) {
-            output_callback_(std::move(output_buffer_));
-            output_buffer_.clear();
-            output_buffer_.reserve(frame_samples_);
-        } else {
-            output_callback_(std::vector<int16_t>(
-                output_buffer_.begin(), output_buffer_.begin() + frame_samples_));
-            output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + frame_samples_);
-        }
-    }
+    output_buffer_.Reserve(frame_samples_ + samples);
+    output_buffer_.Append(result->data, samples);
+    EmitOutputFrames();
 }
 
 void AfeAudioEngine::OutputRawAudio(const std::vector<int16_t>& data) {
@@ -450,20 +448,20 @@ void AfeAudioEngine::OutputRawAudio(const std::vector<int16_t>& data) {
         return;
     }
     if (output_reset_pending_.exchange(false)) {
-        output_buffer_.clear();
+        output_buffer_.Clear();
     }
-    const size_t channels = codec_->input_channels();
-    if (channels <= 1) {
-        output_buffer_.insert(output_buffer_.end(), data.begin(), data.end());
-    } else {
-        for (size_t i = 0; i < data.size(); i += channels) {
-            output_buffer_.push_back(data[i]);
-        }
-    }
-    while (output_buffer_.size() >= static_cast<size_t>(frame_samples_)) {
-        output_callback_(std::vector<int16_t>(
-            output_buffer_.begin(), output_buffer_.begin() + frame_samples_));
-        output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + frame_samples_);
+    output_buffer_.Reserve(frame_samples_ + data.size());
+    output_buffer_.AppendStrided(data.data(), data.size(), codec_->input_channels());
+    EmitOutputFrames();
+}
+
+void AfeAudioEngine::EmitOutputFrames() {
+    while (output_buffer_.Size() >= static_cast<size_t>(frame_samples_)) {
+        // The callback only borrows the frame (AudioService copies it into a pooled
+        // task), so the same allocation is refilled for every frame
+        output_frame_.assign(output_buffer_.Data(), output_buffer_.Data() + frame_samples_);
+        output_buffer_.Consume(frame_samples_);
+        output_callback_(output_frame_);
     }
 }
 
@@ -475,6 +473,11 @@ void AfeAudioEngine::EncodeWakeWordData() {
     if (wake_detector_ != WakeDetector::kWakeNet) {
         return;
     }
+#if CONFIG_SEND_WAKE_WORD_DATA_PREENCODED
+    // The pre-roll was encoded while waiting, only its last frames are left
+    wake_word_opus_cache_.Seal();
+    return;
+#endif
 
     const size_t stack_size = 4096 * 6;
     wake_word_opus_.clear();
@@ -563,6 +566,9 @@ bool AfeAudioEngine::GetWakeWordOpus(std::vector<uint8_t>& opus) {
     if (wake_detector_ != WakeDetector::kWakeNet) {
         return false;
     }
+#if CONFIG_SEND_WAKE_WORD_DATA_PREENCODED
+    return wake_word_opus_cache_.Pop(opus);
+#endif
     std::unique_lock<std::mutex> lock(wake_word_mutex_);
     wake_word_cv_.wait(lock, [this]() { return !wake_word_opus_.empty(); });
     opus.swap(wake_word_opus_.front());
@@ -16,7 +16,9 @@
 #include <freertos/task.h>
 
 #include "audio_engine.h"
+#include "audio_staging_buffer.h"
 #include "wake_words/wake_word_audio_cache.h"
+#include "wake_words/wake_word_opus_cache.h"
 
 class CustomWakeWord;
 
@@ -26,7 +28,7 @@ public:
     ~AfeAudioEngine() override;
 
     bool Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) override;
-    void Feed(std::vector<int16_t>&& data) override;
+    void Feed(const std::vector<int16_t>& data) override;
 
     void EnableWakeWordDetection(bool enable) override;
     void EnableVoiceProcessing(bool enable) override;
@@ -39,7 +41,7 @@ public:
     size_t GetFeedSize() const override;
 
     void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) override;
-    void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) override;
+    void OnOutput(std::function<void(const std::vector<int16_t>& data)> callback) override;
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
 
     void EncodeWakeWordData() override;
@@ -81,18 +83,20 @@ private:
     std::unique_ptr<CustomWakeWord> custom_wake_word_;
     std::vector<std::string> wake_words_;
     std::string last_detected_wake_word_;
-    std::vector<int16_t> input_buffer_;
-    std::vector<int16_t> output_buffer_;
+    AudioStagingBuffer input_buffer_;
+    AudioStagingBuffer output_buffer_;
+    std::vector<int16_t> output_frame_;
     std::mutex input_buffer_mutex_;
 
     std::function<void(const std::string&)> wake_word_detected_callback_;
-    std::function<void(std::vector<int16_t>&&)> output_callback_;
+    std::function<void(const std::vector<int16_t>&)> output_callback_;
     std::function<void(bool)> vad_state_change_callback_;
 
     TaskHandle_t wake_word_encode_task_ = nullptr;
     StaticTask_t* wake_word_encode_task_buffer_ = nullptr;
     StackType_t* wake_word_encode_task_stack_ = nullptr;
     WakeWordAudioCache wake_word_audio_cache_;
+    WakeWordOpusCache wake_word_opus_cache_;
     std::deque<std::vector<uint8_t>> wake_word_opus_;
     std::mutex wake_word_mutex_;
     std::condition_variable wake_word_cv_;
@@ -103,6 +107,7 @@ private:
     void ApplyAfeControls();
     void ApplyPendingReset();
     void OutputRawAudio(const std::vector<int16_t>& data);
+    void EmitOutputFrames();
     void HandleWakeWordResult(const afe_fetch_result_t* result);
     void HandleVoiceResult(const afe_fetch_result_t* result);
 };
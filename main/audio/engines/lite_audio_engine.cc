@@ -13,7 +13,7 @@ LiteAudioEngine::~LiteAudioEngine() = default;
 bool LiteAudioEngine::Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) {
     codec_ = codec;
     frame_samples_ = frame_duration_ms * 16000 / 1000;
-    output_buffer_.reserve(frame_samples_);
+    output_frame_.reserve(frame_samples_);
 
     bool has_wakenet = models_list != nullptr &&
         esp_srmodel_filter(models_list, ESP_WN_PREFIX, nullptr) != nullptr;
@@ -39,7 +39,7 @@ bool LiteAudioEngine::Initialize(AudioCodec* codec, int frame_duration_ms, srmod
     return true;
 }
 
-void LiteAudioEngine::Feed(std::vector<int16_t>&& data) {
+void LiteAudioEngine::Feed(const std::vector<int16_t>& data) {
     if (wake_word_enabled_ && wake_word_) {
         wake_word_->Feed(data);
     }
@@ -66,7 +66,7 @@ void LiteAudioEngine::EnableVoiceProcessing(bool enable) {
     voice_processing_enabled_ = enable;
     if (!enable) {
         std::lock_guard<std::mutex> lock(output_mutex_);
-        output_buffer_.clear();
+        output_buffer_.Clear();
     }
 }
 
@@ -99,7 +99,7 @@ void LiteAudioEngine::OnWakeWordDetected(std::function<void(const std::string& w
     wake_word_detected_callback_ = std::move(callback);
 }
 
-void LiteAudioEngine::OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) {
+void LiteAudioEngine::OnOutput(std::function<void(const std::vector<int16_t>& data)> callback) {
     output_callback_ = std::move(callback);
 }
 
@@ -127,24 +127,13 @@ void LiteAudioEngine::OutputRawAudio(const std::vector<int16_t>& data) {
     }
 
     std::lock_guard<std::mutex> lock(output_mutex_);
-    const size_t channels = codec_->input_channels();
-    if (channels <= 1) {
-        output_buffer_.insert(output_buffer_.end(), data.begin(), data.end());
-    } else {
-        for (size_t i = 0; i < data.size(); i += channels) {
-            output_buffer_.push_back(data[i]);
-        }
-    }
-
-    while (output_buffer_.size() >= static_cast<size_t>(frame_samples_)) {
-        if (output_buffer_.size() == static_cast<size_t>(frame_samples_)) {
-            output_callback_(std::move(output_buffer_));
-            output_buffer_.clear();
-            output_buffer_.reserve(frame_samples_);
-        } else {
-            output_callback_(std::vector<int16_t>(
-                output_buffer_.begin(), output_buffer_.begin() + frame_samples_));
-            output_buffer_.erase(output_buffer_.begin(), output_buffer_.begin() + frame_samples_);
-        }
+    output_buffer_.Reserve(frame_samples_ + data.size());
+    output_buffer_.AppendStrided(data.data(), data.size(), codec_->input_channels());
+
+    while (output_buffer_.Size() >= static_cast<size_t>(frame_samples_)) {
+        // The callback only borrows the frame, so the same allocation is refilled
+        output_frame_.assign(output_buffer_.Data(), output_buffer_.Data() + frame_samples_);
+        output_buffer_.Consume(frame_samples_);
+        output_callback_(output_frame_);
     }
 }
@@ -9,6 +9,7 @@
 #include <vector>
 
 #include "audio_engine.h"
+#include "audio_staging_buffer.h"
 
 class EspWakeWord;
 
@@ -18,7 +19,7 @@ public:
     ~LiteAudioEngine() override;
 
     bool Initialize(AudioCodec* codec, int frame_duration_ms, srmodel_list_t* models_list) override;
-    void Feed(std::vector<int16_t>&& data) override;
+    void Feed(const std::vector<int16_t>& data) override;
 
     void EnableWakeWordDetection(bool enable) override;
     void EnableVoiceProcessing(bool enable) override;
@@ -31,7 +32,7 @@ public:
     size_t GetFeedSize() const override;
 
     void OnWakeWordDetected(std::function<void(const std::string& wake_word)> callback) override;
-    void OnOutput(std::function<void(std::vector<int16_t>&& data)> callback) override;
+    void OnOutput(std::function<void(const std::vector<int16_t>& data)> callback) override;
     void OnVadStateChange(std::function<void(bool speaking)> callback) override;
 
     void EncodeWakeWordData() override;
@@ -44,11 +45,12 @@ private:
     std::atomic<bool> wake_word_enabled_ = false;
     std::atomic<bool> voice_processing_enabled_ = false;
     int frame_samples_ = 0;
-    std::vector<int16_t> output_buffer_;
+    AudioStagingBuffer output_buffer_;
+    std::vector<int16_t> output_frame_;
     std::mutex output_mutex_;
 
     std::function<void(const std::string&)> wake_word_detected_callback_;
-    std::function<void(std::vector<int16_t>&&)> output_callback_;
+    std::function<void(const std::vector<int16_t>&)> output_callback_;
     std::function<void(bool)> vad_state_change_callback_;
     std::string empty_wake_word_;
 
@@ -0,0 +1,94 @@
+#include "opus_decoder_cache.h"
+#include "audio_service.h"
+
+#include <algorithm>
+
+#include <esp_log.h>
+
+#define TAG "OpusDecoderCache"
+
+#define OPUS_DEC_CFG(_sample_rate, _frame_duration_ms)                                                    \
+    (esp_opus_dec_cfg_t)                                                                                  \
+    {                                                                                                     \
+        .sample_rate    = (uint32_t)(_sample_rate),                                                       \
+        .channel        = ESP_AUDIO_MONO,                                                                 \
+        .frame_duration = (esp_opus_dec_frame_duration_t)AS_OPUS_GET_FRAME_DRU_ENUM(_frame_duration_ms),  \
+        .self_delimited = false,                                                                          \
+    }
+
+OpusDecoderCache::~OpusDecoderCache() {
+    for (auto& decoder : decoders_) {
+        Close(*decoder);
+    }
+}
+
+void OpusDecoderCache::Initialize(int output_sample_rate) {
+    output_sample_rate_ = output_sample_rate;
+    decoders_.reserve(kMaxDecoders);
+}
+
+OpusDecoderCache::Decoder* OpusDecoderCache::Get(int sample_rate, int duration_ms) {
+    // Consecutive packets almost always share the format of the previous one
+    if (last_ != nullptr && last_->sample_rate == sample_rate && last_->duration_ms == duration_ms) {
+        return last_;
+    }
+
+    auto it = std::find_if(decoders_.begin(), decoders_.end(), [&](const std::unique_ptr<Decoder>& decoder) {
+        return decoder->sample_rate == sample_rate && decoder->duration_ms == duration_ms;
+    });
+    if (it == decoders_.end()) {
+        auto decoder = Open(sample_rate, duration_ms);
+        if (!decoder) {
+            return nullptr;
+        }
+        if (decoders_.size() >= kMaxDecoders) {
+            auto oldest = std::min_element(decoders_.begin(), decoders_.end(),
+                [](const std::unique_ptr<Decoder>& a, const std::unique_ptr<Decoder>& b) {
+                    return a->last_used < b->last_used;
+                });
+            ESP_LOGI(TAG, "Closing decoder %d Hz / %d ms", (*oldest)->sample_rate, (*oldest)->duration_ms);
+            Close(**oldest);
+            decoders_.erase(oldest);
+        }
+        decoders_.push_back(std::move(decoder));
+        it = decoders_.end() - 1;
+    }
+
+    last_ = it->get();
+    last_->last_used = ++use_count_;
+    return last_;
+}
+
+void OpusDecoderCache::Reset() {
+    for (auto& decoder : decoders_) {
+        esp_opus_dec_reset(decoder->handle);
+        decoder->resampler.Reset();
+    }
+}
+
+std::unique_ptr<OpusDecoderCache::Decoder> OpusDecoderCache::Open(int sample_rate, int duration_ms) {
+    auto decoder = std::make_unique<Decoder>();
+    esp_opus_dec_cfg_t opus_dec_cfg = OPUS_DEC_CFG(sample_rate, duration_ms);
+    auto ret = esp_opus_dec_open(&opus_dec_cfg, sizeof(esp_opus_dec_cfg_t), &decoder->handle);
+    if (decoder->handle == nullptr) {
+        ESP_LOGE(TAG, "Failed to create audio decoder, error code: %d", ret);
+        return nullptr;
+    }
+    if (sample_rate != output_sample_rate_ && !decoder->resampler.Open(sample_rate, output_sample_rate_, 1)) {
+        // Played at the wrong speed rather than not at all, as before
+        ESP_LOGE(TAG, "Failed to create output resampler %d -> %d", sample_rate, output_sample_rate_);
+    }
+    decoder->sample_rate = sample_rate;
+    decoder->duration_ms = duration_ms;
+    decoder->frame_size = sample_rate / 1000 * duration_ms;
+    ESP_LOGI(TAG, "Opened decoder %d Hz / %d ms", sample_rate, duration_ms);
+    return decoder;
+}
+
+void OpusDecoderCache::Close(Decoder& decoder) {
+    if (decoder.handle != nullptr) {
+        esp_opus_dec_close(decoder.handle);
+        decoder.handle = nullptr;
+    }
+    decoder.resampler.Close();
+}
@@ -0,0 +1,52 @@
+#ifndef OPUS_DECODER_CACHE_H
+#define OPUS_DECODER_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "audio_resampler.h"
+
+/*
+ * Opus decoders kept open per stream format (sample rate, frame duration), each
+ * with its own resampler to the codec output rate.
+ *
+ * Sounds played locally (16 kHz OGG) and server TTS (often 24 kHz) alternate all
+ * the time; switching between them picks an open decoder instead of closing and
+ * reopening the decoder and resampler. Separate decoders also keep the state of
+ * one stream out of the other. The least recently used decoder is closed when
+ * more than kMaxDecoders formats are in use. Not thread safe.
+ */
+class OpusDecoderCache {
+public:
+    struct Decoder {
+        int sample_rate = 0;
+        int duration_ms = 0;
+        int frame_size = 0;             // Samples per frame at sample_rate
+        void* handle = nullptr;
+        AudioResampler resampler;       // Open when sample_rate is not the output rate
+        uint32_t last_used = 0;
+    };
+
+    ~OpusDecoderCache();
+
+    void Initialize(int output_sample_rate);
+    // Opens the decoder on first use, nullptr when that fails
+    Decoder* Get(int sample_rate, int duration_ms);
+    // Drops the state of every decoder and resampler
+    void Reset();
+
+private:
+    static constexpr size_t kMaxDecoders = 3;
+
+    int output_sample_rate_ = 0;
+    uint32_t use_count_ = 0;
+    Decoder* last_ = nullptr;
+    std::vector<std::unique_ptr<Decoder>> decoders_;
+
+    std::unique_ptr<Decoder> Open(int sample_rate, int duration_ms);
+    static void Close(Decoder& decoder);
+};
+
+#endif // OPUS_DECODER_CACHE_H
@@ -0,0 +1,88 @@
+#include "opus_rate_controller.h"
+
+#include <esp_log.h>
+#include <esp_opus_enc.h>
+
+#include <algorithm>
+
+#define TAG "OpusRateController"
+
+struct RateLevel {
+    int bitrate;
+    bool fec;
+    bool long_frames;
+};
+
+static const RateLevel kRateLevels[] = {
+    { ESP_OPUS_BITRATE_AUTO, false, false },
+    { 24000, true, false },
+    { 16000, true, false },
+    { 12000, true, false },
+    { 8000, true, true },
+};
+static constexpr int kMaxLevel = sizeof(kRateLevels) / sizeof(kRateLevels[0]) - 1;
+
+// Frames per evaluation window
+static constexpr int kWindowFrames = 5;
+// Queued packets that mean the network is not keeping up
+static constexpr size_t kQueueHighWater = 3;
+// Clean windows in a row before stepping back up
+static constexpr int kRecoveryWindows = 6;
+// Longest frame the Opus encoder accepts
+static constexpr int kMaxFrameDurationMs = 120;
+
+void OpusRateController::Reset(int base_frame_duration_ms, int max_frame_duration_ms) {
+    base_frame_duration_ms_ = base_frame_duration_ms;
+    // Longer frames are only used when the server allows them, in whole multiples of the base frame
+    if (max_frame_duration_ms >= base_frame_duration_ms && max_frame_duration_ms <= kMaxFrameDurationMs &&
+        max_frame_duration_ms % base_frame_duration_ms == 0) {
+        max_frame_duration_ms_ = max_frame_duration_ms;
+    } else {
+        max_frame_duration_ms_ = base_frame_duration_ms;
+    }
+    window_frames_ = 0;
+    window_max_depth_ = 0;
+    window_events_ = 0;
+    clean_windows_ = 0;
+    SetLevel(0);
+}
+
+bool OpusRateController::Update(size_t send_queue_depth, uint32_t pressure_events) {
+    window_max_depth_ = std::max(window_max_depth_, send_queue_depth);
+    window_events_ += pressure_events;
+    if (++window_frames_ < kWindowFrames) {
+        return false;
+    }
+
+    const bool congested = window_max_depth_ >= kQueueHighWater || window_events_ > 0;
+    const int previous_level = level_;
+    if (congested) {
+        clean_windows_ = 0;
+        if (level_ < kMaxLevel) {
+            SetLevel(level_ + 1);
+        }
+    } else if (++clean_windows_ >= kRecoveryWindows) {
+        clean_windows_ = 0;
+        if (level_ > 0) {
+            SetLevel(level_ - 1);
+        }
+    }
+    window_frames_ = 0;
+    window_max_depth_ = 0;
+    window_events_ = 0;
+
+    if (level_ == previous_level) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Uplink level %d -> %d: bitrate %d, fec %d, frame %d ms", previous_level, level_,
+             settings_.bitrate, settings_.fec, settings_.frame_duration_ms);
+    return true;
+}
+
+void OpusRateController::SetLevel(int level) {
+    const auto& rate = kRateLevels[level];
+    level_ = level;
+    settings_.bitrate = rate.bitrate;
+    settings_.fec = rate.fec;
+    settings_.frame_duration_ms = rate.long_frames ? max_frame_duration_ms_ : base_frame_duration_ms_;
+}
@@ -0,0 +1,45 @@
+#ifndef OPUS_RATE_CONTROLLER_H
+#define OPUS_RATE_CONTROLLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct OpusRateSettings {
+    int bitrate;                // bps, or ESP_OPUS_BITRATE_AUTO
+    bool fec;                   // In-band forward error correction
+    int frame_duration_ms;
+};
+
+/*
+ * Picks uplink Opus encoder settings from the pressure seen on the send path.
+ *
+ * The encoder task reports the send queue depth after every frame together
+ * with the number of dropped packets and failed sends since the last frame.
+ * Sustained pressure steps the encoder down a ladder of lower bitrates with
+ * FEC enabled and, at the bottom, longer frames (only when the server allows
+ * them); a few clean windows in a row step it back up. Level 0 is the
+ * default configuration from AS_OPUS_ENC_CONFIG().
+ */
+class OpusRateController {
+public:
+    void Reset(int base_frame_duration_ms, int max_frame_duration_ms);
+    // Returns true when the settings changed and the encoder has to be updated
+    bool Update(size_t send_queue_depth, uint32_t pressure_events);
+
+    const OpusRateSettings& settings() const { return settings_; }
+    int level() const { return level_; }
+
+private:
+    int level_ = 0;
+    int base_frame_duration_ms_ = 60;
+    int max_frame_duration_ms_ = 60;
+    int window_frames_ = 0;
+    size_t window_max_depth_ = 0;
+    uint32_t window_events_ = 0;
+    int clean_windows_ = 0;
+    OpusRateSettings settings_ = {};
+
+    void SetLevel(int level);
+};
+
+#endif // OPUS_RATE_CONTROLLER_H
@@ -0,0 +1,80 @@
+#include "pcm_cache.h"
+
+#include <algorithm>
+
+#include <esp_log.h>
+
+#define TAG "PcmCache"
+
+void PcmCache::SetBudget(size_t budget_bytes) {
+    budget_bytes_ = budget_bytes;
+    EvictUntil(budget_bytes_);
+}
+
+PcmClip PcmCache::Find(const std::string_view& key) {
+    auto it = Lookup(key);
+    if (it == entries_.end()) {
+        misses_++;
+        return nullptr;
+    }
+    hits_++;
+    it->last_used = ++use_count_;
+    return it->pcm;
+}
+
+void PcmCache::Insert(const std::string_view& key, PcmClip pcm) {
+    if (!pcm) {
+        return;
+    }
+    const size_t bytes = BytesOf(pcm);
+    if (bytes > budget_bytes_) {
+        return;
+    }
+    auto it = Lookup(key);
+    if (it != entries_.end()) {
+        bytes_ -= BytesOf(it->pcm);
+        entries_.erase(it);
+    }
+    EvictUntil(budget_bytes_ - bytes);
+    entries_.push_back({key.data(), key.size(), std::move(pcm), ++use_count_});
+    bytes_ += bytes;
+}
+
+bool PcmCache::Contains(const std::string_view& key) const {
+    return std::any_of(entries_.begin(), entries_.end(), [&](const Entry& entry) {
+        return entry.data == key.data() && entry.size == key.size();
+    });
+}
+
+void PcmCache::Clear() {
+    entries_.clear();
+    bytes_ = 0;
+}
+
+PcmCache::Stats PcmCache::GetStats() const {
+    Stats stats;
+    stats.hits = hits_;
+    stats.misses = misses_;
+    stats.evictions = evictions_;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+std::vector<PcmCache::Entry>::iterator PcmCache::Lookup(const std::string_view& key) {
+    return std::find_if(entries_.begin(), entries_.end(), [&](const Entry& entry) {
+        return entry.data == key.data() && entry.size == key.size();
+    });
+}
+
+void PcmCache::EvictUntil(size_t budget_bytes) {
+    while (bytes_ > budget_bytes && !entries_.empty()) {
+        auto oldest = std::min_element(entries_.begin(), entries_.end(), [](const Entry& a, const Entry& b) {
+            return a.last_used < b.last_used;
+        });
+        ESP_LOGD(TAG, "Evicting %u bytes", (unsigned)BytesOf(oldest->pcm));
+        bytes_ -= BytesOf(oldest->pcm);
+        entries_.erase(oldest);
+        evictions_++;
+    }
+}
@@ -0,0 +1,68 @@
+#ifndef PCM_CACHE_H
+#define PCM_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "psram_allocator.h"
+
+// Decoded clips go to PSRAM when the board has it, internal RAM otherwise
+using PcmSamples = PsramVector<int16_t>;
+using PcmClip = std::shared_ptr<const PcmSamples>;
+
+/*
+ * Least recently used cache of decoded sound clips, bounded by a byte budget.
+ *
+ * Clips are keyed by the location of their encoded data: Lang::Sounds live in the
+ * app image, so the same prompt always has the same address and size. Entries are
+ * shared, so evicting a clip that is still playing only drops the cache's reference.
+ * Not thread safe.
+ */
+class PcmCache {
+public:
+    struct Stats {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        uint32_t evictions = 0;
+        size_t entries = 0;
+        size_t bytes = 0;
+    };
+
+    explicit PcmCache(size_t budget_bytes = 0) : budget_bytes_(budget_bytes) {}
+
+    void SetBudget(size_t budget_bytes);
+    size_t budget() const { return budget_bytes_; }
+
+    // Counts a hit or a miss; nullptr on a miss
+    PcmClip Find(const std::string_view& key);
+    // Evicts the least recently used clips to make room; clips larger than the budget are not kept
+    void Insert(const std::string_view& key, PcmClip pcm);
+    bool Contains(const std::string_view& key) const;
+    void Clear();
+    Stats GetStats() const;
+
+private:
+    struct Entry {
+        const char* data;
+        size_t size;
+        PcmClip pcm;
+        uint32_t last_used;
+    };
+
+    size_t budget_bytes_;
+    size_t bytes_ = 0;
+    uint32_t use_count_ = 0;
+    uint32_t hits_ = 0;
+    uint32_t misses_ = 0;
+    uint32_t evictions_ = 0;
+    std::vector<Entry> entries_;
+
+    std::vector<Entry>::iterator Lookup(const std::string_view& key);
+    void EvictUntil(size_t budget_bytes);
+    static size_t BytesOf(const PcmClip& pcm) { return pcm->size() * sizeof(int16_t); }
+};
+
+#endif // PCM_CACHE_H
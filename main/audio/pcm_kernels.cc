@@ -0,0 +1,253 @@
+#include "pcm_kernels.h"
+#include "sdkconfig.h"
+
+#include <algorithm>
+#include <climits>
+
+#if defined(PCM_KERNELS_PIE_MODEL)
+// Host benchmark: the PIE instructions run on a C++ model of the q registers
+#include "pie_model.h"
+#define PCM_KERNELS_PIE 1
+#elif CONFIG_IDF_TARGET_ESP32S3
+/*
+ * One PIE instruction per statement on fixed q registers. The compiler never
+ * allocates q0-q7, so they keep their values from one statement to the next, and
+ * it only sets SAR inside its own shift instructions, so nothing may sit between
+ * PIE_WSR_SAR() and the vector instructions that read it except plain arithmetic.
+ */
+#define PCM_KERNELS_PIE 1
+#define PIE_WSR_SAR(value) asm volatile("wsr.sar %0" : : "r"(value))
+#define PIE_VLDBC_16(q, p) asm volatile("ee.vldbc.16 " #q ", %0" : : "r"(p) : "memory")
+#define PIE_VLDBC_32(q, p) asm volatile("ee.vldbc.32 " #q ", %0" : : "r"(p) : "memory")
+#define PIE_LD_USAR(q, p) asm volatile("ee.ld.128.usar.ip " #q ", %0, 16" : "+r"(p) : : "memory")
+#define PIE_SRC_Q_QUP(qa, qs0, qs1) asm volatile("ee.src.q.qup " #qa ", " #qs0 ", " #qs1)
+#define PIE_VLD_128(q, p) asm volatile("ee.vld.128.ip " #q ", %0, 16" : "+r"(p) : : "memory")
+#define PIE_VST_128(q, p) asm volatile("ee.vst.128.ip " #q ", %0, 16" : "+r"(p) : : "memory")
+#define PIE_VSR_32(qa, qs) asm volatile("ee.vsr.32 " #qa ", " #qs)
+#define PIE_VMAX_S32(qa, qx, qy) asm volatile("ee.vmax.s32 " #qa ", " #qx ", " #qy)
+#define PIE_VMIN_S32(qa, qx, qy) asm volatile("ee.vmin.s32 " #qa ", " #qx ", " #qy)
+#define PIE_VMAX_S16(qa, qx, qy) asm volatile("ee.vmax.s16 " #qa ", " #qx ", " #qy)
+#define PIE_VADDS_S16(qa, qx, qy) asm volatile("ee.vadds.s16 " #qa ", " #qx ", " #qy)
+#define PIE_VMUL_S16(qz, qx, qy) asm volatile("ee.vmul.s16 " #qz ", " #qx ", " #qy)
+#define PIE_VUNZIP_16(qs0, qs1) asm volatile("ee.vunzip.16 " #qs0 ", " #qs1)
+#else
+#define PCM_KERNELS_PIE 0
+#endif
+
+namespace pcm {
+
+namespace {
+
+// Symmetric, as the codecs have always clamped, so inverting a sample never overflows
+inline int16_t Clamp16(int32_t value) {
+    return static_cast<int16_t>(std::min<int32_t>(std::max<int32_t>(value, -INT16_MAX), INT16_MAX));
+}
+
+inline int32_t Clamp32(int64_t value) {
+    return static_cast<int32_t>(std::min<int64_t>(std::max<int64_t>(value, INT32_MIN), INT32_MAX));
+}
+
+#if PCM_KERNELS_PIE
+// 16-bit samples before dest is 16-byte aligned for the vector stores, SIZE_MAX if it never is
+inline size_t HeadSamples(const int16_t* dest) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(dest);
+    if (address & 1) {
+        return SIZE_MAX;
+    }
+    return ((16 - (address & 15)) & 15) / sizeof(int16_t);
+}
+
+// 16-byte vectors PIE_LD_USAR() and PIE_SRC_Q_QUP() can take from src without
+// loading past the aligned block that holds the last of the bytes. The stream is
+// primed with one load and stays one aligned block ahead.
+inline size_t StreamVectors(const void* src, size_t bytes) {
+    size_t span = (reinterpret_cast<uintptr_t>(src) & 15) + bytes;
+    return span >= 32 ? span / 16 - 1 : 0;
+}
+#endif
+
+} // namespace
+
+int32_t VolumeToGain(int volume) {
+    volume = std::min(std::max(volume, 0), 100);
+    return volume * volume * 65536 / 10000;
+}
+
+void Convert16To32(const int16_t* src, int32_t* dest, size_t samples, int32_t gain) {
+    // No PIE path: it has no widening 16x32-bit multiply outside the accumulators
+    if (gain < 0 || gain > 65536) {
+        // Only a gain above unity can overflow 32 bits
+        for (size_t i = 0; i < samples; ++i) {
+            dest[i] = Clamp32(static_cast<int64_t>(src[i]) * gain);
+        }
+        return;
+    }
+    // |src * gain| <= 32768 * 65536, which still fits in an int32_t
+    for (size_t i = 0; i < samples; ++i) {
+        dest[i] = src[i] * gain;
+    }
+}
+
+namespace scalar {
+
+void Convert32To16(const int32_t* src, int16_t* dest, size_t samples, int shift) {
+    for (size_t i = 0; i < samples; ++i) {
+        dest[i] = Clamp16(src[i] >> shift);
+    }
+}
+
+void ExtractChannel(const int16_t* src, int16_t* dest, size_t frames, size_t channels, size_t channel) {
+    for (size_t i = 0; i < frames; ++i) {
+        dest[i] = src[i * channels + channel];
+    }
+}
+
+void Mix(int16_t* dest, const int16_t* src, size_t samples, int32_t gain_q15) {
+    if (gain_q15 == 32768) {
+        for (size_t i = 0; i < samples; ++i) {
+            dest[i] = Clamp16(dest[i] + src[i]);
+        }
+        return;
+    }
+    gain_q15 = std::min<int32_t>(std::max<int32_t>(gain_q15, 0), 32768);
+    for (size_t i = 0; i < samples; ++i) {
+        dest[i] = Clamp16(dest[i] + ((src[i] * gain_q15) >> 15));
+    }
+}
+
+} // namespace scalar
+
+#if PCM_KERNELS_PIE
+
+void Convert32To16(const int32_t* src, int16_t* dest, size_t samples, int shift) {
+    size_t head = std::min(HeadSamples(dest), samples);
+    scalar::Convert32To16(src, dest, head, shift);
+    src += head;
+    dest += head;
+    samples -= head;
+
+    // Eight samples per store: shift two vectors of 32-bit slots, clamp them, keep the low halves
+    size_t blocks = std::min(samples / 8, StreamVectors(src, samples * sizeof(int32_t)) / 2);
+    if (blocks > 0) {
+        static const int32_t bounds[2] = {-INT16_MAX, INT16_MAX};
+        const int32_t* in = src;
+        int16_t* out = dest;
+        PIE_VLDBC_32(q6, &bounds[0]);
+        PIE_VLDBC_32(q7, &bounds[1]);
+        PIE_LD_USAR(q0, in);
+        PIE_WSR_SAR(shift);
+        for (size_t i = 0; i < blocks; ++i) {
+            PIE_LD_USAR(q1, in);
+            PIE_SRC_Q_QUP(q2, q0, q1);
+            PIE_LD_USAR(q1, in);
+            PIE_SRC_Q_QUP(q3, q0, q1);
+            PIE_VSR_32(q2, q2);
+            PIE_VSR_32(q3, q3);
+            PIE_VMAX_S32(q2, q2, q6);
+            PIE_VMAX_S32(q3, q3, q6);
+            PIE_VMIN_S32(q2, q2, q7);
+            PIE_VMIN_S32(q3, q3, q7);
+            PIE_VUNZIP_16(q2, q3);
+            PIE_VST_128(q2, out);
+        }
+        src += blocks * 8;
+        dest += blocks * 8;
+        samples -= blocks * 8;
+    }
+    scalar::Convert32To16(src, dest, samples, shift);
+}
+
+void ExtractChannel(const int16_t* src, int16_t* dest, size_t frames, size_t channels, size_t channel) {
+    if (channels != 2 || channel > 1) {
+        scalar::ExtractChannel(src, dest, frames, channels, channel);
+        return;
+    }
+    size_t head = std::min(HeadSamples(dest), frames);
+    scalar::ExtractChannel(src, dest, head, channels, channel);
+    src += head * 2;
+    dest += head;
+    frames -= head;
+
+    // Eight stereo frames per store, split into both channels. In place, every store
+    // lands on samples that were loaded already.
+    size_t blocks = std::min(frames / 8, StreamVectors(src, frames * 2 * sizeof(int16_t)) / 2);
+    if (blocks > 0) {
+        const int16_t* in = src;
+        int16_t* out = dest;
+        PIE_LD_USAR(q0, in);
+        for (size_t i = 0; i < blocks; ++i) {
+            PIE_LD_USAR(q1, in);
+            PIE_SRC_Q_QUP(q2, q0, q1);
+            PIE_LD_USAR(q1, in);
+            PIE_SRC_Q_QUP(q3, q0, q1);
+            PIE_VUNZIP_16(q2, q3);
+            if (channel == 0) {
+                PIE_VST_128(q2, out);
+            } else {
+                PIE_VST_128(q3, out);
+            }
+        }
+        src += blocks * 16;
+        dest += blocks * 8;
+        frames -= blocks * 8;
+    }
+    scalar::ExtractChannel(src, dest, frames, channels, channel);
+}
+
+void Mix(int16_t* dest, const int16_t* src, size_t samples, int32_t gain_q15) {
+    gain_q15 = std::min<int32_t>(std::max<int32_t>(gain_q15, 0), 32768);
+    size_t head = std::min(HeadSamples(dest), samples);
+    scalar::Mix(dest, src, head, gain_q15);
+    src += head;
+    dest += head;
+    samples -= head;
+
+    // Eight samples per store: scale, add with saturation, then raise -32768 to the
+    // symmetric -32767 of the scalar loop
+    size_t blocks = std::min(samples / 8, StreamVectors(src, samples * sizeof(int16_t)));
+    if (blocks > 0) {
+        static const int16_t lowest = -INT16_MAX;
+        const int16_t gain = static_cast<int16_t>(gain_q15 == 32768 ? 0 : gain_q15);
+        const int16_t* in = src;
+        const int16_t* acc = dest;
+        int16_t* out = dest;
+        PIE_VLDBC_16(q7, &lowest);
+        PIE_VLDBC_16(q6, &gain);
+        PIE_LD_USAR(q0, in);
+        PIE_WSR_SAR(15);
+        for (size_t i = 0; i < blocks; ++i) {
+            PIE_LD_USAR(q1, in);
+            PIE_SRC_Q_QUP(q2, q0, q1);
+            if (gain_q15 != 32768) {
+                // |src * gain| >> 15 fits in 16 bits below unity
+                PIE_VMUL_S16(q2, q2, q6);
+            }
+            PIE_VLD_128(q3, acc);
+            PIE_VADDS_S16(q3, q3, q2);
+            PIE_VMAX_S16(q3, q3, q7);
+            PIE_VST_128(q3, out);
+        }
+        src += blocks * 8;
+        dest += blocks * 8;
+        samples -= blocks * 8;
+    }
+    scalar::Mix(dest, src, samples, gain_q15);
+}
+
+#else
+
+void Convert32To16(const int32_t* src, int16_t* dest, size_t samples, int shift) {
+    scalar::Convert32To16(src, dest, samples, shift);
+}
+
+void ExtractChannel(const int16_t* src, int16_t* dest, size_t frames, size_t channels, size_t channel) {
+    scalar::ExtractChannel(src, dest, frames, channels, channel);
+}
+
+void Mix(int16_t* dest, const int16_t* src, size_t samples, int32_t gain_q15) {
+    scalar::Mix(dest, src, samples, gain_q15);
+}
+
+#endif // PCM_KERNELS_PIE
+
+} // namespace pcm
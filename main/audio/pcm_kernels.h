@@ -0,0 +1,47 @@
+#ifndef PCM_KERNELS_H
+#define PCM_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Block kernels for the PCM conversions done by NoAudioCodec, the audio input path
+ * and the sound effect mixer.
+ *
+ * Every kernel works on a whole buffer, never allocates and saturates instead of
+ * wrapping. On the ESP32-S3 the 32-bit to 16-bit conversion, the channel extraction
+ * and the mix run on the PIE vector unit, eight samples at a time, with the scalar
+ * loops below for the unaligned head and the tail. Other targets use the scalar
+ * loops. The ES83xx and Box codecs hand 16-bit PCM straight to esp_codec_dev and
+ * scale the volume in the codec, so they have no conversion to route through here.
+ */
+namespace pcm {
+
+// Q16 gain of a 0-100 volume with a square law, 65536 at full volume
+int32_t VolumeToGain(int volume);
+
+// dest[i] = clamp(src[i] >> shift), e.g. 32-bit I2S microphone slots to 16-bit PCM
+void Convert32To16(const int32_t* src, int16_t* dest, size_t samples, int shift);
+
+// dest[i] = clamp(src[i] * gain), 16-bit PCM to 32-bit I2S slots with a Q16 gain
+void Convert16To32(const int16_t* src, int32_t* dest, size_t samples, int32_t gain);
+
+// dest[i] = src[i * channels + channel], e.g. the microphone or the reference of
+// interleaved input. dest may equal src.
+void ExtractChannel(const int16_t* src, int16_t* dest, size_t frames, size_t channels, size_t channel);
+
+// dest[i] = clamp(dest[i] + src[i] * gain / 32768), mixes a Q15-scaled source into dest
+void Mix(int16_t* dest, const int16_t* src, size_t samples, int32_t gain_q15 = 32768);
+
+// The portable loops, also what the vector kernels must match sample for sample
+namespace scalar {
+
+void Convert32To16(const int32_t* src, int16_t* dest, size_t samples, int shift);
+void ExtractChannel(const int16_t* src, int16_t* dest, size_t frames, size_t channels, size_t channel);
+void Mix(int16_t* dest, const int16_t* src, size_t samples, int32_t gain_q15 = 32768);
+
+} // namespace scalar
+
+} // namespace pcm
+
+#endif // PCM_KERNELS_H
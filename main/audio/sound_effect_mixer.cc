@@ -0,0 +1,213 @@
+#include "sound_effect_mixer.h"
+#include "audio_service.h"
+#include "opus_decoder_cache.h"
+#include "pcm_kernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "SoundEffectMixer"
+
+void SoundEffectMixer::Initialize(int output_sample_rate) {
+    output_sample_rate_ = output_sample_rate;
+    has_psram_ = heap_caps_get_total_size(MALLOC_CAP_SPIRAM) > 0;
+#ifdef CONFIG_SOUND_EFFECT_CACHE_SIZE_KB
+    if (has_psram_) {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        cache_.SetBudget(CONFIG_SOUND_EFFECT_CACHE_SIZE_KB * 1024);
+    }
+#endif
+}
+
+bool SoundEffectMixer::Play(const std::string_view& ogg) {
+    PcmClip pcm;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        pcm = cache_.Find(ogg);
+    }
+    Job job;
+    if (!pcm && !Demux(ogg, job)) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() >= kMaxQueuedClips) {
+        ESP_LOGW(TAG, "Too many sound effects queued, dropping the oldest");
+        queue_.pop_front();
+    }
+    if (pcm) {
+        queue_.push_back({std::move(pcm), 0, 0});
+        return true;
+    }
+    job.id = next_job_++;
+    queue_.push_back({nullptr, job.id, 0});
+    jobs_.push_back(std::move(job));
+    return true;
+}
+
+void SoundEffectMixer::Preload(const std::string_view& ogg) {
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        if (cache_.budget() == 0 || cache_.Contains(ogg)) {
+            return;
+        }
+    }
+    // No clip waits for it, DecodeNext() demuxes it too
+    Job job;
+    job.ogg = ogg;
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(std::move(job));
+}
+
+PcmCache::Stats SoundEffectMixer::GetCacheStats() const {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    return cache_.GetStats();
+}
+
+bool SoundEffectMixer::IsPlaying() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !queue_.empty();
+}
+
+bool SoundEffectMixer::DecodeNext() {
+    Job job;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (jobs_.empty()) {
+            return false;
+        }
+        job = std::move(jobs_.front());
+        jobs_.pop_front();
+    }
+    if (job.packets.empty() && !Demux(job.ogg, job)) {
+        return true;
+    }
+
+    // A clip queued twice before its first decode finished is decoded once
+    PcmClip pcm;
+    {
+        std::lock_guard<std::mutex> lock(cache_mutex_);
+        pcm = cache_.Contains(job.ogg) ? cache_.Find(job.ogg) : nullptr;
+    }
+    if (!pcm) {
+        // Without the cache lock, so Play() and Preload() do not wait for the decode
+        pcm = Decode(job);
+        if (pcm) {
+            std::lock_guard<std::mutex> lock(cache_mutex_);
+            if (cache_.Contains(job.ogg)) {
+                pcm = cache_.Find(job.ogg);
+            } else {
+                // Clips still playing keep their PCM through the queue when evicted
+                cache_.Insert(job.ogg, pcm);
+                auto stats = cache_.GetStats();
+                ESP_LOGI(TAG, "Cache: %u hits, %u misses, %u clips, %u/%u KB", (unsigned)stats.hits,
+                    (unsigned)stats.misses, (unsigned)stats.entries, (unsigned)(stats.bytes / 1024),
+                    (unsigned)(cache_.budget() / 1024));
+            }
+        }
+    }
+
+    if (job.id == 0) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+        if (it->job == job.id) {
+            if (pcm) {
+                it->pcm = pcm;
+            } else {
+                queue_.erase(it);
+            }
+            break;
+        }
+    }
+    return true;
+}
+
+void SoundEffectMixer::Mix(int16_t* pcm, size_t samples) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    while (samples > 0 && !queue_.empty()) {
+        auto& clip = queue_.front();
+        if (!clip.pcm) {
+            // Still being decoded, the clips after it wait for it
+            break;
+        }
+        const size_t count = std::min(samples, clip.pcm->size() - clip.position);
+        pcm::Mix(pcm, clip.pcm->data() + clip.position, count);
+        clip.position += count;
+        pcm += count;
+        samples -= count;
+        if (clip.position >= clip.pcm->size()) {
+            queue_.pop_front();
+        }
+    }
+}
+
+bool SoundEffectMixer::Demux(const std::string_view& ogg, Job& job) {
+    job.ogg = ogg;
+    auto demuxer = std::make_unique<OggDemuxer>();
+    demuxer->OnDemuxerFinished([&job](const uint8_t* data, int rate, size_t size) {
+        job.packets.emplace_back(data, data + size);
+        job.sample_rate = rate;
+    });
+    demuxer->Process(reinterpret_cast<const uint8_t*>(ogg.data()), ogg.size());
+    demuxer.reset();
+    if (job.packets.empty()) {
+        ESP_LOGW(TAG, "No audio in sound effect");
+        return false;
+    }
+
+    // Bundled prompts use 60 ms frames, as in AudioService::PlaySound
+    const size_t frame_samples = output_sample_rate_ / 1000 * OPUS_FRAME_DURATION_MS;
+    const size_t estimated_bytes = job.packets.size() * frame_samples * sizeof(int16_t);
+    return has_psram_ || estimated_bytes <= kMaxInternalClipBytes;
+}
+
+PcmClip SoundEffectMixer::Decode(Job& job) {
+    int64_t start_time = esp_timer_get_time();
+    const size_t frame_samples = output_sample_rate_ / 1000 * OPUS_FRAME_DURATION_MS;
+    OpusDecoderCache decoders;
+    decoders.Initialize(output_sample_rate_);
+    auto decoder = decoders.Get(job.sample_rate, OPUS_FRAME_DURATION_MS);
+    if (decoder == nullptr) {
+        return nullptr;
+    }
+    auto pcm = std::make_shared<PcmSamples>();
+    pcm->reserve(job.packets.size() * frame_samples + frame_samples);
+    std::vector<int16_t> frame(decoder->frame_size);
+    for (auto& packet : job.packets) {
+        esp_audio_dec_in_raw_t raw = {
+            .buffer = packet.data(),
+            .len = (uint32_t)packet.size(),
+            .consumed = 0,
+            .frame_recover = ESP_AUDIO_DEC_RECOVERY_NONE,
+        };
+        esp_audio_dec_out_frame_t out_frame = {
+            .buffer = (uint8_t *)frame.data(),
+            .len = (uint32_t)(frame.size() * sizeof(int16_t)),
+            .decoded_size = 0,
+        };
+        esp_audio_dec_info_t dec_info = {};
+        auto ret = esp_opus_dec_decode(decoder->handle, &raw, &out_frame, &dec_info);
+        if (ret != ESP_AUDIO_ERR_OK) {
+            ESP_LOGE(TAG, "Failed to decode sound effect, error code: %d", ret);
+            return nullptr;
+        }
+        const size_t samples = out_frame.decoded_size / sizeof(int16_t);
+        size_t offset = pcm->size();
+        if (decoder->resampler.IsOpen()) {
+            pcm->resize(offset + decoder->resampler.MaxOutputFrames(samples));
+            pcm->resize(offset + decoder->resampler.Process(frame.data(), samples, pcm->data() + offset));
+        } else {
+            pcm->insert(pcm->end(), frame.begin(), frame.begin() + samples);
+        }
+    }
+    pcm->shrink_to_fit();
+    ESP_LOGI(TAG, "Decoded sound effect: %u ms in %ld ms",
+        (unsigned)(pcm->size() * 1000 / output_sample_rate_), (long)((esp_timer_get_time() - start_time) / 1000));
+    return pcm;
+}
@@ -0,0 +1,73 @@
+#ifndef SOUND_EFFECT_MIXER_H
+#define SOUND_EFFECT_MIXER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "pcm_cache.h"
+
+/*
+ * Local sound effect channel, mixed into the playback stream by AudioOutputTask.
+ *
+ * Bundled OGG prompts are decoded to PCM at the codec output rate once and kept in
+ * an LRU cache (PSRAM targets only), so a repeated prompt starts in the next output
+ * period without demuxing or decoding. They never enter the decode queue, so
+ * ResetDecoder() does not flush them and they do not wait behind server TTS.
+ * Clips queued while another one plays follow it, e.g. the activation code digits.
+ *
+ * Play() only demuxes on the calling task; a clip missing from the cache is queued
+ * as a decode job, which the opus codec task runs with DecodeNext() on its own stack.
+ */
+class SoundEffectMixer {
+public:
+    void Initialize(int output_sample_rate);
+    // Any task, does not decode. Returns false when the clip cannot be kept decoded
+    // (too large without PSRAM)
+    bool Play(const std::string_view& ogg);
+    // Any task. Queues a decode job that puts the clip into the cache ahead of its first Play()
+    void Preload(const std::string_view& ogg);
+    PcmCache::Stats GetCacheStats() const;
+    bool IsPlaying() const;
+    // Codec task. Runs one queued decode job, false when there was none
+    bool DecodeNext();
+    // Output task. Mixes the next samples of the queued clips into pcm
+    void Mix(int16_t* pcm, size_t samples);
+
+private:
+    struct Clip {
+        PcmClip pcm;                // nullptr until its decode job has run
+        uint32_t job = 0;
+        size_t position = 0;
+    };
+
+    struct Job {
+        uint32_t id = 0;            // The clip waiting for it, 0 for a preload
+        std::string_view ogg;
+        std::vector<std::vector<uint8_t>> packets;
+        int sample_rate = 0;
+    };
+
+    // Without PSRAM only short clips (the popup) are decoded, only while they play,
+    // and the rest stream through the decode queue as before
+    static constexpr size_t kMaxInternalClipBytes = 32 * 1024;
+    static constexpr size_t kMaxQueuedClips = 16;
+
+    int output_sample_rate_ = 0;
+    bool has_psram_ = false;
+    mutable std::mutex mutex_;
+    std::deque<Clip> queue_;
+    std::deque<Job> jobs_;
+    uint32_t next_job_ = 1;
+    // Guarded by cache_mutex_, which is never held while decoding
+    PcmCache cache_;
+    mutable std::mutex cache_mutex_;
+
+    bool Demux(const std::string_view& ogg, Job& job);
+    PcmClip Decode(Job& job);
+};
+
+#endif // SOUND_EFFECT_MIXER_H
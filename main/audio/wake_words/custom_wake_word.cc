@@ -1,5 +1,6 @@
 #include "custom_wake_word.h"
 #include "audio_service.h"
+#include "pcm_kernels.h"
 #include "system_info.h"
 #include "assets.h"
 
@@ -127,7 +128,11 @@ bool CustomWakeWord::Initialize(AudioCodec* codec, srmodel_list_t* models_list)
     esp_mn_commands_update();
     
     multinet_->print_active_speech_commands(multinet_model_data_);
-#if CONFIG_SEND_WAKE_WORD_DATA
+#if CONFIG_SEND_WAKE_WORD_DATA_PREENCODED
+    if (!wake_word_opus_cache_.Initialize(2000)) {
+        ESP_LOGW(TAG, "Wake-word audio upload disabled: encoder task allocation failed");
+    }
+#elif CONFIG_SEND_WAKE_WORD_DATA
     if (!wake_word_audio_cache_.Initialize(16000 * 2)) {
         ESP_LOGW(TAG, "Wake-word audio upload disabled: PSRAM cache allocation failed");
     }
@@ -171,16 +176,20 @@ void CustomWakeWord::FeedSamples(const int16_t* data, size_t samples, bool mono)
 
     // If input channels is 2, we need to fetch the left channel data
     if (!mono && codec_->input_channels() > 1) {
-        for (size_t i = 0; i < samples; i += codec_->input_channels()) {
-            input_buffer_.push_back(data[i]);
-        }
+        const size_t channels = codec_->input_channels();
+        const size_t frames = samples / channels;
+        const size_t offset = input_buffer_.size();
+        input_buffer_.resize(offset + frames);
+        pcm::ExtractChannel(data, input_buffer_.data() + offset, frames, channels, 0);
     } else {
         input_buffer_.insert(input_buffer_.end(), data, data + samples);
     }
     
     int chunksize = multinet_->get_samp_chunksize(multinet_model_data_);
     while (input_buffer_.size() >= chunksize) {
-#if CONFIG_SEND_WAKE_WORD_DATA
+#if CONFIG_SEND_WAKE_WORD_DATA_PREENCODED
+        wake_word_opus_cache_.Store(input_buffer_.data(), chunksize);
+#elif CONFIG_SEND_WAKE_WORD_DATA
         wake_word_audio_cache_.Store(input_buffer_.data(), chunksize);
 #endif
 
@@ -223,6 +232,11 @@ size_t CustomWakeWord::GetFeedSize() {
 }
 
 void CustomWakeWord::EncodeWakeWordData() {
+#if CONFIG_SEND_WAKE_WORD_DATA_PREENCODED
+    // The pre-roll was encoded while waiting, only its last frames are left
+    wake_word_opus_cache_.Seal();
+    return;
+#endif
     const size_t stack_size = 4096 * 7;
     wake_word_opus_.clear();
     if (wake_word_encode_task_stack_ == nullptr) {
@@ -300,6 +314,9 @@ void CustomWakeWord::EncodeWakeWordData() {
 }
 
 bool CustomWakeWord::GetWakeWordOpus(std::vector<uint8_t>& opus) {
+#if CONFIG_SEND_WAKE_WORD_DATA_PREENCODED
+    return wake_word_opus_cache_.Pop(opus);
+#endif
     std::unique_lock<std::mutex> lock(wake_word_mutex_);
     wake_word_cv_.wait(lock, [this]() {
         return !wake_word_opus_.empty();
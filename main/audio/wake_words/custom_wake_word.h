@@ -19,6 +19,7 @@
 #include "audio_codec.h"
 #include "wake_word.h"
 #include "wake_word_audio_cache.h"
+#include "wake_word_opus_cache.h"
 
 class CustomWakeWord : public WakeWord {
 public:
@@ -65,6 +66,7 @@ private:
     StaticTask_t* wake_word_encode_task_buffer_ = nullptr;
     StackType_t* wake_word_encode_task_stack_ = nullptr;
     WakeWordAudioCache wake_word_audio_cache_;
+    WakeWordOpusCache wake_word_opus_cache_;
     std::deque<std::vector<uint8_t>> wake_word_opus_;
     std::mutex wake_word_mutex_;
     std::condition_variable wake_word_cv_;
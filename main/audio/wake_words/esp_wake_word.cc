@@ -1,4 +1,5 @@
 #include "esp_wake_word.h"
+#include "pcm_kernels.h"
 #include <esp_log.h>
 
 
@@ -84,9 +85,11 @@ void EspWakeWord::Feed(const std::vector<int16_t>& data) {
     }
 
     if (codec_->input_channels() > 1) {
-        for (size_t i = 0; i < data.size(); i += codec_->input_channels()) {
-            input_buffer_.push_back(data[i]);
-        }
+        const size_t channels = codec_->input_channels();
+        const size_t frames = data.size() / channels;
+        const size_t offset = input_buffer_.size();
+        input_buffer_.resize(offset + frames);
+        pcm::ExtractChannel(data.data(), input_buffer_.data() + offset, frames, channels, 0);
     } else {
         input_buffer_.insert(input_buffer_.end(), data.begin(), data.end());
     }
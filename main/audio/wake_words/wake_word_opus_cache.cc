@@ -0,0 +1,167 @@
+#include "wake_word_opus_cache.h"
+#include "audio_service.h"
+
+#include <algorithm>
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "WakeWordOpusCache"
+
+WakeWordOpusCache::~WakeWordOpusCache() {
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        stopping_ = true;
+        cv_.notify_all();
+        cv_.wait(lock, [this]() { return !running_; });
+    }
+    if (encode_task_stack_ != nullptr) {
+        heap_caps_free(encode_task_stack_);
+    }
+    if (encode_task_buffer_ != nullptr) {
+        heap_caps_free(encode_task_buffer_);
+    }
+}
+
+bool WakeWordOpusCache::Initialize(int duration_ms) {
+    if (encode_task_ != nullptr) {
+        return true;
+    }
+    frame_samples_ = 16000 * OPUS_FRAME_DURATION_MS / 1000;
+    max_packets_ = std::max(duration_ms / OPUS_FRAME_DURATION_MS, 1);
+    pending_.reserve(frame_samples_ * kMaxPendingFrames);
+
+    // The Opus encoder needs a large stack, which is kept in PSRAM like the one of the PCM path
+    const size_t stack_size = 4096 * 6;
+    encode_task_stack_ = static_cast<StackType_t*>(heap_caps_malloc(stack_size, MALLOC_CAP_SPIRAM));
+    encode_task_buffer_ = static_cast<StaticTask_t*>(heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL));
+    if (encode_task_stack_ == nullptr || encode_task_buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate the encoder task");
+        return false;
+    }
+
+    running_ = true;
+    encode_task_ = xTaskCreateStatic([](void* arg) {
+        static_cast<WakeWordOpusCache*>(arg)->EncodeTask();
+        vTaskDelete(nullptr);
+    }, "wake_word_enc", stack_size, this, 2, encode_task_stack_, encode_task_buffer_);
+    ESP_LOGI(TAG, "Keeping %u ms of wake word audio as Opus",
+        static_cast<unsigned>(max_packets_ * OPUS_FRAME_DURATION_MS));
+    return true;
+}
+
+void WakeWordOpusCache::Store(const int16_t* data, size_t samples) {
+    if (data == nullptr || samples == 0) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!running_ || sealing_) {
+        return;
+    }
+    pending_.insert(pending_.end(), data, data + samples);
+    if (pending_.size() > frame_samples_ * kMaxPendingFrames) {
+        // The encoder fell behind, keep the newest audio
+        ESP_LOGW(TAG, "Dropped %u samples of wake word audio",
+            static_cast<unsigned>(pending_.size() - frame_samples_ * kMaxPendingFrames));
+        pending_.erase(pending_.begin(), pending_.end() - frame_samples_ * kMaxPendingFrames);
+    }
+    if (pending_.size() >= frame_samples_) {
+        cv_.notify_all();
+    }
+}
+
+void WakeWordOpusCache::Seal() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    sealed_.clear();
+    if (!running_) {
+        return;
+    }
+    sealing_ = true;
+    seal_time_ = esp_timer_get_time();
+    cv_.notify_all();
+}
+
+bool WakeWordOpusCache::Pop(std::vector<uint8_t>& opus) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this]() { return !sealing_ || !running_; });
+    if (sealed_.empty()) {
+        return false;
+    }
+    opus.swap(sealed_.front());
+    sealed_.pop_front();
+    return !opus.empty();
+}
+
+void WakeWordOpusCache::EncodeTask() {
+    esp_opus_enc_config_t opus_enc_cfg = AS_OPUS_ENC_CONFIG();
+    void* encoder_handle = nullptr;
+    auto ret = esp_opus_enc_open(&opus_enc_cfg, sizeof(esp_opus_enc_config_t), &encoder_handle);
+    int frame_size = 0;
+    int outbuf_size = 0;
+    if (encoder_handle != nullptr) {
+        esp_opus_enc_get_frame_size(encoder_handle, &frame_size, &outbuf_size);
+    }
+    if (encoder_handle == nullptr || frame_size / sizeof(int16_t) != frame_samples_) {
+        ESP_LOGE(TAG, "Failed to create wake-word encoder: %d", ret);
+        if (encoder_handle != nullptr) {
+            esp_opus_enc_close(encoder_handle);
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+        pending_.clear();
+        cv_.notify_all();
+        return;
+    }
+
+    std::vector<int16_t> input(frame_samples_);
+    std::vector<uint8_t> output(outbuf_size);
+    esp_audio_enc_in_frame_t in = {};
+    esp_audio_enc_out_frame_t out = {};
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        if (pending_.size() >= frame_samples_) {
+            std::copy(pending_.begin(), pending_.begin() + frame_samples_, input.begin());
+            pending_.erase(pending_.begin(), pending_.begin() + frame_samples_);
+            lock.unlock();
+            in.buffer = reinterpret_cast<uint8_t*>(input.data());
+            in.len = frame_samples_ * sizeof(int16_t);
+            out.buffer = output.data();
+            out.len = outbuf_size;
+            out.encoded_bytes = 0;
+            ret = esp_opus_enc_process(encoder_handle, &in, &out);
+            lock.lock();
+            if (ret != ESP_AUDIO_ERR_OK) {
+                ESP_LOGE(TAG, "Failed to encode wake-word audio: %d", ret);
+                continue;
+            }
+            // Reuse the buffer of the oldest packet once the pre-roll is full
+            std::vector<uint8_t> packet;
+            if (packets_.size() >= max_packets_) {
+                packet.swap(packets_.front());
+                packets_.pop_front();
+            }
+            packet.assign(output.data(), output.data() + out.encoded_bytes);
+            packets_.push_back(std::move(packet));
+            continue;
+        }
+        if (sealing_) {
+            // Whatever is left is shorter than a frame and dropped, as on the PCM path
+            pending_.clear();
+            sealed_.swap(packets_);
+            packets_.clear();
+            sealed_.emplace_back();
+            sealing_ = false;
+            ESP_LOGI(TAG, "Wake word ready as %u packets in %ld ms", static_cast<unsigned>(sealed_.size() - 1),
+                static_cast<long>((esp_timer_get_time() - seal_time_) / 1000));
+            cv_.notify_all();
+            continue;
+        }
+        cv_.wait(lock);
+    }
+
+    esp_opus_enc_close(encoder_handle);
+    running_ = false;
+    cv_.notify_all();
+}
@@ -0,0 +1,59 @@
+#ifndef WAKE_WORD_OPUS_CACHE_H
+#define WAKE_WORD_OPUS_CACHE_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+/*
+ * Wake word pre-roll kept as Opus packets.
+ *
+ * Audio fed while waiting for the wake word is encoded in the background by a
+ * task with a persistent encoder, and only the newest packets are kept. On
+ * detection, Seal() encodes what is left of the pre-roll and hands the packets
+ * to Pop(), so they are ready by the time the audio channel opens.
+ */
+class WakeWordOpusCache {
+public:
+    WakeWordOpusCache() = default;
+    ~WakeWordOpusCache();
+
+    WakeWordOpusCache(const WakeWordOpusCache&) = delete;
+    WakeWordOpusCache& operator=(const WakeWordOpusCache&) = delete;
+
+    bool Initialize(int duration_ms);
+    void Store(const int16_t* data, size_t samples);
+    // Ends the pre-roll, audio stored after this is not part of it
+    void Seal();
+    // Blocks until the next packet of the sealed pre-roll, false after the last one
+    bool Pop(std::vector<uint8_t>& opus);
+
+private:
+    static constexpr size_t kMaxPendingFrames = 4;
+
+    TaskHandle_t encode_task_ = nullptr;
+    StaticTask_t* encode_task_buffer_ = nullptr;
+    StackType_t* encode_task_stack_ = nullptr;
+    size_t frame_samples_ = 0;
+    size_t max_packets_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::vector<int16_t> pending_;                  // Audio not encoded yet
+    std::deque<std::vector<uint8_t>> packets_;      // Newest max_packets_ packets, oldest first
+    std::deque<std::vector<uint8_t>> sealed_;       // Handed out by Pop(), ends with an empty packet
+    bool sealing_ = false;
+    bool stopping_ = false;
+    bool running_ = false;
+    int64_t seal_time_ = 0;
+
+    void EncodeTask();
+};
+
+#endif
@@ -104,6 +104,10 @@ private:
             }
             app.ToggleChatState();
         });
+        boot_button_.OnPressDown([this]() {
+            // The click only comes on release, start connecting while the button is held
+            Application::GetInstance().PreconnectAudioChannel();
+        });
         boot_button_.OnDoubleClick([this]() {
             auto& app = Application::GetInstance();
             if (app.GetDeviceState() == kDeviceStateStarting || app.GetDeviceState() == kDeviceStateWifiConfiguring) {
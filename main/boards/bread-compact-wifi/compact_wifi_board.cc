@@ -109,6 +109,10 @@ private:
             }
             app.ToggleChatState();
         });
+        boot_button_.OnPressDown([this]() {
+            // The click only comes on release, start connecting while the button is held
+            Application::GetInstance().PreconnectAudioChannel();
+        });
         touch_button_.OnPressDown([this]() {
             Application::GetInstance().StartListening();
         });
@@ -0,0 +1,338 @@
+#include "camera_pipeline.h"
+#include "board.h"
+#include "system_info.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "CameraPipeline"
+
+CameraPipeline::~CameraPipeline() {
+    Cancel();
+    if (encoder_task_ != nullptr) {
+        vTaskDelete(encoder_task_);
+    }
+    heap_caps_free(encoder_task_stack_);
+    heap_caps_free(encoder_task_buffer_);
+    if (free_slots_ != nullptr) {
+        vQueueDelete(free_slots_);
+    }
+    if (full_slots_ != nullptr) {
+        vQueueDelete(full_slots_);
+    }
+    if (idle_ != nullptr) {
+        vSemaphoreDelete(idle_);
+    }
+    heap_caps_free(chunks_);
+}
+
+void CameraPipeline::SetExplainUrl(const std::string& url, const std::string& token) {
+    explain_url_ = url;
+    explain_token_ = token;
+}
+
+bool CameraPipeline::Initialize() {
+    if (encoder_task_ != nullptr) {
+        return true;
+    }
+    chunks_ = static_cast<uint8_t*>(heap_caps_malloc(kChunkSize * kChunkCount, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT));
+    free_slots_ = xQueueCreate(kChunkCount, sizeof(int));
+    // One more entry for the end marker, so the encoder never blocks on it
+    full_slots_ = xQueueCreate(kChunkCount + 1, sizeof(ChunkRef));
+    idle_ = xSemaphoreCreateBinary();
+    if (chunks_ == nullptr || free_slots_ == nullptr || full_slots_ == nullptr || idle_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate the chunk ring");
+        return false;
+    }
+
+    // The encoder needs about 8KB of stack, kept in PSRAM while it waits for a frame like the
+    // wake word encoders; internal RAM when the board has no PSRAM
+    encoder_task_stack_ = static_cast<StackType_t*>(heap_caps_malloc(kEncoderStackSize, MALLOC_CAP_SPIRAM));
+    if (encoder_task_stack_ == nullptr) {
+        encoder_task_stack_ = static_cast<StackType_t*>(heap_caps_malloc(kEncoderStackSize, MALLOC_CAP_INTERNAL));
+    }
+    encoder_task_buffer_ = static_cast<StaticTask_t*>(heap_caps_malloc(sizeof(StaticTask_t), MALLOC_CAP_INTERNAL));
+    if (encoder_task_stack_ == nullptr || encoder_task_buffer_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate the encoder task");
+        return false;
+    }
+    // StartEncoder() sets the priority of the task that waits for the chunks
+    encoder_task_ = xTaskCreateStatic([](void* arg) {
+        static_cast<CameraPipeline*>(arg)->EncoderTask();
+    }, "jpeg_encoder", kEncoderStackSize, this, uxTaskPriorityGet(nullptr), encoder_task_stack_,
+       encoder_task_buffer_);
+    return encoder_task_ != nullptr;
+}
+
+bool CameraPipeline::Start(const Frame& frame, int64_t capture_us) {
+    Cancel();
+    frame_ = frame;
+    capture_us_ = capture_us;
+    encode_us_ = 0;
+    started_ = frame.data != nullptr && frame.len > 0;
+    consumed_ = false;
+    if (!started_ || frame.format == V4L2_PIX_FMT_JPEG) {
+        return started_;
+    }
+    if (!Initialize()) {
+        started_ = false;
+        return false;
+    }
+    StartEncoder();
+    return true;
+}
+
+void CameraPipeline::StartEncoder() {
+    ResetSlots();
+    cancel_ = false;
+    encoding_ = true;
+    // At the priority of the caller, which waits for the chunks: the MCP tool lowers itself to 1
+    // for the photo, so audio and the UI still come first
+    vTaskPrioritySet(encoder_task_, uxTaskPriorityGet(nullptr));
+    xTaskNotifyGive(encoder_task_);
+}
+
+void CameraPipeline::Cancel() {
+    StopEncoder();
+    started_ = false;
+}
+
+void CameraPipeline::StopEncoder() {
+    if (encoding_) {
+        // The encoder checks the flag between chunks and while it waits for a free one
+        cancel_ = true;
+        xSemaphoreTake(idle_, portMAX_DELAY);
+        encoding_ = false;
+    }
+}
+
+void CameraPipeline::ResetSlots() {
+    xQueueReset(free_slots_);
+    xQueueReset(full_slots_);
+    for (int slot = 0; slot < kChunkCount; slot++) {
+        xQueueSend(free_slots_, &slot, 0);
+    }
+}
+
+void CameraPipeline::EncoderTask() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        EncodeFrame();
+        xSemaphoreGive(idle_);
+    }
+}
+
+void CameraPipeline::EncodeFrame() {
+    int64_t start_time = esp_timer_get_time();
+    fill_slot_ = -1;
+    fill_len_ = 0;
+
+    auto on_data = [](void* arg, size_t index, const void* data, size_t len) -> size_t {
+        if (data == nullptr) {
+            return 0;
+        }
+        return static_cast<CameraPipeline*>(arg)->Append(static_cast<const uint8_t*>(data), len);
+    };
+    bool ok = false;
+#if !CONFIG_XIAOZHI_ENABLE_HARDWARE_JPEG_ENCODER
+    // Stripe by stripe straight from the frame, without a frame-sized conversion or output buffer
+    switch (frame_.format) {
+        case V4L2_PIX_FMT_GREY:
+        case V4L2_PIX_FMT_YUYV:
+        case V4L2_PIX_FMT_RGB565:
+        case V4L2_PIX_FMT_RGB565X:
+        case V4L2_PIX_FMT_RGB24: {
+            size_t stride = frame_.stride;
+            if (stride == 0) {
+                size_t bytes_per_pixel = frame_.format == V4L2_PIX_FMT_GREY ? 1 :
+                                         frame_.format == V4L2_PIX_FMT_RGB24 ? 3 : 2;
+                stride = (size_t)frame_.width * bytes_per_pixel;
+            }
+            ok = image_to_jpeg_stream(frame_.data, frame_.width, frame_.height, stride, frame_.format, kQuality,
+                                      on_data, this);
+            break;
+        }
+        default:
+            ok = image_to_jpeg_cb(const_cast<uint8_t*>(frame_.data), frame_.len, frame_.width, frame_.height,
+                                  frame_.format, kQuality, on_data, this);
+            break;
+    }
+#else
+    ok = image_to_jpeg_cb(const_cast<uint8_t*>(frame_.data), frame_.len, frame_.width, frame_.height,
+                          frame_.format, kQuality, on_data, this);
+#endif
+    ok = ok && !cancel_;
+    if (ok) {
+        Flush();
+    } else if (fill_slot_ >= 0) {
+        xQueueSend(free_slots_, &fill_slot_, 0);
+        fill_slot_ = -1;
+    }
+    encode_us_ = esp_timer_get_time() - start_time;
+    ESP_LOGD(TAG, "Encoder stack headroom: %u bytes", (unsigned)uxTaskGetStackHighWaterMark(nullptr));
+    ChunkRef end = {.slot = ok ? kEndOk : kEndError, .len = 0};
+    xQueueSend(full_slots_, &end, 0);
+}
+
+size_t CameraPipeline::Append(const uint8_t* data, size_t len) {
+    size_t written = 0;
+    while (written < len) {
+        if (fill_slot_ < 0) {
+            // Wait for the upload to hand a chunk back
+            while (xQueueReceive(free_slots_, &fill_slot_, pdMS_TO_TICKS(100)) != pdPASS) {
+                if (cancel_) {
+                    return written;
+                }
+            }
+            fill_len_ = 0;
+        }
+        if (cancel_) {
+            return written;
+        }
+        size_t count = std::min(len - written, kChunkSize - fill_len_);
+        memcpy(chunks_ + fill_slot_ * kChunkSize + fill_len_, data + written, count);
+        fill_len_ += count;
+        written += count;
+        if (fill_len_ == kChunkSize) {
+            Flush();
+        }
+    }
+    return written;
+}
+
+void CameraPipeline::Flush() {
+    if (fill_slot_ < 0) {
+        return;
+    }
+    ChunkRef chunk = {.slot = fill_slot_, .len = fill_len_};
+    xQueueSend(full_slots_, &chunk, 0);
+    fill_slot_ = -1;
+    fill_len_ = 0;
+}
+
+std::string CameraPipeline::Explain(const std::string& question) {
+    if (explain_url_.empty()) {
+        throw std::runtime_error("Image explain URL or token is not set");
+    }
+    if (!started_) {
+        throw std::runtime_error("No camera frame captured");
+    }
+    if (consumed_ && frame_.format != V4L2_PIX_FMT_JPEG) {
+        // Explained before, the camera still holds the frame
+        StartEncoder();
+    }
+
+    int64_t upload_start = esp_timer_get_time();
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(3);
+    // 构造multipart/form-data请求体
+    std::string boundary = "----ESP32_CAMERA_BOUNDARY";
+
+    // 配置HTTP客户端，使用分块传输编码
+    http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    http->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+    if (!explain_token_.empty()) {
+        http->SetHeader("Authorization", "Bearer " + explain_token_);
+    }
+    http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
+    http->SetHeader("Transfer-Encoding", "chunked");
+    if (!http->Open("POST", explain_url_)) {
+        ESP_LOGE(TAG, "Failed to connect to explain URL");
+        StopEncoder();
+        consumed_ = true;
+        throw std::runtime_error("Failed to connect to explain URL");
+    }
+
+    // Once a write fails the body is cut off, nothing after it is sent
+    bool sent = true;
+    auto write = [&http, &sent](const char* data, size_t len) {
+        sent = sent && http->Write(data, len) >= 0;
+        return sent;
+    };
+    {
+        // 第一块：question字段
+        std::string question_field;
+        question_field += "--" + boundary + "\r\n";
+        question_field += "Content-Disposition: form-data; name=\"question\"\r\n";
+        question_field += "\r\n";
+        question_field += question + "\r\n";
+        write(question_field.c_str(), question_field.size());
+    }
+    {
+        // 第二块：文件字段头部
+        std::string file_header;
+        file_header += "--" + boundary + "\r\n";
+        file_header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera.jpg\"\r\n";
+        file_header += "Content-Type: image/jpeg\r\n";
+        file_header += "\r\n";
+        write(file_header.c_str(), file_header.size());
+    }
+
+    // 第三块：JPEG数据，编码器写满一块就发送一块
+    size_t total_sent = 0;
+    bool ok = true;
+    if (frame_.format == V4L2_PIX_FMT_JPEG) {
+        if (write(reinterpret_cast<const char*>(frame_.data), frame_.len)) {
+            total_sent = frame_.len;
+        }
+    } else {
+        while (sent) {
+            ChunkRef chunk;
+            xQueueReceive(full_slots_, &chunk, portMAX_DELAY);
+            if (chunk.slot < 0) {
+                ok = chunk.slot == kEndOk;
+                // The end marker is the encoder's last step, it is idle right after
+                xSemaphoreTake(idle_, portMAX_DELAY);
+                encoding_ = false;
+                break;
+            }
+            if (write(reinterpret_cast<const char*>(chunks_ + chunk.slot * kChunkSize), chunk.len)) {
+                total_sent += chunk.len;
+            }
+            xQueueSend(free_slots_, &chunk.slot, 0);
+        }
+        // Stops an encoder that is still running after a failed write
+        StopEncoder();
+    }
+    consumed_ = true;
+
+    if (!sent) {
+        ESP_LOGE(TAG, "Failed to send the photo, %u bytes of JPEG sent", (unsigned)total_sent);
+        throw std::runtime_error("Failed to upload photo");
+    }
+    if (!ok || total_sent == 0) {
+        ESP_LOGE(TAG, "JPEG encoder failed or produced empty output");
+        throw std::runtime_error("Failed to encode image to JPEG");
+    }
+
+    {
+        // 第四块：multipart尾部
+        std::string multipart_footer;
+        multipart_footer += "\r\n--" + boundary + "--\r\n";
+        write(multipart_footer.c_str(), multipart_footer.size());
+    }
+    // 结束块
+    if (!write("", 0)) {
+        ESP_LOGE(TAG, "Failed to send the end of the photo upload");
+        throw std::runtime_error("Failed to upload photo");
+    }
+
+    if (http->GetStatusCode() != 200) {
+        ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
+        throw std::runtime_error("Failed to upload photo");
+    }
+
+    std::string result = http->ReadAll();
+    http->Close();
+
+    // Encoding overlaps the preview and the connection, so the stages add up to more than the total
+    ESP_LOGI(TAG, "Explain %ux%u, jpeg=%u bytes, capture=%ld ms, encode=%ld ms, upload=%ld ms, question=%s\n%s",
+             frame_.width, frame_.height, (unsigned)total_sent, (long)(capture_us_ / 1000), (long)(encode_us_ / 1000),
+             (long)((esp_timer_get_time() - upload_start) / 1000), question.c_str(), result.c_str());
+    return result;
+}
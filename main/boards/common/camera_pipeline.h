@@ -0,0 +1,96 @@
+#ifndef CAMERA_PIPELINE_H
+#define CAMERA_PIPELINE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
+
+#include "jpg/image_to_jpeg.h"
+
+/*
+ * Capture -> JPEG encode -> explain upload, shared by the camera backends.
+ *
+ * Start() hands a captured frame to a persistent encoder task, so encoding runs
+ * while the camera builds its preview and Explain() connects to the server.
+ * The encoder fills a fixed ring of chunk buffers that Explain() writes straight
+ * into the request body and hands back, so nothing is allocated per chunk or
+ * per photo. JPEG frames skip the encoder and are uploaded as they are.
+ *
+ * The frame is read in place: it must stay valid until Cancel(), the next
+ * Start() or the end of Explain(). Called from one task at a time, like Camera.
+ */
+class CameraPipeline {
+public:
+    struct Frame {
+        const uint8_t* data = nullptr;
+        size_t len = 0;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        size_t stride = 0;              // Bytes per row, 0 when rows are packed
+        v4l2_pix_fmt_t format = 0;
+    };
+
+    CameraPipeline() = default;
+    ~CameraPipeline();
+    CameraPipeline(const CameraPipeline&) = delete;
+    CameraPipeline& operator=(const CameraPipeline&) = delete;
+
+    void SetExplainUrl(const std::string& url, const std::string& token);
+    // capture_us is how long the camera took to get the frame, for the timing log
+    bool Start(const Frame& frame, int64_t capture_us);
+    // Stops the encoder and waits until it no longer reads the frame
+    void Cancel();
+    // Uploads the question and the JPEG of the started frame; throws on failure
+    std::string Explain(const std::string& question);
+
+private:
+    static constexpr size_t kChunkSize = 8 * 1024;
+    static constexpr int kChunkCount = 6;
+    static constexpr int kEndOk = -1;
+    static constexpr int kEndError = -2;
+    static constexpr uint8_t kQuality = 80;
+    static constexpr size_t kEncoderStackSize = 4096 * 2;
+
+    struct ChunkRef {
+        int slot;       // kEndOk or kEndError after the last chunk
+        size_t len;
+    };
+
+    std::string explain_url_;
+    std::string explain_token_;
+    Frame frame_;
+    bool started_ = false;
+    bool encoding_ = false;
+    bool consumed_ = false;         // The ring was drained, encode again for another Explain()
+    int64_t capture_us_ = 0;
+    int64_t encode_us_ = 0;
+
+    uint8_t* chunks_ = nullptr;
+    QueueHandle_t free_slots_ = nullptr;
+    QueueHandle_t full_slots_ = nullptr;
+    SemaphoreHandle_t idle_ = nullptr;
+    TaskHandle_t encoder_task_ = nullptr;
+    StackType_t* encoder_task_stack_ = nullptr;
+    StaticTask_t* encoder_task_buffer_ = nullptr;
+    std::atomic<bool> cancel_{false};
+    // Encoder task only
+    int fill_slot_ = -1;
+    size_t fill_len_ = 0;
+
+    bool Initialize();
+    void StartEncoder();
+    void StopEncoder();
+    void ResetSlots();
+    void EncoderTask();
+    void EncodeFrame();
+    size_t Append(const uint8_t* data, size_t len);
+    void Flush();
+};
+
+#endif // CAMERA_PIPELINE_H
@@ -2,34 +2,20 @@
 #include "sdkconfig.h"
 
 #include <lvgl.h>
-#include <thread>
 #include <memory>
 #include <vector>
 
-#include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
-
 #include "camera.h"
+#include "camera_pipeline.h"
 #include "esp_camera.h"
-#include "jpg/image_to_jpeg.h"
-
-struct JpegChunk
-{
-    uint8_t *data;
-    size_t len;
-};
 
 class Esp32Camera : public Camera
 {
 private:
     bool streaming_on_ = false;
     bool swap_bytes_enabled_ = true;  // Swap pixel byte order for RGB565, enabled by default
-    std::string explain_url_;
-    std::string explain_token_;
-    std::thread encoder_thread_;
     camera_fb_t *current_fb_ = nullptr;
-    uint8_t *encode_buf_ = nullptr;  // Buffer for JPEG encoding (with optional byte swap)
-    size_t encode_buf_size_ = 0;
+    CameraPipeline pipeline_;  // Encodes current_fb_ in place
 
 public:
     Esp32Camera(const camera_config_t &config);
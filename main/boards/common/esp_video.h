@@ -3,21 +3,13 @@
 
 #include <lvgl.h>
 #include <memory>
-#include <thread>
 #include <vector>
 
-#include <freertos/FreeRTOS.h>
-#include <freertos/queue.h>
-
 #include "camera.h"
+#include "camera_pipeline.h"
 #include "esp_video_init.h"
 #include "jpg/image_to_jpeg.h"
 
-struct JpegChunk {
-    uint8_t* data;
-    size_t len;
-};
-
 class EspVideo : public Camera {
 private:
     struct FrameBuffer {
@@ -39,9 +31,10 @@ private:
         size_t length = 0;
     };
     std::vector<MmapBuffer> mmap_buffers_;
-    std::string explain_url_;
-    std::string explain_token_;
-    std::thread encoder_thread_;
+    int held_buffer_ = -1;  // V4L2 buffer frame_ points into, kept dequeued until the next capture
+    CameraPipeline pipeline_;
+
+    void ReleaseFrame();
 
 public:
     EspVideo(const esp_video_init_config_t& config);
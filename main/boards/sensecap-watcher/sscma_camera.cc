@@ -564,14 +564,16 @@ void SscmaCamera::InitializeMcpTools() {
 }
 
 void SscmaCamera::SetExplainUrl(const std::string& url, const std::string& token) {
-    explain_url_ = url;
-    explain_token_ = token;
+    pipeline_.SetExplainUrl(url, token);
 }
 
 bool SscmaCamera::Capture() {
 
     SscmaData data;
     int ret = 0;
+
+    // jpeg_data_ is about to be overwritten
+    pipeline_.Cancel();
     
     if (sscma_client_handle_ == nullptr) {
         ESP_LOGE(TAG, "SSCMA client handle is not initialized");
@@ -583,6 +585,7 @@ bool SscmaCamera::Capture() {
         return false;
     }
     ESP_LOGI(TAG, "Capturing image...");
+    int64_t start_time = esp_timer_get_time();
     // himax 可能有缓存数据, 只获取最新的照片即可.
     if (sscma_client_sample(sscma_client_handle_, 1) ) {
         ESP_LOGE(TAG, "Failed to capture image from SSCMA client");
@@ -607,6 +610,14 @@ bool SscmaCamera::Capture() {
     }
     heap_caps_free(data.img);
 
+    CameraPipeline::Frame frame;
+    frame.data = jpeg_data_.buf;
+    frame.len = jpeg_data_.len;
+    frame.width = preview_image_.header.w;
+    frame.height = preview_image_.header.h;
+    frame.format = V4L2_PIX_FMT_JPEG;
+    pipeline_.Start(frame, esp_timer_get_time() - start_time);
+
     //DECODE JPEG
     if (!jpeg_dec_ || !jpeg_io_ || !jpeg_out_ || !preview_image_.data) {
         return true;
@@ -660,9 +671,7 @@ bool SscmaCamera::SetVFlip(bool enabled) {
 /**
  * @brief 将摄像头捕获的图像发送到远程服务器进行AI分析和解释
  * 
- * 该函数将当前摄像头缓冲区中的图像编码为JPEG格式，并通过HTTP POST请求
- * 以multipart/form-data的形式发送到指定的解释服务器。服务器将根据提供的
- * 问题对图像进行AI分析并返回结果。
+ * 摄像头直接输出JPEG，由CameraPipeline以multipart/form-data的形式原样上传。
  * 
  * @param question 要向AI提出的关于图像的问题，将作为表单字段发送
  * @return std::string 服务器返回的JSON格式响应字符串
@@ -671,73 +680,11 @@ bool SscmaCamera::SetVFlip(bool enabled) {
  *                  {"success": false, "message": "错误信息"}
  * 
  * @note 调用此函数前必须先调用SetExplainUrl()设置服务器URL
- * @note 函数会等待之前的编码线程完成后再开始新的处理
- * @warning 如果摄像头缓冲区为空或网络连接失败，将返回错误信息
  */
 std::string SscmaCamera::Explain(const std::string& question) {
-    if (explain_url_.empty()) {
-        return "{\"success\": false, \"message\": \"Image explain URL or token is not set\"}";
+    try {
+        return pipeline_.Explain(question);
+    } catch (const std::exception& e) {
+        return std::string("{\"success\": false, \"message\": \"") + e.what() + "\"}";
     }
-
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(3);
-    // 构造multipart/form-data请求体
-    std::string boundary = "----ESP32_CAMERA_BOUNDARY";
-    
-    // 构造question字段
-    std::string question_field;
-    question_field += "--" + boundary + "\r\n";
-    question_field += "Content-Disposition: form-data; name=\"question\"\r\n";
-    question_field += "\r\n";
-    question_field += question + "\r\n";
-    
-    // 构造文件字段头部
-    std::string file_header;
-    file_header += "--" + boundary + "\r\n";
-    file_header += "Content-Disposition: form-data; name=\"file\"; filename=\"camera.jpg\"\r\n";
-    file_header += "Content-Type: image/jpeg\r\n";
-    file_header += "\r\n";
-    
-    // 构造尾部
-    std::string multipart_footer;
-    multipart_footer += "\r\n--" + boundary + "--\r\n";
-
-    // 配置HTTP客户端，使用分块传输编码
-    http->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
-    http->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
-    if (!explain_token_.empty()) {
-        http->SetHeader("Authorization", "Bearer " + explain_token_);
-    }
-    http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
-    http->SetHeader("Transfer-Encoding", "chunked");
-    if (!http->Open("POST", explain_url_)) {
-        ESP_LOGE(TAG, "Failed to connect to explain URL");
-        return "{\"success\": false, \"message\": \"Failed to connect to explain URL\"}";
-    }
-    
-    // 第一块：question字段
-    http->Write(question_field.c_str(), question_field.size());
-    
-    // 第二块：文件字段头部
-    http->Write(file_header.c_str(), file_header.size());
-    
-    // 第三块：JPEG数据
-    http->Write((const char*)jpeg_data_.buf, jpeg_data_.len);
-
-    // 第四块：multipart尾部
-    http->Write(multipart_footer.c_str(), multipart_footer.size());
-    
-    // 结束块
-    http->Write("", 0);
-
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to upload photo, status code: %d", http->GetStatusCode());
-        return "{\"success\": false, \"message\": \"Failed to upload photo\"}";
-    }
-
-    std::string result = http->ReadAll();
-    http->Close();
-
-    ESP_LOGI(TAG, "Explain image size=%d, question=%s\n%s", jpeg_data_.len, question.c_str(), result.c_str());
-    return result;
 }
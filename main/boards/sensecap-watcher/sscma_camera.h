@@ -14,6 +14,7 @@
 
 #include "sscma_client.h"
 #include "camera.h"
+#include "camera_pipeline.h"
 
 struct SscmaData {
     uint8_t* img;
@@ -27,8 +28,7 @@ struct JpegData {
 class SscmaCamera : public Camera {
 private:
     lv_img_dsc_t preview_image_;
-    std::string explain_url_;
-    std::string explain_token_;
+    CameraPipeline pipeline_;  // Uploads jpeg_data_ as it is
     sscma_client_io_handle_t sscma_client_io_handle_;
     sscma_client_handle_t sscma_client_handle_;
     QueueHandle_t sscma_data_queue_;
@@ -46,6 +46,10 @@ public:
     virtual void SetPowerSaveMode(bool on);
     virtual bool AddTextGlyphs(const std::vector<TextGlyph>& glyphs, uint8_t bpp) { return false; }
     virtual void ClearTextGlyphs() {}
+    // Writes the glyphs pushed during the finished turn to flash, off the caller's task
+    virtual void PersistTextGlyphs() {}
+    // Code points of the pushed glyphs kept in flash, advertised so the server can skip them
+    virtual std::vector<uint32_t> GetStoredTextGlyphs(size_t max_count) { return {}; }
     virtual void SetEmojiCollection(std::shared_ptr<EmojiCollection>) {}
     virtual void SetupUI() { setup_ui_called_ = true; }
 
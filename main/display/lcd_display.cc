@@ -1137,20 +1137,26 @@ void LcdDisplay::SetEmotion(const char* emotion) {
     }
 
     DisplayLockGuard lock(this);
-    // Stop any running GIF animation in the same lock scope as setting new image
-    // to prevent LVGL from accessing freed image data between operations
-    if (gif_controller_) {
-        gif_controller_->Stop();
-        gif_controller_.reset();
-    }
-    if (image->IsGif()) {
+    if (gif_controller_ && gif_source_ == image->image_dsc()) {
+        // Same GIF: keep it running, along with the frames it has cached
+        if (!gif_controller_->IsPlaying()) {
+            gif_controller_->Start();
+        }
+    } else if (image->IsGif()) {
+        // Stop any running GIF animation in the same lock scope as setting new image
+        // to prevent LVGL from accessing freed image data between operations
+        if (gif_controller_) {
+            gif_controller_->Stop();
+            gif_controller_.reset();
+        }
         // Create new GIF controller
         gif_controller_ = std::make_unique<LvglGif>(image->image_dsc());
+        gif_source_ = image->image_dsc();
 
         if (gif_controller_->IsLoaded()) {
             // Set up frame update callback
             gif_controller_->SetFrameCallback(
-                [this]() { lv_image_set_src(emoji_image_, gif_controller_->image_dsc()); });
+                [this](const lv_area_t& area) { gif_controller_->InvalidateArea(emoji_image_, area); });
 
             // Set initial frame and start animation
             lv_image_set_src(emoji_image_, gif_controller_->image_dsc());
@@ -1164,6 +1170,10 @@ void LcdDisplay::SetEmotion(const char* emotion) {
             gif_controller_.reset();
         }
     } else {
+        if (gif_controller_) {
+            gif_controller_->Stop();
+            gif_controller_.reset();
+        }
         lv_image_set_src(emoji_image_, image->image_dsc());
         lv_obj_add_flag(emoji_label_, LV_OBJ_FLAG_HIDDEN);
         lv_obj_remove_flag(emoji_image_, LV_OBJ_FLAG_HIDDEN);
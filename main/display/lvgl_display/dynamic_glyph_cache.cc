@@ -2,21 +2,31 @@
 
 #include <esp_log.h>
 #include <algorithm>
-#include <iterator>
+#include <cstring>
 
 #define TAG "DynamicGlyphCache"
 
-DynamicGlyphCache::DynamicGlyphCache() : retain_between_batches_(TextGlyphStorageUsesPsram()) {}
+// Code points of one cmap share a block, so their offsets never move when the list changes
+static constexpr uint32_t kCmapBlockBits = 15;
+// Number of blocks up to U+10FFFF
+static constexpr size_t kMaxCmaps = (0x10FFFF >> kCmapBlockBits) + 1;
+// Glyphs in one payload, the most that is kept without PSRAM
+static constexpr size_t kMaxBatchGlyphs = 64;
+// The arena is compacted before growing past this
+static constexpr size_t kMaxArenaBytes = DynamicGlyphCache::kMaxBitmapBytes + DynamicGlyphCache::kMaxBitmapBytes / 4;
+
+DynamicGlyphCache::DynamicGlyphCache()
+    : retain_between_batches_(TextGlyphStorageUsesPsram()),
+      max_glyphs_(retain_between_batches_ ? kMaxGlyphs : kMaxBatchGlyphs) {}
 
 lv_font_t* DynamicGlyphCache::EnsureFont(const lv_font_t* base_font, uint8_t bpp) {
     if (base_font == nullptr || (bpp != 1 && bpp != 4)) {
         return nullptr;
     }
-    bool needs_rebuild = !initialized_;
+    bool needs_update = !initialized_;
     if (initialized_ && bpp_ != bpp) {
-        entries_.clear();
-        use_counter_ = 0;
-        needs_rebuild = true;
+        Reset(false);
+        needs_update = true;
     }
     bpp_ = bpp;
     font_.get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt;
@@ -29,22 +39,19 @@ lv_font_t* DynamicGlyphCache::EnsureFont(const lv_font_t* base_font, uint8_t bpp
     font_.static_bitmap = 0;
     font_.underline_position = base_font->underline_position;
     font_.underline_thickness = base_font->underline_thickness;
-    font_.fallback = nullptr;
+    font_.fallback = fallback_;
     font_.user_data = nullptr;
     font_.dsc = &dsc_;
     initialized_ = true;
-    if (needs_rebuild) {
-        Rebuild();
+    if (needs_update) {
+        UpdateFont();
     }
     return &font_;
 }
 
-size_t DynamicGlyphCache::BitmapBytes() const {
-    size_t total = 0;
-    for (const auto& entry : entries_) {
-        total += entry.bitmap.size();
-    }
-    return total;
+void DynamicGlyphCache::SetFallback(const lv_font_t* fallback) {
+    fallback_ = fallback;
+    font_.fallback = fallback;
 }
 
 bool DynamicGlyphCache::AddGlyphs(const std::vector<TextGlyph>& glyphs) {
@@ -54,121 +61,258 @@ bool DynamicGlyphCache::AddGlyphs(const std::vector<TextGlyph>& glyphs) {
 
     bool changed = false;
     if (!retain_between_batches_) {
-        changed = !entries_.empty();
-        entries_.clear();
-        use_counter_ = 0;
+        changed = !index_.empty();
+        Reset(false);
+    }
+    if (slots_.empty()) {
+        Allocate();
     }
-    size_t bitmap_bytes = BitmapBytes();
     for (const auto& glyph : glyphs) {
-        const size_t expected = (static_cast<size_t>(glyph.box_w) * glyph.box_h * bpp_ + 7) / 8;
-        if (glyph.codepoint == 0 || glyph.codepoint > 0x10FFFF || glyph.bitmap.size() != expected) {
+        const size_t size = (static_cast<size_t>(glyph.box_w) * glyph.box_h * bpp_ + 7) / 8;
+        if (glyph.codepoint == 0 || glyph.codepoint > 0x10FFFF || glyph.bitmap.size() != size) {
             ESP_LOGW(TAG, "Rejected glyph U+%04lX", static_cast<unsigned long>(glyph.codepoint));
             continue;
         }
 
-        auto existing = std::find_if(
-            entries_.begin(), entries_.end(),
-            [&glyph](const Entry& entry) { return entry.codepoint == glyph.codepoint; });
-        if (existing != entries_.end()) {
-            bitmap_bytes -= existing->bitmap.size();
+        uint16_t slot;
+        auto existing = index_.find(glyph.codepoint);
+        const bool added = existing == index_.end();
+        if (!added) {
+            slot = existing->second;
+            Unlink(slot);
         } else {
-            entries_.emplace_back();
-            existing = std::prev(entries_.end());
+            slot = AcquireSlot();
+            slots_[slot].codepoint = glyph.codepoint;
+            index_.emplace(glyph.codepoint, slot);
+            InsertCodepoint(glyph.codepoint, slot);
         }
-        existing->codepoint = glyph.codepoint;
-        existing->adv_w = glyph.adv_w;
-        existing->box_w = glyph.box_w;
-        existing->box_h = glyph.box_h;
-        existing->ofs_x = glyph.ofs_x;
-        existing->ofs_y = glyph.ofs_y;
-        existing->bitmap.assign(glyph.bitmap.begin(), glyph.bitmap.end());
-        existing->last_use = ++use_counter_;
-        bitmap_bytes += glyph.bitmap.size();
-        changed = true;
-    }
+        LinkFront(slot);
 
-    while (entries_.size() > kMaxGlyphs || bitmap_bytes > kMaxBitmapBytes) {
-        auto oldest = std::min_element(
-            entries_.begin(), entries_.end(),
-            [](const Entry& a, const Entry& b) { return a.last_use < b.last_use; });
-        if (oldest == entries_.end()) {
-            break;
+        auto& dsc = glyph_dsc_[slot + 1];
+        if (added || BitmapSize(slot) != size) {
+            ReleaseBitmap(slot);
+            // Evict the least recently updated glyphs until the bitmap fits
+            while (live_bytes_ + size > kMaxBitmapBytes && lru_tail_ != slot) {
+                RemoveGlyph(lru_tail_);
+            }
+            if (bitmap_arena_.size() + size > kMaxArenaBytes) {
+                Compact();
+            }
+            dsc.bitmap_index = bitmap_arena_.size();
+            bitmap_arena_.resize(bitmap_arena_.size() + size);
+            live_bytes_ += size;
         }
-        bitmap_bytes -= oldest->bitmap.size();
-        entries_.erase(oldest);
+        // A glyph sent again with the same size is overwritten in place
+        std::copy(glyph.bitmap.begin(), glyph.bitmap.end(), bitmap_arena_.begin() + dsc.bitmap_index);
+        dsc.adv_w = glyph.adv_w;
+        dsc.box_w = glyph.box_w;
+        dsc.box_h = glyph.box_h;
+        dsc.ofs_x = glyph.ofs_x;
+        dsc.ofs_y = glyph.ofs_y;
+        changed = true;
     }
+
     if (changed) {
-        Rebuild();
+        UpdateFont();
     }
     return changed;
 }
 
 void DynamicGlyphCache::Clear() {
-    if (retain_between_batches_) {
-        entries_.clear();
-    } else {
-        TextGlyphVector<Entry>().swap(entries_);
-        TextGlyphVector<uint8_t>().swap(bitmap_blob_);
+    Reset(!retain_between_batches_);
+    UpdateFont();
+}
+
+void DynamicGlyphCache::Reset(bool release_memory) {
+    if (release_memory) {
+        TextGlyphVector<Slot>().swap(slots_);
+        GlyphIndex().swap(index_);
+        TextGlyphVector<uint8_t>().swap(bitmap_arena_);
+        TextGlyphVector<uint32_t>().swap(sorted_codepoints_);
         TextGlyphVector<uint16_t>().swap(unicode_list_);
+        TextGlyphVector<uint16_t>().swap(glyph_id_list_);
         TextGlyphVector<lv_font_fmt_txt_glyph_dsc_t>().swap(glyph_dsc_);
         TextGlyphVector<lv_font_fmt_txt_cmap_t>().swap(cmaps_);
+        lru_head_ = lru_tail_ = free_head_ = kNoSlot;
+        live_bytes_ = 0;
+        return;
     }
-    use_counter_ = 0;
-    Rebuild();
-}
-
-void DynamicGlyphCache::Rebuild() {
-    std::sort(entries_.begin(), entries_.end(),
-              [](const Entry& a, const Entry& b) { return a.codepoint < b.codepoint; });
 
-    bitmap_blob_.clear();
+    index_.clear();
+    bitmap_arena_.clear();
+    sorted_codepoints_.clear();
     unicode_list_.clear();
-    glyph_dsc_.clear();
+    glyph_id_list_.clear();
     cmaps_.clear();
-    glyph_dsc_.push_back(lv_font_fmt_txt_glyph_dsc_t{});
-
-    struct Range {
-        uint32_t start;
-        uint32_t list_begin;
-        uint32_t last;
-        uint16_t count;
-    };
-    TextGlyphVector<Range> ranges;
-    for (const auto& entry : entries_) {
-        if (ranges.empty() || entry.codepoint - ranges.back().start > 0xFFFE) {
-            ranges.push_back(Range{entry.codepoint, static_cast<uint32_t>(unicode_list_.size()),
-                                   entry.codepoint, 0});
+    std::fill(glyph_dsc_.begin(), glyph_dsc_.end(), lv_font_fmt_txt_glyph_dsc_t{});
+    lru_head_ = lru_tail_ = kNoSlot;
+    free_head_ = slots_.empty() ? kNoSlot : 0;
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        slots_[i] = Slot{};
+        slots_[i].next = i + 1 < slots_.size() ? i + 1 : kNoSlot;
+    }
+    live_bytes_ = 0;
+}
+
+void DynamicGlyphCache::Allocate() {
+    // Everything is sized once, so the lists the cmaps point into never move
+    slots_.resize(max_glyphs_);
+    index_.reserve(max_glyphs_);
+    sorted_codepoints_.reserve(max_glyphs_);
+    unicode_list_.reserve(max_glyphs_);
+    glyph_id_list_.reserve(max_glyphs_);
+    glyph_dsc_.assign(max_glyphs_ + 1, lv_font_fmt_txt_glyph_dsc_t{});
+    cmaps_.reserve(kMaxCmaps);
+    if (retain_between_batches_) {
+        // Keeps the arena from growing past its limit in steps of doubling
+        bitmap_arena_.reserve(kMaxArenaBytes);
+    }
+    Reset(false);
+}
+
+uint16_t DynamicGlyphCache::AcquireSlot() {
+    if (free_head_ == kNoSlot) {
+        RemoveGlyph(lru_tail_);
+    }
+    uint16_t slot = free_head_;
+    free_head_ = slots_[slot].next;
+    slots_[slot].next = kNoSlot;
+    return slot;
+}
+
+void DynamicGlyphCache::RemoveGlyph(uint16_t slot) {
+    auto& entry = slots_[slot];
+    index_.erase(entry.codepoint);
+    RemoveCodepoint(entry.codepoint);
+    Unlink(slot);
+    ReleaseBitmap(slot);
+    glyph_dsc_[slot + 1] = lv_font_fmt_txt_glyph_dsc_t{};
+    entry.codepoint = 0;
+    entry.next = free_head_;
+    free_head_ = slot;
+}
+
+void DynamicGlyphCache::LinkFront(uint16_t slot) {
+    slots_[slot].prev = kNoSlot;
+    slots_[slot].next = lru_head_;
+    if (lru_head_ != kNoSlot) {
+        slots_[lru_head_].prev = slot;
+    }
+    lru_head_ = slot;
+    if (lru_tail_ == kNoSlot) {
+        lru_tail_ = slot;
+    }
+}
+
+void DynamicGlyphCache::Unlink(uint16_t slot) {
+    auto& entry = slots_[slot];
+    if (entry.prev != kNoSlot) {
+        slots_[entry.prev].next = entry.next;
+    } else {
+        lru_head_ = entry.next;
+    }
+    if (entry.next != kNoSlot) {
+        slots_[entry.next].prev = entry.prev;
+    } else {
+        lru_tail_ = entry.prev;
+    }
+    entry.prev = entry.next = kNoSlot;
+}
+
+void DynamicGlyphCache::InsertCodepoint(uint32_t codepoint, uint16_t slot) {
+    const uint32_t block_start = codepoint >> kCmapBlockBits << kCmapBlockBits;
+    const uint16_t offset = static_cast<uint16_t>(codepoint - block_start);
+    auto position = std::lower_bound(sorted_codepoints_.begin(), sorted_codepoints_.end(), codepoint) -
+                    sorted_codepoints_.begin();
+    sorted_codepoints_.insert(sorted_codepoints_.begin() + position, codepoint);
+    unicode_list_.insert(unicode_list_.begin() + position, offset);
+    glyph_id_list_.insert(glyph_id_list_.begin() + position, static_cast<uint16_t>(slot + 1));
+
+    auto cmap = std::lower_bound(cmaps_.begin(), cmaps_.end(), block_start,
+                                 [](const lv_font_fmt_txt_cmap_t& a, uint32_t start) { return a.range_start < start; });
+    if (cmap == cmaps_.end() || cmap->range_start != block_start) {
+        lv_font_fmt_txt_cmap_t new_cmap{};
+        new_cmap.range_start = block_start;
+        new_cmap.glyph_id_start = 0;
+        new_cmap.type = LV_FONT_FMT_TXT_CMAP_SPARSE_FULL;
+        cmap = cmaps_.insert(cmap, new_cmap);
+    }
+    cmap->list_length++;
+    UpdateCmapLists(cmap - cmaps_.begin());
+}
+
+void DynamicGlyphCache::RemoveCodepoint(uint32_t codepoint) {
+    const uint32_t block_start = codepoint >> kCmapBlockBits << kCmapBlockBits;
+    auto position = std::lower_bound(sorted_codepoints_.begin(), sorted_codepoints_.end(), codepoint) -
+                    sorted_codepoints_.begin();
+    sorted_codepoints_.erase(sorted_codepoints_.begin() + position);
+    unicode_list_.erase(unicode_list_.begin() + position);
+    glyph_id_list_.erase(glyph_id_list_.begin() + position);
+
+    auto cmap = std::lower_bound(cmaps_.begin(), cmaps_.end(), block_start,
+                                 [](const lv_font_fmt_txt_cmap_t& a, uint32_t start) { return a.range_start < start; });
+    const size_t index = cmap - cmaps_.begin();
+    if (--cmap->list_length == 0) {
+        cmaps_.erase(cmap);
+    }
+    UpdateCmapLists(index);
+}
+
+void DynamicGlyphCache::UpdateCmapLists(size_t first_cmap) {
+    size_t begin = 0;
+    for (size_t i = 0; i < first_cmap; ++i) {
+        begin += cmaps_[i].list_length;
+    }
+    for (size_t i = first_cmap; i < cmaps_.size(); ++i) {
+        auto& cmap = cmaps_[i];
+        cmap.unicode_list = unicode_list_.data() + begin;
+        cmap.glyph_id_ofs_list = glyph_id_list_.data() + begin;
+        // The list is sorted, so the range only has to reach its last entry
+        if (i == first_cmap) {
+            cmap.range_length = unicode_list_[begin + cmap.list_length - 1] + 1;
+        }
+        begin += cmap.list_length;
+    }
+}
+
+size_t DynamicGlyphCache::BitmapSize(uint16_t slot) const {
+    const auto& dsc = glyph_dsc_[slot + 1];
+    return (static_cast<size_t>(dsc.box_w) * dsc.box_h * bpp_ + 7) / 8;
+}
+
+void DynamicGlyphCache::ReleaseBitmap(uint16_t slot) {
+    live_bytes_ -= BitmapSize(slot);
+    // Without a size the bitmap is skipped by Compact() until a new one is written
+    glyph_dsc_[slot + 1].box_w = 0;
+    glyph_dsc_[slot + 1].box_h = 0;
+}
+
+void DynamicGlyphCache::Compact() {
+    // Move the live bitmaps to the front of the arena in their current order
+    TextGlyphVector<uint16_t> order;
+    order.reserve(index_.size());
+    for (const auto& item : index_) {
+        if (BitmapSize(item.second) > 0) {
+            order.push_back(item.second);
         }
-        auto& range = ranges.back();
-        unicode_list_.push_back(static_cast<uint16_t>(entry.codepoint - range.start));
-        range.last = entry.codepoint;
-        ++range.count;
-
-        lv_font_fmt_txt_glyph_dsc_t glyph_dsc{};
-        glyph_dsc.bitmap_index = bitmap_blob_.size();
-        glyph_dsc.adv_w = entry.adv_w;
-        glyph_dsc.box_w = entry.box_w;
-        glyph_dsc.box_h = entry.box_h;
-        glyph_dsc.ofs_x = entry.ofs_x;
-        glyph_dsc.ofs_y = entry.ofs_y;
-        glyph_dsc_.push_back(glyph_dsc);
-        bitmap_blob_.insert(bitmap_blob_.end(), entry.bitmap.begin(), entry.bitmap.end());
-    }
-
-    for (const auto& range : ranges) {
-        lv_font_fmt_txt_cmap_t cmap{};
-        cmap.range_start = range.start;
-        cmap.range_length = static_cast<uint16_t>(range.last - range.start + 1);
-        cmap.glyph_id_start = static_cast<uint16_t>(range.list_begin + 1);
-        cmap.unicode_list = unicode_list_.data() + range.list_begin;
-        cmap.glyph_id_ofs_list = nullptr;
-        cmap.list_length = range.count;
-        cmap.type = LV_FONT_FMT_TXT_CMAP_SPARSE_TINY;
-        cmaps_.push_back(cmap);
-    }
-
-    dsc_.glyph_bitmap = bitmap_blob_.empty() ? nullptr : bitmap_blob_.data();
-    dsc_.glyph_dsc = glyph_dsc_.data();
+    }
+    std::sort(order.begin(), order.end(), [this](uint16_t a, uint16_t b) {
+        return glyph_dsc_[a + 1].bitmap_index < glyph_dsc_[b + 1].bitmap_index;
+    });
+    size_t write = 0;
+    for (auto slot : order) {
+        auto& dsc = glyph_dsc_[slot + 1];
+        const size_t size = BitmapSize(slot);
+        memmove(bitmap_arena_.data() + write, bitmap_arena_.data() + dsc.bitmap_index, size);
+        dsc.bitmap_index = write;
+        write += size;
+    }
+    bitmap_arena_.resize(write);
+}
+
+void DynamicGlyphCache::UpdateFont() {
+    dsc_.glyph_bitmap = bitmap_arena_.empty() ? nullptr : bitmap_arena_.data();
+    dsc_.glyph_dsc = glyph_dsc_.empty() ? nullptr : glyph_dsc_.data();
     dsc_.cmaps = cmaps_.empty() ? nullptr : cmaps_.data();
     dsc_.kern_dsc = nullptr;
     dsc_.kern_scale = 0;
@@ -6,8 +6,19 @@
 #include <lvgl.h>
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <unordered_map>
 #include <vector>
 
+/*
+ * Fallback font made of glyphs pushed by the server.
+ *
+ * Every cached glyph owns a fixed slot, and its glyph id (slot + 1) stays the
+ * same while it is cached. The cmaps are SPARSE_FULL lists kept sorted by
+ * code point, one per 32K block, so adding or evicting a glyph only patches
+ * the list of its block. Bitmaps are appended to an arena. Space freed by
+ * evictions is reclaimed by compacting the arena once it runs full.
+ */
 class DynamicGlyphCache {
 public:
     static constexpr size_t kMaxGlyphs = 256;
@@ -15,34 +26,57 @@ public:
 
     DynamicGlyphCache();
     lv_font_t* EnsureFont(const lv_font_t* base_font, uint8_t bpp);
+    // Searched for glyphs that are not cached, e.g. PersistentGlyphStore
+    void SetFallback(const lv_font_t* fallback);
     bool AddGlyphs(const std::vector<TextGlyph>& glyphs);
     void Clear();
 
 private:
-    struct Entry {
+    static constexpr uint16_t kNoSlot = 0xFFFF;
+
+    struct Slot {
         uint32_t codepoint = 0;
-        uint32_t adv_w = 0;
-        uint16_t box_w = 0;
-        uint16_t box_h = 0;
-        int16_t ofs_x = 0;
-        int16_t ofs_y = 0;
-        TextGlyphVector<uint8_t> bitmap;
-        uint64_t last_use = 0;
+        uint16_t prev = kNoSlot;    // Towards the most recently used
+        uint16_t next = kNoSlot;    // Towards the least recently used, or the next free slot
     };
 
-    void Rebuild();
-    size_t BitmapBytes() const;
+    using GlyphIndex = std::unordered_map<uint32_t, uint16_t, std::hash<uint32_t>, std::equal_to<uint32_t>,
+                                          TextGlyphAllocator<std::pair<const uint32_t, uint16_t>>>;
+
+    void Reset(bool release_memory);
+    void Allocate();
+    uint16_t AcquireSlot();
+    void RemoveGlyph(uint16_t slot);
+    void LinkFront(uint16_t slot);
+    void Unlink(uint16_t slot);
+    void InsertCodepoint(uint32_t codepoint, uint16_t slot);
+    void RemoveCodepoint(uint32_t codepoint);
+    void UpdateCmapLists(size_t first_cmap);
+    size_t BitmapSize(uint16_t slot) const;
+    void ReleaseBitmap(uint16_t slot);
+    void Compact();
+    void UpdateFont();
 
     bool initialized_ = false;
     bool retain_between_batches_ = false;
     uint8_t bpp_ = 0;
-    uint64_t use_counter_ = 0;
+    size_t max_glyphs_ = 0;
     lv_font_t font_{};
     lv_font_fmt_txt_dsc_t dsc_{};
-    TextGlyphVector<Entry> entries_;
-    TextGlyphVector<uint8_t> bitmap_blob_;
-    TextGlyphVector<uint16_t> unicode_list_;
-    TextGlyphVector<lv_font_fmt_txt_glyph_dsc_t> glyph_dsc_;
+    const lv_font_t* fallback_ = nullptr;
+
+    TextGlyphVector<Slot> slots_;
+    GlyphIndex index_;                  // Code point -> slot
+    uint16_t lru_head_ = kNoSlot;
+    uint16_t lru_tail_ = kNoSlot;
+    uint16_t free_head_ = kNoSlot;
+    size_t live_bytes_ = 0;             // Bitmap bytes of cached glyphs, the rest of the arena is garbage
+
+    TextGlyphVector<uint8_t> bitmap_arena_;
+    TextGlyphVector<uint32_t> sorted_codepoints_;
+    TextGlyphVector<uint16_t> unicode_list_;        // Parallel to sorted_codepoints_, relative to the block
+    TextGlyphVector<uint16_t> glyph_id_list_;       // Parallel to sorted_codepoints_
+    TextGlyphVector<lv_font_fmt_txt_glyph_dsc_t> glyph_dsc_;   // Indexed by glyph id
     TextGlyphVector<lv_font_fmt_txt_cmap_t> cmaps_;
 };
 
@@ -33,11 +33,39 @@ static bool f_gif_open(gd_GIF * gif, const void * path, bool is_file);
 static inline void f_gif_read(gd_GIF * gif, void * buf, size_t len);
 static inline int f_gif_seek(gd_GIF * gif, size_t pos, int k);
 static void f_gif_close(gd_GIF * gif);
+static void mark_dirty(gd_GIF * gif, uint16_t x, uint16_t y, uint16_t w, uint16_t h);
+static void expand_palette(gd_GIF * gif);
 
 #if LV_USE_DRAW_SW_ASM == LV_DRAW_SW_ASM_HELIUM
     #include "gifdec_mve.h"
 #endif
 
+#ifndef GIFDEC_FILL_BG
+/* Canvas pixels are B, G, R, A bytes; the canvas is word aligned, so fill a word per pixel. */
+#define GIFDEC_FILL_BG(dst, w, h, stride, color, opa) \
+    gifdec_fill_bg_word(dst, w, h, stride, color, opa)
+
+static uint32_t
+argb_word(const uint8_t * color, uint8_t opa)
+{
+    uint8_t bytes[4] = {color[2], color[1], color[0], opa};
+    uint32_t word;
+    memcpy(&word, bytes, sizeof(word));
+    return word;
+}
+
+static void
+gifdec_fill_bg_word(uint8_t * dst, uint16_t w, uint16_t h, uint16_t stride, const uint8_t * color, uint8_t opa)
+{
+    uint32_t word = argb_word(color, opa);
+    uint32_t * row = (uint32_t *) dst;
+    for(int j = 0; j < h; j++) {
+        for(int k = 0; k < w; k++) row[k] = word;
+        row += stride;
+    }
+}
+#endif
+
 static uint16_t
 read_num(gd_GIF * gif)
 {
@@ -149,16 +177,9 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
     gif->lzw_cache = gif->frame + width * height;
     #endif
 
-#ifdef GIFDEC_FILL_BG
-    GIFDEC_FILL_BG(gif->canvas, gif->width * gif->height, 1, gif->width * gif->height, bgcolor, 0x00);
-#else
-    for(int i = 0; i < gif->width * gif->height; i++) {
-        gif->canvas[i * 4 + 0] = *(bgcolor + 2);
-        gif->canvas[i * 4 + 1] = *(bgcolor + 1);
-        gif->canvas[i * 4 + 2] = *(bgcolor + 0);
-        gif->canvas[i * 4 + 3] = 0x00;  // 初始化为透明，让第一帧根据自己的透明度设置来渲染
-    }
-#endif
+    // 初始化为透明，让第一帧根据自己的透明度设置来渲染
+    GIFDEC_FILL_BG(gif->canvas, gif->width, gif->height, gif->width, bgcolor, 0x00);
+    mark_dirty(gif, 0, 0, width, height);
     gif->anim_start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     gif->loop_count = -1;
     goto ok;
@@ -650,9 +671,12 @@ read_image(gd_GIF * gif)
         gif->lct.size = 1 << ((fisrz & 0x07) + 1);
         f_gif_read(gif, gif->lct.colors, 3 * gif->lct.size);
         gif->palette = &gif->lct;
+        expand_palette(gif);
     }
-    else
+    else {
         gif->palette = &gif->gct;
+        if(gif->palette_argb_src != gif->palette) expand_palette(gif);
+    }
     /* Image Data. */
     return read_image_data(gif, interlace);
 }
@@ -666,23 +690,43 @@ render_frame_rect(gd_GIF * gif, uint8_t * buffer)
                         &gif->frame[i], gif->palette->colors,
                         gif->gce.transparency ? gif->gce.tindex : 0x100);
 #else
+    /* One table load and one word store per pixel instead of three palette loads and four byte stores */
+    const uint32_t * argb = gif->palette_argb;
+    const uint8_t * src = &gif->frame[i];
+    uint32_t * dst = (uint32_t *) &buffer[i * 4];
     int j, k;
-    uint8_t index, * color;
 
     for(j = 0; j < gif->fh; j++) {
-        for(k = 0; k < gif->fw; k++) {
-            index = gif->frame[(gif->fy + j) * gif->width + gif->fx + k];
-            color = &gif->palette->colors[index * 3];
-            if(!gif->gce.transparency || index != gif->gce.tindex) {
-                buffer[(i + k) * 4 + 0] = *(color + 2);
-                buffer[(i + k) * 4 + 1] = *(color + 1);
-                buffer[(i + k) * 4 + 2] = *(color + 0);
-                buffer[(i + k) * 4 + 3] = 0xFF;
+        if(!gif->gce.transparency) {
+            for(k = 0; k + 4 <= gif->fw; k += 4) {
+                dst[k + 0] = argb[src[k + 0]];
+                dst[k + 1] = argb[src[k + 1]];
+                dst[k + 2] = argb[src[k + 2]];
+                dst[k + 3] = argb[src[k + 3]];
             }
+            for(; k < gif->fw; k++) dst[k] = argb[src[k]];
         }
-        i += gif->width;
+        else {
+            uint8_t tindex = gif->gce.tindex;
+            for(k = 0; k < gif->fw; k++) {
+                if(src[k] != tindex) dst[k] = argb[src[k]];
+            }
+        }
+        src += gif->width;
+        dst += gif->width;
+    }
+#endif
+}
+
+static void
+expand_palette(gd_GIF * gif)
+{
+#ifndef GIFDEC_RENDER_FRAME
+    for(int c = 0; c < 0x100; c++) {
+        gif->palette_argb[c] = argb_word(&gif->palette->colors[c * 3], 0xFF);
     }
 #endif
+    gif->palette_argb_src = gif->palette;
 }
 
 static void
@@ -698,29 +742,115 @@ dispose(gd_GIF * gif)
             if(gif->gce.transparency) opa = 0x00;
 
             i = gif->fy * gif->width + gif->fx;
-#ifdef GIFDEC_FILL_BG
             GIFDEC_FILL_BG(&(gif->canvas[i * 4]), gif->fw, gif->fh, gif->width, bgcolor, opa);
-#else
-            int j, k;
-            for(j = 0; j < gif->fh; j++) {
-                for(k = 0; k < gif->fw; k++) {
-                    gif->canvas[(i + k) * 4 + 0] = *(bgcolor + 2);
-                    gif->canvas[(i + k) * 4 + 1] = *(bgcolor + 1);
-                    gif->canvas[(i + k) * 4 + 2] = *(bgcolor + 0);
-                    gif->canvas[(i + k) * 4 + 3] = opa;
-                }
-                i += gif->width;
-            }
-#endif
+            mark_dirty(gif, gif->fx, gif->fy, gif->fw, gif->fh);
             break;
         case 3: /* Restore to previous, i.e., don't update canvas.*/
             break;
         default:
-            /* Add frame non-transparent pixels to canvas. */
-            render_frame_rect(gif, gif->canvas);
+            /* Add frame non-transparent pixels to canvas, unless gd_render_frame() already did. */
+            if(!gif->rendered) {
+                render_frame_rect(gif, gif->canvas);
+                mark_dirty(gif, gif->fx, gif->fy, gif->fw, gif->fh);
+            }
     }
 }
 
+static void
+mark_dirty(gd_GIF * gif, uint16_t x, uint16_t y, uint16_t w, uint16_t h)
+{
+    if(w == 0 || h == 0) return;
+    if(gif->dw == 0 || gif->dh == 0) {
+        gif->dx = x;
+        gif->dy = y;
+        gif->dw = w;
+        gif->dh = h;
+        return;
+    }
+    uint16_t x2 = MAX(gif->dx + gif->dw, x + w);
+    uint16_t y2 = MAX(gif->dy + gif->dh, y + h);
+    gif->dx = MIN(gif->dx, x);
+    gif->dy = MIN(gif->dy, y);
+    gif->dw = x2 - gif->dx;
+    gif->dh = y2 - gif->dy;
+}
+
+int
+gd_take_dirty_area(gd_GIF * gif, lv_area_t * area)
+{
+    if(gif->dw == 0 || gif->dh == 0) return 0;
+    area->x1 = gif->dx;
+    area->y1 = gif->dy;
+    area->x2 = gif->dx + gif->dw - 1;
+    area->y2 = gif->dy + gif->dh - 1;
+    gif->dw = gif->dh = 0;
+    return 1;
+}
+
+static uint64_t
+union_pixels(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t bx, uint16_t by, uint16_t bw, uint16_t bh)
+{
+    if(bw == 0 || bh == 0) return (uint64_t) w * h;
+    uint32_t x2 = MAX(x + w, bx + bw);
+    uint32_t y2 = MAX(y + h, by + bh);
+    return (uint64_t)(x2 - MIN(x, bx)) * (y2 - MIN(y, by));
+}
+
+/* Walks the blocks of one loop like gd_get_frame() but skips the image data. Every frame
+ * changes at most its own rect and the rect the previous one restores to the background. */
+int64_t
+gd_loop_dirty_pixels(gd_GIF * gif)
+{
+    size_t pos = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
+    int64_t pixels = 0;
+    uint8_t disposal = 0, byte;
+    uint16_t x, y, w, h;
+    uint16_t bx = 0, by = 0, bw = 0, bh = 0;
+    int frames = 0;
+    char sep;
+
+    f_gif_seek(gif, gif->anim_start, LV_FS_SEEK_SET);
+    for(;;) {
+        f_gif_read(gif, &sep, 1);
+        if(sep == '!') {
+            f_gif_read(gif, &byte, 1);
+            if(byte == 0xF9) {
+                f_gif_seek(gif, 1, LV_FS_SEEK_CUR);
+                f_gif_read(gif, &byte, 1);
+                disposal = (byte >> 2) & 3;
+                /* Delay and transparent index, the terminator is left to discard_sub_blocks(). */
+                f_gif_seek(gif, 3, LV_FS_SEEK_CUR);
+            }
+            discard_sub_blocks(gif);
+            continue;
+        }
+        if(sep != ',') break;
+        x = read_num(gif);
+        y = read_num(gif);
+        w = read_num(gif);
+        h = read_num(gif);
+        if(x + (uint32_t)w > gif->width || y + (uint32_t)h > gif->height) break;
+        f_gif_read(gif, &byte, 1);
+        if(byte & 0x80) f_gif_seek(gif, 3 * (1 << ((byte & 0x07) + 1)), LV_FS_SEEK_CUR);
+        /* LZW minimum code size, then the image data. */
+        f_gif_seek(gif, 1, LV_FS_SEEK_CUR);
+        discard_sub_blocks(gif);
+        if(frames++ > 0) pixels += union_pixels(x, y, w, h, bx, by, bw, bh);
+        if(disposal == 2) {
+            bx = x;
+            by = y;
+            bw = w;
+            bh = h;
+        }
+        else {
+            bw = bh = 0;
+        }
+    }
+    f_gif_seek(gif, pos, LV_FS_SEEK_SET);
+    if(sep != ';' || frames == 0) return -1;
+    return pixels;
+}
+
 /* Return 1 if got a frame; 0 if got GIF trailer; -1 if error. */
 int
 gd_get_frame(gd_GIF * gif)
@@ -744,6 +874,7 @@ gd_get_frame(gd_GIF * gif)
         else return -1;
         f_gif_read(gif, &sep, 1);
     }
+    gif->rendered = 0;
     if(read_image(gif) == -1)
         return -1;
     return 1;
@@ -753,6 +884,10 @@ void
 gd_render_frame(gd_GIF * gif, uint8_t * buffer)
 {
     render_frame_rect(gif, buffer);
+    if(buffer == gif->canvas) {
+        mark_dirty(gif, gif->fx, gif->fy, gif->fw, gif->fh);
+        gif->rendered = 1;
+    }
 }
 
 void
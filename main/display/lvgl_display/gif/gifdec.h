@@ -44,8 +44,15 @@ typedef struct _gd_GIF {
     void (*comment)(struct _gd_GIF * gif);
     void (*application)(struct _gd_GIF * gif, char id[8], char auth[3]);
     uint16_t fx, fy, fw, fh;
+    /* Canvas area changed since the last gd_take_dirty_area(), empty when dw or dh is 0 */
+    uint16_t dx, dy, dw, dh;
+    /* The current frame rect is already on the canvas, disposal need not draw it again */
+    uint8_t rendered;
     uint8_t bgindex;
     uint8_t * canvas, * frame;
+    /* Palette expanded to canvas pixels, rebuilt when the palette changes */
+    uint32_t palette_argb[0x100];
+    gd_Palette * palette_argb_src;
 #if LV_GIF_CACHE_DECODE_DATA
     uint8_t *lzw_cache;
 #endif
@@ -58,6 +65,11 @@ gd_GIF * gd_open_gif_data(const void * data);
 void gd_render_frame(gd_GIF * gif, uint8_t * buffer);
 
 int gd_get_frame(gd_GIF * gif);
+/* Return 1 and the canvas area changed since the previous call, 0 if nothing changed */
+int gd_take_dirty_area(gd_GIF * gif, lv_area_t * area);
+/* Return at most the canvas pixels the frames of one loop after the first change, summed
+ * over the frames, without decoding them; -1 on a parse error */
+int64_t gd_loop_dirty_pixels(gd_GIF * gif);
 void gd_rewind(gd_GIF * gif);
 void gd_close_gif(gd_GIF * gif);
 
@@ -1,12 +1,23 @@
 #include "lvgl_gif.h"
 #include <esp_log.h>
+#include <esp_heap_caps.h>
 #include <cstring>
 
 #define TAG "LvglGif"
 
+// Copies the rows of an area between buffers of different strides
+static void CopyRows(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride, size_t row_bytes,
+                     int32_t rows) {
+    for (int32_t y = 0; y < rows; y++) {
+        memcpy(dst + y * dst_stride, src + y * src_stride, row_bytes);
+    }
+}
+
 LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
     : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false),
-      loop_delay_ms_(0), loop_waiting_(false), loop_wait_start_(0) {
+      loop_delay_ms_(0), loop_waiting_(false), loop_wait_start_(0), frame_cache_pixels_(nullptr),
+      frame_cache_size_(0), frame_cache_used_(0), caching_(false), replaying_(false), replay_index_(0),
+      replay_loop_count_(-1) {
     if (!img_dsc || !img_dsc->data) {
         ESP_LOGE(TAG, "Invalid image descriptor");
         return;
@@ -34,6 +45,20 @@ LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
         gd_render_frame(gif_, gif_->canvas);
     }
 
+#ifdef CONFIG_GIF_FRAME_CACHE_SIZE_KB
+    // Size the cache from the frame rects before anything is decoded or allocated for it
+    const size_t budget = CONFIG_GIF_FRAME_CACHE_SIZE_KB * 1024;
+    int64_t dirty_pixels = budget > 0 ? gd_loop_dirty_pixels(gif_) : -1;
+    uint64_t cache_bytes = img_dsc_.data_size + dirty_pixels * 4;
+    if (dirty_pixels >= 0 && cache_bytes <= budget) {
+        frame_cache_size_ = cache_bytes;
+    } else if (dirty_pixels >= 0) {
+        ESP_LOGI(TAG, "GIF loop needs up to %u KB, over %u KB, not caching frames",
+                 (unsigned)(cache_bytes / 1024), (unsigned)(budget / 1024));
+    }
+#endif
+    caching_ = frame_cache_size_ > 0;
+
     loaded_ = true;
     ESP_LOGD(TAG, "GIF loaded from image descriptor: %dx%d", gif_->width, gif_->height);
 }
@@ -109,6 +134,18 @@ void LvglGif::Stop() {
     // Reset loop waiting state
     loop_waiting_ = false;
 
+    if (replaying_) {
+        // The cache holds every frame, start over from the first one without decoding
+        gif_->loop_count = replay_loop_count_;
+        replay_index_ = 0;
+        memcpy(gif_->canvas, frame_cache_pixels_, img_dsc_.data_size);
+        ESP_LOGD(TAG, "GIF animation stopped and rewound");
+        return;
+    }
+    // A partly collected loop cannot be resumed after rewinding
+    DropFrameCache();
+    caching_ = frame_cache_size_ > 0;
+
     if (gif_) {
         gd_rewind(gif_);
         // Render first frame without advancing
@@ -165,10 +202,34 @@ uint16_t LvglGif::height() const {
     return gif_->height;
 }
 
-void LvglGif::SetFrameCallback(std::function<void()> callback) {
+void LvglGif::SetFrameCallback(std::function<void(const lv_area_t& area)> callback) {
     frame_callback_ = callback;
 }
 
+void LvglGif::InvalidateArea(lv_obj_t* image, const lv_area_t& area) const {
+    // The canvas is drawn through the image cache, drop the stale entry
+    lv_image_cache_drop(&img_dsc_);
+
+    if (lv_image_get_scale_x(image) != LV_SCALE_NONE || lv_image_get_scale_y(image) != LV_SCALE_NONE ||
+        lv_image_get_rotation(image) != 0 || lv_image_get_inner_align(image) != LV_IMAGE_ALIGN_CENTER) {
+        lv_obj_invalidate(image);
+        return;
+    }
+
+    // Centered in the content area, like LVGL draws it
+    lv_area_t content;
+    lv_obj_get_content_coords(image, &content);
+    int32_t x = content.x1 + (lv_area_get_width(&content) - img_dsc_.header.w) / 2 + lv_image_get_offset_x(image);
+    int32_t y = content.y1 + (lv_area_get_height(&content) - img_dsc_.header.h) / 2 + lv_image_get_offset_y(image);
+    lv_area_t dirty = {
+        .x1 = x + area.x1,
+        .y1 = y + area.y1,
+        .x2 = x + area.x2,
+        .y2 = y + area.y2,
+    };
+    lv_obj_invalidate_area(image, &dirty);
+}
+
 void LvglGif::NextFrame() {
     if (!loaded_ || !gif_ || !playing_) {
         return;
@@ -186,6 +247,11 @@ void LvglGif::NextFrame() {
         ESP_LOGD(TAG, "Loop delay completed, continuing GIF");
     }
 
+    if (replaying_) {
+        ReplayNextFrame();
+        return;
+    }
+
     // Check if enough time has passed for the next frame
     uint32_t elapsed = lv_tick_elaps(last_call_);
     if (elapsed < gif_->gce.delay * 10) {
@@ -199,6 +265,11 @@ void LvglGif::NextFrame() {
 
     // Get next frame
     int has_next = gd_get_frame(gif_);
+    if (has_next <= 0) {
+        // Not a looping GIF or a broken one, nothing to replay
+        DropFrameCache();
+        caching_ = false;
+    }
     if (has_next == 0) {
         // Animation truly finished (non-infinite loop)
         playing_ = false;
@@ -210,25 +281,175 @@ void LvglGif::NextFrame() {
     }
 
     // Detect loop by checking if file position jumped back (rewound to start)
-    // This works for looping GIFs regardless of when loop_count is set
-    if (loop_delay_ms_ > 0 && gif_->f_rw_p < pos_before) {
+    // This works for looping GIFs regardless of when loop_count is set; a single frame GIF
+    // reads its only frame up to the same position again
+    bool looped = gif_->f_rw_p <= pos_before;
+    if (looped && caching_ && !frame_cache_.empty()) {
+        // Over the end of a loop the first frame may compose differently than over the initial canvas
+        gd_render_frame(gif_, gif_->canvas);
+        if (memcmp(gif_->canvas, frame_cache_pixels_, img_dsc_.data_size) == 0) {
+            // Every later loop repeats the cached one, the cached frames carry their own areas
+            lv_area_t area;
+            bool dirty = gd_take_dirty_area(gif_, &area);
+            StartReplay(dirty ? &area : nullptr);
+            if (loop_delay_ms_ > 0) {
+                loop_waiting_ = true;
+                loop_wait_start_ = lv_tick_get();
+                ESP_LOGD(TAG, "GIF completed one cycle, waiting %lu ms before next loop", loop_delay_ms_);
+                return;
+            }
+            ShowCachedFrame(0);
+            return;
+        }
+        // This loop is the one that repeats, collect it instead
+        DropFrameCache();
+    }
+    if (caching_ && frame_cache_.empty()) {
+        if (!looped && pos_before != (uint32_t)gif_->anim_start) {
+            // Started in the middle of a loop, the cache would miss its first frames
+            caching_ = false;
+        } else {
+            // The NETSCAPE extension before the first frame has set the loop count now
+            replay_loop_count_ = gif_->loop_count;
+        }
+    }
+
+    if (loop_delay_ms_ > 0 && looped) {
         // File position decreased, meaning GIF looped back to beginning
         // Start waiting before rendering this frame
         loop_waiting_ = true;
         loop_wait_start_ = lv_tick_get();
         ESP_LOGD(TAG, "GIF completed one cycle, waiting %lu ms before next loop", loop_delay_ms_);
+        if (caching_ && frame_cache_.empty()) {
+            // Still collect the first frame, its area is reported with the next one
+            gd_render_frame(gif_, gif_->canvas);
+            CacheFrame(nullptr);
+        }
         return;
     }
 
     // Render current frame
     if (gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
-        
-        // Call frame callback if set
-        if (frame_callback_) {
-            frame_callback_();
+
+        // Report only the pixels that changed, a still frame costs no redraw
+        lv_area_t area;
+        bool dirty = gd_take_dirty_area(gif_, &area);
+        if (caching_) {
+            CacheFrame(dirty ? &area : nullptr);
+        }
+        if (dirty && frame_callback_) {
+            frame_callback_(area);
+        }
+    }
+}
+
+void LvglGif::CacheFrame(const lv_area_t* area) {
+    if (frame_cache_pixels_ == nullptr) {
+        frame_cache_pixels_ = static_cast<uint8_t*>(heap_caps_malloc(frame_cache_size_, MALLOC_CAP_SPIRAM));
+        if (frame_cache_pixels_ == nullptr) {
+            ESP_LOGW(TAG, "Failed to allocate %u KB of GIF frame cache", (unsigned)(frame_cache_size_ / 1024));
+            caching_ = false;
+            return;
+        }
+    }
+
+    CachedFrame frame = {.offset = frame_cache_used_, .delay = gif_->gce.delay, .area = {0, 0, -1, -1}};
+    const size_t stride = img_dsc_.header.stride;
+    if (frame_cache_.empty()) {
+        // Kept whole, the loop check and Stop() need the full canvas
+        memcpy(frame_cache_pixels_, gif_->canvas, img_dsc_.data_size);
+        frame_cache_used_ = img_dsc_.data_size;
+    } else if (area != nullptr) {
+        size_t row_bytes = lv_area_get_width(area) * 4;
+        size_t bytes = row_bytes * lv_area_get_height(area);
+        if (frame_cache_used_ + bytes > frame_cache_size_) {
+            // The frame rects bound every area, this GIF does not play the way it was scanned
+            ESP_LOGW(TAG, "GIF frame changed more than its rects, not caching frames");
+            DropFrameCache();
+            caching_ = false;
+            return;
+        }
+        frame.area = *area;
+        CopyRows(frame_cache_pixels_ + frame_cache_used_, row_bytes, gif_->canvas + area->y1 * stride + area->x1 * 4,
+                 stride, row_bytes, lv_area_get_height(area));
+        frame_cache_used_ += bytes;
+    }
+    frame_cache_.push_back(frame);
+}
+
+void LvglGif::StartReplay(const lv_area_t* first_area) {
+    // The first frame was cached against the initial canvas, replay follows the last frame
+    frame_cache_[0].area = first_area != nullptr ? *first_area : lv_area_t{0, 0, -1, -1};
+    caching_ = false;
+    replaying_ = true;
+    replay_index_ = kBeforeFirstFrame;
+    ESP_LOGI(TAG, "Cached %u GIF frames, %u KB", (unsigned)frame_cache_.size(),
+             (unsigned)(frame_cache_used_ / 1024));
+}
+
+void LvglGif::ReplayNextFrame() {
+    uint32_t delay = replay_index_ == kBeforeFirstFrame ? 0 : frame_cache_[replay_index_].delay;
+    if (lv_tick_elaps(last_call_) < delay * 10) {
+        return;
+    }
+    last_call_ = lv_tick_get();
+
+    size_t next = replay_index_ == kBeforeFirstFrame ? 0 : replay_index_ + 1;
+    if (next == frame_cache_.size()) {
+        // Same loop accounting as gd_get_frame()
+        if (gif_->loop_count == 1 || gif_->loop_count < 0) {
+            playing_ = false;
+            if (timer_) {
+                lv_timer_pause(timer_);
+            }
+            ESP_LOGD(TAG, "GIF animation completed");
+            return;
+        }
+        if (gif_->loop_count > 1) {
+            gif_->loop_count--;
         }
+        if (loop_delay_ms_ > 0) {
+            replay_index_ = kBeforeFirstFrame;
+            loop_waiting_ = true;
+            loop_wait_start_ = lv_tick_get();
+            ESP_LOGD(TAG, "GIF completed one cycle, waiting %lu ms before next loop", loop_delay_ms_);
+            return;
+        }
+        next = 0;
+    }
+    ShowCachedFrame(next);
+}
+
+void LvglGif::ShowCachedFrame(size_t index) {
+    const CachedFrame& frame = frame_cache_[index];
+    replay_index_ = index;
+    if (frame.area.x2 < frame.area.x1) {
+        return;
+    }
+
+    // Only the area changed from the previous frame is written back to the canvas
+    const size_t stride = img_dsc_.header.stride;
+    const size_t canvas_offset = frame.area.y1 * stride + frame.area.x1 * 4;
+    const size_t row_bytes = lv_area_get_width(&frame.area) * 4;
+    if (index == 0) {
+        CopyRows(gif_->canvas + canvas_offset, stride, frame_cache_pixels_ + canvas_offset, stride, row_bytes,
+                 lv_area_get_height(&frame.area));
+    } else {
+        CopyRows(gif_->canvas + canvas_offset, stride, frame_cache_pixels_ + frame.offset, row_bytes, row_bytes,
+                 lv_area_get_height(&frame.area));
     }
+    if (frame_callback_) {
+        frame_callback_(frame.area);
+    }
+}
+
+void LvglGif::DropFrameCache() {
+    replaying_ = false;
+    heap_caps_free(frame_cache_pixels_);
+    frame_cache_pixels_ = nullptr;
+    frame_cache_used_ = 0;
+    frame_cache_.clear();
 }
 
 void LvglGif::Cleanup() {
@@ -238,6 +459,8 @@ void LvglGif::Cleanup() {
         timer_ = nullptr;
     }
 
+    DropFrameCache();
+
     // Close GIF decoder
     if (gif_) {
         gd_close_gif(gif_);
@@ -3,12 +3,18 @@
 #include "../lvgl_image.h"
 #include "gifdec.h"
 #include <lvgl.h>
+#include <cstdint>
 #include <memory>
 #include <functional>
+#include <vector>
 
 /**
  * C++ implementation of LVGL GIF widget
  * Provides GIF animation functionality using gifdec library
+ *
+ * With CONFIG_GIF_FRAME_CACHE_SIZE_KB, the first loop of a looping GIF is kept in PSRAM,
+ * its first frame whole and every later frame as the canvas area it changed, and later
+ * loops replay them onto the canvas without decoding.
  */
 class LvglGif {
 public:
@@ -77,8 +83,15 @@ public:
 
     /**
      * Set frame update callback
+     * @param callback Receives the canvas area the new frame changed, in image coordinates
      */
-    void SetFrameCallback(std::function<void()> callback);
+    void SetFrameCallback(std::function<void(const lv_area_t& area)> callback);
+
+    /**
+     * Redraw only the part of an image object showing this GIF that the frame changed.
+     * Falls back to the whole object when the image is scaled, rotated or not centered.
+     */
+    void InvalidateArea(lv_obj_t* image, const lv_area_t& area) const;
 
 private:
     // GIF decoder instance
@@ -103,13 +116,38 @@ private:
     uint32_t loop_wait_start_;    // Timestamp when loop wait started
     
     // Frame update callback
-    std::function<void()> frame_callback_;
+    std::function<void(const lv_area_t& area)> frame_callback_;
+
+    // Frame cache of the first loop
+    struct CachedFrame {
+        size_t offset;                // Of the area pixels in frame_cache_pixels_, unused by the first frame
+        uint16_t delay;               // In 10 ms units, like gd_GCE
+        lv_area_t area;               // Changed from the previous frame, x2 < x1 when nothing changed
+    };
+    static constexpr size_t kBeforeFirstFrame = SIZE_MAX;
+    std::vector<CachedFrame> frame_cache_;
+    uint8_t* frame_cache_pixels_;     // The first frame canvas, then the area pixels of every later frame
+    size_t frame_cache_size_;         // Bytes one loop needs at most, 0 when it is not cached
+    size_t frame_cache_used_;
+    bool caching_;                    // Collecting the frames of the first loop
+    bool replaying_;                  // Later loops come from frame_cache_
+    size_t replay_index_;             // Cached frame shown, kBeforeFirstFrame while waiting to loop
+    int32_t replay_loop_count_;       // Loop count when the first loop started, restored by Stop()
     
     /**
      * Update to next frame
      */
     void NextFrame();
     
+    /**
+     * Frame cache helpers
+     */
+    void CacheFrame(const lv_area_t* area);
+    void StartReplay(const lv_area_t* first_area);
+    void ReplayNextFrame();
+    void ShowCachedFrame(size_t index);
+    void DropFrameCache();
+
     /**
      * Cleanup resources
      */
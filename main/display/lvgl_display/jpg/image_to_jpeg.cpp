@@ -424,6 +424,163 @@ static bool encode_with_esp_new_jpeg(const uint8_t* src, size_t src_len, uint16_
     return true;
 }
 
+// 按条带编码：每次只转换并编码一个 MCU 行，输入转换缓冲区和输出缓冲区都只有一个条带大小
+static bool encode_stripes_with_esp_new_jpeg(const uint8_t* src, uint16_t width, uint16_t height, size_t stride,
+                                             v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void* cb_arg) {
+    if (quality < 1)
+        quality = 1;
+    if (quality > 100)
+        quality = 100;
+
+    jpeg_pixel_format_t enc_src_type = JPEG_PIXEL_FORMAT_YCbYCr;
+    esp_imgfx_pixel_fmt_t in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
+    bool needs_convert = true;
+    size_t src_bpp = 2;
+    switch (format) {
+        case V4L2_PIX_FMT_GREY:
+            enc_src_type = JPEG_PIXEL_FORMAT_GRAY;
+            needs_convert = false;
+            src_bpp = 1;
+            break;
+        case V4L2_PIX_FMT_YUYV:
+            needs_convert = false;
+            break;
+        case V4L2_PIX_FMT_RGB565:
+            in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_LE;
+            break;
+        case V4L2_PIX_FMT_RGB565X:
+            // 字节交换由颜色转换完成，无需单独交换一遍
+            in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB565_BE;
+            break;
+        case V4L2_PIX_FMT_RGB24:
+            in_pixel_fmt = ESP_IMGFX_PIXEL_FMT_RGB888;
+            src_bpp = 3;
+            break;
+        default:
+            ESP_LOGE(TAG, "stripe encoder: unsupported format: 0x%08lx", format);
+            return false;
+    }
+    const size_t src_row_bytes = (size_t)width * src_bpp;
+    const size_t enc_row_bytes = (size_t)width * (enc_src_type == JPEG_PIXEL_FORMAT_GRAY ? 1 : 2);
+    if (stride < src_row_bytes) {
+        ESP_LOGE(TAG, "stripe encoder: stride %u < row %u", (unsigned)stride, (unsigned)src_row_bytes);
+        return false;
+    }
+
+    jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
+    cfg.width = width;
+    cfg.height = height;
+    cfg.src_type = enc_src_type;
+    cfg.subsampling = (enc_src_type == JPEG_PIXEL_FORMAT_GRAY) ? JPEG_SUBSAMPLE_GRAY : JPEG_SUBSAMPLE_420;
+    cfg.quality = quality;
+    cfg.rotate = JPEG_ROTATE_0D;
+    cfg.task_enable = false;
+
+    jpeg_enc_handle_t h = NULL;
+    jpeg_error_t ret = jpeg_enc_open(&cfg, &h);
+    if (ret != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
+        return false;
+    }
+    const int block_size = jpeg_enc_get_block_size(h);
+    if (block_size <= 0 || block_size % enc_row_bytes != 0) {
+        ESP_LOGE(TAG, "stripe encoder: unexpected block size %d", block_size);
+        jpeg_enc_close(h);
+        return false;
+    }
+    const int stripe_rows = block_size / (int)enc_row_bytes;
+
+    // 条带输出上限：未压缩大小再加上文件头
+    const size_t out_cap = (size_t)block_size + 2048;
+    uint8_t* enc_in = (uint8_t*)jpeg_calloc_align(block_size, 16);
+    uint8_t* outbuf = (uint8_t*)malloc_psram(out_cap);
+    // 末尾不完整的条带和带 stride 的输入需要先拼成连续的条带
+    const bool needs_staging = needs_convert && (stride != src_row_bytes || height % stripe_rows != 0);
+    uint8_t* staging = needs_staging ? (uint8_t*)malloc_psram(src_row_bytes * stripe_rows) : NULL;
+    esp_imgfx_color_convert_handle_t convert_handle = nullptr;
+    bool ok = enc_in != NULL && outbuf != NULL && (!needs_staging || staging != NULL);
+    if (!ok) {
+        ESP_LOGE(TAG, "stripe encoder: alloc buffers failed");
+    } else if (needs_convert) {
+        esp_imgfx_color_convert_cfg_t convert_cfg = {
+            .in_res = {.width = static_cast<int16_t>(width), .height = static_cast<int16_t>(stripe_rows)},
+            .in_pixel_fmt = in_pixel_fmt,
+            .out_pixel_fmt = ESP_IMGFX_PIXEL_FMT_YUYV,
+            .color_space_std = ESP_IMGFX_COLOR_SPACE_STD_BT601,
+        };
+        ok = esp_imgfx_color_convert_open(&convert_cfg, &convert_handle) == ESP_IMGFX_ERR_OK && convert_handle != nullptr;
+        if (!ok) {
+            ESP_LOGE(TAG, "esp_imgfx_color_convert_open failed");
+        }
+    }
+
+    size_t offset = 0;
+    for (int row = 0; ok && row < height; row += stripe_rows) {
+        const int rows = (height - row < stripe_rows) ? (height - row) : stripe_rows;
+        const uint8_t* s = src + (size_t)row * stride;
+        if (needs_convert) {
+            const uint8_t* in = s;
+            if (stride != src_row_bytes || rows < stripe_rows) {
+                // 末尾条带用最后一行补齐，超出图像高度的部分不会出现在 JPEG 中
+                for (int r = 0; r < stripe_rows; r++) {
+                    const int src_row = r < rows ? r : rows - 1;
+                    memcpy(staging + (size_t)r * src_row_bytes, s + (size_t)src_row * stride, src_row_bytes);
+                }
+                in = staging;
+            }
+            esp_imgfx_data_t convert_input_data = {
+                .data = const_cast<uint8_t*>(in),
+                .data_len = static_cast<uint32_t>(src_row_bytes * stripe_rows),
+            };
+            esp_imgfx_data_t convert_output_data = {
+                .data = enc_in,
+                .data_len = static_cast<uint32_t>(block_size),
+            };
+            if (esp_imgfx_color_convert_process(convert_handle, &convert_input_data, &convert_output_data) !=
+                ESP_IMGFX_ERR_OK) {
+                ESP_LOGE(TAG, "esp_imgfx_color_convert_process failed");
+                ok = false;
+                break;
+            }
+        } else {
+            for (int r = 0; r < stripe_rows; r++) {
+                const int src_row = r < rows ? r : rows - 1;
+                memcpy(enc_in + (size_t)r * enc_row_bytes, s + (size_t)src_row * stride, enc_row_bytes);
+            }
+        }
+
+        int out_len = 0;
+        ret = jpeg_enc_process_with_block(h, enc_in, block_size, outbuf, (int)out_cap, &out_len);
+        if (ret < JPEG_ERR_OK) {
+            ESP_LOGE(TAG, "jpeg_enc_process_with_block failed: %d", (int)ret);
+            ok = false;
+            break;
+        }
+        if (out_len > 0) {
+            if (cb(cb_arg, offset, outbuf, (size_t)out_len) != (size_t)out_len) {
+                ESP_LOGW(TAG, "stripe encoder: output aborted at %u bytes", (unsigned)offset);
+                ok = false;
+                break;
+            }
+            offset += out_len;
+        }
+    }
+    if (ok) {
+        cb(cb_arg, offset, NULL, 0);  // 结束信号
+    }
+
+    if (convert_handle != nullptr) {
+        esp_imgfx_color_convert_close(convert_handle);
+    }
+    jpeg_enc_close(h);
+    free(staging);
+    free(outbuf);
+    if (enc_in != NULL) {
+        jpeg_free_align(enc_in);
+    }
+    return ok;
+}
+
 bool image_to_jpeg(uint8_t* src, size_t src_len, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
                    uint8_t quality, uint8_t** out, size_t* out_len) {
 #ifdef CONFIG_XIAOZHI_CAMERA_ALLOW_JPEG_INPUT
@@ -465,3 +622,8 @@ bool image_to_jpeg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t hei
 #endif
     return encode_with_esp_new_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg);
 }
+
+bool image_to_jpeg_stream(const uint8_t* src, uint16_t width, uint16_t height, size_t stride, v4l2_pix_fmt_t format,
+                          uint8_t quality, jpg_out_cb cb, void* arg) {
+    return encode_stripes_with_esp_new_jpeg(src, width, height, stride, format, quality, cb, arg);
+}
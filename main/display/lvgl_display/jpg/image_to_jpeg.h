@@ -77,6 +77,30 @@ extern "C"
     bool image_to_jpeg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height,
                           v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void *arg);
 
+    /**
+     * @brief 按条带将图像流式编码为JPEG
+     *
+     * 每次只转换并编码一个 MCU 行（4:2:0 为 16 行），编码结果立即交给回调：
+     * - 不分配整帧的转换缓冲区和输出缓冲区，内存占用只有几个条带
+     * - RGB565X（大端）输入的字节交换在颜色转换中完成
+     * - 回调的 index 为数据块在 JPEG 中的偏移，结束时以 data 为 NULL 调用一次
+     * - 回调返回值小于 len 时停止编码并返回 false（例如上传失败）
+     * - 始终使用软件编码器，支持 GREY、YUYV、RGB565、RGB565X、RGB24
+     *
+     * @param src       源图像数据
+     * @param width     图像宽度
+     * @param height    图像高度
+     * @param stride    源图像每行字节数
+     * @param format    图像格式
+     * @param quality   JPEG质量 (1-100)
+     * @param cb        输出回调函数
+     * @param arg       传递给回调函数的用户参数
+     *
+     * @return true 成功, false 失败
+     */
+    bool image_to_jpeg_stream(const uint8_t *src, uint16_t width, uint16_t height, size_t stride,
+                              v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void *arg);
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,10 +6,12 @@
 #include <string>
 
 #include "application.h"
+#include "assets.h"
 #include "assets/lang_config.h"
 #include "audio_codec.h"
 #include "board.h"
 #include "dynamic_glyph_cache.h"
+#include "persistent_glyph_store.h"
 #include "jpg/image_to_jpeg.h"
 #include "lvgl_display.h"
 #include "lvgl_theme.h"
@@ -19,6 +21,7 @@
 
 LvglDisplay::LvglDisplay() {
     dynamic_glyph_cache_ = std::make_unique<DynamicGlyphCache>();
+    glyph_store_ = std::make_unique<PersistentGlyphStore>();
     // Notification timer
     esp_timer_create_args_t notification_timer_args = {
         .callback =
@@ -83,6 +86,9 @@ bool LvglDisplay::AddTextGlyphs(const std::vector<TextGlyph>& glyphs, uint8_t bp
         if (!TextGlyphStorageUsesPsram()) {
             ClearTextGlyphs();
         }
+        // The server leaves out glyphs that are stored, they still have to be found
+        DisplayLockGuard lock(this);
+        UpdateTextGlyphFallback(Assets::GetInstance().text_font_capability().bpp);
         return false;
     }
     if (bpp != 1 && bpp != 4) {
@@ -90,17 +96,69 @@ bool LvglDisplay::AddTextGlyphs(const std::vector<TextGlyph>& glyphs, uint8_t bp
     }
 
     DisplayLockGuard lock(this);
+    if (!UpdateTextGlyphFallback(bpp)) {
+        return false;
+    }
+    bool changed = dynamic_glyph_cache_->AddGlyphs(glyphs);
+    // Written to flash by PersistTextGlyphs() after the turn
+    glyph_store_->Queue(glyphs);
+    return changed;
+}
+
+bool LvglDisplay::UpdateTextGlyphFallback(uint8_t bpp) {
     auto theme = dynamic_cast<LvglTheme*>(current_theme_);
     if (theme == nullptr || theme->text_font() == nullptr) {
         return false;
     }
-
-    auto fallback = dynamic_glyph_cache_->EnsureFont(theme->text_font()->font(), bpp);
+    auto base_font = theme->text_font()->font();
+    auto fallback = dynamic_glyph_cache_->EnsureFont(base_font, bpp);
     if (fallback == nullptr) {
         return false;
     }
+    // Text font -> glyphs cached in RAM -> glyphs stored in flash
+    auto& assets = Assets::GetInstance();
+    const lv_font_t* stored = nullptr;
+    if (glyph_store_->Open(assets.text_font_capability())) {
+        stored = glyph_store_->EnsureFont(base_font);
+        if (!glyph_store_unmap_hooked_) {
+            glyph_store_unmap_hooked_ = true;
+            // Stored bitmaps are read through the assets mapping, e.g. Download() unmaps it
+            assets.OnUnmapPartition([this]() {
+                DisplayLockGuard lock(this);
+                dynamic_glyph_cache_->SetFallback(nullptr);
+                glyph_store_->Close();
+            });
+        }
+    }
+    dynamic_glyph_cache_->SetFallback(stored);
     theme->text_font()->SetFallback(fallback);
-    return dynamic_glyph_cache_->AddGlyphs(glyphs);
+    return true;
+}
+
+void LvglDisplay::PersistTextGlyphs() {
+    if (persist_task_ != nullptr || !glyph_store_->HasPending()) {
+        return;
+    }
+    // Low priority: erasing and programming flash must not hold up audio or the UI
+    xTaskCreate(
+        [](void* arg) {
+            LvglDisplay* display = static_cast<LvglDisplay*>(arg);
+            bool more = true;
+            while (more) {
+                more = display->glyph_store_->WritePending();
+                DisplayLockGuard lock(display);
+                if (display->glyph_store_->Commit()) {
+                    display->UpdateTextGlyphFallback(Assets::GetInstance().text_font_capability().bpp);
+                }
+            }
+            display->persist_task_ = nullptr;
+            vTaskDelete(NULL);
+        },
+        "glyph_store", 4096, this, 1, &persist_task_);
+}
+
+std::vector<uint32_t> LvglDisplay::GetStoredTextGlyphs(size_t max_count) {
+    return glyph_store_->Snapshot(Assets::GetInstance().text_font_capability(), max_count);
 }
 
 void LvglDisplay::ClearTextGlyphs() {
@@ -312,47 +370,52 @@ void LvglDisplay::SetPowerSaveMode(bool on) {
     }
 }
 
-bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
+bool LvglDisplay::SnapshotToJpeg(const std::function<bool(const void* data, size_t len)>& write, int quality) {
 #if CONFIG_LV_USE_SNAPSHOT
-    DisplayLockGuard lock(this);
-
-    lv_obj_t* screen = lv_screen_active();
-    lv_draw_buf_t* draw_buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
+    lv_draw_buf_t* draw_buffer = nullptr;
+    {
+        DisplayLockGuard lock(this);
+        draw_buffer = lv_snapshot_take(lv_screen_active(), LV_COLOR_FORMAT_RGB565);
+    }
     if (draw_buffer == nullptr) {
         ESP_LOGE(TAG, "Failed to take snapshot, draw_buffer is nullptr");
         return false;
     }
 
-    // swap bytes
-    uint16_t* data = (uint16_t*)draw_buffer->data;
-    size_t pixel_count = draw_buffer->data_size / 2;
-    for (size_t i = 0; i < pixel_count; i++) {
-        data[i] = __builtin_bswap16(data[i]);
-    }
-
-    // Clear output string and use callback version to avoid pre-allocating large memory blocks
-    jpeg_data.clear();
-
-    // Use callback-based JPEG encoder to further save memory
-    bool ret =
-        image_to_jpeg_cb((uint8_t*)draw_buffer->data, draw_buffer->data_size, draw_buffer->header.w,
-                         draw_buffer->header.h, V4L2_PIX_FMT_RGB565, quality,
-                         [](void* arg, size_t index, const void* data, size_t len) -> size_t {
-                             std::string* output = static_cast<std::string*>(arg);
-                             if (data && len > 0) {
-                                 output->append(static_cast<const char*>(data), len);
-                             }
-                             return len;
-                         },
-                         &jpeg_data);
-    if (!ret) {
+    // The snapshot is byte-swapped RGB565, read as big-endian by the color conversion.
+    // Encoding and writing run without the display lock, so the UI keeps going during an upload
+    int64_t start_time = esp_timer_get_time();
+    bool ret = image_to_jpeg_stream(draw_buffer->data, draw_buffer->header.w, draw_buffer->header.h,
+                                    draw_buffer->header.stride, V4L2_PIX_FMT_RGB565X, quality,
+                                    [](void* arg, size_t index, const void* data, size_t len) -> size_t {
+                                        if (data == nullptr) {
+                                            return 0;
+                                        }
+                                        auto& write = *static_cast<const std::function<bool(const void*, size_t)>*>(arg);
+                                        return write(data, len) ? len : 0;
+                                    },
+                                    const_cast<std::function<bool(const void*, size_t)>*>(&write));
+    if (ret) {
+        ESP_LOGI(TAG, "Snapshot encoded in %ld ms", (long)((esp_timer_get_time() - start_time) / 1000));
+    } else {
         ESP_LOGE(TAG, "Failed to convert image to JPEG");
     }
 
-    lv_draw_buf_destroy(draw_buffer);
+    {
+        DisplayLockGuard lock(this);
+        lv_draw_buf_destroy(draw_buffer);
+    }
     return ret;
 #else
     ESP_LOGE(TAG, "LV_USE_SNAPSHOT is not enabled");
     return false;
 #endif
 }
+
+bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
+    jpeg_data.clear();
+    return SnapshotToJpeg([&jpeg_data](const void* data, size_t len) {
+        jpeg_data.append(static_cast<const char*>(data), len);
+        return true;
+    }, quality);
+}
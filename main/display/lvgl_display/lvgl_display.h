@@ -7,13 +7,17 @@
 #include <esp_log.h>
 #include <esp_pm.h>
 #include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <lvgl.h>
 
 #include <chrono>
+#include <functional>
 #include <memory>
 #include <string>
 
 class DynamicGlyphCache;
+class PersistentGlyphStore;
 class LvglFont;
 
 class LvglDisplay : public Display {
@@ -27,9 +31,13 @@ public:
     virtual void SetPreviewImage(std::unique_ptr<LvglImage> image);
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
-    virtual bool SnapshotToJpeg(std::string& jpeg_data, int quality = 80);
+    // Streams the JPEG to `write` stripe by stripe as it is encoded; a false return aborts
+    virtual bool SnapshotToJpeg(const std::function<bool(const void* data, size_t len)>& write, int quality = 80);
+    bool SnapshotToJpeg(std::string& jpeg_data, int quality = 80);
     virtual bool AddTextGlyphs(const std::vector<TextGlyph>& glyphs, uint8_t bpp) override;
     virtual void ClearTextGlyphs() override;
+    virtual void PersistTextGlyphs() override;
+    virtual std::vector<uint32_t> GetStoredTextGlyphs(size_t max_count) override;
     bool SetTextFont(std::shared_ptr<LvglFont> text_font);
 
 protected:
@@ -51,6 +59,11 @@ protected:
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
     std::unique_ptr<DynamicGlyphCache> dynamic_glyph_cache_;
+    std::unique_ptr<PersistentGlyphStore> glyph_store_;
+    TaskHandle_t persist_task_ = nullptr;
+    bool glyph_store_unmap_hooked_ = false;
+
+    bool UpdateTextGlyphFallback(uint8_t bpp);
 
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
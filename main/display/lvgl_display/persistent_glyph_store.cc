@@ -0,0 +1,461 @@
+#include "persistent_glyph_store.h"
+#include "assets.h"
+
+#include <esp_log.h>
+#include <esp_random.h>
+#include <esp_rom_crc.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#define TAG "PersistentGlyphStore"
+
+static constexpr uint32_t kHeaderMagic = 0x53594c47;   // "GLYS"
+static constexpr uint16_t kVersion = 1;
+static constexpr uint16_t kRecordMagic = 0x4c47;
+static constexpr size_t kMaxBundleLength = 64;
+
+struct StoreHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t size;
+    uint8_t bpp;
+    uint32_t generation;
+    char bundle[kMaxBundleLength + 4];
+    uint32_t crc;               // Of the header up to here
+};
+
+struct StoreRecord {
+    uint16_t magic;
+    uint16_t bitmap_size;
+    uint32_t generation;        // Records left over from an earlier log do not match
+    uint32_t codepoint;
+    uint16_t adv_w;
+    uint8_t box_w;
+    uint8_t box_h;
+    int16_t ofs_x;
+    int16_t ofs_y;
+    uint32_t crc;               // Of the record up to here and the bitmap
+};
+
+static constexpr size_t Align4(size_t size) {
+    return (size + 3) & ~static_cast<size_t>(3);
+}
+
+static constexpr size_t kRecordsOffset = Align4(sizeof(StoreHeader));
+
+bool PersistentGlyphStore::Open(const TextFontCapability& capability) {
+    if (!capability.glyph_push || capability.bundle.size() > kMaxBundleLength || capability.size <= 0 ||
+        capability.size > UINT8_MAX || (capability.bpp != 1 && capability.bpp != 4)) {
+        return false;
+    }
+    if (!TextGlyphStorageUsesPsram()) {
+        // Queued bitmaps would stay in internal RAM after DynamicGlyphCache drops its batch
+        return false;
+    }
+    std::lock_guard<std::mutex> open_lock(open_mutex_);
+    if (is_open() && bundle_ == capability.bundle && size_ == capability.size && bpp_ == capability.bpp) {
+        return true;
+    }
+
+    auto& assets = Assets::GetInstance();
+    size_t offset = 0;
+    const char* mapped = nullptr;
+    if (!assets.GetSpareRegion(kRegionSize, offset, mapped)) {
+        ESP_LOGD(TAG, "No spare flash for the glyph store");
+        return false;
+    }
+    std::lock_guard<std::mutex> flash_lock(flash_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.clear();
+    pending_bytes_ = 0;
+    written_.clear();
+    full_ = false;
+    cleared_ = false;
+    partition_ = assets.partition();
+    mapped_ = mapped;
+    offset_ = offset;
+    sector_size_ = esp_partition_get_main_flash_sector_size();
+    bundle_ = capability.bundle;
+    size_ = static_cast<uint8_t>(capability.size);
+    bpp_ = static_cast<uint8_t>(capability.bpp);
+    Load();
+    UpdateFont();
+    ESP_LOGI(TAG, "Loaded %u glyphs, %u of %u bytes used", (unsigned)codepoints_.size(),
+             (unsigned)write_offset_, (unsigned)kRegionSize);
+    return true;
+}
+
+void PersistentGlyphStore::Load() {
+    codepoints_.clear();
+    glyph_dsc_.assign(1, lv_font_fmt_txt_glyph_dsc_t{});
+
+    StoreHeader header;
+    memcpy(&header, mapped_, sizeof(header));
+    const bool header_valid = header.magic == kHeaderMagic && header.version == kVersion &&
+                              header.crc == esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&header),
+                                                             offsetof(StoreHeader, crc));
+    header.bundle[kMaxBundleLength] = '\0';
+    if (!header_valid || header.size != size_ || header.bpp != bpp_ || bundle_ != header.bundle) {
+        Reset();
+        return;
+    }
+
+    generation_ = header.generation;
+    header_written_ = true;
+    size_t position = ScanRecords(kRecordsOffset);
+    while (position % sector_size_ != 0) {
+        // The rest of the sector being written was erased together with its start, unless a
+        // write was cut off there. Those bytes cannot be programmed again, so the log goes on
+        // in the next sector.
+        const size_t sector_end = (position + sector_size_ - 1) / sector_size_ * sector_size_;
+        if (IsErased(position, std::min(sector_end, kRegionSize))) {
+            break;
+        }
+        ESP_LOGW(TAG, "Skipping a cut off record at %u", (unsigned)position);
+        position = sector_end;
+        const size_t end = ScanRecords(position);
+        if (end == position) {
+            break;
+        }
+        position = end;
+    }
+    write_offset_ = position;
+    erased_end_ = (position + sector_size_ - 1) / sector_size_ * sector_size_;
+}
+
+size_t PersistentGlyphStore::ScanRecords(size_t position) {
+    while (position + sizeof(StoreRecord) <= kRegionSize) {
+        StoreRecord record;
+        memcpy(&record, mapped_ + position, sizeof(record));
+        const size_t total = Align4(sizeof(StoreRecord) + record.bitmap_size);
+        if (record.magic != kRecordMagic || record.generation != generation_ || position + total > kRegionSize ||
+            record.bitmap_size != (static_cast<size_t>(record.box_w) * record.box_h * bpp_ + 7) / 8) {
+            break;
+        }
+        const auto bitmap = reinterpret_cast<const uint8_t*>(mapped_ + position + sizeof(StoreRecord));
+        uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&record), offsetof(StoreRecord, crc));
+        if (esp_rom_crc32_le(crc, bitmap, record.bitmap_size) != record.crc) {
+            break;
+        }
+
+        lv_font_fmt_txt_glyph_dsc_t dsc{};
+        dsc.bitmap_index = position + sizeof(StoreRecord);
+        dsc.adv_w = record.adv_w;
+        dsc.box_w = record.box_w;
+        dsc.box_h = record.box_h;
+        dsc.ofs_x = record.ofs_x;
+        dsc.ofs_y = record.ofs_y;
+        Index(record.codepoint, dsc);
+        position += total;
+    }
+    return position;
+}
+
+bool PersistentGlyphStore::IsErased(size_t begin, size_t end) const {
+    for (size_t i = begin; i < end; ++i) {
+        if (static_cast<uint8_t>(mapped_[i]) != 0xFF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void PersistentGlyphStore::Close() {
+    std::lock_guard<std::mutex> open_lock(open_mutex_);
+    // Waits for a write in progress, none starts after this
+    std::lock_guard<std::mutex> flash_lock(flash_mutex_);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!is_open()) {
+        return;
+    }
+    mapped_ = nullptr;
+    partition_ = nullptr;
+    bundle_.clear();
+    pending_.clear();
+    pending_bytes_ = 0;
+    written_.clear();
+    full_ = false;
+    cleared_ = false;
+    codepoints_.clear();
+    glyph_dsc_.assign(1, lv_font_fmt_txt_glyph_dsc_t{});
+    UpdateFont();
+}
+
+void PersistentGlyphStore::Reset() {
+    StartOver();
+    codepoints_.clear();
+    glyph_dsc_.assign(1, lv_font_fmt_txt_glyph_dsc_t{});
+}
+
+void PersistentGlyphStore::StartOver() {
+    // A new generation, so nothing written before can be mistaken for part of the new log
+    generation_ = esp_random();
+    header_written_ = false;
+    write_offset_ = kRecordsOffset;
+    erased_end_ = 0;
+}
+
+const lv_font_t* PersistentGlyphStore::EnsureFont(const lv_font_t* base_font) {
+    if (!is_open() || base_font == nullptr || codepoints_.empty()) {
+        return nullptr;
+    }
+    font_.get_glyph_dsc = lv_font_get_glyph_dsc_fmt_txt;
+    font_.get_glyph_bitmap = lv_font_get_bitmap_fmt_txt;
+    font_.release_glyph = nullptr;
+    font_.line_height = base_font->line_height;
+    font_.base_line = base_font->base_line;
+    font_.subpx = LV_FONT_SUBPX_NONE;
+    font_.kerning = LV_FONT_KERNING_NONE;
+    font_.static_bitmap = 0;
+    font_.underline_position = base_font->underline_position;
+    font_.underline_thickness = base_font->underline_thickness;
+    font_.fallback = nullptr;
+    font_.user_data = nullptr;
+    font_.dsc = &dsc_;
+    return &font_;
+}
+
+bool PersistentGlyphStore::Contains(uint32_t codepoint) const {
+    return std::binary_search(codepoints_.begin(), codepoints_.end(), codepoint);
+}
+
+bool PersistentGlyphStore::IsQueued(uint32_t codepoint) const {
+    for (const auto& glyph : pending_) {
+        if (glyph.codepoint == codepoint) {
+            return true;
+        }
+    }
+    for (const auto& item : written_) {
+        if (item.first == codepoint) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void PersistentGlyphStore::Queue(const std::vector<TextGlyph>& glyphs) {
+    std::lock_guard<std::mutex> open_lock(open_mutex_);
+    if (!is_open()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& glyph : glyphs) {
+        if (Contains(glyph.codepoint) || IsQueued(glyph.codepoint)) {
+            continue;
+        }
+        if (pending_bytes_ + glyph.bitmap.size() > kMaxPendingBytes) {
+            break;
+        }
+        pending_bytes_ += glyph.bitmap.size();
+        pending_.push_back(glyph);
+    }
+}
+
+bool PersistentGlyphStore::HasPending() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return !pending_.empty();
+}
+
+bool PersistentGlyphStore::WritePending() {
+    std::lock_guard<std::mutex> flash_lock(flash_mutex_);
+    if (!is_open()) {
+        return false;
+    }
+    while (true) {
+        TextGlyph glyph;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (cleared_) {
+                cleared_ = false;
+                StartOver();
+            }
+            if (full_) {
+                return true;
+            }
+            if (pending_.empty()) {
+                return false;
+            }
+            glyph = std::move(pending_.front());
+            pending_.pop_front();
+            pending_bytes_ -= glyph.bitmap.size();
+            const size_t total = Align4(sizeof(StoreRecord) + glyph.bitmap.size());
+            if (glyph.bitmap.size() > UINT16_MAX || kRecordsOffset + total > kRegionSize) {
+                continue;
+            }
+            if (write_offset_ + total > kRegionSize) {
+                // The font must stop using the old log before its sectors are erased
+                ESP_LOGI(TAG, "Glyph store is full, starting over");
+                pending_bytes_ += glyph.bitmap.size();
+                pending_.push_front(std::move(glyph));
+                full_ = true;
+                return true;
+            }
+        }
+
+        lv_font_fmt_txt_glyph_dsc_t dsc{};
+        if (!Append(glyph, dsc)) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(mutex_);
+        written_.emplace_back(glyph.codepoint, dsc);
+    }
+}
+
+bool PersistentGlyphStore::Commit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (full_) {
+        full_ = false;
+        cleared_ = true;
+        written_.clear();
+        codepoints_.clear();
+        glyph_dsc_.assign(1, lv_font_fmt_txt_glyph_dsc_t{});
+        UpdateFont();
+        return true;
+    }
+    if (written_.empty()) {
+        return false;
+    }
+    for (const auto& item : written_) {
+        Index(item.first, item.second);
+    }
+    ESP_LOGI(TAG, "Stored %u glyphs, %u in total", (unsigned)written_.size(), (unsigned)codepoints_.size());
+    written_.clear();
+    UpdateFont();
+    return true;
+}
+
+std::vector<uint32_t> PersistentGlyphStore::Snapshot(const TextFontCapability& capability, size_t max_count) {
+    {
+        std::lock_guard<std::mutex> open_lock(open_mutex_);
+        if (is_open() && (bundle_ != capability.bundle || size_ != capability.size || bpp_ != capability.bpp)) {
+            // Reloading for another font changes what is rendered, that needs the display lock
+            return {};
+        }
+    }
+    // Not open yet: nothing renders from the store, so it can be loaded here
+    if (!Open(capability)) {
+        return {};
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    const size_t count = std::min(max_count, codepoints_.size());
+    return std::vector<uint32_t>(codepoints_.begin(), codepoints_.begin() + count);
+}
+
+bool PersistentGlyphStore::Append(const TextGlyph& glyph, lv_font_fmt_txt_glyph_dsc_t& dsc) {
+    const size_t total = Align4(sizeof(StoreRecord) + glyph.bitmap.size());
+    if (!EraseUntil(write_offset_ + total)) {
+        return false;
+    }
+
+    if (!header_written_) {
+        StoreHeader header{};
+        header.magic = kHeaderMagic;
+        header.version = kVersion;
+        header.size = size_;
+        header.bpp = bpp_;
+        header.generation = generation_;
+        strncpy(header.bundle, bundle_.c_str(), kMaxBundleLength);
+        header.crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&header), offsetof(StoreHeader, crc));
+        esp_err_t err = esp_partition_write(partition_, offset_, &header, sizeof(header));
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write header: %s", esp_err_to_name(err));
+            return false;
+        }
+        header_written_ = true;
+    }
+
+    StoreRecord record{};
+    record.magic = kRecordMagic;
+    record.bitmap_size = static_cast<uint16_t>(glyph.bitmap.size());
+    record.generation = generation_;
+    record.codepoint = glyph.codepoint;
+    record.adv_w = static_cast<uint16_t>(glyph.adv_w);
+    record.box_w = static_cast<uint8_t>(glyph.box_w);
+    record.box_h = static_cast<uint8_t>(glyph.box_h);
+    record.ofs_x = glyph.ofs_x;
+    record.ofs_y = glyph.ofs_y;
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&record), offsetof(StoreRecord, crc));
+    record.crc = esp_rom_crc32_le(crc, glyph.bitmap.data(), glyph.bitmap.size());
+
+    // One write for the record and its bitmap, padding stays erased
+    TextGlyphVector<uint8_t> buffer(total, 0xFF);
+    memcpy(buffer.data(), &record, sizeof(record));
+    std::copy(glyph.bitmap.begin(), glyph.bitmap.end(), buffer.begin() + sizeof(record));
+    esp_err_t err = esp_partition_write(partition_, offset_ + write_offset_, buffer.data(), buffer.size());
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write glyph U+%04lX: %s", static_cast<unsigned long>(glyph.codepoint),
+                 esp_err_to_name(err));
+        return false;
+    }
+
+    dsc.bitmap_index = write_offset_ + sizeof(StoreRecord);
+    dsc.adv_w = record.adv_w;
+    dsc.box_w = record.box_w;
+    dsc.box_h = record.box_h;
+    dsc.ofs_x = record.ofs_x;
+    dsc.ofs_y = record.ofs_y;
+    write_offset_ += total;
+    return true;
+}
+
+bool PersistentGlyphStore::EraseUntil(size_t end) {
+    while (erased_end_ < end) {
+        esp_err_t err = esp_partition_erase_range(partition_, offset_ + erased_end_, sector_size_);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to erase sector at %u: %s", (unsigned)(offset_ + erased_end_),
+                     esp_err_to_name(err));
+            return false;
+        }
+        erased_end_ += sector_size_;
+    }
+    return true;
+}
+
+void PersistentGlyphStore::Index(uint32_t codepoint, const lv_font_fmt_txt_glyph_dsc_t& dsc) {
+    auto it = std::lower_bound(codepoints_.begin(), codepoints_.end(), codepoint);
+    const size_t position = it - codepoints_.begin();
+    if (it != codepoints_.end() && *it == codepoint) {
+        glyph_dsc_[position + 1] = dsc;
+        return;
+    }
+    codepoints_.insert(it, codepoint);
+    glyph_dsc_.insert(glyph_dsc_.begin() + position + 1, dsc);
+}
+
+void PersistentGlyphStore::UpdateFont() {
+    // Glyph ids follow the code point order, so the cmaps are plain sorted lists
+    unicode_list_.clear();
+    cmaps_.clear();
+    for (size_t i = 0; i < codepoints_.size(); ++i) {
+        const uint32_t codepoint = codepoints_[i];
+        if (cmaps_.empty() || codepoint - cmaps_.back().range_start > 0xFFFE) {
+            lv_font_fmt_txt_cmap_t cmap{};
+            cmap.range_start = codepoint;
+            cmap.glyph_id_start = static_cast<uint16_t>(i + 1);
+            cmap.type = LV_FONT_FMT_TXT_CMAP_SPARSE_TINY;
+            cmaps_.push_back(cmap);
+        }
+        auto& cmap = cmaps_.back();
+        unicode_list_.push_back(static_cast<uint16_t>(codepoint - cmap.range_start));
+        cmap.range_length = static_cast<uint16_t>(codepoint - cmap.range_start + 1);
+        cmap.list_length++;
+    }
+    size_t begin = 0;
+    for (auto& cmap : cmaps_) {
+        cmap.unicode_list = unicode_list_.data() + begin;
+        begin += cmap.list_length;
+    }
+
+    dsc_.glyph_bitmap = reinterpret_cast<const uint8_t*>(mapped_);
+    dsc_.glyph_dsc = glyph_dsc_.data();
+    dsc_.cmaps = cmaps_.empty() ? nullptr : cmaps_.data();
+    dsc_.kern_dsc = nullptr;
+    dsc_.kern_scale = 0;
+    dsc_.cmap_num = cmaps_.size();
+    dsc_.bpp = bpp_;
+    dsc_.kern_classes = 0;
+    dsc_.bitmap_format = LV_FONT_FMT_TXT_PLAIN;
+    dsc_.stride = 0;
+    font_.dsc = &dsc_;
+}
@@ -0,0 +1,108 @@
+#ifndef PERSISTENT_GLYPH_STORE_H
+#define PERSISTENT_GLYPH_STORE_H
+
+#include "display.h"
+
+#include <lvgl.h>
+#include <esp_partition.h>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct TextFontCapability;
+
+/*
+ * Pushed glyphs kept in flash, so they survive reboots and evictions from
+ * DynamicGlyphCache and the server can skip them (see text_font.cached in the
+ * client hello).
+ *
+ * The store is an append-only log in the spare end of the assets partition,
+ * keyed by font bundle, size and bpp. Bitmaps are rendered straight from the
+ * partition mapping; only the glyph descriptors and cmaps are kept in RAM.
+ * When the log is full, or the font changes, it starts over. Sectors are
+ * erased one at a time just before they are written; a record cut off by a
+ * power loss leaves the rest of its sector unusable, so the log goes on at the
+ * next sector.
+ *
+ * Flash is never written under the display lock: pushed glyphs are queued in
+ * RAM while a turn streams in, WritePending() writes them from a low priority
+ * task once the turn ends, and Commit() adds the written glyphs to the font
+ * under the display lock. Without PSRAM the queue would hold bitmaps in
+ * internal RAM, so the store is not used there.
+ *
+ * The owner calls Close() before the assets partition is unmapped.
+ */
+class PersistentGlyphStore {
+public:
+    static constexpr size_t kRegionSize = 128 * 1024;
+    // Bitmap bytes waiting for WritePending(), later glyphs are left to the next turn
+    static constexpr size_t kMaxPendingBytes = 32 * 1024;
+
+    // Loads the glyphs stored for this font, false if there is no flash for the store.
+    // Display lock, unless the store is not open yet.
+    bool Open(const TextFontCapability& capability);
+    bool is_open() const { return mapped_ != nullptr; }
+    // Display lock. Forgets the mapping and everything queued, Open() loads the store again
+    void Close();
+    // Display lock. Font for the stored glyphs, nullptr while the store is empty
+    const lv_font_t* EnsureFont(const lv_font_t* base_font);
+    // Display lock. Queues the glyphs that are not stored yet for WritePending()
+    void Queue(const std::vector<TextGlyph>& glyphs);
+    bool HasPending();
+    // Any task without the display lock. Writes the queued glyphs to flash,
+    // true when Commit() has to run before the rest can be written
+    bool WritePending();
+    // Display lock. Adds the written glyphs to the font, true if the font changed
+    bool Commit();
+    // Any task. Stored code points of this font, at most max_count of them
+    std::vector<uint32_t> Snapshot(const TextFontCapability& capability, size_t max_count);
+
+private:
+    // Lock order: display lock, open_mutex_, flash_mutex_, mutex_
+    std::mutex open_mutex_;         // Font identity and mapping
+    std::mutex flash_mutex_;        // Write position and erased sectors
+    std::mutex mutex_;              // Index, queued and written glyphs
+
+    const esp_partition_t* partition_ = nullptr;
+    const char* mapped_ = nullptr;
+    size_t offset_ = 0;             // Of the region in the partition
+    size_t sector_size_ = 4096;
+    std::string bundle_;
+    uint8_t size_ = 0;
+    uint8_t bpp_ = 0;
+    uint32_t generation_ = 0;
+    bool header_written_ = false;
+    size_t write_offset_ = 0;
+    size_t erased_end_ = 0;         // Sectors below this are erased or written by this generation
+
+    std::deque<TextGlyph> pending_;
+    size_t pending_bytes_ = 0;
+    std::vector<std::pair<uint32_t, lv_font_fmt_txt_glyph_dsc_t>> written_;
+    bool full_ = false;             // WritePending() stopped, Commit() empties the font
+    bool cleared_ = false;          // Commit() emptied the font, WritePending() starts over
+
+    lv_font_t font_{};
+    lv_font_fmt_txt_dsc_t dsc_{};
+    TextGlyphVector<uint32_t> codepoints_;                    // Sorted
+    TextGlyphVector<lv_font_fmt_txt_glyph_dsc_t> glyph_dsc_;   // Parallel to codepoints_, after glyph 0
+    TextGlyphVector<uint16_t> unicode_list_;
+    TextGlyphVector<lv_font_fmt_txt_cmap_t> cmaps_;
+
+    void Load();
+    size_t ScanRecords(size_t position);
+    bool IsErased(size_t begin, size_t end) const;
+    void Reset();
+    void StartOver();
+    bool Contains(uint32_t codepoint) const;
+    bool IsQueued(uint32_t codepoint) const;
+    bool Append(const TextGlyph& glyph, lv_font_fmt_txt_glyph_dsc_t& dsc);
+    bool EraseUntil(size_t end);
+    void Index(uint32_t codepoint, const lv_font_fmt_txt_glyph_dsc_t& dsc);
+    void UpdateFont();
+};
+
+#endif // PERSISTENT_GLYPH_STORE_H
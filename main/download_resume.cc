@@ -0,0 +1,269 @@
+#include "download_resume.h"
+#include "settings.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+#include <http.h>
+
+#define TAG "DownloadResume"
+
+static std::string ToHex(const std::string& data) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(data.size() * 2);
+    for (unsigned char c : data) {
+        hex.push_back(digits[c >> 4]);
+        hex.push_back(digits[c & 0x0F]);
+    }
+    return hex;
+}
+
+static std::string FromHex(const std::string& hex) {
+    std::string data;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2) {
+        data.push_back(static_cast<char>(std::stoul(hex.substr(i, 2), nullptr, 16)));
+    }
+    return data;
+}
+
+DownloadResume::DownloadResume(const std::string& ns, size_t sector_size, size_t head_size)
+    : ns_(ns), sector_size_(sector_size), head_size_(head_size) {
+    Settings settings(ns_);
+    identity_ = settings.GetString("resume_id");
+    if (identity_.empty()) {
+        return;
+    }
+    length_ = settings.GetInt("resume_len");
+    offset_ = settings.GetInt("resume_at");
+    crc_ = static_cast<uint32_t>(settings.GetInt("resume_crc"));
+    head_ = FromHex(settings.GetString("resume_head"));
+    if (offset_ == 0 || offset_ > length_ || offset_ % sector_size_ != 0 ||
+        head_.size() != std::min(head_size_, offset_)) {
+        ESP_LOGW(TAG, "Dropping an invalid resume record");
+        offset_ = 0;
+        identity_.clear();
+        head_.clear();
+        return;
+    }
+    saved_ = offset_;
+}
+
+bool DownloadResume::Verify(std::function<bool(size_t offset, void* data, size_t size)> read) {
+    if (offset_ == 0) {
+        return false;
+    }
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(head_.data()), head_.size());
+    std::vector<uint8_t> buffer(sector_size_);
+    bool ok = true;
+    for (size_t pos = head_.size(); pos < offset_ && ok;) {
+        size_t size = std::min(sector_size_ - pos % sector_size_, offset_ - pos);
+        ok = read(pos, buffer.data(), size);
+        crc = esp_rom_crc32_le(crc, buffer.data(), size);
+        pos += size;
+    }
+    if (!ok || crc != crc_) {
+        ESP_LOGW(TAG, "The %u bytes in flash do not match the resume record, downloading from the start",
+                 (unsigned int)offset_);
+        Clear();
+        return false;
+    }
+    ESP_LOGI(TAG, "Verified %u of %u bytes in flash", (unsigned int)offset_, (unsigned int)length_);
+    return true;
+}
+
+bool DownloadResume::Open(Http& http, const std::string& url, size_t& start) {
+    bool continues = false;
+    if (!Request(http, url, offset_, continues)) {
+        if (open_status_ == 206 || open_status_ == 416) {
+            // The server cannot continue the record, the next attempt starts over
+            Clear();
+        }
+        return false;
+    }
+    if (continues) {
+        ESP_LOGI(TAG, "Resuming download at %u of %u bytes", (unsigned int)offset_, (unsigned int)length_);
+        start = offset_;
+        return true;
+    }
+    if (offset_ > 0) {
+        ESP_LOGW(TAG, "The content changed, downloading from the start");
+    }
+    Begin();
+    start = 0;
+    return true;
+}
+
+bool DownloadResume::Reconnect(Http& http, const std::string& url, size_t offset) {
+    if (identity_.empty()) {
+        ESP_LOGE(TAG, "The server gave no ETag or Last-Modified, cannot resume");
+        return false;
+    }
+    bool continues = false;
+    if (!Request(http, url, offset, continues)) {
+        return false;
+    }
+    if (!continues) {
+        ESP_LOGE(TAG, "The content changed during the download");
+        return false;
+    }
+    ESP_LOGI(TAG, "Reconnected at %u of %u bytes", (unsigned int)offset, (unsigned int)length_);
+    return true;
+}
+
+bool DownloadResume::Receive(std::unique_ptr<Http>& http, const std::function<std::unique_ptr<Http>()>& connect,
+                             const std::string& url, size_t start, const Sink& sink,
+                             const std::function<void(size_t received, size_t recent)>& progress) {
+    size_t received = start;
+    size_t recent = 0;
+    int reconnects = 0;
+    int64_t last_progress_time = esp_timer_get_time();
+    while (true) {
+        size_t space = 0;
+        char* buffer = sink.acquire(space);
+        if (buffer == nullptr) {
+            return false;
+        }
+        int ret = http->Read(buffer, space);
+        if (ret < 0 || (ret == 0 && received < open_length_)) {
+            if (ret < 0) {
+                ESP_LOGE(TAG, "Failed to read HTTP data: %d", ret);
+            } else {
+                ESP_LOGE(TAG, "Connection closed at %u of %u bytes", (unsigned int)received,
+                         (unsigned int)open_length_);
+            }
+            // Ask for the rest, the record keeps the last checkpoint if that fails too
+            http->Close();
+            if (++reconnects > kMaxReconnects) {
+                return false;
+            }
+            http = connect();
+            if (http == nullptr || !Reconnect(*http, url, received)) {
+                return false;
+            }
+            continue;
+        }
+        if (ret == 0) {
+            break;
+        }
+
+        if (!sink.commit(ret)) {
+            return false;
+        }
+        received += ret;
+        recent += ret;
+        if (esp_timer_get_time() - last_progress_time >= 1000000 || received == open_length_) {
+            if (progress) {
+                progress(received, recent);
+            }
+            last_progress_time = esp_timer_get_time();
+            recent = 0;
+        }
+    }
+
+    if (received != open_length_) {
+        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", (unsigned int)received,
+                 (unsigned int)open_length_);
+        return false;
+    }
+    return true;
+}
+
+bool DownloadResume::Request(Http& http, const std::string& url, size_t offset, bool& continues) {
+    if (offset > 0) {
+        http.SetHeader("Range", "bytes=" + std::to_string(offset) + "-");
+        http.SetHeader("If-Range", identity_);
+    }
+    open_status_ = 0;
+    if (!http.Open("GET", url)) {
+        ESP_LOGE(TAG, "Failed to open HTTP connection");
+        return false;
+    }
+
+    int status_code = http.GetStatusCode();
+    open_status_ = status_code;
+    open_identity_ = http.GetResponseHeader("ETag");
+    if (open_identity_.empty()) {
+        open_identity_ = http.GetResponseHeader("Last-Modified");
+    }
+    if (offset > 0 && status_code == 206) {
+        // Content-Range: bytes <first>-<last>/<length>
+        std::string range = http.GetResponseHeader("Content-Range");
+        unsigned long first = 0, last = 0, length = 0;
+        if (sscanf(range.c_str(), "bytes %lu-%lu/%lu", &first, &last, &length) != 3 || first != offset ||
+            length != length_ || (!open_identity_.empty() && open_identity_ != identity_)) {
+            ESP_LOGE(TAG, "The range answer does not continue the download: %s", range.c_str());
+            return false;
+        }
+        open_length_ = length_;
+        continues = true;
+        return true;
+    }
+
+    if (status_code != 200) {
+        ESP_LOGE(TAG, "Failed to download, status code: %d", status_code);
+        return false;
+    }
+    open_length_ = http.GetBodyLength();
+    if (open_length_ == 0) {
+        ESP_LOGE(TAG, "Failed to get content length");
+        return false;
+    }
+    continues = false;
+    return true;
+}
+
+void DownloadResume::Begin() {
+    if (offset_ > 0) {
+        Clear();
+    }
+    identity_ = open_identity_;
+    length_ = open_length_;
+    offset_ = 0;
+    saved_ = 0;
+    crc_ = 0;
+    head_.clear();
+    if (identity_.empty()) {
+        ESP_LOGW(TAG, "The server gave no ETag or Last-Modified, the download cannot resume");
+    }
+}
+
+void DownloadResume::Update(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    if (offset_ < head_size_) {
+        size_t take = std::min(head_size_ - offset_, size);
+        head_.append(reinterpret_cast<const char*>(bytes), take);
+    }
+    crc_ = esp_rom_crc32_le(crc_, bytes, size);
+    offset_ += size;
+    if (!identity_.empty() && offset_ - saved_ >= kInterval && offset_ % sector_size_ == 0 && offset_ < length_) {
+        Save();
+    }
+}
+
+void DownloadResume::Clear() {
+    Settings settings(ns_, true);
+    settings.EraseKey("resume_id");
+    settings.EraseKey("resume_len");
+    settings.EraseKey("resume_at");
+    settings.EraseKey("resume_crc");
+    settings.EraseKey("resume_head");
+    identity_.clear();
+    offset_ = 0;
+    saved_ = 0;
+    head_.clear();
+}
+
+void DownloadResume::Save() {
+    Settings settings(ns_, true);
+    settings.SetString("resume_id", identity_);
+    settings.SetInt("resume_len", length_);
+    settings.SetInt("resume_crc", static_cast<int32_t>(crc_));
+    settings.SetString("resume_head", ToHex(head_));
+    settings.SetInt("resume_at", offset_);
+    saved_ = offset_;
+}
@@ -0,0 +1,92 @@
+#ifndef DOWNLOAD_RESUME_H
+#define DOWNLOAD_RESUME_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+class Http;
+
+/*
+ * How far a download into flash got, kept in NVS so that a retry asks for the rest
+ * with a Range request instead of starting over.
+ *
+ * The record names the content by its length and ETag, or Last-Modified without one.
+ * The Range request sends it as If-Range, so a server with other content answers 200
+ * and the download starts from zero. The record also keeps the CRC32 of the bytes in
+ * flash, which are read back and checked before they are trusted again, and the held
+ * back head of the image that is not in flash until the end.
+ *
+ * Update() may run on another task during Reconnect(), which leaves the record alone.
+ */
+class DownloadResume {
+public:
+    // A checkpoint is saved every kInterval bytes in flash, at a sector boundary
+    static constexpr size_t kInterval = 64 * 1024;
+    // Reconnects with a Range request within one download
+    static constexpr int kMaxReconnects = 3;
+
+    // Where Receive() puts the body
+    struct Sink {
+        // Space for the next read, nullptr to stop
+        std::function<char*(size_t& space)> acquire;
+        // size bytes were read into that space, false to stop
+        std::function<bool(size_t size)> commit;
+    };
+
+    // ns is the Settings namespace of the record, sector_size the erase unit of the flash,
+    // head_size the bytes written to flash last
+    DownloadResume(const std::string& ns, size_t sector_size, size_t head_size = 0);
+
+    // Bytes of the recorded download in flash, 0 without a record
+    size_t offset() const { return offset_; }
+    // Held back head of the recorded download
+    const std::string& head() const { return head_; }
+    // Length of the whole content, after Open()
+    size_t content_length() const { return open_length_; }
+
+    // Reads the recorded bytes back from flash and drops the record if their CRC differs
+    bool Verify(std::function<bool(size_t offset, void* data, size_t size)> read);
+    // GETs url, from offset() on when there is a record. start is where the body begins:
+    // offset() when the server continues the recorded content, else 0 and a new record begins.
+    bool Open(Http& http, const std::string& url, size_t& start);
+    // GETs url again after a dropped connection, true when the server continues at offset
+    bool Reconnect(Http& http, const std::string& url, size_t offset);
+    // Reads the body Open() asked for into sink, start being where it begins. After a dropped
+    // connection or an early close it asks connect() for a new connection and Reconnect()s,
+    // up to kMaxReconnects times. progress gets the bytes received so far and since its last
+    // call, about once a second and at the end. True when all content_length() bytes arrived.
+    bool Receive(std::unique_ptr<Http>& http, const std::function<std::unique_ptr<Http>()>& connect,
+                 const std::string& url, size_t start, const Sink& sink,
+                 const std::function<void(size_t received, size_t recent)>& progress);
+    // Data in flash now, in download order from offset()
+    void Update(const void* data, size_t size);
+    // The download completed, or the flash holds something else now
+    void Clear();
+
+private:
+    std::string ns_;
+    size_t sector_size_;
+    size_t head_size_;
+
+    // The record
+    std::string identity_;
+    size_t length_ = 0;
+    size_t offset_ = 0;
+    size_t saved_ = 0;
+    uint32_t crc_ = 0;
+    std::string head_;
+
+    // The last response
+    int open_status_ = 0;
+    std::string open_identity_;
+    size_t open_length_ = 0;
+
+    bool Request(Http& http, const std::string& url, size_t offset, bool& continues);
+    void Begin();
+    void Save();
+};
+
+#endif // DOWNLOAD_RESUME_H
@@ -196,18 +196,12 @@ void McpServer::AddUserOnlyTools() {
                 auto url = properties["url"].value<std::string>();
                 auto quality = properties["quality"].value<int>();
 
-                std::string jpeg_data;
-                if (!display->SnapshotToJpeg(jpeg_data, quality)) {
-                    throw std::runtime_error("Failed to snapshot screen");
-                }
-
-                ESP_LOGI(TAG, "Upload snapshot %u bytes to %s", jpeg_data.size(), url.c_str());
-                
-                // 构造multipart/form-data请求体
+                // 构造multipart/form-data请求体，JPEG边编码边上传
                 std::string boundary = "----ESP32_SCREEN_SNAPSHOT_BOUNDARY";
                 
                 auto http = Board::GetInstance().GetNetwork()->CreateHttp(3);
                 http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
+                http->SetHeader("Transfer-Encoding", "chunked");
                 if (!http->Open("POST", url)) {
                     throw std::runtime_error("Failed to open URL: " + url);
                 }
@@ -222,7 +216,19 @@ void McpServer::AddUserOnlyTools() {
                 }
 
                 // JPEG数据
-                http->Write((const char*)jpeg_data.data(), jpeg_data.size());
+                size_t jpeg_size = 0;
+                bool written = display->SnapshotToJpeg([&http, &jpeg_size](const void* data, size_t len) {
+                    if (http->Write(static_cast<const char*>(data), len) < 0) {
+                        return false;
+                    }
+                    jpeg_size += len;
+                    return true;
+                }, quality);
+                if (!written) {
+                    http->Close();
+                    throw std::runtime_error("Failed to snapshot screen");
+                }
+                ESP_LOGI(TAG, "Uploaded snapshot %u bytes to %s", (unsigned)jpeg_size, url.c_str());
 
                 {
                     // multipart尾部
@@ -1,6 +1,7 @@
 #include "ota.h"
 #include "system_info.h"
 #include "settings.h"
+#include "download_resume.h"
 #include "assets/lang_config.h"
 
 #include <freertos/FreeRTOS.h>
@@ -275,24 +276,31 @@ bool Ota::Upgrade(const std::string& firmware_url, std::function<void(int progre
 
     ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
     bool image_header_checked = false;
-    std::string image_header;
 
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    if (!http->Open("GET", firmware_url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
+    // An interrupted upgrade continues where its last checkpoint in flash is
+    DownloadResume resume("ota", esp_partition_get_main_flash_sector_size());
+    if (resume.offset() > 0) {
+        resume.Verify([update_partition](size_t offset, void* data, size_t size) {
+            return esp_partition_read(update_partition, offset, data, size) == ESP_OK;
+        });
     }
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
+    auto network = Board::GetInstance().GetNetwork();
+    auto http = network->CreateHttp(0);
+    size_t start = 0;
+    if (!resume.Open(*http, firmware_url, start)) {
+        ESP_LOGE(TAG, "Failed to get firmware");
         return false;
     }
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        return false;
+    size_t content_length = resume.content_length();
+    if (start > 0) {
+        // The image header is in flash already, esp_ota_end() validates the whole image
+        if (esp_ota_resume(update_partition, OTA_WITH_SEQUENTIAL_WRITES, start, &update_handle)) {
+            ESP_LOGE(TAG, "Failed to resume OTA");
+            return false;
+        }
+        image_header_checked = true;
     }
 
     constexpr size_t PAGE_SIZE = 4096;
@@ -302,71 +310,62 @@ bool Ota::Upgrade(const std::string& firmware_url, std::function<void(int progre
         return false;
     }
 
+    // HTTP reads fill the buffer, which is written to flash a page at a time
     size_t buffer_offset = 0;  // Current data size in buffer
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer + buffer_offset, PAGE_SIZE - buffer_offset);
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
-            heap_caps_free(buffer);
+    auto flush = [&]() {
+        auto err = esp_ota_write(update_handle, buffer, buffer_offset);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
             return false;
         }
-
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        buffer_offset += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (callback) {
-                callback(progress, recent_read);
-            }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
-        }
-
-        if (!image_header_checked) {
-            image_header.append(buffer, buffer_offset);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    heap_caps_free(buffer);
-                    return false;
-                }
-
-                image_header_checked = true;
-                std::string().swap(image_header);
-            }
-        }
-
-        // Write to flash when buffer is full (4KB) or it's the last chunk
-        bool is_last_chunk = (ret == 0);
-        if (buffer_offset == PAGE_SIZE || (is_last_chunk && buffer_offset > 0)) {
-            auto err = esp_ota_write(update_handle, buffer, buffer_offset);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-                esp_ota_abort(update_handle);
-                heap_caps_free(buffer);
+        resume.Update(buffer, buffer_offset);
+        buffer_offset = 0;
+        return true;
+    };
+    DownloadResume::Sink sink;
+    sink.acquire = [&](size_t& space) {
+        space = PAGE_SIZE - buffer_offset;
+        return buffer + buffer_offset;
+    };
+    sink.commit = [&](size_t size) {
+        buffer_offset += size;
+        // The first page holds the image header
+        if (!image_header_checked &&
+            buffer_offset >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
+            if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
+                ESP_LOGE(TAG, "Failed to begin OTA");
                 return false;
             }
-
-            buffer_offset = 0;
-        }
-
-        if (is_last_chunk) {
-            break;
+            image_header_checked = true;
         }
+        return buffer_offset < PAGE_SIZE || flush();
+    };
+    bool success = resume.Receive(http, [network]() { return network->CreateHttp(0); }, firmware_url, start, sink,
+        [&](size_t received, size_t recent) {
+            size_t progress = received * 100 / content_length;
+            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, received, content_length, recent);
+            if (callback) {
+                callback(progress, recent);
+            }
+        });
+    if (success && !image_header_checked) {
+        ESP_LOGE(TAG, "Firmware image is too short");
+        success = false;
     }
-    http->Close();
+    // Write the last partial page
+    success = success && (buffer_offset == 0 || flush());
     heap_caps_free(buffer);
+    if (!success) {
+        // The resume record keeps the last checkpoint for the next attempt
+        if (image_header_checked) {
+            esp_ota_abort(update_handle);
+        }
+        return false;
+    }
 
     esp_err_t err = esp_ota_end(update_handle);
+    // Validated or not, the next attempt does not continue this image
+    resume.Clear();
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
             ESP_LOGE(TAG, "Image validation failed, image is corrupted");
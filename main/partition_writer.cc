@@ -0,0 +1,195 @@
+#include "partition_writer.h"
+
+#include <algorithm>
+
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_pthread.h>
+
+#define TAG "PartitionWriter"
+
+PartitionWriter::PartitionWriter(const Target& target, size_t length, size_t hold_back, size_t buffer_count)
+    : target_(target), length_(length), hold_back_(hold_back), buffers_(buffer_count, nullptr) {
+    size_t partition_sectors = target_.size / target_.sector_size;
+    erase_limit_ = std::min((length_ + target_.sector_size - 1) / target_.sector_size, partition_sectors);
+}
+
+PartitionWriter::~PartitionWriter() {
+    Stop();
+    for (auto buffer : buffers_) {
+        heap_caps_free(buffer);
+    }
+}
+
+void PartitionWriter::Resume(size_t offset, const std::string& head) {
+    position_ = offset;
+    erased_ = offset / target_.sector_size;
+    head_.assign(head.begin(), head.end());
+}
+
+bool PartitionWriter::Start() {
+    for (size_t i = 0; i < buffers_.size(); i++) {
+        // Internal RAM, flash writes from PSRAM would go through a bounce buffer
+        buffers_[i] = static_cast<char*>(heap_caps_malloc(target_.sector_size, MALLOC_CAP_INTERNAL));
+        if (buffers_[i] == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate sector buffer");
+            return false;
+        }
+        free_.push_back(i);
+    }
+
+    auto cfg = esp_pthread_get_default_config();
+    cfg.thread_name = "partition_writer";
+    // Room for on_written_, which may save to NVS
+    cfg.stack_size = 4096 + 2048;
+    cfg.prio = 4;
+    esp_pthread_set_cfg(&cfg);
+    thread_ = std::thread(&PartitionWriter::WriterLoop, this);
+    cfg = esp_pthread_get_default_config();
+    esp_pthread_set_cfg(&cfg);
+    return true;
+}
+
+char* PartitionWriter::Acquire(size_t& space) {
+    if (current_ < 0) {
+        if (position_ >= target_.size) {
+            ESP_LOGE(TAG, "Data exceeds the partition size (%u)", (unsigned)target_.size);
+            return nullptr;
+        }
+        std::unique_lock<std::mutex> lock(mutex_);
+        cv_.wait(lock, [this]() { return !free_.empty() || failed_; });
+        if (failed_) {
+            return nullptr;
+        }
+        current_ = free_.front();
+        free_.pop_front();
+        fill_ = 0;
+    }
+    space = target_.sector_size - fill_;
+    return buffers_[current_] + fill_;
+}
+
+void PartitionWriter::Commit(size_t len) {
+    fill_ += len;
+    position_ += len;
+    if (fill_ == target_.sector_size) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        filled_.push_back({current_, position_ / target_.sector_size - 1, fill_});
+        current_ = -1;
+        cv_.notify_all();
+    }
+}
+
+bool PartitionWriter::Finish() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (current_ >= 0 && fill_ > 0) {
+            filled_.push_back({current_, position_ / target_.sector_size, fill_});
+            current_ = -1;
+        }
+    }
+    Stop();
+    return !failed_;
+}
+
+bool PartitionWriter::WriteHead() {
+    if (failed_ || head_.empty()) {
+        return false;
+    }
+    return target_.write(0, head_.data(), head_.size());
+}
+
+void PartitionWriter::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        finishing_ = true;
+        cv_.notify_all();
+    }
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+}
+
+void PartitionWriter::WriterLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        if (!filled_.empty()) {
+            Job job = filled_.front();
+            filled_.pop_front();
+            lock.unlock();
+            bool ok = EraseUpTo(job.sector) && WriteJob(job);
+            lock.lock();
+            free_.push_back(job.buffer);
+            if (!ok) {
+                failed_ = true;
+            }
+            cv_.notify_all();
+            if (failed_) {
+                break;
+            }
+            continue;
+        }
+        if (finishing_) {
+            break;
+        }
+        if (erased_ < erase_limit_) {
+            // Nothing to program yet, erase the next sector while the network delivers
+            lock.unlock();
+            bool ok = EraseUpTo(erased_);
+            lock.lock();
+            if (!ok) {
+                failed_ = true;
+                cv_.notify_all();
+                break;
+            }
+            continue;
+        }
+        cv_.wait(lock);
+    }
+}
+
+bool PartitionWriter::EraseUpTo(size_t sector) {
+    const size_t block_sectors = std::max<size_t>(target_.block_size / target_.sector_size, 1);
+    while (erased_ <= sector) {
+        size_t offset = erased_ * target_.sector_size;
+        size_t count = 1;
+        if (erased_ % block_sectors == 0 && erased_ + block_sectors <= erase_limit_) {
+            count = block_sectors;
+        }
+        size_t size = count * target_.sector_size;
+        if (offset + size > target_.size) {
+            ESP_LOGE(TAG, "Sector end (%u) exceeds partition size (%u)", (unsigned)(offset + size),
+                     (unsigned)target_.size);
+            return false;
+        }
+        if (!target_.erase(offset, size)) {
+            ESP_LOGE(TAG, "Failed to erase %u sectors at sector %u", (unsigned)count, (unsigned)erased_.load());
+            return false;
+        }
+        erased_ += count;
+    }
+    return true;
+}
+
+bool PartitionWriter::WriteJob(const Job& job) {
+    size_t offset = job.sector * target_.sector_size;
+    const char* data = buffers_[job.buffer];
+    size_t len = job.len;
+    const char* job_data = data;
+    if (offset < hold_back_) {
+        // The head goes in last, by WriteHead()
+        size_t skip = std::min(hold_back_ - offset, len);
+        head_.insert(head_.end(), data, data + skip);
+        data += skip;
+        offset += skip;
+        len -= skip;
+    }
+    if (len > 0 && !target_.write(offset, data, len)) {
+        ESP_LOGE(TAG, "Failed to write %u bytes at offset %u", (unsigned)len, (unsigned)offset);
+        return false;
+    }
+    if (on_written_) {
+        on_written_(job_data, job.len);
+    }
+    return true;
+}
@@ -0,0 +1,102 @@
+#ifndef PARTITION_WRITER_H
+#define PARTITION_WRITER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Streams a download into a flash partition without stalling the network on flash.
+ *
+ * The producer (the HTTP read loop) receives straight into a small ring of sector
+ * buffers with Acquire()/Commit(). A writer thread programs the full sectors and,
+ * while it waits for data, erases the blocks ahead of them, so reading, erasing and
+ * programming overlap instead of taking turns.
+ *
+ * The first hold_back bytes are kept aside and only written by WriteHead(), after
+ * everything else, so an interrupted download never leaves a valid header behind.
+ */
+class PartitionWriter {
+public:
+    // Flash operations: esp_partition_* on the device, a RAM image in host tests
+    struct Target {
+        size_t size = 0;
+        size_t sector_size = 4096;
+        // Erasing ahead goes by aligned blocks of this size, a block erase costs a few sectors
+        size_t block_size = 65536;
+        std::function<bool(size_t offset, size_t size)> erase;
+        std::function<bool(size_t offset, const void* data, size_t size)> write;
+    };
+
+    // length is the expected download size, used to bound erasing ahead
+    PartitionWriter(const Target& target, size_t length, size_t hold_back = 0, size_t buffer_count = 3);
+    ~PartitionWriter();
+    PartitionWriter(const PartitionWriter&) = delete;
+    PartitionWriter& operator=(const PartitionWriter&) = delete;
+
+    // Continues a download whose first offset bytes are in flash already, offset is sector
+    // aligned and head holds the held back part of them. Before Start().
+    void Resume(size_t offset, const std::string& head);
+    // Called by the writer thread with the data of each sector once it is in flash, including
+    // the held back bytes, in download order. Before Start().
+    void OnWritten(std::function<void(const char* data, size_t size)> callback) { on_written_ = callback; }
+    // Allocates the buffers and starts the writer thread
+    bool Start();
+    // Space to receive the next bytes into, up to the end of the current sector.
+    // Waits for a free buffer; nullptr after a flash error or past the end of the partition.
+    char* Acquire(size_t& space);
+    // The producer put len bytes at the pointer returned by Acquire()
+    void Commit(size_t len);
+    // Writes the last partial sector and waits for the writer; false if any erase or write failed
+    bool Finish();
+    // Writes the held back bytes, after a successful Finish()
+    bool WriteHead();
+
+    size_t received() const { return position_; }
+    size_t sectors_erased() const { return erased_; }
+
+private:
+    struct Job {
+        int buffer;
+        size_t sector;
+        size_t len;
+    };
+
+    Target target_;
+    size_t length_;
+    size_t hold_back_;
+    size_t erase_limit_;            // Sectors the download covers, erased ahead of the data
+    std::vector<char*> buffers_;
+    std::vector<char> head_;
+    std::function<void(const char* data, size_t size)> on_written_;
+
+    // Producer only
+    int current_ = -1;
+    size_t fill_ = 0;
+    size_t position_ = 0;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<int> free_;
+    std::deque<Job> filled_;
+    bool finishing_ = false;
+    bool failed_ = false;
+    std::thread thread_;
+
+    // Written by the writer thread only
+    std::atomic<size_t> erased_{0};
+
+    void WriterLoop();
+    bool EraseUpTo(size_t sector);
+    bool WriteJob(const Job& job);
+    void Stop();
+};
+
+#endif // PARTITION_WRITER_H
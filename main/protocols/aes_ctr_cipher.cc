@@ -0,0 +1,75 @@
+#include "aes_ctr_cipher.h"
+
+#include <esp_log.h>
+
+#include <cstring>
+
+#define TAG "AesCtrCipher"
+
+static constexpr size_t kBlockSize = 16;
+
+AesCtrCipher::~AesCtrCipher() {
+    Abort();
+}
+
+bool AesCtrCipher::SetKey(psa_key_id_t key_id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Abort();
+    psa_status_t status = psa_cipher_encrypt_setup(&operation_, key_id, PSA_ALG_ECB_NO_PADDING);
+    if (status != PSA_SUCCESS) {
+        ESP_LOGE(TAG, "Failed to set up AES operation, status: %ld", static_cast<long>(status));
+        Abort();
+        return false;
+    }
+    ready_ = true;
+    return true;
+}
+
+void AesCtrCipher::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Abort();
+}
+
+bool AesCtrCipher::Crypt(const uint8_t* input, size_t input_size, const uint8_t* nonce,
+                         uint8_t* output) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!ready_ || input == nullptr || nonce == nullptr || output == nullptr) {
+        return false;
+    }
+    if (input_size == 0) {
+        return true;
+    }
+
+    // Counter blocks start at the nonce and are incremented as one 128-bit big-endian number
+    const size_t size = (input_size + kBlockSize - 1) / kBlockSize * kBlockSize;
+    counter_blocks_.resize(size);
+    keystream_.resize(size);
+    uint8_t counter[kBlockSize];
+    memcpy(counter, nonce, kBlockSize);
+    for (size_t offset = 0; offset < size; offset += kBlockSize) {
+        memcpy(&counter_blocks_[offset], counter, kBlockSize);
+        for (int i = kBlockSize - 1; i >= 0 && ++counter[i] == 0; --i) {
+        }
+    }
+
+    size_t keystream_len = 0;
+    psa_status_t status = psa_cipher_update(&operation_, counter_blocks_.data(), size,
+                                            keystream_.data(), size, &keystream_len);
+    if (status != PSA_SUCCESS || keystream_len != size) {
+        ESP_LOGE(TAG, "AES keystream generation failed, status: %ld", static_cast<long>(status));
+        Abort();
+        return false;
+    }
+
+    // input and output may be the same buffer
+    for (size_t i = 0; i < input_size; ++i) {
+        output[i] = input[i] ^ keystream_[i];
+    }
+    return true;
+}
+
+void AesCtrCipher::Abort() {
+    // Leaves the operation ready to be set up again
+    psa_cipher_abort(&operation_);
+    ready_ = false;
+}
@@ -0,0 +1,47 @@
+#ifndef AES_CTR_CIPHER_H
+#define AES_CTR_CIPHER_H
+
+#include <psa/crypto.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/*
+ * AES-CTR for short datagrams on a cipher context that stays prepared.
+ *
+ * A PSA CTR operation has to be set up (key schedule included), given an IV,
+ * finished and aborted for every datagram. Instead this keeps one ECB
+ * operation open for the lifetime of the key and produces the keystream of a
+ * whole datagram with a single update over its counter blocks, which is then
+ * XORed with the data. The result is identical to PSA_ALG_CTR with the same
+ * 16-byte initial counter block.
+ *
+ * Each instance has its own lock, so using one instance per direction keeps
+ * sending and receiving from waiting on each other.
+ */
+class AesCtrCipher {
+public:
+    AesCtrCipher() = default;
+    ~AesCtrCipher();
+
+    AesCtrCipher(const AesCtrCipher&) = delete;
+    AesCtrCipher& operator=(const AesCtrCipher&) = delete;
+
+    // The key must allow PSA_KEY_USAGE_ENCRYPT with PSA_ALG_ECB_NO_PADDING
+    bool SetKey(psa_key_id_t key_id);
+    void Reset();
+    bool Crypt(const uint8_t* input, size_t input_size, const uint8_t* nonce, uint8_t* output);
+
+private:
+    std::mutex mutex_;
+    psa_cipher_operation_t operation_ = PSA_CIPHER_OPERATION_INIT;
+    bool ready_ = false;
+    std::vector<uint8_t> counter_blocks_;
+    std::vector<uint8_t> keystream_;
+
+    void Abort();
+};
+
+#endif // AES_CTR_CIPHER_H
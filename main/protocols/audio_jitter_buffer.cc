@@ -0,0 +1,263 @@
+#include "audio_jitter_buffer.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "JitterBuffer"
+
+// Longest run of lost frames that is concealed, longer gaps are skipped
+static constexpr uint32_t kMaxConcealedFrames = 3;
+// Packets held while waiting for a missing one before giving up on it
+static constexpr size_t kMaxPendingPackets = 16;
+static constexpr int kMaxTargetDelayFrames = 5;
+// A larger sequence jump means the sender restarted its counter
+static constexpr int32_t kMaxSequenceJump = 256;
+// Silence longer than this starts a new burst, which is buffered again
+static constexpr int64_t kIdleTimeoutUs = 1000 * 1000;
+// Servers send the first frames of a burst ahead of time, keep them out of the jitter estimate
+static constexpr uint32_t kJitterWarmupPackets = 5;
+static constexpr int64_t kMaxJitterSampleUs = 500 * 1000;
+
+AudioJitterBuffer::AudioJitterBuffer() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<AudioJitterBuffer*>(arg)->OnTimer();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "jitter_buffer",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&timer_args, &timer_);
+    // A gap releases at most every held packet and the placeholders before each of them
+    ready_.reserve(kMaxPendingPackets * (kMaxConcealedFrames + 1));
+}
+
+AudioJitterBuffer::~AudioJitterBuffer() {
+    if (timer_ == nullptr) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        esp_timer_stop(timer_);
+    }
+    // esp_timer_stop() does not wait for a callback that was already dispatched. The esp_timer
+    // task runs callbacks one at a time, so once a callback queued after it has run, it is done.
+    SemaphoreHandle_t done = xSemaphoreCreateBinary();
+    esp_timer_create_args_t barrier_args = {
+        .callback = [](void* arg) { xSemaphoreGive(static_cast<SemaphoreHandle_t>(arg)); },
+        .arg = done,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "jitter_buffer_stop",
+        .skip_unhandled_events = false,
+    };
+    esp_timer_handle_t barrier = nullptr;
+    if (done != nullptr && esp_timer_create(&barrier_args, &barrier) == ESP_OK) {
+        if (esp_timer_start_once(barrier, 0) == ESP_OK) {
+            xSemaphoreTake(done, portMAX_DELAY);
+        }
+        esp_timer_delete(barrier);
+    }
+    if (done != nullptr) {
+        vSemaphoreDelete(done);
+    }
+    esp_timer_delete(timer_);
+}
+
+void AudioJitterBuffer::OnOutput(Output output) {
+    std::lock_guard<std::mutex> lock(output_mutex_);
+    output_ = std::move(output);
+}
+
+void AudioJitterBuffer::SetPacketPool(Allocate allocate, Output recycle) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    allocate_ = std::move(allocate);
+    recycle_ = std::move(recycle);
+}
+
+void AudioJitterBuffer::Reset(int frame_duration_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    esp_timer_stop(timer_);
+    Clear();
+    frame_duration_ms_ = frame_duration_ms > 0 ? frame_duration_ms : 60;
+    started_ = false;
+    buffering_ = true;
+    burst_packets_ = 0;
+    jitter_us_ = 0;
+    stats_ = {};
+}
+
+void AudioJitterBuffer::Put(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet) {
+    std::lock_guard<std::mutex> output_lock(output_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        PutLocked(sequence, std::move(packet));
+    }
+    Deliver();
+}
+
+void AudioJitterBuffer::PutLocked(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet) {
+    int64_t now = esp_timer_get_time();
+    stats_.received++;
+
+    if (!started_) {
+        started_ = true;
+        next_sequence_ = sequence;
+        highest_sequence_ = sequence;
+    }
+    if (now - last_arrival_us_ > kIdleTimeoutUs) {
+        buffering_ = true;
+        burst_packets_ = 0;
+    }
+
+    int32_t offset = static_cast<int32_t>(sequence - next_sequence_);
+    if (offset > kMaxSequenceJump || offset < -kMaxSequenceJump) {
+        ESP_LOGW(TAG, "Audio sequence jumped from %lu to %lu, resynchronizing",
+                 (unsigned long)next_sequence_, (unsigned long)sequence);
+        Clear();
+        next_sequence_ = sequence;
+        highest_sequence_ = sequence;
+        offset = 0;
+    }
+    if (offset < 0 || pending_.count(sequence) > 0) {
+        stats_.late++;
+        last_arrival_us_ = now;
+        Recycle(std::move(packet));
+        return;
+    }
+
+    int32_t advance = static_cast<int32_t>(sequence - highest_sequence_);
+    if (advance > 0) {
+        if (burst_packets_ >= kJitterWarmupPackets) {
+            // Difference between the arrival spacing and the sending spacing of the two packets
+            int64_t expected = (int64_t)advance * frame_duration_ms_ * 1000;
+            int64_t deviation = std::min<int64_t>(std::llabs((now - last_arrival_us_) - expected),
+                                                  kMaxJitterSampleUs);
+            jitter_us_ += (deviation - jitter_us_) / 16;
+        }
+        highest_sequence_ = sequence;
+    } else if (advance < 0) {
+        stats_.reordered++;
+    }
+    last_arrival_us_ = now;
+    burst_packets_++;
+
+    pending_.emplace(sequence, Entry{std::move(packet), now});
+    Process(now);
+}
+
+void AudioJitterBuffer::OnTimer() {
+    std::lock_guard<std::mutex> output_lock(output_mutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) {
+            return;
+        }
+        Process(esp_timer_get_time());
+    }
+    Deliver();
+}
+
+AudioJitterBufferStats AudioJitterBuffer::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AudioJitterBufferStats stats = stats_;
+    stats.jitter_ms = jitter_us_ / 1000;
+    stats.target_delay_ms = TargetDelayUs() / 1000;
+    return stats;
+}
+
+void AudioJitterBuffer::Process(int64_t now) {
+    const int64_t target = TargetDelayUs();
+    int64_t oldest_arrival = now;
+
+    while (!pending_.empty()) {
+        oldest_arrival = now;
+        for (const auto& item : pending_) {
+            oldest_arrival = std::min(oldest_arrival, item.second.arrival_us);
+        }
+        const int64_t waited = now - oldest_arrival;
+
+        if (buffering_) {
+            int64_t buffered = (int64_t)pending_.size() * frame_duration_ms_ * 1000;
+            if (buffered < target && waited < target) {
+                break;
+            }
+            buffering_ = false;
+        }
+
+        auto it = pending_.begin();
+        if (it->first == next_sequence_) {
+            Emit(std::move(it->second.packet));
+            pending_.erase(it);
+            next_sequence_++;
+            continue;
+        }
+
+        // Give the missing packet the target delay to show up
+        if (waited < target && pending_.size() < kMaxPendingPackets) {
+            break;
+        }
+
+        const uint32_t missing = it->first - next_sequence_;
+        const uint32_t concealed = std::min(missing, kMaxConcealedFrames);
+        stats_.lost += missing;
+        stats_.concealed += concealed;
+        for (uint32_t i = 0; i < concealed; ++i) {
+            auto placeholder = allocate_ ? allocate_() : std::make_unique<AudioStreamPacket>();
+            placeholder->sample_rate = it->second.packet->sample_rate;
+            placeholder->frame_duration = it->second.packet->frame_duration;
+            placeholder->timestamp = 0;
+            placeholder->lost = true;
+            // The frame right before a received packet can be rebuilt from its in-band FEC
+            if (i == concealed - 1 && missing == concealed) {
+                placeholder->payload = it->second.packet->payload;
+            } else {
+                placeholder->payload.clear();
+            }
+            Emit(std::move(placeholder));
+        }
+        next_sequence_ = it->first;
+    }
+
+    esp_timer_stop(timer_);
+    if (!pending_.empty() && !stopping_) {
+        int64_t delay = std::max<int64_t>(oldest_arrival + target - now, 1000);
+        esp_timer_start_once(timer_, delay);
+    }
+}
+
+void AudioJitterBuffer::Emit(std::unique_ptr<AudioStreamPacket> packet) {
+    ready_.push_back(std::move(packet));
+}
+
+void AudioJitterBuffer::Deliver() {
+    for (auto& packet : ready_) {
+        if (output_) {
+            output_(std::move(packet));
+        }
+    }
+    ready_.clear();
+}
+
+void AudioJitterBuffer::Recycle(std::unique_ptr<AudioStreamPacket> packet) {
+    if (recycle_) {
+        recycle_(std::move(packet));
+    }
+}
+
+void AudioJitterBuffer::Clear() {
+    for (auto& item : pending_) {
+        Recycle(std::move(item.second.packet));
+    }
+    pending_.clear();
+}
+
+int64_t AudioJitterBuffer::TargetDelayUs() const {
+    const int64_t frame_us = (int64_t)frame_duration_ms_ * 1000;
+    return std::min(frame_us + 2 * jitter_us_, frame_us * kMaxTargetDelayFrames);
+}
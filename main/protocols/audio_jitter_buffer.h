@@ -0,0 +1,92 @@
+#ifndef AUDIO_JITTER_BUFFER_H
+#define AUDIO_JITTER_BUFFER_H
+
+#include "protocol.h"
+
+#include <esp_timer.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+struct AudioJitterBufferStats {
+    uint32_t jitter_ms = 0;         // Smoothed inter-arrival jitter (RFC 3550 estimator)
+    uint32_t target_delay_ms = 0;   // Current playout delay derived from the jitter
+    uint32_t received = 0;
+    uint32_t reordered = 0;         // Arrived out of order, still in time to be played
+    uint32_t late = 0;              // Arrived after their slot was played or concealed (incl. duplicates)
+    uint32_t lost = 0;              // Never arrived in time
+    uint32_t concealed = 0;         // Lost frames replaced with an FEC/PLC placeholder
+};
+
+/*
+ * Reorders sequenced audio packets from an unreliable transport (UDP) and
+ * replaces the ones that never arrive.
+ *
+ * Packets are released in sequence order. A gap is waited for up to the target
+ * delay, which follows the measured inter-arrival jitter; after that the
+ * missing frames are handed out as placeholder packets (AudioStreamPacket::lost)
+ * so the decoder can run Opus FEC (payload of the next packet) or PLC instead
+ * of skipping them. After the stream has been idle, playout starts again only
+ * once the target delay worth of audio is buffered.
+ *
+ * Placeholders come from the packet allocator and dropped packets go back to
+ * the recycler, so with a packet pool behind them the buffer does not touch
+ * the heap either. Released packets are handed to the output after the state
+ * lock is dropped, so stats(), Reset() and the recycler never wait for it.
+ */
+class AudioJitterBuffer {
+public:
+    using Output = std::function<void(std::unique_ptr<AudioStreamPacket> packet)>;
+    using Allocate = std::function<std::unique_ptr<AudioStreamPacket>()>;
+
+    AudioJitterBuffer();
+    ~AudioJitterBuffer();
+
+    void OnOutput(Output output);
+    // recycle takes the packets that are dropped instead of handed out
+    void SetPacketPool(Allocate allocate, Output recycle);
+    void Reset(int frame_duration_ms);
+    void Put(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet);
+    AudioJitterBufferStats stats() const;
+
+private:
+    struct Entry {
+        std::unique_ptr<AudioStreamPacket> packet;
+        int64_t arrival_us;
+    };
+
+    // Lock order: output_mutex_, mutex_
+    std::mutex output_mutex_;       // Hands out ready_ in order, guards output_
+    mutable std::mutex mutex_;
+    esp_timer_handle_t timer_ = nullptr;
+    bool stopping_ = false;
+    Output output_;
+    std::vector<std::unique_ptr<AudioStreamPacket>> ready_;
+    Allocate allocate_;
+    Output recycle_;
+    std::map<uint32_t, Entry> pending_;
+    int frame_duration_ms_ = 60;
+    bool started_ = false;
+    bool buffering_ = true;
+    uint32_t next_sequence_ = 0;
+    uint32_t highest_sequence_ = 0;
+    uint32_t burst_packets_ = 0;
+    int64_t last_arrival_us_ = 0;
+    int64_t jitter_us_ = 0;
+    AudioJitterBufferStats stats_;
+
+    void PutLocked(uint32_t sequence, std::unique_ptr<AudioStreamPacket> packet);
+    void OnTimer();
+    void Process(int64_t now);
+    void Deliver();
+    void Emit(std::unique_ptr<AudioStreamPacket> packet);
+    void Recycle(std::unique_ptr<AudioStreamPacket> packet);
+    void Clear();
+    int64_t TargetDelayUs() const;
+};
+
+#endif // AUDIO_JITTER_BUFFER_H
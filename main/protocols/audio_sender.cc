@@ -0,0 +1,108 @@
+#include "audio_sender.h"
+#include "audio_service.h"
+#include "protocol.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cstdio>
+
+#define TAG "AudioSender"
+
+AudioSender::AudioSender(AudioService& audio_service) : audio_service_(audio_service) {}
+
+void AudioSender::Start() {
+    if (task_handle_ != nullptr) {
+        return;
+    }
+    // Just below the main task, network writes mostly wait on the socket
+    xTaskCreate([](void* arg) {
+        static_cast<AudioSender*>(arg)->SenderTask();
+        vTaskDelete(NULL);
+    }, "audio_sender", 4096 * 2, this, 9, &task_handle_);
+}
+
+void AudioSender::SetProtocol(Protocol* protocol) {
+    std::lock_guard<std::mutex> lock(protocol_mutex_);
+    protocol_ = protocol;
+}
+
+void AudioSender::Notify() {
+    if (task_handle_ != nullptr) {
+        xTaskNotifyGive(task_handle_);
+    }
+}
+
+void AudioSender::OnSent(std::function<void()> callback) {
+    on_sent_ = std::move(callback);
+}
+
+void AudioSender::SenderTask() {
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        std::lock_guard<std::mutex> lock(protocol_mutex_);
+        size_t sent_packets = 0;
+        while (auto packet = audio_service_.PopPacketFromSendQueue()) {
+            bool sent = true;
+            if (protocol_ != nullptr) {
+                int64_t start_time = esp_timer_get_time();
+                sent = protocol_->SendAudio(*packet);
+                RecordSendTime(static_cast<uint32_t>(esp_timer_get_time() - start_time));
+            }
+            audio_service_.RecyclePacket(std::move(packet));
+            if (!sent) {
+                // Whatever is queued behind a failed send is stale by the time the
+                // channel recovers, and keeping it would stall the encoder
+                size_t dropped_packets = 0;
+                while (auto dropped = audio_service_.PopPacketFromSendQueue()) {
+                    audio_service_.RecyclePacket(std::move(dropped));
+                    dropped_packets++;
+                }
+                // Lets the uplink rate controller back off
+                audio_service_.ReportSendFailure(dropped_packets);
+                break;
+            }
+            sent_packets++;
+        }
+        if (sent_packets > 0) {
+            batch_count_++;
+            packet_count_ += sent_packets;
+            if (on_sent_) {
+                on_sent_();
+            }
+        }
+    }
+}
+
+void AudioSender::RecordSendTime(uint32_t elapsed_us) {
+    size_t bucket = 0;
+    while (bucket < kBucketCount - 1 && elapsed_us >= kBucketLimitsMs[bucket] * 1000) {
+        bucket++;
+    }
+    send_histogram_[bucket]++;
+    uint32_t max = send_time_max_us_.load();
+    while (elapsed_us > max && !send_time_max_us_.compare_exchange_weak(max, elapsed_us)) {
+    }
+}
+
+void AudioSender::PrintStatistics() const {
+    char histogram[128];
+    int length = 0;
+    for (size_t i = 0; i < kBucketCount && length < (int)sizeof(histogram); ++i) {
+        if (i < kBucketCount - 1) {
+            length += snprintf(histogram + length, sizeof(histogram) - length, "<%lums:%lu ",
+                (unsigned long)kBucketLimitsMs[i], (unsigned long)send_histogram_[i].load());
+        } else {
+            length += snprintf(histogram + length, sizeof(histogram) - length, ">=%lums:%lu",
+                (unsigned long)kBucketLimitsMs[i - 1], (unsigned long)send_histogram_[i].load());
+        }
+    }
+    const uint32_t batches = batch_count_.load();
+    const uint32_t packets = packet_count_.load();
+    ESP_LOGI(TAG, "sent %lu packets in %lu batches (avg %lu.%lu per batch), max send %lu us",
+        (unsigned long)packets, (unsigned long)batches,
+        (unsigned long)(batches > 0 ? packets / batches : 0),
+        (unsigned long)(batches > 0 ? packets * 10 / batches % 10 : 0),
+        (unsigned long)send_time_max_us_.load());
+    ESP_LOGI(TAG, "send time: %s", histogram);
+}
@@ -0,0 +1,59 @@
+#ifndef AUDIO_SENDER_H
+#define AUDIO_SENDER_H
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+class AudioService;
+class Protocol;
+
+/*
+ * Sends uplink audio from its own task, so a slow TLS write or cellular send
+ * does not hold up the main loop, and the main loop does not hold up the audio.
+ *
+ * Every wakeup drains the send queue of AudioService in one batch. That queue is
+ * bounded and drops its oldest packet when it runs full; after a failed send the
+ * rest of the batch is dropped as well and reported to the uplink rate controller.
+ * Neither protocol carries more than one Opus frame per WebSocket message or UDP
+ * datagram, so frames are coalesced per wakeup rather than per write.
+ */
+class AudioSender {
+public:
+    explicit AudioSender(AudioService& audio_service);
+
+    void Start();
+    // Blocks until a batch in progress has been sent, so the old protocol can be destroyed
+    void SetProtocol(Protocol* protocol);
+    // Any task, e.g. from AudioServiceCallbacks::on_send_queue_available
+    void Notify();
+    // Called from the sender task after every batch that sent at least one packet
+    void OnSent(std::function<void()> callback);
+    void PrintStatistics() const;
+
+private:
+    // Upper bounds of the send latency buckets in ms, the last bucket takes the rest
+    static constexpr uint32_t kBucketLimitsMs[] = {1, 2, 5, 10, 20, 50, 100};
+    static constexpr size_t kBucketCount = sizeof(kBucketLimitsMs) / sizeof(kBucketLimitsMs[0]) + 1;
+
+    AudioService& audio_service_;
+    TaskHandle_t task_handle_ = nullptr;
+    std::mutex protocol_mutex_;
+    Protocol* protocol_ = nullptr;
+    std::function<void()> on_sent_;
+
+    std::atomic<uint32_t> send_histogram_[kBucketCount] = {};
+    std::atomic<uint32_t> send_time_max_us_{0};
+    std::atomic<uint32_t> batch_count_{0};
+    std::atomic<uint32_t> packet_count_{0};
+
+    void SenderTask();
+    void RecordSendTime(uint32_t elapsed_us);
+};
+
+#endif // AUDIO_SENDER_H
@@ -0,0 +1,223 @@
+#include "json_message.h"
+
+#include <cstdlib>
+#include <cstring>
+
+// Members that are decoded from their text and left out of the cJSON tree
+static const char* const kRawMembers[] = {"glyph_push"};
+
+static bool IsRawMember(std::string_view key) {
+    for (auto name : kRawMembers) {
+        if (key == name) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void JsonReader::SkipWhitespace() {
+    while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t' ||
+                                   text_[pos_] == '\r' || text_[pos_] == '\n')) {
+        pos_++;
+    }
+}
+
+bool JsonReader::Consume(char c) {
+    SkipWhitespace();
+    if (!ok_ || pos_ >= text_.size() || text_[pos_] != c) {
+        return Fail();
+    }
+    pos_++;
+    return true;
+}
+
+bool JsonReader::NextItem(char open, char close) {
+    if (!ok_) {
+        return false;
+    }
+    // Right after the opening bracket there is no separator in front of the first item
+    const bool first = pos_ > 0 && text_[pos_ - 1] == open;
+    SkipWhitespace();
+    if (pos_ >= text_.size()) {
+        return Fail();
+    }
+    if (text_[pos_] == close) {
+        pos_++;
+        return false;
+    }
+    if (!first && !Consume(',')) {
+        return false;
+    }
+    SkipWhitespace();
+    return true;
+}
+
+bool JsonReader::NextMember(std::string_view& key) {
+    if (!NextItem('{', '}')) {
+        return false;
+    }
+    return ReadString(key) && Consume(':');
+}
+
+bool JsonReader::NextElement() {
+    return NextItem('[', ']');
+}
+
+bool JsonReader::ReadString(std::string_view& raw) {
+    if (!Consume('"')) {
+        return false;
+    }
+    const size_t begin = pos_;
+    while (pos_ < text_.size()) {
+        char c = text_[pos_];
+        if (c == '"') {
+            raw = text_.substr(begin, pos_ - begin);
+            pos_++;
+            return true;
+        }
+        if (static_cast<unsigned char>(c) < 0x20) {
+            break;
+        }
+        pos_ += c == '\\' ? 2 : 1;
+    }
+    return Fail();
+}
+
+bool JsonReader::ReadNumber(double& value) {
+    SkipWhitespace();
+    const size_t begin = pos_;
+    while (pos_ < text_.size() && strchr("+-.0123456789eE", text_[pos_]) != nullptr) {
+        pos_++;
+    }
+    char number[32];
+    const size_t length = pos_ - begin;
+    if (length == 0 || length >= sizeof(number)) {
+        return Fail();
+    }
+    memcpy(number, text_.data() + begin, length);
+    number[length] = '\0';
+    char* end = nullptr;
+    value = strtod(number, &end);
+    if (end != number + length) {
+        return Fail();
+    }
+    return true;
+}
+
+bool JsonReader::SkipValue(std::string_view* raw) {
+    SkipWhitespace();
+    if (!ok_ || pos_ >= text_.size()) {
+        return Fail();
+    }
+    const size_t begin = pos_;
+    const char c = text_[pos_];
+    if (c == '"') {
+        std::string_view unused;
+        if (!ReadString(unused)) {
+            return false;
+        }
+    } else if (c == '{' || c == '[') {
+        // Nesting only has to be counted, brackets inside strings are skipped with the strings
+        int depth = 0;
+        do {
+            char current = text_[pos_];
+            if (current == '"') {
+                std::string_view unused;
+                if (!ReadString(unused)) {
+                    return false;
+                }
+                continue;
+            }
+            if (current == '{' || current == '[') {
+                depth++;
+            } else if (current == '}' || current == ']') {
+                depth--;
+            }
+            pos_++;
+        } while (depth > 0 && pos_ < text_.size());
+        if (depth != 0) {
+            return Fail();
+        }
+    } else {
+        // Number, true, false or null
+        while (pos_ < text_.size() && strchr(",}] \t\r\n", text_[pos_]) == nullptr) {
+            pos_++;
+        }
+    }
+    if (raw != nullptr) {
+        *raw = text_.substr(begin, pos_ - begin);
+    }
+    return true;
+}
+
+JsonMessage::JsonMessage(const char* data, size_t size) : text_(data, size) {
+    JsonReader reader(text_);
+    if (!reader.BeginObject()) {
+        return;
+    }
+    std::string_view key;
+    while (reader.NextMember(key)) {
+        std::string_view value;
+        if (!reader.SkipValue(&value)) {
+            return;
+        }
+        members_.push_back({key, value});
+    }
+    if (!reader.ok()) {
+        return;
+    }
+    valid_ = true;
+
+    auto type = Member("type");
+    if (type.size() >= 2 && type.front() == '"' && type.find('\\') == std::string_view::npos) {
+        type_.assign(type.data() + 1, type.size() - 2);
+    }
+}
+
+JsonMessage::~JsonMessage() {
+    if (root_ != nullptr) {
+        cJSON_Delete(root_);
+    }
+}
+
+std::string_view JsonMessage::Member(std::string_view key) const {
+    for (const auto& member : members_) {
+        if (member.key == key) {
+            return member.value;
+        }
+    }
+    return {};
+}
+
+const cJSON* JsonMessage::root() const {
+    if (parsed_ || !valid_) {
+        return root_;
+    }
+    parsed_ = true;
+
+    bool has_raw_member = false;
+    for (const auto& member : members_) {
+        has_raw_member = has_raw_member || IsRawMember(member.key);
+    }
+    if (!has_raw_member) {
+        root_ = cJSON_ParseWithLength(text_.data(), text_.size());
+        return root_;
+    }
+
+    // Parse a copy without the raw members, which is small compared to what they would allocate
+    std::string text = "{";
+    for (const auto& member : members_) {
+        if (IsRawMember(member.key)) {
+            continue;
+        }
+        if (text.size() > 1) {
+            text += ',';
+        }
+        // From the opening quote of the key to the end of the value
+        const char* begin = member.key.data() - 1;
+        text.append(begin, member.value.data() + member.value.size() - begin);
+    }
+    text += '}';
+    root_ = cJSON_ParseWithLength(text.data(), text.size());
+    return root_;
+}
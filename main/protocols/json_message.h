@@ -0,0 +1,85 @@
+#ifndef JSON_MESSAGE_H
+#define JSON_MESSAGE_H
+
+#include <cJSON.h>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/*
+ * Forward-only reader over JSON text. Values are located and skipped without
+ * building a DOM; strings are returned raw (still escaped, without quotes).
+ */
+class JsonReader {
+public:
+    explicit JsonReader(std::string_view text) : text_(text) {}
+
+    bool ok() const { return ok_; }
+
+    bool BeginObject() { return Consume('{'); }
+    // Moves to the next member and returns its key, false at the end of the object or on error
+    bool NextMember(std::string_view& key);
+    bool BeginArray() { return Consume('['); }
+    // Moves to the next element, false at the end of the array or on error
+    bool NextElement();
+
+    bool ReadString(std::string_view& raw);
+    bool ReadNumber(double& value);
+    // Skips the value at the current position, raw receives its complete text
+    bool SkipValue(std::string_view* raw = nullptr);
+
+private:
+    std::string_view text_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+
+    void SkipWhitespace();
+    bool Consume(char c);
+    bool NextItem(char open, char close);
+    bool Fail() {
+        ok_ = false;
+        return false;
+    }
+};
+
+/*
+ * Top level of an incoming JSON text frame.
+ *
+ * The members are only located, so the type can be read and the message routed
+ * before anything is allocated for it. The cJSON tree is built on first use of
+ * root() and leaves out bulky members such as glyph_push, which are decoded
+ * straight from their text with Member().
+ */
+class JsonMessage {
+public:
+    JsonMessage(const char* data, size_t size);
+    ~JsonMessage();
+
+    JsonMessage(const JsonMessage&) = delete;
+    JsonMessage& operator=(const JsonMessage&) = delete;
+
+    bool valid() const { return valid_; }
+    // Empty when the message has no string type
+    const std::string& type() const { return type_; }
+    // Raw text of a top-level member's value, empty if the member is absent
+    std::string_view Member(std::string_view key) const;
+    // nullptr if the message is not valid JSON
+    const cJSON* root() const;
+
+private:
+    struct MemberSpan {
+        std::string_view key;
+        std::string_view value;
+    };
+
+    std::string_view text_;
+    std::vector<MemberSpan> members_;
+    std::string type_;
+    bool valid_ = false;
+    mutable cJSON* root_ = nullptr;
+    mutable bool parsed_ = false;
+};
+
+#endif // JSON_MESSAGE_H
@@ -32,6 +32,16 @@ MqttProtocol::MqttProtocol() {
         .arg = this,
     };
     esp_timer_create(&reconnect_timer_args, &reconnect_timer_);
+
+    jitter_buffer_.OnOutput([this](std::unique_ptr<AudioStreamPacket> packet) {
+        if (on_incoming_audio_ != nullptr) {
+            on_incoming_audio_(std::move(packet));
+        }
+    });
+    jitter_buffer_.SetPacketPool([this]() { return AllocateAudioPacket(); },
+                                 [this](std::unique_ptr<AudioStreamPacket> packet) {
+                                     RecycleAudioPacket(std::move(packet));
+                                 });
 }
 
 MqttProtocol::~MqttProtocol() {
@@ -55,6 +65,8 @@ MqttProtocol::~MqttProtocol() {
 
     {
         std::lock_guard<std::mutex> lock(crypto_mutex_);
+        send_cipher_.Reset();
+        receive_cipher_.Reset();
         if (aes_key_id_ != PSA_KEY_ID_NULL) {
             psa_destroy_key(aes_key_id_);
             aes_key_id_ = PSA_KEY_ID_NULL;
@@ -111,22 +123,23 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
-        if (root == nullptr) {
+        // Route by type before parsing the whole message
+        JsonMessage message(payload.data(), payload.size());
+        if (!message.valid()) {
             ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
             return;
         }
-        cJSON* type = cJSON_GetObjectItem(root, "type");
-        if (!cJSON_IsString(type)) {
+        if (message.type().empty()) {
             ESP_LOGE(TAG, "Message type is invalid");
-            cJSON_Delete(root);
             return;
         }
 
-        if (strcmp(type->valuestring, "hello") == 0) {
-            ParseServerHello(root);
-        } else if (strcmp(type->valuestring, "goodbye") == 0) {
-            auto session_id = cJSON_GetObjectItem(root, "session_id");
+        if (message.type() == "hello") {
+            if (message.root() != nullptr) {
+                ParseServerHello(message.root());
+            }
+        } else if (message.type() == "goodbye") {
+            auto session_id = cJSON_GetObjectItem(message.root(), "session_id");
             ESP_LOGI(TAG, "Received goodbye message, session_id: %s",
                      cJSON_IsString(session_id) ? session_id->valuestring : "null");
             if (cJSON_IsString(session_id) && session_id_ == session_id->valuestring) {
@@ -139,9 +152,8 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
                 });
             }
         } else if (on_incoming_json_ != nullptr) {
-            on_incoming_json_(root);
+            on_incoming_json_(message);
         }
-        cJSON_Delete(root);
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -177,38 +189,36 @@ bool MqttProtocol::SendText(const std::string& text) {
     return true;
 }
 
-bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
+bool MqttProtocol::SendAudio(AudioStreamPacket& packet) {
     std::lock_guard<std::mutex> lock(channel_mutex_);
     if (udp_ == nullptr) {
         return false;
     }
 
     constexpr size_t kAudioHeaderSize = 16;
-    if (aes_nonce_.size() != kAudioHeaderSize || packet->payload.size() > UINT16_MAX) {
-        ESP_LOGE(TAG, "Invalid AES nonce or audio payload length: %zu", packet->payload.size());
+    if (aes_nonce_.size() != kAudioHeaderSize || packet.payload.size() > UINT16_MAX) {
+        ESP_LOGE(TAG, "Invalid AES nonce or audio payload length: %zu", packet.payload.size());
         return false;
     }
 
-    std::string nonce(aes_nonce_);
-    const uint16_t payload_len = htons(static_cast<uint16_t>(packet->payload.size()));
-    const uint32_t timestamp = htonl(packet->timestamp);
+    // The datagram is assembled in a reused buffer: the nonce doubles as the header
+    // and the payload is encrypted straight behind it
+    send_buffer_.resize(kAudioHeaderSize + packet.payload.size());
+    auto nonce = reinterpret_cast<uint8_t*>(send_buffer_.data());
+    const uint16_t payload_len = htons(static_cast<uint16_t>(packet.payload.size()));
+    const uint32_t timestamp = htonl(packet.timestamp);
     const uint32_t sequence = htonl(++local_sequence_);
-    memcpy(nonce.data() + 2, &payload_len, sizeof(payload_len));
-    memcpy(nonce.data() + 8, &timestamp, sizeof(timestamp));
-    memcpy(nonce.data() + 12, &sequence, sizeof(sequence));
+    memcpy(nonce, aes_nonce_.data(), kAudioHeaderSize);
+    memcpy(nonce + 2, &payload_len, sizeof(payload_len));
+    memcpy(nonce + 8, &timestamp, sizeof(timestamp));
+    memcpy(nonce + 12, &sequence, sizeof(sequence));
 
-    std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet->payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
-
-    if (!CryptAesCtr(reinterpret_cast<const uint8_t*>(packet->payload.data()),
-                     packet->payload.size(), reinterpret_cast<const uint8_t*>(nonce.data()),
-                     reinterpret_cast<uint8_t*>(&encrypted[nonce.size()]))) {
+    if (!send_cipher_.Crypt(packet.payload.data(), packet.payload.size(), nonce, nonce + kAudioHeaderSize)) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
         return false;
     }
 
-    return udp_->Send(encrypted) > 0;
+    return udp_->Send(send_buffer_) > 0;
 }
 
 void MqttProtocol::CloseAudioChannel(bool send_goodbye) {
@@ -220,6 +230,11 @@ void MqttProtocol::CloseAudioChannel(bool send_goodbye) {
     udp.reset();
 
     ESP_LOGI(TAG, "Closing audio channel, send_goodbye: %d", send_goodbye);
+    auto stats = jitter_buffer_.stats();
+    ESP_LOGI(TAG, "Jitter buffer: jitter %lu ms, delay %lu ms, received %lu, reordered %lu, late %lu, lost %lu, concealed %lu",
+             (unsigned long)stats.jitter_ms, (unsigned long)stats.target_delay_ms,
+             (unsigned long)stats.received, (unsigned long)stats.reordered, (unsigned long)stats.late,
+             (unsigned long)stats.lost, (unsigned long)stats.concealed);
 
     // Only send goodbye when client initiates the close
     // Don't send if server already sent goodbye (to avoid ping-pong)
@@ -294,43 +309,23 @@ bool MqttProtocol::OpenAudioChannel() {
             return;
         }
 
-        {
-            std::lock_guard<std::mutex> lock(channel_mutex_);
-            if (sequence <= remote_sequence_) {
-                ESP_LOGW(TAG, "Received duplicate/old audio sequence: %lu, last: %lu", sequence,
-                         remote_sequence_);
-                return;
-            }
-            if (sequence != remote_sequence_ + 1) {
-                ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu",
-                         sequence, remote_sequence_ + 1);
-            }
-        }
-
         const size_t decrypted_size = payload_len;
         auto nonce = reinterpret_cast<const uint8_t*>(data.data());
         auto encrypted = reinterpret_cast<const uint8_t*>(data.data() + kAudioHeaderSize);
-        auto packet = std::make_unique<AudioStreamPacket>();
+        auto packet = AllocateAudioPacket();
         packet->sample_rate = server_sample_rate_;
         packet->frame_duration = server_frame_duration_;
         packet->timestamp = timestamp;
         packet->payload.resize(decrypted_size);
-        if (!CryptAesCtr(encrypted, decrypted_size, nonce,
+        if (!receive_cipher_.Crypt(encrypted, decrypted_size, nonce,
                          reinterpret_cast<uint8_t*>(packet->payload.data()))) {
             ESP_LOGE(TAG, "Failed to decrypt audio data");
+            RecycleAudioPacket(std::move(packet));
             return;
         }
-        {
-            std::lock_guard<std::mutex> lock(channel_mutex_);
-            if (sequence <= remote_sequence_) {
-                return;
-            }
-            remote_sequence_ = sequence;
-        }
         last_incoming_time_ = std::chrono::steady_clock::now();
-        if (on_incoming_audio_ != nullptr) {
-            on_incoming_audio_(std::move(packet));
-        }
+        // Reordering, duplicates and lost packets are handled by the jitter buffer
+        jitter_buffer_.Put(sequence, std::move(packet));
     });
 
     if (!udp->Connect(udp_server_, udp_port_)) {
@@ -398,6 +393,8 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
         if (cJSON_IsNumber(frame_duration)) {
             server_frame_duration_ = frame_duration->valueint;
         }
+        auto max_uplink_frame_duration = cJSON_GetObjectItem(audio_params, "max_uplink_frame_duration");
+        max_uplink_frame_duration_ = cJSON_IsNumber(max_uplink_frame_duration) ? max_uplink_frame_duration->valueint : 0;
     }
 
     auto udp = cJSON_GetObjectItem(root, "udp");
@@ -437,19 +434,25 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
 
     {
         std::lock_guard<std::mutex> lock(crypto_mutex_);
+        send_cipher_.Reset();
+        receive_cipher_.Reset();
         if (aes_key_id_ != PSA_KEY_ID_NULL) {
             psa_destroy_key(aes_key_id_);
             aes_key_id_ = PSA_KEY_ID_NULL;
         }
 
+        // AES-CTR is computed by AesCtrCipher from raw AES blocks, in both directions
         psa_key_attributes_t attributes = PSA_KEY_ATTRIBUTES_INIT;
-        psa_set_key_usage_flags(&attributes, PSA_KEY_USAGE_ENCRYPT | PSA_KEY_USAGE_DECRYPT);
-        psa_set_key_algorithm(&attributes, PSA_ALG_CTR);
+        psa_set_key_usage_flags(&attributes, PSA_KEY_USAGE_ENCRYPT);
+        psa_set_key_algorithm(&attributes, PSA_ALG_ECB_NO_PADDING);
         psa_set_key_type(&attributes, PSA_KEY_TYPE_AES);
         psa_set_key_bits(&attributes, 128);
         status = psa_import_key(&attributes, reinterpret_cast<const uint8_t*>(aes_key.data()),
                                 aes_key.size(), &aes_key_id_);
         psa_reset_key_attributes(&attributes);
+        if (status == PSA_SUCCESS && (!send_cipher_.SetKey(aes_key_id_) || !receive_cipher_.SetKey(aes_key_id_))) {
+            status = PSA_ERROR_GENERIC_ERROR;
+        }
     }
     if (status != PSA_SUCCESS) {
         ESP_LOGE(TAG, "Failed to import AES key, status: %ld", static_cast<long>(status));
@@ -461,44 +464,11 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
         udp_port_ = udp_port;
         aes_nonce_ = std::move(aes_nonce);
         local_sequence_ = 0;
-        remote_sequence_ = 0;
     }
+    jitter_buffer_.Reset(server_frame_duration_);
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
-bool MqttProtocol::CryptAesCtr(const uint8_t* input, size_t input_size, const uint8_t* nonce,
-                               uint8_t* output) {
-    std::lock_guard<std::mutex> lock(crypto_mutex_);
-    if (aes_key_id_ == PSA_KEY_ID_NULL || input == nullptr || nonce == nullptr ||
-        output == nullptr) {
-        return false;
-    }
-
-    psa_cipher_operation_t operation = PSA_CIPHER_OPERATION_INIT;
-    psa_status_t status = psa_cipher_encrypt_setup(&operation, aes_key_id_, PSA_ALG_CTR);
-    if (status == PSA_SUCCESS) {
-        status = psa_cipher_set_iv(&operation, nonce, 16);
-    }
-
-    size_t output_len = 0;
-    if (status == PSA_SUCCESS) {
-        status = psa_cipher_update(&operation, input, input_size, output, input_size, &output_len);
-    }
-
-    uint8_t finish_output[16];
-    size_t finish_len = 0;
-    if (status == PSA_SUCCESS) {
-        status = psa_cipher_finish(&operation, finish_output, sizeof(finish_output), &finish_len);
-    }
-    psa_cipher_abort(&operation);
-
-    if (status != PSA_SUCCESS || output_len != input_size || finish_len != 0) {
-        ESP_LOGE(TAG, "AES-CTR operation failed, status: %ld", static_cast<long>(status));
-        return false;
-    }
-    return true;
-}
-
 static inline int CharToHex(char c) {
     if (c >= '0' && c <= '9')
         return c - '0';
@@ -3,6 +3,8 @@
 
 
 #include "protocol.h"
+#include "audio_jitter_buffer.h"
+#include "aes_ctr_cipher.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
@@ -29,10 +31,11 @@ public:
     ~MqttProtocol();
 
     bool Start() override;
-    bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudio(AudioStreamPacket& packet) override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel(bool send_goodbye = true) override;
     bool IsAudioChannelOpened() const override;
+    AudioJitterBufferStats GetJitterBufferStats() const { return jitter_buffer_.stats(); }
 
 private:
     // Alive flag for safe scheduled callbacks - set to false in destructor
@@ -43,21 +46,24 @@ private:
     std::string publish_topic_;
 
     mutable std::mutex channel_mutex_;
-    std::mutex crypto_mutex_;
+    std::mutex crypto_mutex_;   // Guards the key, the ciphers have their own locks
     std::unique_ptr<Mqtt> mqtt_;
     std::unique_ptr<Udp> udp_;
     psa_key_id_t aes_key_id_ = PSA_KEY_ID_NULL;
+    // Separate contexts, so sending and receiving never wait on each other
+    AesCtrCipher send_cipher_;
+    AesCtrCipher receive_cipher_;
     std::string aes_nonce_;
+    std::string send_buffer_;   // Reused for every outgoing datagram, guarded by channel_mutex_
     std::string udp_server_;
     int udp_port_;
     uint32_t local_sequence_;
-    uint32_t remote_sequence_;
+    AudioJitterBuffer jitter_buffer_;
     esp_timer_handle_t reconnect_timer_;
 
     bool StartMqttClient(bool report_error=false);
     void ParseServerHello(const cJSON* root);
     bool DecodeHexString(const std::string& hex_string, std::string& decoded);
-    bool CryptAesCtr(const uint8_t* input, size_t input_size, const uint8_t* nonce, uint8_t* output);
 
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
@@ -1,10 +1,14 @@
 #include "protocol.h"
 #include "assets.h"
+#include "board.h"
 
 #include <esp_log.h>
 
 #define TAG "Protocol"
 
+// Keeps the hello message small, the server pushes the glyphs left out again
+static constexpr size_t kMaxCachedGlyphsInHello = 256;
+
 void Protocol::AddTextFontCapabilities(cJSON* root) {
     auto capability = Assets::GetInstance().text_font_capability();
     cJSON* features = cJSON_GetObjectItem(root, "features");
@@ -20,10 +24,18 @@ void Protocol::AddTextFontCapabilities(cJSON* root) {
     cJSON_AddStringToObject(font, "charset", capability.charset.c_str());
     cJSON_AddNumberToObject(font, "size", capability.size);
     cJSON_AddNumberToObject(font, "bpp", capability.bpp);
+    auto cached = Board::GetInstance().GetDisplay()->GetStoredTextGlyphs(kMaxCachedGlyphsInHello);
+    if (!cached.empty()) {
+        cJSON* codepoints = cJSON_CreateArray();
+        for (auto codepoint : cached) {
+            cJSON_AddItemToArray(codepoints, cJSON_CreateNumber(codepoint));
+        }
+        cJSON_AddItemToObject(font, "cached", codepoints);
+    }
     cJSON_AddItemToObject(root, "text_font", font);
 }
 
-void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
+void Protocol::OnIncomingJson(std::function<void(const JsonMessage& message)> callback) {
     on_incoming_json_ = callback;
 }
 
@@ -32,6 +44,27 @@ void Protocol::OnIncomingAudio(
     on_incoming_audio_ = callback;
 }
 
+void Protocol::SetAudioPacketAllocator(std::function<std::unique_ptr<AudioStreamPacket>()> allocator) {
+    audio_packet_allocator_ = allocator;
+}
+
+std::unique_ptr<AudioStreamPacket> Protocol::AllocateAudioPacket() {
+    if (audio_packet_allocator_ != nullptr) {
+        return audio_packet_allocator_();
+    }
+    return std::make_unique<AudioStreamPacket>();
+}
+
+void Protocol::SetAudioPacketRecycler(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> recycler) {
+    audio_packet_recycler_ = recycler;
+}
+
+void Protocol::RecycleAudioPacket(std::unique_ptr<AudioStreamPacket> packet) {
+    if (audio_packet_recycler_ != nullptr) {
+        audio_packet_recycler_(std::move(packet));
+    }
+}
+
 void Protocol::OnAudioChannelOpened(std::function<void()> callback) {
     on_audio_channel_opened_ = callback;
 }
@@ -1,17 +1,55 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include "json_message.h"
+
 #include <cJSON.h>
 #include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 
+/*
+ * Opus payload with spare room in front of it, so a protocol can write its
+ * header in place and send header and payload as one buffer without copying.
+ * Otherwise it is used like a std::vector<uint8_t> holding just the payload.
+ */
+class AudioPayload {
+public:
+    // Largest protocol header: BinaryProtocol2 and the UDP nonce are both 16 bytes
+    static constexpr size_t kHeadroom = 16;
+
+    uint8_t* data() { return buffer_.data() + kHeadroom; }
+    const uint8_t* data() const { return buffer_.data() + kHeadroom; }
+    size_t size() const { return buffer_.size() - kHeadroom; }
+    bool empty() const { return size() == 0; }
+    void resize(size_t size) { buffer_.resize(kHeadroom + size); }
+    void reserve(size_t size) { buffer_.reserve(kHeadroom + size); }
+    void clear() { buffer_.resize(kHeadroom); }
+    template <typename Iterator>
+    void assign(Iterator first, Iterator last) {
+        buffer_.resize(kHeadroom);
+        buffer_.insert(buffer_.end(), first, last);
+    }
+
+    // The header_size bytes right in front of the payload, header_size <= kHeadroom
+    uint8_t* header(size_t header_size) { return data() - header_size; }
+
+private:
+    std::vector<uint8_t> buffer_ = std::vector<uint8_t>(kHeadroom);
+};
+
 struct AudioStreamPacket {
     int sample_rate = 0;
     int frame_duration = 0;
     uint32_t timestamp = 0;
-    std::vector<uint8_t> payload;
+    // Placeholder for a frame lost in transit: decoded with FEC from payload (the next
+    // packet) when present, or with packet-loss concealment when payload is empty
+    bool lost = false;
+    AudioPayload payload;
 };
 
 struct BinaryProtocol2 {
@@ -44,10 +82,16 @@ public:
 
     inline int server_sample_rate() const { return server_sample_rate_; }
     inline int server_frame_duration() const { return server_frame_duration_; }
+    inline int max_uplink_frame_duration() const { return max_uplink_frame_duration_; }
     inline const std::string& session_id() const { return session_id_; }
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
-    void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    // Incoming packets are taken from here (e.g. a packet pool) instead of the heap
+    void SetAudioPacketAllocator(std::function<std::unique_ptr<AudioStreamPacket>()> allocator);
+    // Incoming packets the protocol drops itself are given back here
+    void SetAudioPacketRecycler(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> recycler);
+    // Messages are routed by type() first, the cJSON tree is only built when root() is used
+    void OnIncomingJson(std::function<void(const JsonMessage& message)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -58,7 +102,8 @@ public:
     virtual bool OpenAudioChannel() = 0;
     virtual void CloseAudioChannel(bool send_goodbye = true) = 0;
     virtual bool IsAudioChannelOpened() const = 0;
-    virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
+    // May write the protocol header into the headroom in front of the payload
+    virtual bool SendAudio(AudioStreamPacket& packet) = 0;
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
@@ -66,8 +111,10 @@ public:
     virtual void SendMcpMessage(const std::string& message);
 
 protected:
-    std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<void(const JsonMessage& message)> on_incoming_json_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
+    std::function<std::unique_ptr<AudioStreamPacket>()> audio_packet_allocator_;
+    std::function<void(std::unique_ptr<AudioStreamPacket> packet)> audio_packet_recycler_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
     std::function<void(const std::string& message)> on_network_error_;
@@ -76,6 +123,7 @@ protected:
 
     int server_sample_rate_ = 24000;
     int server_frame_duration_ = 60;
+    int max_uplink_frame_duration_ = 0;  // Longest uplink frame the server accepts, 0 if not announced
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
@@ -83,6 +131,8 @@ protected:
     virtual bool SendText(const std::string& text) = 0;
     virtual void SetError(const std::string& message);
     virtual bool IsTimeout() const;
+    std::unique_ptr<AudioStreamPacket> AllocateAudioPacket();
+    void RecycleAudioPacket(std::unique_ptr<AudioStreamPacket> packet);
     static void AddTextFontCapabilities(cJSON* root);
 };
 
@@ -1,99 +1,183 @@
 #include "text_glyph_payload.h"
+#include "json_message.h"
 #include "assets.h"
 
 #include <esp_log.h>
 #include <mbedtls/base64.h>
 
-#include <cstring>
+#include <cstdint>
+#include <string>
 #include <utility>
 
 #define TAG "TextGlyphPayload"
 
 namespace TextGlyphPayload {
 
-bool Parse(const cJSON* root, std::vector<TextGlyph>& result, uint8_t& bpp) {
-    auto payload = cJSON_GetObjectItem(root, "glyph_push");
-    if (!cJSON_IsObject(payload)) {
+enum GlyphField {
+    kCodepoint = 1 << 0,
+    kAdvW = 1 << 1,
+    kBoxW = 1 << 2,
+    kBoxH = 1 << 3,
+    kOfsX = 1 << 4,
+    kOfsY = 1 << 5,
+    kBitmap = 1 << 6,
+    kAllFields = (1 << 7) - 1,
+};
+
+static bool InRange(double value, double min, double max) {
+    return value >= min && value <= max;
+}
+
+// Reads one glyph object, the bitmap is base64-decoded straight into the glyph's storage
+static bool ParseGlyph(JsonReader& reader, uint8_t bpp, size_t& total_bitmap_bytes, TextGlyph& glyph) {
+    double codepoint = 0, adv_w = 0, box_w = 0, box_h = 0, ofs_x = 0, ofs_y = 0;
+    std::string_view bitmap;
+    int fields = 0;
+    std::string_view key;
+    reader.BeginObject();
+    while (reader.NextMember(key)) {
+        bool read = true;
+        if (key == "codepoint") {
+            read = reader.ReadNumber(codepoint);
+            fields |= kCodepoint;
+        } else if (key == "adv_w") {
+            read = reader.ReadNumber(adv_w);
+            fields |= kAdvW;
+        } else if (key == "box_w") {
+            read = reader.ReadNumber(box_w);
+            fields |= kBoxW;
+        } else if (key == "box_h") {
+            read = reader.ReadNumber(box_h);
+            fields |= kBoxH;
+        } else if (key == "ofs_x") {
+            read = reader.ReadNumber(ofs_x);
+            fields |= kOfsX;
+        } else if (key == "ofs_y") {
+            read = reader.ReadNumber(ofs_y);
+            fields |= kOfsY;
+        } else if (key == "bitmap") {
+            read = reader.ReadString(bitmap);
+            fields |= kBitmap;
+        } else {
+            read = reader.SkipValue();
+        }
+        if (!read) {
+            break;
+        }
+    }
+    if (!reader.ok() || fields != kAllFields || codepoint <= 0 || codepoint > 0x10FFFF ||
+        !InRange(adv_w, 0, UINT32_MAX) || !InRange(box_w, 0, 64) || !InRange(box_h, 0, 64) ||
+        !InRange(ofs_x, INT16_MIN, INT16_MAX) || !InRange(ofs_y, INT16_MIN, INT16_MAX)) {
+        ESP_LOGW(TAG, "Rejected malformed glyph");
+        return false;
+    }
+
+    glyph.codepoint = static_cast<uint32_t>(codepoint);
+    glyph.adv_w = static_cast<uint32_t>(adv_w);
+    glyph.box_w = static_cast<uint16_t>(box_w);
+    glyph.box_h = static_cast<uint16_t>(box_h);
+    glyph.ofs_x = static_cast<int16_t>(ofs_x);
+    glyph.ofs_y = static_cast<int16_t>(ofs_y);
+
+    const size_t expected = (static_cast<size_t>(glyph.box_w) * glyph.box_h * bpp + 7) / 8;
+    total_bitmap_bytes += expected;
+    if (total_bitmap_bytes > 64 * 1024) {
+        ESP_LOGW(TAG, "Rejected oversized glyph payload");
+        return false;
+    }
+    // Every '/' may arrive escaped as "\/", so the raw string can be up to twice the limit
+    const size_t max_base64 = ((expected + 2) / 3) * 4 + 4;
+    if (bitmap.size() > max_base64 * 2) {
+        ESP_LOGW(TAG, "Rejected oversized base64 bitmap");
+        return false;
+    }
+
+    // Base64 only needs unescaping when the server escaped '/' as "\/"
+    std::string unescaped;
+    if (bitmap.find('\\') != std::string_view::npos) {
+        unescaped.reserve(bitmap.size());
+        for (size_t i = 0; i < bitmap.size(); ++i) {
+            if (bitmap[i] == '\\' && i + 1 < bitmap.size() && bitmap[i + 1] == '/') {
+                continue;
+            }
+            unescaped += bitmap[i];
+        }
+        bitmap = unescaped;
+    }
+    if (bitmap.size() > max_base64) {
+        ESP_LOGW(TAG, "Rejected oversized base64 bitmap");
+        return false;
+    }
+    if (expected == 0) {
+        return bitmap.empty();
+    }
+
+    glyph.bitmap.resize(expected);
+    size_t decoded = 0;
+    int rc = mbedtls_base64_decode(glyph.bitmap.data(), glyph.bitmap.size(), &decoded,
+                                   reinterpret_cast<const unsigned char*>(bitmap.data()), bitmap.size());
+    if (rc != 0 || decoded != expected) {
+        ESP_LOGW(TAG, "Rejected invalid bitmap for U+%04lX", static_cast<unsigned long>(glyph.codepoint));
+        return false;
+    }
+    return true;
+}
+
+bool Parse(std::string_view payload, std::vector<TextGlyph>& result, uint8_t& bpp) {
+    if (payload.empty() || payload.front() != '{') {
         return true;
     }
-    auto version = cJSON_GetObjectItem(payload, "v");
-    auto bundle = cJSON_GetObjectItem(payload, "bundle");
-    auto size = cJSON_GetObjectItem(payload, "size");
-    auto wire_bpp = cJSON_GetObjectItem(payload, "bpp");
-    auto glyphs = cJSON_GetObjectItem(payload, "glyphs");
+
+    // The header may come after the glyphs, so only locate the glyphs on the first pass
+    double version = 0, size = 0, wire_bpp = 0;
+    std::string_view bundle, glyphs;
+    bool header_valid = true;
+    JsonReader reader(payload);
+    std::string_view key;
+    reader.BeginObject();
+    while (header_valid && reader.NextMember(key)) {
+        if (key == "v") {
+            header_valid = reader.ReadNumber(version);
+        } else if (key == "bundle") {
+            header_valid = reader.ReadString(bundle);
+        } else if (key == "size") {
+            header_valid = reader.ReadNumber(size);
+        } else if (key == "bpp") {
+            header_valid = reader.ReadNumber(wire_bpp);
+        } else if (key == "glyphs") {
+            header_valid = reader.SkipValue(&glyphs);
+        } else {
+            header_valid = reader.SkipValue();
+        }
+    }
     auto capability = Assets::GetInstance().text_font_capability();
-    if (!capability.glyph_push || !cJSON_IsNumber(version) || version->valueint != 1 ||
-        !cJSON_IsString(bundle) || capability.bundle != bundle->valuestring ||
-        !cJSON_IsNumber(size) || size->valuedouble != capability.size ||
-        !cJSON_IsNumber(wire_bpp) || wire_bpp->valuedouble != capability.bpp ||
-        !cJSON_IsArray(glyphs) || cJSON_GetArraySize(glyphs) > 64) {
+    if (!header_valid || !reader.ok() || !capability.glyph_push || version != 1 ||
+        capability.bundle != bundle || size != capability.size || wire_bpp != capability.bpp ||
+        glyphs.empty() || glyphs.front() != '[') {
         ESP_LOGW(TAG, "Rejected incompatible glyph payload");
         return false;
     }
 
-    const uint8_t parsed_bpp = static_cast<uint8_t>(wire_bpp->valueint);
+    const uint8_t parsed_bpp = static_cast<uint8_t>(wire_bpp);
     std::vector<TextGlyph> parsed;
-    parsed.reserve(cJSON_GetArraySize(glyphs));
     size_t total_bitmap_bytes = 0;
-    cJSON* item = nullptr;
-    cJSON_ArrayForEach (item, glyphs) {
-        auto codepoint = cJSON_GetObjectItem(item, "codepoint");
-        auto adv_w = cJSON_GetObjectItem(item, "adv_w");
-        auto box_w = cJSON_GetObjectItem(item, "box_w");
-        auto box_h = cJSON_GetObjectItem(item, "box_h");
-        auto ofs_x = cJSON_GetObjectItem(item, "ofs_x");
-        auto ofs_y = cJSON_GetObjectItem(item, "ofs_y");
-        auto bitmap = cJSON_GetObjectItem(item, "bitmap");
-        if (!cJSON_IsNumber(codepoint) || codepoint->valuedouble <= 0 ||
-            codepoint->valuedouble > 0x10FFFF || !cJSON_IsNumber(adv_w) || adv_w->valuedouble < 0 ||
-            adv_w->valuedouble > UINT32_MAX || !cJSON_IsNumber(box_w) || box_w->valueint < 0 ||
-            box_w->valueint > 64 || !cJSON_IsNumber(box_h) || box_h->valueint < 0 ||
-            box_h->valueint > 64 || !cJSON_IsNumber(ofs_x) || ofs_x->valueint < INT16_MIN ||
-            ofs_x->valueint > INT16_MAX || !cJSON_IsNumber(ofs_y) || ofs_y->valueint < INT16_MIN ||
-            ofs_y->valueint > INT16_MAX || !cJSON_IsString(bitmap)) {
-            ESP_LOGW(TAG, "Rejected malformed glyph");
+    JsonReader glyph_reader(glyphs);
+    glyph_reader.BeginArray();
+    while (glyph_reader.NextElement()) {
+        if (parsed.size() == 64) {
+            ESP_LOGW(TAG, "Rejected incompatible glyph payload");
             return false;
         }
-
-        const size_t expected =
-            (static_cast<size_t>(box_w->valueint) * box_h->valueint * parsed_bpp + 7) / 8;
-        total_bitmap_bytes += expected;
-        if (total_bitmap_bytes > 64 * 1024) {
-            ESP_LOGW(TAG, "Rejected oversized glyph payload");
-            return false;
-        }
-
         TextGlyph glyph;
-        glyph.codepoint = static_cast<uint32_t>(codepoint->valuedouble);
-        glyph.adv_w = static_cast<uint32_t>(adv_w->valuedouble);
-        glyph.box_w = static_cast<uint16_t>(box_w->valueint);
-        glyph.box_h = static_cast<uint16_t>(box_h->valueint);
-        glyph.ofs_x = static_cast<int16_t>(ofs_x->valueint);
-        glyph.ofs_y = static_cast<int16_t>(ofs_y->valueint);
-        glyph.bitmap.resize(expected);
-        const size_t encoded_length = strlen(bitmap->valuestring);
-        if (encoded_length > ((expected + 2) / 3) * 4 + 4) {
-            ESP_LOGW(TAG, "Rejected oversized base64 bitmap");
-            return false;
-        }
-        if (expected == 0) {
-            if (encoded_length != 0) {
-                return false;
-            }
-            parsed.push_back(std::move(glyph));
-            continue;
-        }
-        size_t decoded = 0;
-        int rc = mbedtls_base64_decode(glyph.bitmap.data(), glyph.bitmap.size(), &decoded,
-                                       reinterpret_cast<const unsigned char*>(bitmap->valuestring),
-                                       encoded_length);
-        if (rc != 0 || decoded != expected) {
-            ESP_LOGW(TAG, "Rejected invalid bitmap for U+%04lX",
-                     static_cast<unsigned long>(glyph.codepoint));
+        if (!ParseGlyph(glyph_reader, parsed_bpp, total_bitmap_bytes, glyph)) {
             return false;
         }
         parsed.push_back(std::move(glyph));
     }
+    if (!glyph_reader.ok()) {
+        ESP_LOGW(TAG, "Rejected malformed glyph");
+        return false;
+    }
     result = std::move(parsed);
     bpp = parsed_bpp;
     return true;
@@ -2,13 +2,13 @@
 
 #include "display/text_glyph.h"
 
-#include <cJSON.h>
-
 #include <cstdint>
+#include <string_view>
 #include <vector>
 
 namespace TextGlyphPayload {
 
-bool Parse(const cJSON* root, std::vector<TextGlyph>& result, uint8_t& bpp);
+// payload is the raw JSON text of a glyph_push object, see JsonMessage::Member()
+bool Parse(std::string_view payload, std::vector<TextGlyph>& result, uint8_t& bpp);
 
 }  // namespace TextGlyphPayload
@@ -0,0 +1,57 @@
+#ifndef PSRAM_ALLOCATOR_H
+#define PSRAM_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <type_traits>
+#include <vector>
+
+#include <esp_heap_caps.h>
+
+// Standard allocator for large buffers: PSRAM when the board has it (and it has room),
+// internal RAM otherwise. Aborts like operator new when both are exhausted.
+template <typename T>
+class PsramAllocator {
+public:
+    using value_type = T;
+    using is_always_equal = std::true_type;
+
+    PsramAllocator() noexcept = default;
+
+    template <typename U>
+    PsramAllocator(const PsramAllocator<U>&) noexcept {}
+
+    T* allocate(size_t count) {
+        if (count == 0) {
+            return nullptr;
+        }
+        if (count > std::numeric_limits<size_t>::max() / sizeof(T)) {
+            std::abort();
+        }
+        auto ptr = static_cast<T*>(heap_caps_malloc_prefer(count * sizeof(T), 2,
+            MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT));
+        if (ptr == nullptr) {
+            std::abort();
+        }
+        return ptr;
+    }
+
+    void deallocate(T* ptr, size_t) noexcept { heap_caps_free(ptr); }
+};
+
+template <typename T, typename U>
+bool operator==(const PsramAllocator<T>&, const PsramAllocator<U>&) {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const PsramAllocator<T>&, const PsramAllocator<U>&) {
+    return false;
+}
+
+template <typename T>
+using PsramVector = std::vector<T, PsramAllocator<T>>;
+
+#endif // PSRAM_ALLOCATOR_H
@@ -0,0 +1,55 @@
+#include "wake_word_latency.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <algorithm>
+
+#define TAG "WakeWordLatency"
+
+void WakeWordLatency::OnDetected() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    detected_time_ = esp_timer_get_time();
+}
+
+void WakeWordLatency::Start(bool channel_warm) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Invocations without a detected wake word (e.g. WakeWordInvoke) start now
+    start_time_ = detected_time_ != 0 ? detected_time_ : esp_timer_get_time();
+    detected_time_ = 0;
+    uplink_pending_ = true;
+    downlink_pending_ = true;
+    warm_ = channel_warm;
+}
+
+void WakeWordLatency::Cancel() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    detected_time_ = 0;
+    uplink_pending_ = false;
+    downlink_pending_ = false;
+}
+
+void WakeWordLatency::OnUplinkAudio() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (uplink_pending_) {
+        uplink_pending_ = false;
+        Record(uplink_[warm_], "first uplink");
+    }
+}
+
+void WakeWordLatency::OnDownlinkAudio() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (downlink_pending_) {
+        downlink_pending_ = false;
+        Record(downlink_[warm_], "first TTS audio");
+    }
+}
+
+void WakeWordLatency::Record(Stats& stats, const char* name) {
+    const uint32_t ms = (esp_timer_get_time() - start_time_) / 1000;
+    stats.count++;
+    stats.total_ms += ms;
+    stats.max_ms = std::max(stats.max_ms, ms);
+    ESP_LOGI(TAG, "Wake word to %s: %lu ms, %s channel (avg %lu ms, max %lu ms over %lu)", name,
+             (unsigned long)ms, warm_ ? "warm" : "cold", (unsigned long)(stats.total_ms / stats.count),
+             (unsigned long)stats.max_ms, (unsigned long)stats.count);
+}
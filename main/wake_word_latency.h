@@ -0,0 +1,44 @@
+#ifndef WAKE_WORD_LATENCY_H
+#define WAKE_WORD_LATENCY_H
+
+#include <cstdint>
+#include <mutex>
+
+/**
+ * WakeWordLatency - Measures how long a wake word invocation takes to reach the server
+ *
+ * Two latencies are measured from the wake word: to the first uplink audio packet,
+ * and to the first TTS audio packet. They are kept separately for invocations that
+ * found the audio channel already open (warm) and those that had to open it (cold).
+ */
+class WakeWordLatency {
+public:
+    // Any task, when the wake word is detected
+    void OnDetected();
+    // Main task, when the invocation starts
+    void Start(bool channel_warm);
+    // The invocation ended before all latencies were measured
+    void Cancel();
+    void OnUplinkAudio();
+    void OnDownlinkAudio();
+
+private:
+    struct Stats {
+        uint32_t count = 0;
+        uint64_t total_ms = 0;
+        uint32_t max_ms = 0;
+    };
+
+    std::mutex mutex_;
+    int64_t detected_time_ = 0;
+    int64_t start_time_ = 0;
+    bool uplink_pending_ = false;
+    bool downlink_pending_ = false;
+    bool warm_ = false;
+    Stats uplink_[2];       // Indexed by warm_
+    Stats downlink_[2];
+
+    void Record(Stats& stats, const char* name);
+};
+
+#endif // WAKE_WORD_LATENCY_H
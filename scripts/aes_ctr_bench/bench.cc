@@ -0,0 +1,128 @@
+/*
+ * Host benchmark for the MQTT audio AES-CTR path.
+ *
+ * "per-packet" is the previous MqttProtocol::CryptAesCtr: a CTR operation is
+ * set up, given the IV, updated, finished and aborted under one lock for
+ * every datagram. "prepared" is AesCtrCipher from main/protocols. Both are
+ * checked to produce the same bytes before timing.
+ */
+#include "aes_ctr_cipher.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+static std::mutex g_crypto_mutex;
+
+static bool CryptPerPacket(psa_key_id_t key_id, const uint8_t* input, size_t input_size, const uint8_t* nonce,
+                           uint8_t* output) {
+    std::lock_guard<std::mutex> lock(g_crypto_mutex);
+    psa_cipher_operation_t operation = PSA_CIPHER_OPERATION_INIT;
+    psa_status_t status = psa_cipher_encrypt_setup(&operation, key_id, PSA_ALG_CTR);
+    if (status == PSA_SUCCESS) {
+        status = psa_cipher_set_iv(&operation, nonce, 16);
+    }
+    size_t output_len = 0;
+    if (status == PSA_SUCCESS) {
+        status = psa_cipher_update(&operation, input, input_size, output, input_size, &output_len);
+    }
+    uint8_t finish_output[16];
+    size_t finish_len = 0;
+    if (status == PSA_SUCCESS) {
+        status = psa_cipher_finish(&operation, finish_output, sizeof(finish_output), &finish_len);
+    }
+    psa_cipher_abort(&operation);
+    return status == PSA_SUCCESS && output_len == input_size && finish_len == 0;
+}
+
+// Same layout as MqttProtocol: type, flags, payload_len, ssrc, timestamp, sequence
+static void MakeNonce(uint8_t* nonce, size_t payload_len, uint32_t timestamp, uint32_t sequence) {
+    for (int i = 0; i < 16; ++i) {
+        nonce[i] = (uint8_t)(0x5a ^ (i * 37));
+    }
+    nonce[0] = 0x01;
+    nonce[2] = (uint8_t)(payload_len >> 8);
+    nonce[3] = (uint8_t)payload_len;
+    nonce[8] = (uint8_t)(timestamp >> 24);
+    nonce[9] = (uint8_t)(timestamp >> 16);
+    nonce[10] = (uint8_t)(timestamp >> 8);
+    nonce[11] = (uint8_t)timestamp;
+    nonce[12] = (uint8_t)(sequence >> 24);
+    nonce[13] = (uint8_t)(sequence >> 16);
+    nonce[14] = (uint8_t)(sequence >> 8);
+    nonce[15] = (uint8_t)sequence;
+}
+
+static bool Verify(psa_key_id_t key_id, AesCtrCipher& cipher) {
+    std::vector<uint8_t> input(1500), expected(1500), actual(1500);
+    for (size_t i = 0; i < input.size(); ++i) {
+        input[i] = (uint8_t)rand();
+    }
+    const size_t sizes[] = {1, 15, 16, 17, 60, 120, 333, 1500};
+    // The last sequences make the low counter bytes carry into the sequence and beyond
+    const uint32_t sequences[] = {0, 1, 0xff, 0xfffffffe, 0xffffffff};
+    for (size_t size : sizes) {
+        for (uint32_t sequence : sequences) {
+            uint8_t nonce[16];
+            MakeNonce(nonce, size, sequence * 60, sequence);
+            if (!CryptPerPacket(key_id, input.data(), size, nonce, expected.data()) ||
+                !cipher.Crypt(input.data(), size, nonce, actual.data()) ||
+                memcmp(expected.data(), actual.data(), size) != 0) {
+                printf("Mismatch at size %zu sequence %u\n", size, sequence);
+                return false;
+            }
+            // In place, as used on the send path
+            std::vector<uint8_t> in_place(input.begin(), input.begin() + size);
+            if (!cipher.Crypt(in_place.data(), size, nonce, in_place.data()) ||
+                memcmp(expected.data(), in_place.data(), size) != 0) {
+                printf("In-place mismatch at size %zu sequence %u\n", size, sequence);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+template <typename F>
+static double NsPerPacket(int packets, F&& crypt) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < packets; ++i) {
+        crypt((uint32_t)i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / packets;
+}
+
+int main(int argc, char** argv) {
+    const int packets = argc > 1 ? atoi(argv[1]) : 200000;
+    const uint8_t key[16] = {0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+                             0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c};
+    psa_key_id_t key_id = PSA_KEY_ID_NULL;
+    psa_bench_import_key(key, &key_id);
+
+    AesCtrCipher cipher;
+    if (!cipher.SetKey(key_id) || !Verify(key_id, cipher)) {
+        return 1;
+    }
+    printf("Output identical to per-packet PSA_ALG_CTR\n\n");
+
+    // Typical Opus payloads: 16 kbps / 60 ms, 24 kbps / 60 ms, 24 kbps / 120 ms, a full MTU
+    const size_t sizes[] = {60, 120, 240, 1400};
+    std::vector<uint8_t> buffer(1500, 0x55);
+    printf("%8s %16s %16s %8s\n", "bytes", "per-packet ns", "prepared ns", "speedup");
+    for (size_t size : sizes) {
+        uint8_t nonce[16];
+        double before = NsPerPacket(packets, [&](uint32_t sequence) {
+            MakeNonce(nonce, size, sequence * 60, sequence);
+            CryptPerPacket(key_id, buffer.data(), size, nonce, buffer.data());
+        });
+        double after = NsPerPacket(packets, [&](uint32_t sequence) {
+            MakeNonce(nonce, size, sequence * 60, sequence);
+            cipher.Crypt(buffer.data(), size, nonce, buffer.data());
+        });
+        printf("%8zu %16.1f %16.1f %7.2fx\n", size, before, after, before / after);
+    }
+    return 0;
+}
@@ -0,0 +1,9 @@
+/* Host stand-in for esp_log.h */
+#ifndef AES_CTR_BENCH_ESP_LOG_H
+#define AES_CTR_BENCH_ESP_LOG_H
+
+#include <cstdio>
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+
+#endif // AES_CTR_BENCH_ESP_LOG_H
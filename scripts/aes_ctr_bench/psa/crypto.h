@@ -0,0 +1,94 @@
+/*
+ * Minimal host stand-in for the PSA Crypto calls used by the MQTT audio
+ * cipher, implemented on top of OpenSSL EVP. Only what the benchmark needs.
+ */
+#ifndef AES_CTR_BENCH_PSA_CRYPTO_H
+#define AES_CTR_BENCH_PSA_CRYPTO_H
+
+#include <openssl/evp.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+typedef int32_t psa_status_t;
+typedef uint32_t psa_key_id_t;
+typedef uint32_t psa_algorithm_t;
+
+#define PSA_SUCCESS ((psa_status_t)0)
+#define PSA_ERROR_GENERIC_ERROR ((psa_status_t)-132)
+#define PSA_ERROR_BAD_STATE ((psa_status_t)-137)
+#define PSA_KEY_ID_NULL ((psa_key_id_t)0)
+#define PSA_ALG_CTR ((psa_algorithm_t)0x04c01000)
+#define PSA_ALG_ECB_NO_PADDING ((psa_algorithm_t)0x04404400)
+
+struct psa_cipher_operation_t {
+    EVP_CIPHER_CTX* ctx;
+    psa_algorithm_t alg;
+};
+#define PSA_CIPHER_OPERATION_INIT {nullptr, 0}
+
+// A single 128-bit key slot is enough for the benchmark
+inline uint8_t g_bench_key[16];
+
+inline psa_status_t psa_bench_import_key(const uint8_t* key, psa_key_id_t* key_id) {
+    memcpy(g_bench_key, key, sizeof(g_bench_key));
+    *key_id = 1;
+    return PSA_SUCCESS;
+}
+
+inline psa_status_t psa_cipher_abort(psa_cipher_operation_t* operation) {
+    if (operation->ctx != nullptr) {
+        EVP_CIPHER_CTX_free(operation->ctx);
+    }
+    operation->ctx = nullptr;
+    operation->alg = 0;
+    return PSA_SUCCESS;
+}
+
+inline psa_status_t psa_cipher_encrypt_setup(psa_cipher_operation_t* operation, psa_key_id_t key_id,
+                                             psa_algorithm_t alg) {
+    if (operation->ctx != nullptr || key_id == PSA_KEY_ID_NULL) {
+        return PSA_ERROR_BAD_STATE;
+    }
+    operation->ctx = EVP_CIPHER_CTX_new();
+    operation->alg = alg;
+    const EVP_CIPHER* cipher = alg == PSA_ALG_CTR ? EVP_aes_128_ctr() : EVP_aes_128_ecb();
+    // The key schedule is expanded here, as in mbedTLS
+    if (EVP_EncryptInit_ex(operation->ctx, cipher, nullptr, g_bench_key, nullptr) != 1) {
+        return PSA_ERROR_GENERIC_ERROR;
+    }
+    EVP_CIPHER_CTX_set_padding(operation->ctx, 0);
+    return PSA_SUCCESS;
+}
+
+inline psa_status_t psa_cipher_set_iv(psa_cipher_operation_t* operation, const uint8_t* iv, size_t iv_length) {
+    if (operation->alg != PSA_ALG_CTR || iv_length != 16) {
+        return PSA_ERROR_BAD_STATE;
+    }
+    return EVP_EncryptInit_ex(operation->ctx, nullptr, nullptr, nullptr, iv) == 1 ? PSA_SUCCESS
+                                                                                  : PSA_ERROR_GENERIC_ERROR;
+}
+
+inline psa_status_t psa_cipher_update(psa_cipher_operation_t* operation, const uint8_t* input, size_t input_length,
+                                      uint8_t* output, size_t output_size, size_t* output_length) {
+    int len = 0;
+    if (operation->ctx == nullptr || output_size < input_length ||
+        EVP_EncryptUpdate(operation->ctx, output, &len, input, (int)input_length) != 1) {
+        return PSA_ERROR_GENERIC_ERROR;
+    }
+    *output_length = (size_t)len;
+    return PSA_SUCCESS;
+}
+
+inline psa_status_t psa_cipher_finish(psa_cipher_operation_t* operation, uint8_t* output, size_t output_size,
+                                      size_t* output_length) {
+    int len = 0;
+    if (operation->ctx == nullptr || EVP_EncryptFinal_ex(operation->ctx, output, &len) != 1) {
+        return PSA_ERROR_GENERIC_ERROR;
+    }
+    *output_length = (size_t)len;
+    return PSA_SUCCESS;
+}
+
+#endif // AES_CTR_BENCH_PSA_CRYPTO_H
@@ -0,0 +1,414 @@
+/*
+ * Host benchmark for main/partition_writer.cc, the pipeline behind Assets::Download().
+ *
+ * Downloads an assets image from a file-backed HTTP stand-in into a RAM-backed
+ * fake partition, once with the serial loop Assets::Download() used before and
+ * once through DownloadResume::Receive() into PartitionWriter, the way
+ * Assets::Download() does now, and reports both times. The stand-in delivers
+ * at a fixed rate into a TCP-sized receive window, so the network only keeps
+ * going while the reader is busy as far as the window allows. The partition
+ * sleeps for erases and page programs, and fails any write to bytes that were
+ * not erased first.
+ *
+ * Both images are checked against the source, and the header against the rule
+ * that it is written last. Then the failures: an erase error, a write error, a
+ * truncated stream and an image larger than the partition must fail without a
+ * deadlock and without a header in flash.
+ */
+#include "download_resume.h"
+#include "partition_writer.h"
+#include "settings.h"
+#include "http.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Settings in memory, DownloadResume keeps its record there
+static std::map<std::string, std::map<std::string, std::string>> nvs;
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {}
+Settings::~Settings() {}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    auto& entries = nvs[ns_];
+    auto it = entries.find(key);
+    return it == entries.end() ? default_value : it->second;
+}
+
+void Settings::SetString(const std::string& key, const std::string& value) {
+    nvs[ns_][key] = value;
+}
+
+int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
+    auto& entries = nvs[ns_];
+    auto it = entries.find(key);
+    return it == entries.end() ? default_value : (int32_t)strtol(it->second.c_str(), nullptr, 10);
+}
+
+void Settings::SetInt(const std::string& key, int32_t value) {
+    nvs[ns_][key] = std::to_string(value);
+}
+
+bool Settings::GetBool(const std::string& key, bool default_value) {
+    return GetInt(key, default_value) != 0;
+}
+
+void Settings::SetBool(const std::string& key, bool value) {
+    SetInt(key, value);
+}
+
+void Settings::EraseKey(const std::string& key) {
+    nvs[ns_].erase(key);
+}
+
+void Settings::EraseAll() {
+    nvs[ns_].clear();
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kHeaderSize = 12;
+constexpr size_t kSectorSize = 4096;
+constexpr size_t kBlockSize = 65536;
+constexpr size_t kPageSize = 256;
+constexpr size_t kMss = 1440;
+constexpr size_t kReceiveWindow = 4 * kMss;     // CONFIG_LWIP_TCP_WND_DEFAULT
+
+double Seconds(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Serves a file at a fixed rate, like Http::Read() over a TCP connection. It sends no
+// ETag, so a dropped download does not resume; the download resume test covers that.
+class FileHttp : public Http {
+public:
+    FileHttp(const std::string& path, size_t bytes_per_second, size_t truncate_at = SIZE_MAX)
+        : file_(path, std::ios::binary), bytes_per_second_(bytes_per_second) {
+        file_.seekg(0, std::ios::end);
+        length_ = file_.tellg();
+        file_.seekg(0);
+        end_ = std::min(length_, truncate_at);
+        last_ = Clock::now();
+    }
+
+    void SetTimeout(int) override {}
+    void SetHeader(const std::string&, const std::string&) override {}
+    void SetContent(std::string&&) override {}
+    bool Open(const std::string&, const std::string&) override { return true; }
+    void Close() override {}
+    int Write(const char*, size_t) override { return -1; }
+    int GetStatusCode() override { return 200; }
+    std::string GetResponseHeader(const std::string&) const override { return ""; }
+    size_t GetBodyLength() override { return length_; }
+    std::string ReadAll() override { return ""; }
+    int GetLastError() override { return 0; }
+
+    int Read(char* buffer, size_t size) override {
+        if (served_ == end_) {
+            return 0;
+        }
+        Arrive();
+        while (buffered_ == 0) {
+            std::this_thread::sleep_for(std::chrono::microseconds(kMss * 1000000 / bytes_per_second_));
+            Arrive();
+        }
+        size_t len = std::min({size, buffered_, kMss * 4});
+        file_.read(buffer, len);
+        buffered_ -= len;
+        served_ += len;
+        return len;
+    }
+
+private:
+    std::ifstream file_;
+    size_t bytes_per_second_;
+    size_t length_ = 0;
+    size_t end_ = 0;
+    size_t served_ = 0;
+    size_t buffered_ = 0;
+    Clock::time_point last_;
+
+    // Data keeps arriving while the reader is busy, until the window is full
+    void Arrive() {
+        auto now = Clock::now();
+        double arrived = std::chrono::duration<double>(now - last_).count() * bytes_per_second_;
+        if (arrived < 1) {
+            return;
+        }
+        last_ = now;
+        buffered_ = std::min({buffered_ + (size_t)arrived, kReceiveWindow, end_ - served_});
+    }
+};
+
+// NOR flash in RAM: erase sets 0xFF, programming needs erased bytes
+class FakePartition {
+public:
+    FakePartition(size_t size, int erase_ms, int block_erase_ms, int program_us)
+        : data_(size, 0), erase_ms_(erase_ms), block_erase_ms_(block_erase_ms), program_us_(program_us) {}
+
+    bool Erase(size_t offset, size_t size) {
+        if (offset % kSectorSize != 0 || size % kSectorSize != 0 || offset + size > data_.size()) {
+            return false;
+        }
+        if (fail_erase_at_ >= offset && fail_erase_at_ < offset + size) {
+            return false;
+        }
+        // Aligned blocks take a block erase, like esp_flash_erase_region()
+        int ms = offset % kBlockSize == 0 && size % kBlockSize == 0 ? block_erase_ms_ * (size / kBlockSize)
+                                                                   : erase_ms_ * (size / kSectorSize);
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        std::lock_guard<std::mutex> lock(mutex_);
+        memset(&data_[offset], 0xFF, size);
+        erases_ += size / kSectorSize;
+        return true;
+    }
+
+    bool Write(size_t offset, const void* data, size_t size) {
+        if (offset + size > data_.size() || fail_write_at_ == offset) {
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (size_t i = 0; i < size; i++) {
+                if (data_[offset + i] != 0xFF) {
+                    fprintf(stderr, "Programming byte %u that is not erased\n", (unsigned)(offset + i));
+                    return false;
+                }
+            }
+            memcpy(&data_[offset], data, size);
+        }
+        size_t pages = (offset + size + kPageSize - 1) / kPageSize - offset / kPageSize;
+        std::this_thread::sleep_for(std::chrono::microseconds(program_us_ * pages));
+        return true;
+    }
+
+    PartitionWriter::Target Target() {
+        PartitionWriter::Target target;
+        target.size = data_.size();
+        target.sector_size = kSectorSize;
+        target.block_size = kBlockSize;
+        target.erase = [this](size_t offset, size_t size) { return Erase(offset, size); };
+        target.write = [this](size_t offset, const void* data, size_t size) { return Write(offset, data, size); };
+        return target;
+    }
+
+    const std::vector<uint8_t>& data() const { return data_; }
+    size_t erases() const { return erases_; }
+    size_t fail_erase_at_ = SIZE_MAX;
+    size_t fail_write_at_ = SIZE_MAX;
+
+private:
+    std::vector<uint8_t> data_;
+    int erase_ms_;
+    int block_erase_ms_;
+    int program_us_;
+    size_t erases_ = 0;
+    std::mutex mutex_;
+};
+
+// The loop Assets::Download() used before: read a sector, erase, write, in turn
+bool DownloadSerial(FileHttp& http, FakePartition& partition) {
+    size_t content_length = http.GetBodyLength();
+    size_t size = partition.data().size();
+    if (content_length < kHeaderSize || content_length > size) {
+        return false;
+    }
+    std::vector<char> buffer(kSectorSize);
+    uint8_t header_buf[kHeaderSize];
+    size_t header_collected = 0;
+    size_t total_written = 0;
+    size_t current_sector = 0;
+    bool success = false;
+    while (true) {
+        int ret = http.Read(buffer.data(), kSectorSize);
+        if (ret < 0) {
+            break;
+        }
+        if (ret == 0) {
+            success = true;
+            break;
+        }
+        size_t buf_pos = 0;
+        if (header_collected < kHeaderSize) {
+            size_t take = std::min((size_t)ret, kHeaderSize - header_collected);
+            memcpy(header_buf + header_collected, buffer.data(), take);
+            header_collected += take;
+            buf_pos += take;
+        }
+        if ((size_t)ret > buf_pos) {
+            size_t write_len = ret - buf_pos;
+            size_t needed_sectors = (kHeaderSize + total_written + write_len + kSectorSize - 1) / kSectorSize;
+            bool erase_failed = false;
+            while (current_sector < needed_sectors) {
+                if ((current_sector + 1) * kSectorSize > size ||
+                    !partition.Erase(current_sector * kSectorSize, kSectorSize)) {
+                    erase_failed = true;
+                    break;
+                }
+                current_sector++;
+            }
+            if (erase_failed ||
+                !partition.Write(kHeaderSize + total_written, buffer.data() + buf_pos, write_len)) {
+                break;
+            }
+            total_written += write_len;
+        }
+    }
+    if (success && header_collected + total_written != content_length) {
+        success = false;
+    }
+    return success && partition.Write(0, header_buf, kHeaderSize);
+}
+
+// HTTP reads go straight into the writer's sector buffers, as in Assets::Download()
+DownloadResume::Sink WriterSink(PartitionWriter& writer) {
+    DownloadResume::Sink sink;
+    sink.acquire = [&writer](size_t& space) { return writer.Acquire(space); };
+    sink.commit = [&writer](size_t size) {
+        writer.Commit(size);
+        return true;
+    };
+    return sink;
+}
+
+// The Assets::Download() steps around DownloadResume::Receive(). The stand-in cannot
+// reconnect, the first drop fails the download.
+bool DownloadPipelined(const std::string& path, size_t bytes_per_second, size_t truncate_at,
+                       FakePartition& partition, bool check_length = true) {
+    DownloadResume resume("assets", kSectorSize, kHeaderSize);
+    std::unique_ptr<Http> http = std::make_unique<FileHttp>(path, bytes_per_second, truncate_at);
+    size_t start = 0;
+    if (!resume.Open(*http, path, start)) {
+        return false;
+    }
+    size_t content_length = resume.content_length();
+    if (check_length && (content_length < kHeaderSize || content_length > partition.data().size())) {
+        return false;
+    }
+    PartitionWriter writer(partition.Target(), content_length, kHeaderSize);
+    writer.OnWritten([&resume](const char* data, size_t size) { resume.Update(data, size); });
+    if (!writer.Start()) {
+        return false;
+    }
+    bool success = resume.Receive(http, []() { return std::unique_ptr<Http>(); }, path, start,
+                                  WriterSink(writer), nullptr);
+    success = writer.Finish() && success;
+    if (success && !writer.WriteHead()) {
+        success = false;
+    }
+    if (success) {
+        resume.Clear();
+    }
+    return success;
+}
+
+bool Matches(const FakePartition& partition, const std::vector<uint8_t>& image) {
+    return memcmp(partition.data().data(), image.data(), image.size()) == 0;
+}
+
+bool HeaderWritten(const FakePartition& partition, const std::vector<uint8_t>& image) {
+    return memcmp(partition.data().data(), image.data(), kHeaderSize) == 0;
+}
+
+struct Failure {
+    const char* name;
+    size_t partition_size;
+    size_t truncate_at;
+    size_t fail_erase_at;
+    size_t fail_write_at;
+};
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t image_kb = argc > 1 ? strtoul(argv[1], nullptr, 10) : 512;
+    size_t net_kbps = argc > 2 ? strtoul(argv[2], nullptr, 10) : 500;
+    // Typical 4 KB and 64 KB erase and 256 byte page program times of SPI NOR flash
+    int erase_ms = argc > 3 ? atoi(argv[3]) : 45;
+    int block_erase_ms = argc > 4 ? atoi(argv[4]) : 150;
+    const int program_us = 700;
+
+    // A synthetic image, the header is the last thing either loop writes
+    std::string path = "/tmp/assets_download_bench.bin";
+    std::vector<uint8_t> image(image_kb * 1024 + 123);
+    uint32_t seed = 1;
+    for (auto& byte : image) {
+        seed = seed * 1103515245 + 12345;
+        byte = seed >> 24;
+    }
+    memcpy(image.data(), "ASSETSHEADER", kHeaderSize);
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(image.data()), image.size());
+    size_t partition_size = (image.size() / kSectorSize + 4) * kSectorSize;
+
+    printf("image %u KB, network %u KB/s, erase %d ms per sector and %d ms per block, program %d us per page\n",
+           (unsigned)(image.size() / 1024), (unsigned)net_kbps, erase_ms, block_erase_ms, program_us);
+    bool ok = true;
+    double times[2];
+    for (int pipelined = 0; pipelined < 2; pipelined++) {
+        FakePartition partition(partition_size, erase_ms, block_erase_ms, program_us);
+        auto start = Clock::now();
+        bool done = false;
+        if (pipelined) {
+            done = DownloadPipelined(path, net_kbps * 1024, SIZE_MAX, partition);
+        } else {
+            FileHttp http(path, net_kbps * 1024);
+            done = DownloadSerial(http, partition);
+        }
+        times[pipelined] = Seconds(start);
+        bool same = done && Matches(partition, image);
+        printf("  %-10s %6.2f s, %4.0f KB/s, %u sectors erased, %s\n", pipelined ? "pipelined" : "serial",
+               times[pipelined], image.size() / 1024.0 / times[pipelined], (unsigned)partition.erases(),
+               same ? "image matches" : "IMAGE DIFFERS");
+        ok = ok && same;
+    }
+    double network_s = image.size() / 1024.0 / net_kbps;
+    size_t sectors = (image.size() + kSectorSize - 1) / kSectorSize;
+    size_t blocks = sectors / (kBlockSize / kSectorSize);
+    size_t rest = sectors - blocks * (kBlockSize / kSectorSize);
+    double program_s = sectors * (kSectorSize / kPageSize) * program_us / 1000000.0;
+    double serial_flash_s = sectors * erase_ms / 1000.0 + program_s;
+    double block_flash_s = (blocks * block_erase_ms + rest * erase_ms) / 1000.0 + program_s;
+    printf("  speedup %.2fx; network %.2f s, flash %.2f s by sectors and %.2f s by blocks\n",
+           times[0] / times[1], network_s, serial_flash_s, block_flash_s);
+
+    // Fast settings, only the outcome matters
+    const Failure failures[] = {
+        {"erase error", partition_size, SIZE_MAX, 8 * kSectorSize, SIZE_MAX},
+        {"write error", partition_size, SIZE_MAX, SIZE_MAX, 5 * kSectorSize},
+        {"truncated stream", partition_size, image.size() / 2, SIZE_MAX, SIZE_MAX},
+        {"truncated in the first sector", partition_size, 100, SIZE_MAX, SIZE_MAX},
+    };
+    for (const auto& failure : failures) {
+        FakePartition partition(failure.partition_size, 0, 0, 0);
+        partition.fail_erase_at_ = failure.fail_erase_at;
+        partition.fail_write_at_ = failure.fail_write_at;
+        bool done = DownloadPipelined(path, 64 * 1024 * 1024, failure.truncate_at, partition);
+        bool pass = !done && !HeaderWritten(partition, image);
+        printf("  %-30s %s\n", failure.name, pass ? "fails, no header written" : "NOT DETECTED");
+        ok = ok && pass;
+    }
+    {
+        // Larger than the partition: the writer refuses past its end, Download() checks the length first
+        FakePartition partition(partition_size / 2 / kSectorSize * kSectorSize, 0, 0, 0);
+        bool done = DownloadPipelined(path, 64 * 1024 * 1024, SIZE_MAX, partition, false);
+        bool pass = !done && !HeaderWritten(partition, image);
+        printf("  %-30s %s\n", "larger than the partition", pass ? "fails, no header written" : "NOT DETECTED");
+        ok = ok && pass;
+    }
+    remove(path.c_str());
+    return ok ? 0 : 1;
+}
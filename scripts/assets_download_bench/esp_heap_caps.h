@@ -0,0 +1,18 @@
+/* Host stand-in for esp_heap_caps.h */
+#ifndef ASSETS_DOWNLOAD_BENCH_ESP_HEAP_CAPS_H
+#define ASSETS_DOWNLOAD_BENCH_ESP_HEAP_CAPS_H
+
+#include <stdlib.h>
+
+#define MALLOC_CAP_INTERNAL 0
+
+static inline void* heap_caps_malloc(size_t size, unsigned caps) {
+    (void)caps;
+    return malloc(size);
+}
+
+static inline void heap_caps_free(void* ptr) {
+    free(ptr);
+}
+
+#endif /* ASSETS_DOWNLOAD_BENCH_ESP_HEAP_CAPS_H */
@@ -0,0 +1,11 @@
+/* Host stand-in for esp_log.h */
+#ifndef ASSETS_DOWNLOAD_BENCH_ESP_LOG_H
+#define ASSETS_DOWNLOAD_BENCH_ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOGE(tag, format, ...) fprintf(stderr, "E %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) fprintf(stderr, "I %s: " format "\n", tag, ##__VA_ARGS__)
+
+#endif /* ASSETS_DOWNLOAD_BENCH_ESP_LOG_H */
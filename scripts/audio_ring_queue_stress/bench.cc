@@ -0,0 +1,211 @@
+/*
+ * Threaded stress test of main/audio/audio_ring_queue.h, the way the audio
+ * service uses its queues: producers serialized by a mutex, Push() or
+ * PushDropOldest() when the ring is full, one consumer popping, and another
+ * task clearing the queue now and then, like ResetDecoder() does.
+ *
+ * Every element carries its producer and sequence number. The test checks
+ * that each element comes out exactly once, from a consumer, a clear or the
+ * producer's own drop. It also checks that each task sees a producer's
+ * elements in order and that no element leaks or is freed twice.
+ */
+#include "audio_ring_queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kProducers = 2;
+
+std::atomic<int64_t> live_items{0};
+
+struct Item {
+    int producer;
+    uint32_t seq;
+    uint32_t check;
+
+    Item(int producer, uint32_t seq) : producer(producer), seq(seq), check(seq ^ 0x5a5a5a5a) { live_items++; }
+    ~Item() {
+        check = 0;
+        live_items--;
+    }
+};
+
+struct Ledger {
+    // How often each element was handed out, per producer
+    std::vector<std::unique_ptr<std::atomic<uint8_t>[]>> seen;
+    std::atomic<bool> failed{false};
+
+    explicit Ledger(uint32_t count) {
+        for (int i = 0; i < kProducers; i++) {
+            seen.emplace_back(new std::atomic<uint8_t>[count]());
+        }
+    }
+
+    // Called by the task that got the item, with the last sequence it saw per producer
+    void Take(std::unique_ptr<Item> item, int64_t* last, const char* who) {
+        if (item->producer < 0 || item->producer >= kProducers || item->check != (item->seq ^ 0x5a5a5a5a)) {
+            fprintf(stderr, "%s: corrupt element\n", who);
+            failed = true;
+            return;
+        }
+        if (seen[item->producer][item->seq]++ != 0) {
+            fprintf(stderr, "%s: element %d/%u handed out twice\n", who, item->producer, item->seq);
+            failed = true;
+        }
+        if (last != nullptr) {
+            if ((int64_t)item->seq <= last[item->producer]) {
+                fprintf(stderr, "%s: element %d/%u after %d/%lld\n", who, item->producer, item->seq,
+                        item->producer, (long long)last[item->producer]);
+                failed = true;
+            }
+            last[item->producer] = item->seq;
+        }
+    }
+};
+
+// Every task gives up the CPU now and then, so that the tasks also interleave on one core
+void Pace(uint32_t& steps) {
+    if (++steps % 64 == 0) {
+        std::this_thread::yield();
+    }
+}
+
+struct Counts {
+    std::atomic<uint64_t> consumed{0};
+    std::atomic<uint64_t> cleared{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> rejected{0};
+};
+
+bool Run(const char* name, size_t capacity, uint32_t items_per_producer, bool drop_oldest) {
+    AudioRingQueue<Item> queue(capacity);
+    std::mutex producer_mutex;
+    Ledger ledger(items_per_producer);
+    Counts counts;
+    std::atomic<int> producers_running{kProducers};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < kProducers; p++) {
+        threads.emplace_back([&, p]() {
+            uint32_t steps = 0;
+            std::unique_ptr<Item> item;
+            for (uint32_t seq = 0; seq < items_per_producer; Pace(steps)) {
+                if (item == nullptr) {
+                    item = std::make_unique<Item>(p, seq);
+                }
+                std::unique_lock<std::mutex> lock(producer_mutex);
+                if (drop_oldest) {
+                    auto dropped = queue.PushDropOldest(std::move(item));
+                    lock.unlock();
+                    if (dropped) {
+                        counts.dropped++;
+                        ledger.Take(std::move(dropped), nullptr, "producer");
+                    }
+                    seq++;
+                } else if (queue.Push(item)) {
+                    seq++;
+                } else {
+                    // Full: the caller keeps the element and tries again, like a blocking enqueue
+                    lock.unlock();
+                    counts.rejected++;
+                    if (item == nullptr) {
+                        fprintf(stderr, "producer: a rejected Push() took the element\n");
+                        ledger.failed = true;
+                        break;
+                    }
+                }
+            }
+            producers_running--;
+        });
+    }
+
+    // The consumer and the clearing task each see every producer's elements in order
+    threads.emplace_back([&]() {
+        int64_t last[kProducers];
+        std::fill(last, last + kProducers, -1);
+        uint32_t steps = 0;
+        for (;; Pace(steps)) {
+            bool done = producers_running == 0;
+            auto item = queue.Pop();
+            if (item) {
+                counts.consumed++;
+                ledger.Take(std::move(item), last, "consumer");
+            } else if (done) {
+                break;
+            }
+        }
+    });
+    threads.emplace_back([&]() {
+        int64_t last[kProducers];
+        std::fill(last, last + kProducers, -1);
+        uint32_t steps = 0;
+        for (; producers_running > 0; Pace(steps)) {
+            if (steps % 64 != 0) {
+                continue;
+            }
+            while (auto item = queue.Pop()) {
+                counts.cleared++;
+                ledger.Take(std::move(item), last, "clear");
+            }
+        }
+    });
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    while (auto item = queue.Pop()) {
+        counts.consumed++;
+        ledger.Take(std::move(item), nullptr, "final");
+    }
+
+    bool ok = !ledger.failed;
+    uint64_t total = (uint64_t)kProducers * items_per_producer;
+    for (int p = 0; p < kProducers; p++) {
+        for (uint32_t seq = 0; seq < items_per_producer; seq++) {
+            if (ledger.seen[p][seq] != 1) {
+                fprintf(stderr, "element %d/%u handed out %u times\n", p, seq, (unsigned)ledger.seen[p][seq]);
+                ok = false;
+                break;
+            }
+        }
+    }
+    uint64_t out = counts.consumed + counts.cleared + counts.dropped;
+    if (out != total) {
+        fprintf(stderr, "%llu elements pushed, %llu handed out\n", (unsigned long long)total, (unsigned long long)out);
+        ok = false;
+    }
+    if (live_items != 0 || !queue.Empty()) {
+        fprintf(stderr, "%lld elements still alive, queue size %u\n", (long long)live_items.load(),
+                (unsigned)queue.Size());
+        ok = false;
+    }
+
+    printf("%s, capacity %u\n", name, (unsigned)capacity);
+    printf("  %llu pushed: %llu consumed, %llu cleared, %llu dropped oldest, %llu Push() rejected%s\n",
+           (unsigned long long)total, (unsigned long long)counts.consumed.load(),
+           (unsigned long long)counts.cleared.load(), (unsigned long long)counts.dropped.load(),
+           (unsigned long long)counts.rejected.load(), ok ? "" : ", FAILED");
+    return ok;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    uint32_t items = argc > 1 ? strtoul(argv[1], nullptr, 10) : 1000000;
+    bool ok = true;
+    ok = Run("Push, retried when full", 4, items, false) && ok;
+    ok = Run("Push, retried when full", 40, items, false) && ok;
+    ok = Run("PushDropOldest", 4, items, true) && ok;
+    ok = Run("PushDropOldest", 40, items, true) && ok;
+    return ok ? 0 : 1;
+}
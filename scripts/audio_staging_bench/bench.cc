@@ -0,0 +1,133 @@
+/*
+ * Host benchmark for the AFE feed/fetch staging of the audio engines.
+ *
+ * "vector" is the previous AfeAudioEngine/LiteAudioEngine code: samples are
+ * appended to a std::vector, every chunk is erased from its front and every
+ * output frame is a freshly allocated vector. "staging" is AudioStagingBuffer
+ * from main/audio with one reused output frame. Both are checked to hand out
+ * the same chunks and frames before timing.
+ */
+#include "audio_staging_buffer.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+// 10 ms microphone reads, AFE feed chunks of 512 samples per channel, 60 ms encoder frames
+static constexpr size_t kReadSamples = 160;
+static constexpr size_t kFeedChunk = 512;
+static constexpr size_t kFrameSamples = 960;
+
+using ChunkSink = std::function<void(const int16_t* data, size_t samples)>;
+using FrameSink = std::function<void(std::vector<int16_t>&& frame)>;
+
+struct VectorStaging {
+    std::vector<int16_t> input;
+    std::vector<int16_t> output;
+
+    void Feed(const std::vector<int16_t>& data, size_t chunk_size, const ChunkSink& feed) {
+        input.insert(input.end(), data.begin(), data.end());
+        while (input.size() >= chunk_size) {
+            feed(input.data(), chunk_size);
+            input.erase(input.begin(), input.begin() + chunk_size);
+        }
+    }
+
+    void Fetch(const int16_t* data, size_t samples, const FrameSink& output_callback) {
+        output.insert(output.end(), data, data + samples);
+        while (output.size() >= kFrameSamples) {
+            if (output.size() == kFrameSamples) {
+                output_callback(std::move(output));
+                output.clear();
+                output.reserve(kFrameSamples);
+            } else {
+                output_callback(std::vector<int16_t>(output.begin(), output.begin() + kFrameSamples));
+                output.erase(output.begin(), output.begin() + kFrameSamples);
+            }
+        }
+    }
+};
+
+struct RingStaging {
+    AudioStagingBuffer input;
+    AudioStagingBuffer output;
+    std::vector<int16_t> frame;
+
+    void Feed(const std::vector<int16_t>& data, size_t chunk_size, const ChunkSink& feed) {
+        input.Reserve(chunk_size + data.size());
+        input.Append(data.data(), data.size());
+        while (input.Size() >= chunk_size) {
+            feed(input.Data(), chunk_size);
+            input.Consume(chunk_size);
+        }
+    }
+
+    void Fetch(const int16_t* data, size_t samples, const FrameSink& output_callback) {
+        output.Reserve(kFrameSamples + samples);
+        output.Append(data, samples);
+        while (output.Size() >= kFrameSamples) {
+            frame.assign(output.Data(), output.Data() + kFrameSamples);
+            output.Consume(kFrameSamples);
+            output_callback(std::move(frame));
+        }
+    }
+};
+
+// Feeds `reads` microphone reads and fetches one AFE result per feed chunk,
+// folding every chunk and frame into a checksum
+template <typename Staging>
+static uint64_t Run(Staging& staging, size_t channels, size_t reads) {
+    std::vector<int16_t> read(kReadSamples * channels);
+    std::vector<int16_t> fetched(kFeedChunk);
+    uint64_t sum = 0;
+    int16_t next = 0;
+    ChunkSink feed = [&](const int16_t* data, size_t samples) {
+        for (size_t i = 0; i < samples; i += channels) {
+            sum = sum * 31 + (uint16_t)data[i];
+        }
+        // The AFE returns one channel of processed audio per fed chunk
+        for (size_t i = 0; i < kFeedChunk; ++i) {
+            fetched[i] = data[i * channels];
+        }
+        staging.Fetch(fetched.data(), fetched.size(), [&](std::vector<int16_t>&& frame) {
+            sum = sum * 131 + (uint16_t)frame[0] + (uint16_t)frame[kFrameSamples - 1];
+        });
+    };
+    for (size_t r = 0; r < reads; ++r) {
+        for (auto& sample : read) {
+            sample = next++;
+        }
+        staging.Feed(read, kFeedChunk * channels, feed);
+    }
+    return sum;
+}
+
+template <typename Staging>
+static double Time(size_t channels, size_t reads, uint64_t& sum) {
+    Staging staging;
+    auto start = std::chrono::steady_clock::now();
+    sum = Run(staging, channels, reads);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / reads;
+}
+
+int main(int argc, char** argv) {
+    size_t reads = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2000000;
+    for (size_t channels : {1, 2, 3}) {
+        uint64_t vector_sum = 0;
+        uint64_t ring_sum = 0;
+        Time<VectorStaging>(channels, 1000, vector_sum);
+        Time<RingStaging>(channels, 1000, ring_sum);
+        if (vector_sum != ring_sum) {
+            printf("%zu channel(s): staging output differs from the vector path\n", channels);
+            return 1;
+        }
+        double vector_ns = Time<VectorStaging>(channels, reads, vector_sum);
+        double ring_ns = Time<RingStaging>(channels, reads, ring_sum);
+        printf("%zu channel(s), %zu reads: vector %.1f ns/read, staging %.1f ns/read (%.2fx)\n",
+               channels, reads, vector_ns, ring_ns, vector_ns / ring_ns);
+    }
+    return 0;
+}
@@ -0,0 +1,490 @@
+/*
+ * Host test of main/download_resume.cc with main/partition_writer.cc, the way
+ * Assets::Download() and Ota::Upgrade() continue interrupted downloads.
+ *
+ * An in-memory HTTP server stand-in answers Range and If-Range requests like a
+ * static file server and drops connections on a schedule, half of them with a
+ * read error and half with an early close. The downloads take the steps of
+ * Assets::Download() and Ota::Upgrade() around DownloadResume::Receive(), the
+ * latter against an esp_ota_* stand-in that erases sector by sector as
+ * OTA_WITH_SEQUENTIAL_WRITES does. They reconnect with a Range request, and when a call gives up the resume record in the
+ * Settings stand-in lets the next call continue from its last checkpoint, after
+ * reading the flash back to verify it.
+ *
+ * For every scenario it reports the bytes the server sent against the image
+ * size and against the firmware before, which started from zero on every call,
+ * and checks the image that ends up in the RAM partition.
+ */
+#include "download_resume.h"
+#include "partition_writer.h"
+#include "settings.h"
+#include "http.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Settings in memory, kept across calls like NVS across reboots
+static std::map<std::string, std::map<std::string, std::string>> nvs;
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {}
+Settings::~Settings() {}
+
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    auto& entries = nvs[ns_];
+    auto it = entries.find(key);
+    return it == entries.end() ? default_value : it->second;
+}
+
+void Settings::SetString(const std::string& key, const std::string& value) {
+    nvs[ns_][key] = value;
+}
+
+int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
+    auto& entries = nvs[ns_];
+    auto it = entries.find(key);
+    return it == entries.end() ? default_value : (int32_t)strtol(it->second.c_str(), nullptr, 10);
+}
+
+void Settings::SetInt(const std::string& key, int32_t value) {
+    nvs[ns_][key] = std::to_string(value);
+}
+
+bool Settings::GetBool(const std::string& key, bool default_value) {
+    return GetInt(key, default_value) != 0;
+}
+
+void Settings::SetBool(const std::string& key, bool value) {
+    SetInt(key, value);
+}
+
+void Settings::EraseKey(const std::string& key) {
+    nvs[ns_].erase(key);
+}
+
+void Settings::EraseAll() {
+    nvs[ns_].clear();
+}
+
+namespace {
+
+constexpr size_t kHeaderSize = 12;
+constexpr size_t kMss = 1440;
+const char* const kUrl = "http://localhost/assets.bin";
+// esp_partition_get_main_flash_sector_size(), 4096 on every ESP32 so far
+size_t sector_size = 4096;
+
+struct Server {
+    std::vector<uint8_t> content;
+    std::string etag;                   // Empty: neither ETag nor Last-Modified
+    std::vector<size_t> drops;          // Connection k drops after drops[k] body bytes, later ones do not
+    size_t connections = 0;
+    size_t bytes_sent = 0;
+};
+
+class StandInHttp : public Http {
+public:
+    explicit StandInHttp(Server& server) : server_(server) {}
+
+    void SetTimeout(int) override {}
+    void SetHeader(const std::string& key, const std::string& value) override { request_headers_[key] = value; }
+    void SetContent(std::string&&) override {}
+    int Write(const char*, size_t) override { return -1; }
+    std::string ReadAll() override { return ""; }
+    int GetLastError() override { return 0; }
+    void Close() override { open_ = false; }
+
+    bool Open(const std::string&, const std::string&) override {
+        connection_ = server_.connections++;
+        drop_after_ = connection_ < server_.drops.size() ? server_.drops[connection_] : SIZE_MAX;
+        size_t length = server_.content.size();
+        response_headers_.clear();
+        if (!server_.etag.empty()) {
+            response_headers_["ETag"] = server_.etag;
+        }
+        pos_ = 0;
+        end_ = length;
+        status_code_ = 200;
+        auto range = request_headers_.find("Range");
+        auto if_range = request_headers_.find("If-Range");
+        bool same = if_range == request_headers_.end() || (!server_.etag.empty() && if_range->second == server_.etag);
+        if (range != request_headers_.end() && same) {
+            size_t first = strtoul(range->second.c_str() + 6, nullptr, 10);
+            if (first >= length) {
+                status_code_ = 416;
+                end_ = 0;
+            } else {
+                status_code_ = 206;
+                pos_ = first;
+                response_headers_["Content-Range"] =
+                    "bytes " + std::to_string(first) + "-" + std::to_string(length - 1) + "/" + std::to_string(length);
+            }
+        }
+        open_ = true;
+        return true;
+    }
+
+    int GetStatusCode() override { return status_code_; }
+    size_t GetBodyLength() override { return end_ - pos_; }
+
+    std::string GetResponseHeader(const std::string& key) const override {
+        auto it = response_headers_.find(key);
+        return it == response_headers_.end() ? "" : it->second;
+    }
+
+    int Read(char* buffer, size_t buffer_size) override {
+        if (!open_) {
+            return -1;
+        }
+        if (sent_ >= drop_after_) {
+            // Every other drop is an early close instead of an error
+            return connection_ % 2 == 0 ? -1 : 0;
+        }
+        size_t len = std::min({buffer_size, end_ - pos_, drop_after_ - sent_, kMss});
+        memcpy(buffer, &server_.content[pos_], len);
+        pos_ += len;
+        sent_ += len;
+        server_.bytes_sent += len;
+        return len;
+    }
+
+private:
+    Server& server_;
+    std::map<std::string, std::string> request_headers_;
+    std::map<std::string, std::string> response_headers_;
+    size_t connection_ = 0;
+    size_t drop_after_ = SIZE_MAX;
+    int status_code_ = 0;
+    size_t pos_ = 0;
+    size_t end_ = 0;
+    size_t sent_ = 0;
+    bool open_ = false;
+};
+
+// NOR flash in RAM: erase sets 0xFF, programming needs erased bytes
+class FakePartition {
+public:
+    explicit FakePartition(size_t size) : data_(size, 0xFF) {}
+
+    PartitionWriter::Target Target() {
+        PartitionWriter::Target target;
+        target.size = data_.size();
+        target.sector_size = sector_size;
+        target.erase = [this](size_t offset, size_t size) {
+            memset(&data_[offset], 0xFF, size);
+            return true;
+        };
+        target.write = [this](size_t offset, const void* data, size_t size) {
+            for (size_t i = 0; i < size; i++) {
+                if (data_[offset + i] != 0xFF) {
+                    fprintf(stderr, "Programming byte %u that is not erased\n", (unsigned)(offset + i));
+                    return false;
+                }
+            }
+            memcpy(&data_[offset], data, size);
+            return true;
+        };
+        return target;
+    }
+
+    bool Read(size_t offset, void* data, size_t size) const {
+        memcpy(data, &data_[offset], size);
+        return true;
+    }
+
+    std::vector<uint8_t>& data() { return data_; }
+
+private:
+    std::vector<uint8_t> data_;
+};
+
+// The Assets::Download() loop
+bool Download(Server& server, FakePartition& partition) {
+    DownloadResume resume("assets", sector_size, kHeaderSize);
+    if (resume.offset() > 0) {
+        resume.Verify([&partition](size_t offset, void* data, size_t size) {
+            return partition.Read(offset, data, size);
+        });
+    }
+    std::unique_ptr<Http> http = std::make_unique<StandInHttp>(server);
+    size_t start = 0;
+    if (!resume.Open(*http, kUrl, start)) {
+        return false;
+    }
+    size_t content_length = resume.content_length();
+    if (content_length > partition.data().size() || content_length < kHeaderSize) {
+        return false;
+    }
+
+    PartitionWriter writer(partition.Target(), content_length, kHeaderSize);
+    if (start > 0) {
+        writer.Resume(start, resume.head());
+    }
+    writer.OnWritten([&resume](const char* data, size_t size) { resume.Update(data, size); });
+    if (!writer.Start()) {
+        return false;
+    }
+
+    // HTTP reads go straight into the writer's sector buffers
+    DownloadResume::Sink sink;
+    sink.acquire = [&writer](size_t& space) { return writer.Acquire(space); };
+    sink.commit = [&writer](size_t size) {
+        writer.Commit(size);
+        return true;
+    };
+    bool success = resume.Receive(http, [&server]() { return std::make_unique<StandInHttp>(server); }, kUrl, start,
+                                  sink, nullptr);
+    success = writer.Finish() && success;
+    if (success && !writer.WriteHead()) {
+        success = false;
+    }
+    if (!success) {
+        return false;
+    }
+    resume.Clear();
+    return true;
+}
+
+// esp_ota_begin/resume/write/end with OTA_WITH_SEQUENTIAL_WRITES: the sectors are erased
+// as the writes reach them, and esp_ota_end() checks the whole image
+class OtaStandIn {
+public:
+    static constexpr uint8_t kImageMagic = 0xE9;
+
+    explicit OtaStandIn(FakePartition& partition) : partition_(partition), target_(partition.Target()) {}
+
+    bool Begin() {
+        written_ = 0;
+        started_ = true;
+        return true;
+    }
+
+    bool Resume(size_t offset) {
+        if (offset % sector_size != 0 || offset > target_.size) {
+            return false;
+        }
+        written_ = offset;
+        started_ = true;
+        return true;
+    }
+
+    bool Write(const void* data, size_t size) {
+        if (!started_ || written_ + size > target_.size) {
+            return false;
+        }
+        size_t first = written_ / sector_size;
+        size_t last = (written_ + size - 1) / sector_size;
+        if (written_ % sector_size != 0) {
+            first++;
+        }
+        for (size_t sector = first; sector <= last; sector++) {
+            if (!target_.erase(sector * sector_size, sector_size)) {
+                return false;
+            }
+        }
+        if (!target_.write(written_, data, size)) {
+            return false;
+        }
+        written_ += size;
+        return true;
+    }
+
+    // The image checksum stand-in: the bench knows the image it expects
+    bool End(const std::vector<uint8_t>& expected) {
+        started_ = false;
+        return written_ == expected.size() && memcmp(partition_.data().data(), expected.data(), written_) == 0;
+    }
+
+private:
+    FakePartition& partition_;
+    PartitionWriter::Target target_;
+    size_t written_ = 0;
+    bool started_ = false;
+};
+
+// The Ota::Upgrade() loop
+bool Upgrade(Server& server, FakePartition& partition) {
+    constexpr size_t kPageSize = 4096;
+    constexpr size_t kImageHeaderSize = 288;    // esp_image_header_t, segment header, esp_app_desc_t
+    DownloadResume resume("ota", sector_size);
+    if (resume.offset() > 0) {
+        resume.Verify([&partition](size_t offset, void* data, size_t size) {
+            return partition.Read(offset, data, size);
+        });
+    }
+    std::unique_ptr<Http> http = std::make_unique<StandInHttp>(server);
+    size_t start = 0;
+    if (!resume.Open(*http, kUrl, start)) {
+        return false;
+    }
+    OtaStandIn ota(partition);
+    bool image_header_checked = false;
+    if (start > 0) {
+        // The image header is in flash already, esp_ota_end() validates the whole image
+        if (!ota.Resume(start)) {
+            return false;
+        }
+        image_header_checked = true;
+    }
+
+    // HTTP reads fill the buffer, which is written to flash a page at a time
+    std::vector<char> buffer(kPageSize);
+    size_t buffer_offset = 0;
+    auto flush = [&]() {
+        if (!ota.Write(buffer.data(), buffer_offset)) {
+            return false;
+        }
+        resume.Update(buffer.data(), buffer_offset);
+        buffer_offset = 0;
+        return true;
+    };
+    DownloadResume::Sink sink;
+    sink.acquire = [&](size_t& space) {
+        space = kPageSize - buffer_offset;
+        return buffer.data() + buffer_offset;
+    };
+    sink.commit = [&](size_t size) {
+        buffer_offset += size;
+        // The first page holds the image header
+        if (!image_header_checked && buffer_offset >= kImageHeaderSize) {
+            if ((uint8_t)buffer[0] != OtaStandIn::kImageMagic || !ota.Begin()) {
+                return false;
+            }
+            image_header_checked = true;
+        }
+        return buffer_offset < kPageSize || flush();
+    };
+    bool success = resume.Receive(http, [&server]() { return std::make_unique<StandInHttp>(server); }, kUrl, start,
+                                  sink, nullptr);
+    success = success && image_header_checked;
+    // Write the last partial page
+    if (!success || (buffer_offset > 0 && !flush())) {
+        return false;
+    }
+    bool valid = ota.End(server.content);
+    // Validated or not, the next attempt does not continue this image
+    resume.Clear();
+    return valid;
+}
+
+// The firmware before: a plain GET that fails on the first drop, the next call starts over
+bool DownloadFromZero(Server& server) {
+    StandInHttp http(server);
+    if (!http.Open("GET", kUrl) || http.GetStatusCode() != 200) {
+        return false;
+    }
+    size_t length = http.GetBodyLength();
+    size_t received = 0;
+    std::vector<char> buffer(4096);
+    while (true) {
+        int ret = http.Read(buffer.data(), buffer.size());
+        if (ret <= 0) {
+            return ret == 0 && received == length;
+        }
+        received += ret;
+    }
+}
+
+std::vector<uint8_t> MakeImage(size_t size, uint32_t seed) {
+    std::vector<uint8_t> image(size);
+    for (auto& byte : image) {
+        seed = seed * 1103515245 + 12345;
+        byte = seed >> 24;
+    }
+    image[0] = OtaStandIn::kImageMagic;
+    return image;
+}
+
+struct Scenario {
+    const char* name;
+    std::vector<double> drops;          // Fractions of the image, per connection
+    bool etag = true;
+    bool corrupt = false;               // Flip a flashed byte after the first call
+    bool change = false;                // New content on the server after the first call
+};
+
+bool Run(const Scenario& scenario, size_t image_size, bool ota) {
+    const char* ns = ota ? "ota" : "assets";
+    const int kMaxCalls = 10;
+    Server server;
+    server.content = MakeImage(image_size, 1);
+    server.etag = scenario.etag ? "\"5f3a-1\"" : "";
+    for (double drop : scenario.drops) {
+        server.drops.push_back((size_t)(drop * image_size));
+    }
+    nvs.clear();
+    FakePartition partition(image_size / sector_size * sector_size + 16 * sector_size);
+
+    int calls = 0;
+    bool done = false;
+    while (!done && calls < kMaxCalls) {
+        done = ota ? Upgrade(server, partition) : Download(server, partition);
+        calls++;
+        if (calls == 1 && !done) {
+            if (scenario.corrupt) {
+                partition.data()[sector_size * 3 + 7] ^= 0x01;
+            }
+            if (scenario.change) {
+                server.content = MakeImage(image_size, 2);
+                server.etag = "\"5f3a-2\"";
+            }
+        }
+    }
+    size_t sent = server.bytes_sent;
+    size_t connections = server.connections;
+    bool same = done && memcmp(partition.data().data(), server.content.data(), image_size) == 0;
+    bool clean = nvs[ns].empty();
+
+    // The same drops against the firmware before
+    Server before;
+    before.content = server.content;
+    before.drops = server.drops;
+    int before_calls = 0;
+    bool before_done = false;
+    while (!before_done && before_calls < kMaxCalls) {
+        before_done = DownloadFromZero(before);
+        before_calls++;
+    }
+
+    printf("%s: %s\n", ota ? "ota" : "assets", scenario.name);
+    printf("  resumable:  %d calls, %u connections, %u KB sent (%.0f%% of the image), %s%s\n", calls,
+           (unsigned)connections, (unsigned)(sent / 1024), 100.0 * sent / image_size,
+           same ? "image matches" : "IMAGE DIFFERS", clean ? "" : ", RECORD LEFT");
+    printf("  from zero:  %d calls, %u KB sent (%.0f%% of the image)%s\n", before_calls,
+           (unsigned)(before.bytes_sent / 1024), 100.0 * before.bytes_sent / image_size,
+           before_done ? "" : ", gave up");
+    return same && clean;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t image_kb = argc > 1 ? strtoul(argv[1], nullptr, 10) : 2048;
+    size_t image_size = image_kb * 1024 + 777;
+    if (argc > 2) {
+        sector_size = strtoul(argv[2], nullptr, 10);
+    }
+    printf("%u KB image, %u byte sectors\n", (unsigned)image_kb, (unsigned)sector_size);
+
+    const Scenario scenarios[] = {
+        {"3 drops, reconnected within the call", {0.3, 0.2, 0.25}},
+        {"5 drops, the call gives up and the next one resumes", {0.2, 0.15, 0.15, 0.15, 0.1}},
+        {"call gives up, flash corrupted before the next one", {0.2, 0.15, 0.15, 0.15, 0.1}, true, true},
+        {"call gives up, content changed before the next one", {0.2, 0.15, 0.15, 0.15, 0.1}, true, false, true},
+        {"server without ETag or Last-Modified", {0.3, 0.4}, false},
+        {"no drops", {}},
+    };
+    bool ok = true;
+    for (bool ota : {false, true}) {
+        for (const auto& scenario : scenarios) {
+            ok = Run(scenario, image_size, ota) && ok;
+        }
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,25 @@
+/* Host stand-in for esp_pthread.h, std::thread ignores the config */
+#ifndef DOWNLOAD_RESUME_BENCH_ESP_PTHREAD_H
+#define DOWNLOAD_RESUME_BENCH_ESP_PTHREAD_H
+
+#include <stddef.h>
+
+typedef struct {
+    size_t stack_size;
+    size_t prio;
+    bool inherit_cfg;
+    const char* thread_name;
+    int pin_to_core;
+} esp_pthread_cfg_t;
+
+static inline esp_pthread_cfg_t esp_pthread_get_default_config(void) {
+    esp_pthread_cfg_t cfg = {3072, 5, false, NULL, -1};
+    return cfg;
+}
+
+static inline int esp_pthread_set_cfg(const esp_pthread_cfg_t* cfg) {
+    (void)cfg;
+    return 0;
+}
+
+#endif /* DOWNLOAD_RESUME_BENCH_ESP_PTHREAD_H */
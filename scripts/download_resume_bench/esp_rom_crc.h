@@ -0,0 +1,18 @@
+/* Host stand-in for esp_rom_crc.h, the same CRC32 as the ROM */
+#ifndef DOWNLOAD_RESUME_BENCH_ESP_ROM_CRC_H
+#define DOWNLOAD_RESUME_BENCH_ESP_ROM_CRC_H
+
+#include <stdint.h>
+
+static inline uint32_t esp_rom_crc32_le(uint32_t crc, const uint8_t* buf, uint32_t len) {
+    crc = ~crc;
+    for (uint32_t i = 0; i < len; i++) {
+        crc ^= buf[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+#endif /* DOWNLOAD_RESUME_BENCH_ESP_ROM_CRC_H */
@@ -0,0 +1,9 @@
+/* Host stand-in for nvs_flash.h, bench.cc keeps Settings in memory */
+#ifndef DOWNLOAD_RESUME_BENCH_NVS_FLASH_H
+#define DOWNLOAD_RESUME_BENCH_NVS_FLASH_H
+
+#include <stdint.h>
+
+typedef uint32_t nvs_handle_t;
+
+#endif /* DOWNLOAD_RESUME_BENCH_NVS_FLASH_H */
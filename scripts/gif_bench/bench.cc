@@ -0,0 +1,408 @@
+/*
+ * Host benchmark for main/display/lvgl_display/gif/gifdec.c.
+ *
+ * Plays GIFs the way LvglGif::NextFrame does and reports, per GIF:
+ * - the canvas area LVGL has to redraw per frame, the whole canvas before and
+ *   the area reported by gd_take_dirty_area() now; every frame is checked
+ *   against the previous canvas so that no changed pixel falls outside it
+ * - the frame render cost of the byte loop gifdec used before against the
+ *   expanded palette kernel, checked to produce the same canvas
+ * - the frames per second decoding costs, and the PSRAM the LvglGif frame
+ *   cache needs to replay later loops without decoding: the first frame whole
+ *   and the dirty area of every later one, against the bound gd_loop_dirty_pixels()
+ *   gives before decoding; every replayed frame is checked against the decoded one
+ */
+#include "gifdec.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Sample {
+    std::string name;
+    std::vector<uint8_t> data;
+};
+
+// A cached frame of LvglGif after the first one, x2 < x1 when nothing changed
+struct CachedArea {
+    lv_area_t area;
+    std::vector<uint8_t> pixels;
+};
+
+void CopyArea(uint8_t* dst, size_t dst_stride, const uint8_t* src, size_t src_stride, const lv_area_t& area) {
+    const size_t row_bytes = (size_t)(area.x2 - area.x1 + 1) * 4;
+    for (int32_t y = 0; y <= area.y2 - area.y1; y++) {
+        memcpy(dst + y * dst_stride, src + y * src_stride, row_bytes);
+    }
+}
+
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>& out) : out_(out) {}
+
+    void Put(uint32_t code, int bits) {
+        acc_ |= code << count_;
+        count_ += bits;
+        while (count_ >= 8) {
+            bytes_.push_back(acc_ & 0xFF);
+            acc_ >>= 8;
+            count_ -= 8;
+        }
+    }
+
+    void Finish() {
+        if (count_ > 0) {
+            bytes_.push_back(acc_ & 0xFF);
+        }
+        for (size_t i = 0; i < bytes_.size(); i += 255) {
+            size_t len = std::min<size_t>(255, bytes_.size() - i);
+            out_.push_back(len);
+            out_.insert(out_.end(), bytes_.begin() + i, bytes_.begin() + i + len);
+        }
+        out_.push_back(0);
+    }
+
+private:
+    std::vector<uint8_t>& out_;
+    std::vector<uint8_t> bytes_;
+    uint32_t acc_ = 0;
+    int count_ = 0;
+};
+
+void PutU16(std::vector<uint8_t>& out, uint16_t value) {
+    out.push_back(value & 0xFF);
+    out.push_back(value >> 8);
+}
+
+// Literal codes only, with a clear code often enough to stay at 9 bits
+void PutImage(std::vector<uint8_t>& out, const std::vector<uint8_t>& pixels) {
+    out.push_back(8);
+    BitWriter writer(out);
+    for (size_t i = 0; i < pixels.size(); i++) {
+        if (i % 200 == 0) {
+            writer.Put(256, 9);
+        }
+        writer.Put(pixels[i], 9);
+    }
+    writer.Put(257, 9);
+    writer.Finish();
+}
+
+void PutFrame(std::vector<uint8_t>& out, int disposal, bool transparent, uint16_t x, uint16_t y, uint16_t w,
+              uint16_t h, const std::vector<uint8_t>& pixels) {
+    const uint8_t gce[] = {0x21, 0xF9, 0x04, (uint8_t)((disposal << 2) | (transparent ? 1 : 0)), 6, 0, 0, 0};
+    out.insert(out.end(), std::begin(gce), std::end(gce));
+    out.push_back(0x2C);
+    PutU16(out, x);
+    PutU16(out, y);
+    PutU16(out, w);
+    PutU16(out, h);
+    out.push_back(0);
+    PutImage(out, pixels);
+}
+
+// Pixels of a face in the rect (x, y, w, h), eyes closed or open and mouth shape 0..2
+std::vector<uint8_t> FacePixels(int x0, int y0, int w, int h, bool eyes_closed, int mouth) {
+    std::vector<uint8_t> pixels(w * h);
+    for (int j = 0; j < h; j++) {
+        for (int i = 0; i < w; i++) {
+            int x = x0 + i, y = y0 + j;
+            int dx = x - 60, dy = y - 60;
+            uint8_t c = dx * dx + dy * dy < 56 * 56 ? 2 : 0;
+            for (int eye_x : {38, 82}) {
+                int ex = x - eye_x, ey = y - 45;
+                if (eyes_closed ? (ey >= -1 && ey <= 1 && ex >= -8 && ex <= 8) : (ex * ex + ey * ey < 64)) {
+                    c = 3;
+                }
+            }
+            int mx = x - 60, my = y - 82;
+            if (mx >= -20 && mx <= 20 && my >= -2 - 3 * mouth && my <= 2 + 3 * mouth) {
+                c = 4;
+            }
+            pixels[j * w + i] = c;
+        }
+    }
+    return pixels;
+}
+
+// A 120x120 talking emoji: a full transparent first frame, then opaque mouth moves and a blink
+// restored to the background, in small rects
+Sample SyntheticEmoji() {
+    std::vector<uint8_t> out = {'G', 'I', 'F', '8', '9', 'a'};
+    PutU16(out, 120);
+    PutU16(out, 120);
+    out.push_back(0xF7);
+    out.push_back(0);
+    out.push_back(0);
+    for (int i = 0; i < 256; i++) {
+        const uint8_t colors[][3] = {{0, 0, 0}, {255, 255, 255}, {255, 200, 40}, {60, 40, 20}, {200, 40, 40}};
+        const uint8_t* c = colors[i < 5 ? i : 0];
+        out.insert(out.end(), c, c + 3);
+    }
+    const uint8_t netscape[] = {0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0',
+                                0x03, 0x01, 0x00, 0x00, 0x00};
+    out.insert(out.end(), std::begin(netscape), std::end(netscape));
+
+    PutFrame(out, 1, true, 0, 0, 120, 120, FacePixels(0, 0, 120, 120, false, 0));
+    for (int step = 0; step < 8; step++) {
+        int mouth = step % 3;
+        PutFrame(out, 1, false, 36, 74, 48, 18, FacePixels(36, 74, 48, 18, false, mouth));
+        if (step == 3) {
+            PutFrame(out, 2, true, 28, 35, 64, 20, FacePixels(28, 35, 64, 20, true, mouth));
+        }
+    }
+    out.push_back(0x3B);
+    return {"synthetic talking emoji 120x120", out};
+}
+
+// A 120x120 still emoji: one looping frame
+Sample SyntheticStill() {
+    Sample sample = SyntheticEmoji();
+    sample.name = "synthetic still emoji 120x120";
+    // Header, the global color table and NETSCAPE, then the first frame alone
+    const size_t first_frame_end = 13 + 256 * 3 + 19 + 8 + 10 + 1;
+    std::vector<uint8_t> frame(sample.data.begin() + first_frame_end, sample.data.end());
+    size_t image_end = 0;
+    while (frame[image_end] != 0) {
+        image_end += frame[image_end] + 1;
+    }
+    sample.data.resize(first_frame_end + image_end + 1);
+    sample.data.push_back(0x3B);
+    return sample;
+}
+
+// The render loop gifdec used before the expanded palette
+void RenderBytes(const gd_GIF* gif, uint8_t* buffer) {
+    int i = gif->fy * gif->width + gif->fx;
+    for (int j = 0; j < gif->fh; j++) {
+        for (int k = 0; k < gif->fw; k++) {
+            uint8_t index = gif->frame[(gif->fy + j) * gif->width + gif->fx + k];
+            const uint8_t* color = &gif->palette->colors[index * 3];
+            if (!gif->gce.transparency || index != gif->gce.tindex) {
+                buffer[(i + k) * 4 + 0] = *(color + 2);
+                buffer[(i + k) * 4 + 1] = *(color + 1);
+                buffer[(i + k) * 4 + 2] = *(color + 0);
+                buffer[(i + k) * 4 + 3] = 0xFF;
+            }
+        }
+        i += gif->width;
+    }
+}
+
+double Milliseconds(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool Load(const char* path, Sample& sample) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    sample.name = path;
+    sample.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
+
+bool Run(const Sample& sample, int loops, size_t cache_budget) {
+    // Each frame is rendered this many times to get a measurable time
+    const int kRenders = 20;
+    gd_GIF* gif = gd_open_gif_data(sample.data.data());
+    if (gif == nullptr) {
+        printf("%s: not a GIF\n", sample.name.c_str());
+        return false;
+    }
+    gif->loop_count = 0;
+    const int64_t bound_pixels = gd_loop_dirty_pixels(gif);
+    if (bound_pixels < 0) {
+        printf("%s: cannot scan the frame rects\n", sample.name.c_str());
+        gd_close_gif(gif);
+        return false;
+    }
+    const size_t canvas_bytes = (size_t)gif->width * gif->height * 4;
+    const uint64_t canvas_pixels = (uint64_t)gif->width * gif->height;
+    gd_render_frame(gif, gif->canvas);
+    lv_area_t area;
+    gd_take_dirty_area(gif, &area);
+    std::vector<uint8_t> previous(gif->canvas, gif->canvas + canvas_bytes);
+    std::vector<uint8_t> reference(canvas_bytes);
+    // LvglGif replays the first loop when its first frame composes the same over the end of it
+    std::vector<uint8_t> first_frame;
+    bool first_loop_repeats = false;
+    std::vector<CachedArea> cache;
+    std::vector<uint8_t> replay;
+    size_t cache_bytes = canvas_bytes;
+    const size_t stride = (size_t)gif->width * 4;
+
+    // Ends a GIF whose loop is never detected
+    const int kMaxFrames = 10000;
+    int frames = 0, still_frames = 0, first_loop_frames = 0;
+    uint64_t dirty_pixels = 0;
+    bool ok = true;
+    double decode_ms = 0, render_bytes_ms = 0, render_words_ms = 0;
+    for (int loop = 0; loop < loops && ok && frames < kMaxFrames;) {
+        uint32_t pos_before = gif->f_rw_p;
+        auto start = std::chrono::steady_clock::now();
+        int has_next = gd_get_frame(gif);
+        if (has_next == 0) {
+            // The last loop of a GIF that does not loop forever
+            break;
+        }
+        if (has_next < 0) {
+            printf("%s: decode error\n", sample.name.c_str());
+            ok = false;
+            break;
+        }
+        decode_ms += Milliseconds(start);
+        // Back at the first frame, a single frame GIF reads up to the same position
+        if (gif->f_rw_p <= pos_before) {
+            if (loop == 0) {
+                first_loop_frames = frames;
+            }
+            loop++;
+        }
+
+        // Rendering a frame again leaves the canvas as it is, so both kernels can be repeated
+        memcpy(reference.data(), gif->canvas, canvas_bytes);
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRenders; i++) {
+            RenderBytes(gif, reference.data());
+        }
+        render_bytes_ms += Milliseconds(start) / kRenders;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < kRenders; i++) {
+            gd_render_frame(gif, gif->canvas);
+        }
+        render_words_ms += Milliseconds(start) / kRenders;
+        frames++;
+        if (frames == 1) {
+            first_frame = reference;
+        } else if (frames == first_loop_frames + 1) {
+            first_loop_repeats = reference == first_frame;
+        }
+        if (memcmp(reference.data(), gif->canvas, canvas_bytes) != 0) {
+            printf("%s: frame %d renders differently from the byte loop\n", sample.name.c_str(), frames);
+            ok = false;
+            break;
+        }
+
+        bool dirty = gd_take_dirty_area(gif, &area);
+        if (dirty) {
+            dirty_pixels += (uint64_t)(area.x2 - area.x1 + 1) * (area.y2 - area.y1 + 1);
+        } else {
+            still_frames++;
+        }
+        for (int y = 0; y < gif->height && ok; y++) {
+            for (int x = 0; x < gif->width; x++) {
+                bool inside = dirty && x >= area.x1 && x <= area.x2 && y >= area.y1 && y <= area.y2;
+                size_t offset = ((size_t)y * gif->width + x) * 4;
+                if (!inside && memcmp(&previous[offset], &gif->canvas[offset], 4) != 0) {
+                    printf("%s: frame %d changed pixel (%d, %d) outside the dirty area\n",
+                           sample.name.c_str(), frames, x, y);
+                    ok = false;
+                    break;
+                }
+            }
+        }
+
+        // The frame cache keeps the first frame whole and the dirty area of every later one
+        const size_t index = (frames - 1) % (first_loop_frames > 0 ? first_loop_frames : frames);
+        if (loop == 0) {
+            CachedArea cached = {{0, 0, -1, -1}, {}};
+            if (frames > 1 && dirty) {
+                cached.area = area;
+                cached.pixels.resize((size_t)(area.x2 - area.x1 + 1) * (area.y2 - area.y1 + 1) * 4);
+                CopyArea(cached.pixels.data(), (area.x2 - area.x1 + 1) * 4,
+                         gif->canvas + area.y1 * stride + area.x1 * 4, stride, area);
+                cache_bytes += cached.pixels.size();
+            }
+            cache.push_back(std::move(cached));
+        } else if (first_loop_repeats && ok) {
+            // Replayed the way LvglGif::ShowCachedFrame() does, over the canvas of the previous frame
+            if (index == 0 && loop == 1) {
+                replay = previous;
+            }
+            if (index == 0 && dirty) {
+                const size_t offset = area.y1 * stride + area.x1 * 4;
+                CopyArea(replay.data() + offset, stride, first_frame.data() + offset, stride, area);
+            } else if (index > 0 && cache[index].area.x2 >= cache[index].area.x1) {
+                const lv_area_t& cached = cache[index].area;
+                CopyArea(replay.data() + cached.y1 * stride + cached.x1 * 4, stride, cache[index].pixels.data(),
+                         (cached.x2 - cached.x1 + 1) * 4, cached);
+            }
+            if (memcmp(replay.data(), gif->canvas, canvas_bytes) != 0) {
+                printf("%s: frame %d replays differently from the frame cache\n", sample.name.c_str(), frames);
+                ok = false;
+            }
+        }
+        memcpy(previous.data(), gif->canvas, canvas_bytes);
+    }
+    gd_close_gif(gif);
+    if (!ok || frames == 0) {
+        return false;
+    }
+
+    const uint64_t full_pixels = canvas_pixels * frames;
+    const size_t bound_bytes = canvas_bytes + bound_pixels * 4;
+    if (cache_bytes > bound_bytes) {
+        printf("%s: the frame cache takes %u bytes, over the %u bytes bound\n", sample.name.c_str(),
+               (unsigned)cache_bytes, (unsigned)bound_bytes);
+        return false;
+    }
+    const double frame_ms = (decode_ms + render_words_ms) / frames;
+    printf("%s\n", sample.name.c_str());
+    printf("  %d frames per loop, %d frames played, %d without change\n", first_loop_frames, frames, still_frames);
+    printf("  redrawn per frame: full canvas %.0f px, dirty area %.0f px (%.1f%%)\n",
+           (double)full_pixels / frames, (double)dirty_pixels / frames, 100.0 * dirty_pixels / full_pixels);
+    printf("  render per frame: byte loop %.4f ms, expanded palette %.4f ms (%.2fx)\n",
+           render_bytes_ms / frames, render_words_ms / frames, render_bytes_ms / render_words_ms);
+    printf("  decode and render: %.3f ms per frame, %.0f frames/s\n", frame_ms, 1000.0 / frame_ms);
+    printf("  frame cache: %u KB, %u KB of full canvases before, bound %u KB from the frame rects\n",
+           (unsigned)(cache_bytes / 1024), (unsigned)(canvas_bytes * first_loop_frames / 1024),
+           (unsigned)(bound_bytes / 1024));
+    if (bound_bytes <= cache_budget) {
+        printf("  fits the %u KB budget, loops after the %s replay without decoding\n",
+               (unsigned)(cache_budget / 1024), first_loop_repeats ? "first" : "second");
+    } else {
+        printf("  over the %u KB budget before anything is allocated, every loop decodes\n",
+               (unsigned)(cache_budget / 1024));
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    // CONFIG_GIF_FRAME_CACHE_SIZE_KB default, --cache-kb=N to try another budget
+    size_t cache_budget = 256 * 1024;
+    std::vector<Sample> samples;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--cache-kb=", 11) == 0) {
+            cache_budget = strtoul(argv[i] + 11, nullptr, 10) * 1024;
+            continue;
+        }
+        Sample sample;
+        if (!Load(argv[i], sample)) {
+            fprintf(stderr, "Cannot read %s\n", argv[i]);
+            return 1;
+        }
+        samples.push_back(std::move(sample));
+    }
+    if (samples.empty()) {
+        samples.push_back(SyntheticEmoji());
+        samples.push_back(SyntheticStill());
+    }
+
+    bool ok = true;
+    for (const auto& sample : samples) {
+        ok = Run(sample, 3, cache_budget) && ok;
+    }
+    return ok ? 0 : 1;
+}
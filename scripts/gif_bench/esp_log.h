@@ -0,0 +1,9 @@
+/* Host stand-in for esp_log.h */
+#ifndef GIF_BENCH_ESP_LOG_H
+#define GIF_BENCH_ESP_LOG_H
+
+#include <stdio.h>
+
+#define ESP_LOGW(tag, format, ...) fprintf(stderr, "W %s: " format "\n", tag, ##__VA_ARGS__)
+
+#endif /* GIF_BENCH_ESP_LOG_H */
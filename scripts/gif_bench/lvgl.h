@@ -0,0 +1,61 @@
+/* Host stand-in for the parts of lvgl.h that gifdec uses */
+#ifndef GIF_BENCH_LVGL_H
+#define GIF_BENCH_LVGL_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#define LV_GIF_CACHE_DECODE_DATA 0
+#define LV_DRAW_SW_ASM_HELIUM 2
+#define LV_USE_DRAW_SW_ASM 0
+
+typedef struct {
+    int32_t x1;
+    int32_t y1;
+    int32_t x2;
+    int32_t y2;
+} lv_area_t;
+
+typedef FILE * lv_fs_file_t;
+typedef int lv_fs_res_t;
+
+#define LV_FS_RES_OK 0
+#define LV_FS_MODE_RD 1
+#define LV_FS_SEEK_SET SEEK_SET
+#define LV_FS_SEEK_CUR SEEK_CUR
+
+static inline lv_fs_res_t lv_fs_open(lv_fs_file_t * fd, const char * path, int mode)
+{
+    (void)mode;
+    *fd = fopen(path, "rb");
+    return *fd ? LV_FS_RES_OK : 1;
+}
+
+static inline void lv_fs_read(lv_fs_file_t * fd, void * buf, uint32_t len, uint32_t * read)
+{
+    size_t n = fread(buf, 1, len, *fd);
+    if(read) *read = (uint32_t)n;
+}
+
+static inline void lv_fs_seek(lv_fs_file_t * fd, uint32_t pos, int whence)
+{
+    fseek(*fd, (long)pos, whence);
+}
+
+static inline void lv_fs_tell(lv_fs_file_t * fd, uint32_t * pos)
+{
+    *pos = (uint32_t)ftell(*fd);
+}
+
+static inline void lv_fs_close(lv_fs_file_t * fd)
+{
+    fclose(*fd);
+}
+
+#define lv_malloc malloc
+#define lv_realloc realloc
+#define lv_free free
+
+#endif /* GIF_BENCH_LVGL_H */
@@ -0,0 +1,33 @@
+/* Host stand-in for the parts of main/assets.h that the glyph store uses */
+#ifndef GLYPH_STORE_TEST_ASSETS_H
+#define GLYPH_STORE_TEST_ASSETS_H
+
+#include <esp_partition.h>
+
+#include <cstddef>
+#include <string>
+
+struct TextFontCapability {
+    bool glyph_push = false;
+    std::string bundle;
+    std::string charset;
+    int size = 0;
+    int bpp = 0;
+};
+
+class Assets {
+public:
+    static Assets& GetInstance() {
+        static Assets instance;
+        return instance;
+    }
+
+    // The whole RAM partition of bench.cc is the spare region
+    bool GetSpareRegion(size_t size, size_t& offset, const char*& mapped);
+    const esp_partition_t* partition() const { return &partition_; }
+
+private:
+    esp_partition_t partition_{};
+};
+
+#endif /* GLYPH_STORE_TEST_ASSETS_H */
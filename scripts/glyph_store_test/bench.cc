@@ -0,0 +1,249 @@
+/*
+ * Host test of main/display/lvgl_display/persistent_glyph_store.cc against a
+ * NOR flash model: an erase sets a sector to 0xFF, a write can only clear bits
+ * and counts every byte it programs over one that is not erased.
+ *
+ * A power loss is a write that stops after a given number of bytes. The store
+ * is then dropped and opened again, like after a reboot, more glyphs are
+ * written, and it is reopened once more. Every glyph written before the cut
+ * and after it has to be found with its bitmap, and nothing may be programmed
+ * over bytes that are not erased.
+ */
+#include "persistent_glyph_store.h"
+#include "assets.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+static constexpr size_t kSectorSize = 4096;
+
+static std::vector<uint8_t> flash(PersistentGlyphStore::kRegionSize, 0x5A);
+static long write_budget = -1;      // Bytes until the power is cut, -1 for none
+static size_t last_write_end = 0;
+static size_t overwrites = 0;
+static bool psram = true;
+
+esp_err_t esp_partition_write(const esp_partition_t*, size_t offset, const void* data, size_t size) {
+    if (offset + size > flash.size()) {
+        return ESP_FAIL;
+    }
+    size_t count = size;
+    if (write_budget >= 0 && static_cast<size_t>(write_budget) < size) {
+        count = write_budget;
+    }
+    auto bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < count; ++i) {
+        if (flash[offset + i] != 0xFF) {
+            overwrites++;
+        }
+        flash[offset + i] &= bytes[i];
+    }
+    if (count < size) {
+        write_budget = 0;
+        return ESP_FAIL;
+    }
+    if (write_budget >= 0) {
+        write_budget -= count;
+    }
+    last_write_end = offset + size;
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t*, size_t offset, size_t size) {
+    if (offset % kSectorSize != 0 || size % kSectorSize != 0 || offset + size > flash.size()) {
+        return ESP_FAIL;
+    }
+    if (write_budget == 0) {
+        return ESP_FAIL;
+    }
+    std::fill(flash.begin() + offset, flash.begin() + offset + size, 0xFF);
+    return ESP_OK;
+}
+
+uint32_t esp_partition_get_main_flash_sector_size(void) {
+    return kSectorSize;
+}
+
+bool Assets::GetSpareRegion(size_t size, size_t& offset, const char*& mapped) {
+    partition_.size = flash.size();
+    offset = 0;
+    mapped = reinterpret_cast<const char*>(flash.data());
+    return size <= flash.size();
+}
+
+bool TextGlyphStorageUsesPsram() {
+    return psram;
+}
+
+static TextFontCapability Capability() {
+    TextFontCapability capability;
+    capability.glyph_push = true;
+    capability.bundle = "noto-test";
+    capability.size = 16;
+    capability.bpp = 4;
+    return capability;
+}
+
+static TextGlyph MakeGlyph(uint32_t codepoint) {
+    TextGlyph glyph;
+    glyph.codepoint = codepoint;
+    glyph.adv_w = 16;
+    glyph.box_w = 16;
+    glyph.box_h = 16;
+    glyph.bitmap.resize(16 * 16 * 4 / 8);
+    for (size_t i = 0; i < glyph.bitmap.size(); ++i) {
+        glyph.bitmap[i] = static_cast<uint8_t>(codepoint * 31 + i);
+    }
+    return glyph;
+}
+
+static void Store(PersistentGlyphStore& store, uint32_t first, uint32_t count) {
+    std::vector<TextGlyph> glyphs;
+    for (uint32_t codepoint = first; codepoint < first + count; ++codepoint) {
+        glyphs.push_back(MakeGlyph(codepoint));
+    }
+    store.Queue(glyphs);
+    while (store.WritePending()) {
+        store.Commit();
+    }
+    store.Commit();
+}
+
+// Every expected code point is stored with its bitmap
+static bool Check(PersistentGlyphStore& store, const std::vector<uint32_t>& expected, const char* when) {
+    auto stored = store.Snapshot(Capability(), SIZE_MAX);
+    lv_font_t base{};
+    auto font = store.EnsureFont(&base);
+    if (font == nullptr && !expected.empty()) {
+        printf("  %s: no font\n", when);
+        return false;
+    }
+    for (uint32_t codepoint : expected) {
+        auto it = std::lower_bound(stored.begin(), stored.end(), codepoint);
+        if (it == stored.end() || *it != codepoint) {
+            printf("  %s: U+%04X is missing\n", when, (unsigned)codepoint);
+            return false;
+        }
+        auto dsc = static_cast<const lv_font_fmt_txt_dsc_t*>(font->dsc);
+        const auto& glyph_dsc = dsc->glyph_dsc[it - stored.begin() + 1];
+        auto glyph = MakeGlyph(codepoint);
+        if (memcmp(dsc->glyph_bitmap + glyph_dsc.bitmap_index, glyph.bitmap.data(), glyph.bitmap.size()) != 0) {
+            printf("  %s: U+%04X has a wrong bitmap\n", when, (unsigned)codepoint);
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<uint32_t> Range(uint32_t first, uint32_t count) {
+    std::vector<uint32_t> codepoints;
+    for (uint32_t codepoint = first; codepoint < first + count; ++codepoint) {
+        codepoints.push_back(codepoint);
+    }
+    return codepoints;
+}
+
+/*
+ * Writes `before` glyphs, cuts the power `cut` bytes into the next record (or that
+ * many bytes past the next sector boundary with `straddle`), then reopens, writes
+ * 60 more glyphs across several sectors and reopens again.
+ */
+static bool PowerLoss(const char* name, uint32_t before, long cut, bool straddle) {
+    std::fill(flash.begin(), flash.end(), 0x5A);
+    write_budget = -1;
+    overwrites = 0;
+    auto expected = Range(0x4E00, before);
+
+    auto store = std::make_unique<PersistentGlyphStore>();
+    store->Open(Capability());
+    Store(*store, 0x4E00, before);
+    if (straddle) {
+        // Fill up to the last record that ends inside this sector, the next one crosses
+        const size_t record = MakeGlyph(0).bitmap.size() + 24;
+        uint32_t codepoint = 0x4E00 + before;
+        while (last_write_end % kSectorSize + record <= kSectorSize) {
+            Store(*store, codepoint, 1);
+            expected.push_back(codepoint++);
+        }
+        cut += kSectorSize - last_write_end % kSectorSize;
+    }
+    write_budget = cut;
+    Store(*store, 0x9000, 1);
+    write_budget = -1;
+    store.reset();
+
+    store = std::make_unique<PersistentGlyphStore>();
+    store->Open(Capability());
+    bool ok = Check(*store, expected, "after the cut");
+    Store(*store, 0x6000, 60);
+    auto more = Range(0x6000, 60);
+    expected.insert(expected.end(), more.begin(), more.end());
+    ok = ok && Check(*store, expected, "before the reboot");
+    store.reset();
+
+    store = std::make_unique<PersistentGlyphStore>();
+    store->Open(Capability());
+    ok = ok && Check(*store, expected, "after the reboot");
+    if (overwrites != 0) {
+        printf("  %zu bytes programmed over bytes that were not erased\n", overwrites);
+        ok = false;
+    }
+    printf("%-40s %s\n", name, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static bool PendingLimit() {
+    std::fill(flash.begin(), flash.end(), 0xFF);
+    PersistentGlyphStore store;
+    store.Open(Capability());
+    const uint32_t count = 2 * PersistentGlyphStore::kMaxPendingBytes / MakeGlyph(0).bitmap.size();
+    Store(store, 0x4E00, count);
+    const size_t stored = store.Snapshot(Capability(), SIZE_MAX).size();
+    const size_t limit = PersistentGlyphStore::kMaxPendingBytes / MakeGlyph(0).bitmap.size();
+    bool ok = stored == limit;
+    printf("%-40s %s (%zu of %u glyphs queued in one turn)\n", "pending bytes limit", ok ? "ok" : "FAILED",
+           stored, (unsigned)count);
+    return ok;
+}
+
+static bool WithoutPsram() {
+    psram = false;
+    PersistentGlyphStore store;
+    bool ok = !store.Open(Capability());
+    psram = true;
+    printf("%-40s %s\n", "no store without PSRAM", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+static bool CloseAndReopen() {
+    std::fill(flash.begin(), flash.end(), 0xFF);
+    PersistentGlyphStore store;
+    store.Open(Capability());
+    Store(store, 0x4E00, 10);
+    store.Close();
+    lv_font_t base{};
+    bool ok = !store.is_open() && store.EnsureFont(&base) == nullptr;
+    ok = ok && store.Open(Capability()) && Check(store, Range(0x4E00, 10), "after reopening");
+    printf("%-40s %s\n", "close and reopen", ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main() {
+    bool ok = true;
+    ok = PowerLoss("power loss before the record", 20, 0, false) && ok;
+    ok = PowerLoss("power loss inside the record header", 20, 10, false) && ok;
+    ok = PowerLoss("power loss inside the bitmap", 20, 100, false) && ok;
+    ok = PowerLoss("power loss inside the store header", 0, 60, false) && ok;
+    ok = PowerLoss("power loss past a sector boundary", 5, 16, true) && ok;
+    ok = PowerLoss("power loss before a sector boundary", 5, -16, true) && ok;
+    ok = PendingLimit() && ok;
+    ok = WithoutPsram() && ok;
+    ok = CloseAndReopen() && ok;
+    printf("%s\n", ok ? "All tests passed" : "Some tests FAILED");
+    return ok ? 0 : 1;
+}
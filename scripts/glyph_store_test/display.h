@@ -0,0 +1,25 @@
+/* Host stand-in for the text glyph parts of main/display/display.h */
+#ifndef GLYPH_STORE_TEST_DISPLAY_H
+#define GLYPH_STORE_TEST_DISPLAY_H
+
+#include <lvgl.h>
+
+#include <cstdint>
+#include <vector>
+
+bool TextGlyphStorageUsesPsram();
+
+template <typename T>
+using TextGlyphVector = std::vector<T>;
+
+struct TextGlyph {
+    uint32_t codepoint = 0;
+    uint32_t adv_w = 0;
+    uint16_t box_w = 0;
+    uint16_t box_h = 0;
+    int16_t ofs_x = 0;
+    int16_t ofs_y = 0;
+    TextGlyphVector<uint8_t> bitmap;
+};
+
+#endif /* GLYPH_STORE_TEST_DISPLAY_H */
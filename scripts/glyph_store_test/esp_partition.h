@@ -0,0 +1,25 @@
+/* Host stand-in for esp_partition.h, backed by the flash model in bench.cc */
+#ifndef GLYPH_STORE_TEST_ESP_PARTITION_H
+#define GLYPH_STORE_TEST_ESP_PARTITION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef int esp_err_t;
+
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+static inline const char* esp_err_to_name(esp_err_t err) {
+    return err == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+typedef struct {
+    uint32_t size;
+} esp_partition_t;
+
+esp_err_t esp_partition_write(const esp_partition_t* partition, size_t offset, const void* data, size_t size);
+esp_err_t esp_partition_erase_range(const esp_partition_t* partition, size_t offset, size_t size);
+uint32_t esp_partition_get_main_flash_sector_size(void);
+
+#endif /* GLYPH_STORE_TEST_ESP_PARTITION_H */
@@ -0,0 +1,13 @@
+/* Host stand-in for esp_random.h */
+#ifndef GLYPH_STORE_TEST_ESP_RANDOM_H
+#define GLYPH_STORE_TEST_ESP_RANDOM_H
+
+#include <stdint.h>
+
+static inline uint32_t esp_random(void) {
+    static uint32_t state = 0x12345678;
+    state = state * 1664525 + 1013904223;
+    return state;
+}
+
+#endif /* GLYPH_STORE_TEST_ESP_RANDOM_H */
@@ -0,0 +1,64 @@
+/* Host stand-in for the font parts of lvgl.h that the glyph store fills in */
+#ifndef GLYPH_STORE_TEST_LVGL_H
+#define GLYPH_STORE_TEST_LVGL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define LV_FONT_SUBPX_NONE 0
+#define LV_FONT_KERNING_NONE 1
+#define LV_FONT_FMT_TXT_CMAP_SPARSE_TINY 2
+#define LV_FONT_FMT_TXT_PLAIN 0
+
+typedef struct {
+    uint32_t bitmap_index : 20;
+    uint32_t adv_w : 12;
+    uint8_t box_w;
+    uint8_t box_h;
+    int8_t ofs_x;
+    int8_t ofs_y;
+} lv_font_fmt_txt_glyph_dsc_t;
+
+typedef struct {
+    uint32_t range_start;
+    uint16_t range_length;
+    uint16_t glyph_id_start;
+    const uint16_t* unicode_list;
+    const void* glyph_id_ofs_list;
+    uint16_t list_length;
+    int type;
+} lv_font_fmt_txt_cmap_t;
+
+typedef struct {
+    const uint8_t* glyph_bitmap;
+    const lv_font_fmt_txt_glyph_dsc_t* glyph_dsc;
+    const lv_font_fmt_txt_cmap_t* cmaps;
+    const void* kern_dsc;
+    uint16_t kern_scale;
+    uint16_t cmap_num : 9;
+    uint16_t bpp : 4;
+    uint16_t kern_classes : 1;
+    uint16_t bitmap_format : 2;
+    uint8_t stride;
+} lv_font_fmt_txt_dsc_t;
+
+typedef struct _lv_font_t {
+    bool (*get_glyph_dsc)(const struct _lv_font_t*, void*, uint32_t, uint32_t);
+    const void* (*get_glyph_bitmap)(void*, void*);
+    void (*release_glyph)(const struct _lv_font_t*, void*);
+    int32_t line_height;
+    int32_t base_line;
+    uint8_t subpx : 2;
+    uint8_t kerning : 1;
+    uint8_t static_bitmap : 1;
+    int8_t underline_position;
+    int8_t underline_thickness;
+    const void* dsc;
+    const struct _lv_font_t* fallback;
+    void* user_data;
+} lv_font_t;
+
+static inline bool lv_font_get_glyph_dsc_fmt_txt(const lv_font_t*, void*, uint32_t, uint32_t) { return false; }
+static inline const void* lv_font_get_bitmap_fmt_txt(void*, void*) { return 0; }
+
+#endif /* GLYPH_STORE_TEST_LVGL_H */
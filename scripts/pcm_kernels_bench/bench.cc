@@ -0,0 +1,210 @@
+/*
+ * Host benchmark for main/audio/pcm_kernels.cc.
+ *
+ * Each kernel is timed against the scalar loop it replaced in NoAudioCodec,
+ * including the per-call allocation the old code made, and checked to produce
+ * the same samples first. The mix is timed against the plain saturating loop.
+ *
+ * Built with -DPCM_KERNELS_PIE_MODEL, the kernels take their ESP32-S3 vector
+ * path on a model of the PIE instructions (pie_model.h). The bench then checks
+ * that path against the scalar loops for every alignment of source and
+ * destination, short and odd lengths, in place extraction and edge values, and
+ * skips the timing, which means nothing for the model.
+ */
+#include "pcm_kernels.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// 60 ms at 16 kHz, the size of one encoder frame. Read at run time so the old
+// loops, inlined here, do not get a constant trip count the kernels never see.
+static volatile size_t g_samples = 960;
+static size_t kSamples;
+
+static void ReadOld(const int32_t* i2s, int16_t* dest, int samples) {
+    std::vector<int32_t> bit32_buffer(samples);
+    memcpy(bit32_buffer.data(), i2s, samples * sizeof(int32_t));
+    for (int i = 0; i < samples; i++) {
+        int32_t value = bit32_buffer[i] >> 12;
+        dest[i] = (value > INT16_MAX) ? INT16_MAX : (value < -INT16_MAX) ? -INT16_MAX : (int16_t)value;
+    }
+}
+
+static void WriteOld(const int16_t* data, int32_t* i2s, int samples, int volume) {
+    std::vector<int32_t> buffer(samples);
+    int32_t volume_factor = pow(double(volume) / 100.0, 2) * 65536;
+    for (int i = 0; i < samples; i++) {
+        int64_t temp = int64_t(data[i]) * volume_factor;
+        if (temp > INT32_MAX) {
+            buffer[i] = INT32_MAX;
+        } else if (temp < INT32_MIN) {
+            buffer[i] = INT32_MIN;
+        } else {
+            buffer[i] = static_cast<int32_t>(temp);
+        }
+    }
+    memcpy(i2s, buffer.data(), samples * sizeof(int32_t));
+}
+
+static uint32_t g_seed = 1;
+
+static uint32_t Random() {
+    g_seed = g_seed * 1103515245 + 12345;
+    return g_seed;
+}
+
+// Random samples with the extremes mixed in, so the clamps and saturation are hit
+template <typename T>
+static void Fill(std::vector<T>& data) {
+    for (auto& value : data) {
+        uint32_t r = Random();
+        switch (r >> 28) {
+        case 0: value = std::numeric_limits<T>::min(); break;
+        case 1: value = std::numeric_limits<T>::max(); break;
+        case 2: value = -std::numeric_limits<T>::max(); break;
+        default: value = static_cast<T>(r ^ (Random() << 16)); break;
+        }
+    }
+}
+
+static bool Fail(const char* kernel, size_t src_offset, size_t dest_offset, size_t samples) {
+    printf("%s differs from the scalar loop: source offset %zu, destination offset %zu, %zu samples\n", kernel,
+           src_offset, dest_offset, samples);
+    return false;
+}
+
+// The kernels against pcm::scalar, every byte offset of both buffers within a
+// 16-byte block and every length up to a few vectors past it
+static bool CheckAgainstScalar() {
+    const size_t kOffsets = 8;  // 16-bit samples per 16 bytes
+    const size_t kMaxSamples = 80;
+    std::vector<int32_t> i2s(kMaxSamples + kOffsets + 8);
+    std::vector<int16_t> pcm16(2 * (kMaxSamples + kOffsets) + 16);
+    std::vector<int16_t> base(kMaxSamples + kOffsets + 8);
+    std::vector<int16_t> expected(base.size()), actual(base.size());
+    for (size_t samples = 0; samples <= kMaxSamples; ++samples) {
+        for (size_t src_offset = 0; src_offset < kOffsets; ++src_offset) {
+            for (size_t dest_offset = 0; dest_offset < kOffsets; ++dest_offset) {
+                Fill(i2s);
+                Fill(pcm16);
+                Fill(base);
+                for (int shift : {0, 8, 12, 16, 31}) {
+                    expected = base;
+                    actual = base;
+                    const int32_t* src32 = i2s.data() + src_offset / 2;
+                    pcm::scalar::Convert32To16(src32, expected.data() + dest_offset, samples, shift);
+                    pcm::Convert32To16(src32, actual.data() + dest_offset, samples, shift);
+                    if (expected != actual) {
+                        return Fail("Convert32To16", src_offset / 2, dest_offset, samples);
+                    }
+                }
+                for (size_t channel : {0, 1}) {
+                    expected = base;
+                    actual = base;
+                    const int16_t* src = pcm16.data() + src_offset;
+                    pcm::scalar::ExtractChannel(src, expected.data() + dest_offset, samples, 2, channel);
+                    pcm::ExtractChannel(src, actual.data() + dest_offset, samples, 2, channel);
+                    if (expected != actual) {
+                        return Fail("ExtractChannel", src_offset, dest_offset, samples);
+                    }
+                }
+                for (int32_t gain : {32768, 32767, 23170, 1, 0}) {
+                    expected = base;
+                    actual = base;
+                    const int16_t* src = pcm16.data() + src_offset;
+                    pcm::scalar::Mix(expected.data() + dest_offset, src, samples, gain);
+                    pcm::Mix(actual.data() + dest_offset, src, samples, gain);
+                    if (expected != actual) {
+                        return Fail("Mix", src_offset, dest_offset, samples);
+                    }
+                }
+            }
+            // In place, as AudioService keeps the left channel of stereo input
+            std::vector<int16_t> in_place(pcm16.begin() + src_offset, pcm16.begin() + src_offset + 2 * samples);
+            std::vector<int16_t> reference(samples);
+            pcm::scalar::ExtractChannel(in_place.data(), reference.data(), samples, 2, 0);
+            std::vector<int16_t> shifted(2 * samples + kOffsets);
+            std::copy(in_place.begin(), in_place.end(), shifted.begin() + src_offset);
+            pcm::ExtractChannel(shifted.data() + src_offset, shifted.data() + src_offset, samples, 2, 0);
+            if (!std::equal(reference.begin(), reference.end(), shifted.begin() + src_offset)) {
+                return Fail("ExtractChannel in place", src_offset, src_offset, samples);
+            }
+        }
+    }
+    return true;
+}
+
+template <typename F>
+static double NsPerCall(size_t iterations, F&& f) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+        f();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+}
+
+static void Report(const char* name, double old_ns, double new_ns) {
+    printf("%-12s old %8.1f ns, kernel %8.1f ns (%.2fx)\n", name, old_ns, new_ns, old_ns / new_ns);
+}
+
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? strtoul(argv[1], nullptr, 10) : 200000;
+    kSamples = g_samples;
+    srand(1);
+    std::vector<int32_t> i2s(kSamples);
+    std::vector<int16_t> pcm(kSamples);
+    for (size_t i = 0; i < kSamples; ++i) {
+        i2s[i] = (int32_t)((uint32_t)rand() << 1 ^ (uint32_t)rand());
+        pcm[i] = (int16_t)rand();
+    }
+
+    // Correctness first
+    std::vector<int16_t> expected(kSamples), actual(kSamples);
+    std::vector<int32_t> expected32(kSamples), actual32(kSamples);
+    bool ok = true;
+    ReadOld(i2s.data(), expected.data(), kSamples);
+    pcm::Convert32To16(i2s.data(), actual.data(), kSamples, 12);
+    ok &= memcmp(expected.data(), actual.data(), kSamples * sizeof(int16_t)) == 0;
+    for (int volume = 0; volume <= 100; ++volume) {
+        WriteOld(pcm.data(), expected32.data(), kSamples, volume);
+        pcm::Convert16To32(pcm.data(), actual32.data(), kSamples, pcm::VolumeToGain(volume));
+        ok &= memcmp(expected32.data(), actual32.data(), kSamples * sizeof(int32_t)) == 0;
+    }
+    if (!ok) {
+        printf("Kernel output differs from the scalar code\n");
+        return 1;
+    }
+    if (!CheckAgainstScalar()) {
+        return 1;
+    }
+#if PCM_KERNELS_PIE_MODEL
+    printf("The PIE path matches the scalar loops for every alignment and length\n");
+    return 0;
+#else
+    printf("The kernels match the scalar loops for every alignment and length\n");
+#endif
+
+    printf("%zu samples per call, %zu calls\n", kSamples, iterations);
+    int16_t* out16 = actual.data();
+    int32_t* out32 = actual32.data();
+    Report("32->16", NsPerCall(iterations, [&] { ReadOld(i2s.data(), out16, kSamples); }),
+           NsPerCall(iterations, [&] { pcm::Convert32To16(i2s.data(), out16, kSamples, 12); }));
+    Report("volume", NsPerCall(iterations, [&] { WriteOld(pcm.data(), out32, kSamples, 70); }),
+           NsPerCall(iterations, [&] { pcm::Convert16To32(pcm.data(), out32, kSamples, pcm::VolumeToGain(70)); }));
+    Report("mix", NsPerCall(iterations, [&] {
+               for (size_t i = 0; i < kSamples; ++i) {
+                   int32_t sum = out16[i] + pcm[i];
+                   out16[i] = sum > INT16_MAX ? INT16_MAX : sum < -INT16_MAX ? -INT16_MAX : (int16_t)sum;
+               }
+           }),
+           NsPerCall(iterations, [&] { pcm::Mix(out16, pcm.data(), kSamples); }));
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Host model of the ESP32-S3 PIE instructions main/audio/pcm_kernels.cc uses,
+ * after the instruction descriptions in the ESP32-S3 Technical Reference Manual.
+ * Built into the kernels with -DPCM_KERNELS_PIE_MODEL, so the vector code, its
+ * unaligned head, stream bounds and tail run on the host and can be compared with
+ * the scalar loops. It models what the instructions are documented to do; only a
+ * run on an ESP32-S3 checks the instructions themselves.
+ */
+#ifndef PCM_KERNELS_BENCH_PIE_MODEL_H
+#define PCM_KERNELS_BENCH_PIE_MODEL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+namespace pie_model {
+
+struct Q {
+    uint8_t bytes[16];
+
+    template <typename T>
+    T Lane(int i) const {
+        T value;
+        memcpy(&value, bytes + i * sizeof(T), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    void SetLane(int i, T value) {
+        memcpy(bytes + i * sizeof(T), &value, sizeof(T));
+    }
+};
+
+inline Q q0, q1, q2, q3, q4, q5, q6, q7;
+inline uint32_t sar = 0;        // Core SAR, the shift of ee.vsr.32 and ee.vmul.s16
+inline uint32_t sar_byte = 0;   // Byte offset set by ee.ld.128.usar.ip
+
+// Every vector access goes to the 16-byte aligned block, the low address bits are ignored
+inline uint8_t* Block(const void* p) {
+    return reinterpret_cast<uint8_t*>(reinterpret_cast<uintptr_t>(p) & ~uintptr_t(15));
+}
+
+template <typename T>
+inline void Advance(T*& p) {
+    p = reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(p) + 16);
+}
+
+// ee.vldbc.16/32: one element loaded to every lane
+template <typename T>
+inline void Vldbc(Q& q, const T* p) {
+    for (int i = 0; i < 16 / int(sizeof(T)); ++i) {
+        q.SetLane<T>(i, *p);
+    }
+}
+
+// ee.ld.128.usar.ip: the aligned block, SAR_BYTE from the low address bits
+template <typename T>
+inline void LdUsar(Q& q, T*& p) {
+    sar_byte = reinterpret_cast<uintptr_t>(p) & 15;
+    memcpy(q.bytes, Block(p), 16);
+    Advance(p);
+}
+
+// ee.src.q.qup: the 16 bytes at SAR_BYTE of qs1:qs0, then qs0 = qs1
+inline void SrcQQup(Q& qa, Q& qs0, const Q& qs1) {
+    uint8_t concat[32];
+    memcpy(concat, qs0.bytes, 16);
+    memcpy(concat + 16, qs1.bytes, 16);
+    memcpy(qa.bytes, concat + sar_byte, 16);
+    qs0 = qs1;
+}
+
+template <typename T>
+inline void Vld(Q& q, T*& p) {
+    memcpy(q.bytes, Block(p), 16);
+    Advance(p);
+}
+
+template <typename T>
+inline void Vst(const Q& q, T*& p) {
+    memcpy(Block(p), q.bytes, 16);
+    Advance(p);
+}
+
+// ee.vsr.32: arithmetic right shift of every 32-bit lane by SAR
+inline void Vsr32(Q& qa, const Q& qs) {
+    for (int i = 0; i < 4; ++i) {
+        qa.SetLane<int32_t>(i, qs.Lane<int32_t>(i) >> (sar & 31));
+    }
+}
+
+template <typename T>
+inline void Vmax(Q& qa, const Q& qx, const Q& qy) {
+    for (int i = 0; i < 16 / int(sizeof(T)); ++i) {
+        qa.SetLane<T>(i, std::max(qx.Lane<T>(i), qy.Lane<T>(i)));
+    }
+}
+
+template <typename T>
+inline void Vmin(Q& qa, const Q& qx, const Q& qy) {
+    for (int i = 0; i < 16 / int(sizeof(T)); ++i) {
+        qa.SetLane<T>(i, std::min(qx.Lane<T>(i), qy.Lane<T>(i)));
+    }
+}
+
+// ee.vadds.s16: saturating add
+inline void VaddsS16(Q& qa, const Q& qx, const Q& qy) {
+    for (int i = 0; i < 8; ++i) {
+        int32_t sum = qx.Lane<int16_t>(i) + qy.Lane<int16_t>(i);
+        qa.SetLane<int16_t>(i, static_cast<int16_t>(std::min(std::max(sum, -32768), 32767)));
+    }
+}
+
+// ee.vmul.s16: the 32-bit products shifted right by SAR, low 16 bits kept
+inline void VmulS16(Q& qz, const Q& qx, const Q& qy) {
+    for (int i = 0; i < 8; ++i) {
+        int32_t product = qx.Lane<int16_t>(i) * qy.Lane<int16_t>(i);
+        qz.SetLane<int16_t>(i, static_cast<int16_t>(product >> (sar & 31)));
+    }
+}
+
+// ee.vunzip.16: the even 16-bit lanes of qs1:qs0 to qs0, the odd ones to qs1
+inline void Vunzip16(Q& qs0, Q& qs1) {
+    Q even, odd;
+    for (int i = 0; i < 8; ++i) {
+        const Q& source = i < 4 ? qs0 : qs1;
+        even.SetLane<int16_t>(i, source.Lane<int16_t>((i % 4) * 2));
+        odd.SetLane<int16_t>(i, source.Lane<int16_t>((i % 4) * 2 + 1));
+    }
+    qs0 = even;
+    qs1 = odd;
+}
+
+} // namespace pie_model
+
+#define PIE_WSR_SAR(value) (pie_model::sar = (value))
+#define PIE_VLDBC_16(q, p) pie_model::Vldbc<int16_t>(pie_model::q, p)
+#define PIE_VLDBC_32(q, p) pie_model::Vldbc<int32_t>(pie_model::q, p)
+#define PIE_LD_USAR(q, p) pie_model::LdUsar(pie_model::q, p)
+#define PIE_SRC_Q_QUP(qa, qs0, qs1) pie_model::SrcQQup(pie_model::qa, pie_model::qs0, pie_model::qs1)
+#define PIE_VLD_128(q, p) pie_model::Vld(pie_model::q, p)
+#define PIE_VST_128(q, p) pie_model::Vst(pie_model::q, p)
+#define PIE_VSR_32(qa, qs) pie_model::Vsr32(pie_model::qa, pie_model::qs)
+#define PIE_VMAX_S32(qa, qx, qy) pie_model::Vmax<int32_t>(pie_model::qa, pie_model::qx, pie_model::qy)
+#define PIE_VMIN_S32(qa, qx, qy) pie_model::Vmin<int32_t>(pie_model::qa, pie_model::qx, pie_model::qy)
+#define PIE_VMAX_S16(qa, qx, qy) pie_model::Vmax<int16_t>(pie_model::qa, pie_model::qx, pie_model::qy)
+#define PIE_VADDS_S16(qa, qx, qy) pie_model::VaddsS16(pie_model::qa, pie_model::qx, pie_model::qy)
+#define PIE_VMUL_S16(qz, qx, qy) pie_model::VmulS16(pie_model::qz, pie_model::qx, pie_model::qy)
+#define PIE_VUNZIP_16(qs0, qs1) pie_model::Vunzip16(pie_model::qs0, pie_model::qs1)
+
+#endif /* PCM_KERNELS_BENCH_PIE_MODEL_H */
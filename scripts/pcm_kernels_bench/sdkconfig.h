@@ -0,0 +1 @@
+/* Host stand-in for sdkconfig.h, no target is selected */